@@ -37,6 +37,11 @@ android {
         jvmTarget = "17"
     }
 
+    // Keep bundled models uncompressed so they can be opened as (fd, offset, length) regions
+    androidResources {
+        noCompress += "gguf"
+    }
+
     defaultConfig {
         // TODO: Specify your own unique Application ID (https://developer.android.com/studio/build/application-id.html).
         applicationId = "com.npucheck.app"
@@ -0,0 +1,166 @@
+#include "bandwidth_probe.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "native_common.h"
+
+namespace {
+
+constexpr size_t kMinArrayBytes = 32u << 20;
+constexpr size_t kMaxArrayBytes = 256u << 20;
+constexpr double kScalar = 3.0;
+
+enum StreamKernel { kCopy, kScale, kTriad };
+
+/**
+ * Bytes moved per element: copy and scale read one array and write one, triad reads two
+ */
+size_t bytes_per_element(StreamKernel kernel) {
+    return (kernel == kTriad ? 3 : 2) * sizeof(double);
+}
+
+void run_kernel(StreamKernel kernel, double* a, const double* b, const double* c, size_t begin, size_t end) {
+    switch (kernel) {
+        case kCopy:
+            for (size_t i = begin; i < end; i++) a[i] = b[i];
+            break;
+        case kScale:
+            for (size_t i = begin; i < end; i++) a[i] = kScalar * b[i];
+            break;
+        case kTriad:
+            for (size_t i = begin; i < end; i++) a[i] = b[i] + kScalar * c[i];
+            break;
+    }
+}
+
+/**
+ * Best-of-trials rate of one kernel over n elements split across n_threads.
+ * Threads are started before the clock and released together, so thread
+ * creation isn't timed.
+ */
+double time_kernel(StreamKernel kernel, int n_threads, int trials, double* a, const double* b,
+                   const double* c, size_t n) {
+    int64_t best_us = 0;
+    for (int trial = 0; trial < trials; trial++) {
+        std::atomic<int> ready{0};
+        std::atomic<bool> go{false};
+        std::vector<std::thread> workers;
+        const size_t chunk = (n + n_threads - 1) / n_threads;
+        for (int t = 1; t < n_threads; t++) {
+            workers.emplace_back([&, t] {
+                ready++;
+                while (!go.load(std::memory_order_acquire)) {}
+                run_kernel(kernel, a, b, c, std::min(n, t * chunk), std::min(n, (t + 1) * chunk));
+            });
+        }
+        while (ready.load() < n_threads - 1) {}
+
+        const int64_t t0 = now_us();
+        go.store(true, std::memory_order_release);
+        run_kernel(kernel, a, b, c, 0, std::min(n, chunk));
+        for (std::thread& w : workers) w.join();
+        const int64_t elapsed = now_us() - t0;
+        if (trial == 0 || elapsed < best_us) best_us = elapsed;
+    }
+    return best_us > 0 ? (double) (bytes_per_element(kernel) * n) / best_us / 1e3 : 0.0;
+}
+
+StreamKernelRates run_all(int n_threads, int trials, double* a, double* b, double* c, size_t n) {
+    StreamKernelRates rates;
+    rates.copy_gbps = time_kernel(kCopy, n_threads, trials, a, b, c, n);
+    rates.scale_gbps = time_kernel(kScale, n_threads, trials, b, a, c, n);
+    rates.triad_gbps = time_kernel(kTriad, n_threads, trials, a, b, c, n);
+    return rates;
+}
+
+size_t parse_cache_size(const char* text) {
+    char* end = nullptr;
+    const unsigned long long value = strtoull(text, &end, 10);
+    if (end && (*end == 'K' || *end == 'k')) return value << 10;
+    if (end && (*end == 'M' || *end == 'm')) return value << 20;
+    return value;
+}
+
+} // namespace
+
+double StreamKernelRates::best() const {
+    return std::max({copy_gbps, scale_gbps, triad_gbps});
+}
+
+size_t last_level_cache_bytes() {
+    size_t largest = 0;
+    for (int index = 0; index < 8; index++) {
+        char path[96];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+        FILE* f = fopen(path, "r");
+        if (!f) continue;
+        char buf[32];
+        if (fgets(buf, sizeof(buf), f)) largest = std::max(largest, parse_cache_size(buf));
+        fclose(f);
+    }
+    return largest;
+}
+
+bool measure_memory_bandwidth(int n_threads, int trials, BandwidthReport& out) {
+    if (n_threads <= 0) n_threads = (int) std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    trials = std::max(trials, 1);
+
+    out = BandwidthReport();
+    out.llc_bytes = last_level_cache_bytes();
+    out.array_bytes = std::min(std::max(out.llc_bytes * 4, kMinArrayBytes), kMaxArrayBytes);
+    out.threads = n_threads;
+    out.trials = trials;
+
+    const size_t n = out.array_bytes / sizeof(double);
+    std::unique_ptr<double[]> a(new (std::nothrow) double[n]);
+    std::unique_ptr<double[]> b(new (std::nothrow) double[n]);
+    std::unique_ptr<double[]> c(new (std::nothrow) double[n]);
+    if (!a || !b || !c) {
+        LOGE("BANDWIDTH: Failed to allocate 3 x %zu MiB", out.array_bytes >> 20);
+        return false;
+    }
+    // Touch every page up front so page faults aren't timed
+    for (size_t i = 0; i < n; i++) {
+        a[i] = 1.0;
+        b[i] = 2.0;
+        c[i] = 0.5;
+    }
+
+    out.single = run_all(1, trials, a.get(), b.get(), c.get(), n);
+    out.multi = run_all(n_threads, trials, a.get(), b.get(), c.get(), n);
+
+    // Read a result back so the stores can't be treated as dead
+    volatile double sink = a[n / 2] + b[n - 1];
+    (void) sink;
+
+    LOGI("BANDWIDTH: 1 thread copy %.1f / scale %.1f / triad %.1f GB/s; "
+         "%d threads copy %.1f / scale %.1f / triad %.1f GB/s (3 x %zu MiB, LLC %zu KiB)",
+         out.single.copy_gbps, out.single.scale_gbps, out.single.triad_gbps, n_threads,
+         out.multi.copy_gbps, out.multi.scale_gbps, out.multi.triad_gbps,
+         out.array_bytes >> 20, out.llc_bytes >> 10);
+    return true;
+}
+
+std::string bandwidth_report_json(const BandwidthReport& report) {
+    auto rates_json = [](const StreamKernelRates& r) {
+        char buf[128];
+        snprintf(buf, sizeof(buf), "{\"copy\":%.3f,\"scale\":%.3f,\"triad\":%.3f}",
+                 r.copy_gbps, r.scale_gbps, r.triad_gbps);
+        return std::string(buf);
+    };
+    char buf[160];
+    snprintf(buf, sizeof(buf), "{\"llc_bytes\":%zu,\"array_bytes\":%zu,\"threads\":%d,\"trials\":%d",
+             report.llc_bytes, report.array_bytes, report.threads, report.trials);
+    std::string json = buf;
+    json += ",\"single\":" + rates_json(report.single) + ",\"multi\":" + rates_json(report.multi);
+    snprintf(buf, sizeof(buf), ",\"best_gbps\":%.3f}",
+             std::max(report.single.best(), report.multi.best()));
+    return json + buf;
+}
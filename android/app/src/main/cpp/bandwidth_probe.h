@@ -0,0 +1,48 @@
+#pragma once
+
+// STREAM-style memory bandwidth probe (copy, scale, triad).
+//
+// Batch-1 decoding reads every weight once per token, so the sustained DRAM
+// bandwidth divided by the bytes touched per token is an upper bound on the
+// decode rate of the device, independent of the engine.
+
+#include <cstddef>
+#include <string>
+
+struct StreamKernelRates {
+    double copy_gbps = 0.0;  // a[i] = b[i]
+    double scale_gbps = 0.0; // a[i] = q * b[i]
+    double triad_gbps = 0.0; // a[i] = b[i] + q * c[i]
+
+    double best() const;
+};
+
+struct BandwidthReport {
+    size_t llc_bytes = 0;   // Largest cache reported by sysfs, 0 if unknown
+    size_t array_bytes = 0; // Per array; three arrays are allocated
+    int threads = 0;        // Threads of the multi-threaded pass
+    int trials = 0;
+    StreamKernelRates single;
+    StreamKernelRates multi;
+};
+
+/**
+ * Size of the largest CPU cache listed under /sys/devices/system/cpu/cpu0/cache.
+ * Returns: 0 if sysfs doesn't expose it (common for SoC system caches)
+ */
+size_t last_level_cache_bytes();
+
+/**
+ * Run copy/scale/triad single-threaded and on n_threads threads (<= 0: one per
+ * online CPU). Each array is sized at 4x the last-level cache, at least 32 MiB,
+ * so the kernels stream from DRAM; each rate is the best of `trials` runs, as in
+ * STREAM, and counts the bytes the kernel reads and writes (no write-allocate).
+ * Returns: false if the arrays could not be allocated
+ */
+bool measure_memory_bandwidth(int n_threads, int trials, BandwidthReport& out);
+
+/**
+ * JSON: {"llc_bytes","array_bytes","threads","trials",
+ * "single":{"copy","scale","triad"},"multi":{..},"best_gbps"}, rates in GB/s
+ */
+std::string bandwidth_report_json(const BandwidthReport& report);
@@ -0,0 +1,195 @@
+#include "bench_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+/**
+ * Linear-interpolated quantile of sorted data, q in [0, 1]
+ */
+double quantile_sorted(const std::vector<double>& sorted, double q) {
+    if (sorted.empty()) return 0.0;
+    const double pos = q * (sorted.size() - 1);
+    const size_t lo = (size_t) std::floor(pos);
+    const size_t hi = std::min(lo + 1, sorted.size() - 1);
+    return sorted[lo] + (pos - lo) * (sorted[hi] - sorted[lo]);
+}
+
+} // namespace
+
+double student_t95(int dof) {
+    static const double kTable[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+    };
+    if (dof <= 0) return 0.0;
+    if (dof <= 30) return kTable[dof - 1];
+    if (dof <= 60) return 2.000;
+    if (dof <= 120) return 1.980;
+    return 1.960;
+}
+
+SampleStats compute_sample_stats(const std::vector<double>& samples) {
+    SampleStats stats;
+    if (samples.empty()) return stats;
+
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+
+    std::vector<double> kept;
+    if (samples.size() >= 4) {
+        const double q1 = quantile_sorted(sorted, 0.25);
+        const double q3 = quantile_sorted(sorted, 0.75);
+        const double fence = 1.5 * (q3 - q1);
+        for (size_t i = 0; i < samples.size(); i++) {
+            if (samples[i] < q1 - fence || samples[i] > q3 + fence) {
+                stats.outliers.push_back((int) i);
+            } else {
+                kept.push_back(samples[i]);
+            }
+        }
+        std::sort(kept.begin(), kept.end());
+    } else {
+        kept = sorted;
+    }
+
+    stats.n = (int) kept.size();
+    stats.n_outliers = (int) stats.outliers.size();
+    stats.min = kept.front();
+    stats.max = kept.back();
+    stats.median = quantile_sorted(kept, 0.5);
+
+    double sum = 0.0;
+    for (const double v : kept) sum += v;
+    stats.mean = sum / stats.n;
+
+    if (stats.n > 1) {
+        double sq = 0.0;
+        for (const double v : kept) sq += (v - stats.mean) * (v - stats.mean);
+        stats.stddev = std::sqrt(sq / (stats.n - 1));
+    }
+    const double half_width = student_t95(stats.n - 1) * stats.stddev / std::sqrt((double) stats.n);
+    stats.ci95_low = stats.mean - half_width;
+    stats.ci95_high = stats.mean + half_width;
+    return stats;
+}
+
+std::string sample_stats_json(const SampleStats& stats) {
+    char buf[384];
+    snprintf(buf, sizeof(buf),
+             "{\"n\":%d,\"n_outliers\":%d,\"mean\":%.4f,\"median\":%.4f,\"stddev\":%.4f,"
+             "\"ci95_low\":%.4f,\"ci95_high\":%.4f,\"min\":%.4f,\"max\":%.4f,\"outliers\":[",
+             stats.n, stats.n_outliers, stats.mean, stats.median, stats.stddev,
+             stats.ci95_low, stats.ci95_high, stats.min, stats.max);
+    std::string json = buf;
+    for (size_t i = 0; i < stats.outliers.size(); i++) {
+        json += (i > 0 ? "," : "") + std::to_string(stats.outliers[i]);
+    }
+    json += "]}";
+    return json;
+}
+
+LinearFit fit_line(const std::vector<double>& xs, const std::vector<double>& ys) {
+    LinearFit fit;
+    const size_t n = std::min(xs.size(), ys.size());
+    if (n < 2) return fit;
+
+    double mean_x = 0.0, mean_y = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        mean_x += xs[i];
+        mean_y += ys[i];
+    }
+    mean_x /= n;
+    mean_y /= n;
+
+    double sxx = 0.0, sxy = 0.0, syy = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        sxx += (xs[i] - mean_x) * (xs[i] - mean_x);
+        sxy += (xs[i] - mean_x) * (ys[i] - mean_y);
+        syy += (ys[i] - mean_y) * (ys[i] - mean_y);
+    }
+    if (sxx <= 0.0) return fit;
+
+    fit.slope = sxy / sxx;
+    fit.intercept = mean_y - fit.slope * mean_x;
+    fit.r2 = syy > 0.0 ? (sxy * sxy) / (sxx * syy) : 0.0;
+    return fit;
+}
+
+namespace {
+
+constexpr int kExactMaxSamples = 20;
+
+/**
+ * P(U <= u) for tie-free samples of sizes m and n. The counts of U are the
+ * coefficients of the Gaussian binomial [m + n choose m](q), built as
+ * prod_{i=1..m} (1 - q^(n+i)) / (1 - q^i); they stay exact in doubles up to 20 x 20.
+ */
+double mann_whitney_exact_cdf(int m, int n, double u) {
+    const int max_u = m * n;
+    std::vector<double> c(max_u + 1, 0.0);
+    c[0] = 1.0;
+    for (int i = 1; i <= m; i++) {
+        for (int k = max_u; k >= n + i; k--) c[k] -= c[k - n - i]; // * (1 - q^(n+i))
+        for (int k = i; k <= max_u; k++) c[k] += c[k - i];         // / (1 - q^i)
+    }
+    double total = 0.0, below = 0.0;
+    for (int k = 0; k <= max_u; k++) {
+        total += c[k];
+        if (k <= u) below += c[k];
+    }
+    return total > 0 ? below / total : 1.0;
+}
+
+} // namespace
+
+MannWhitneyResult mann_whitney_u(const std::vector<double>& a, const std::vector<double>& b) {
+    MannWhitneyResult result;
+    result.n_a = (int) a.size();
+    result.n_b = (int) b.size();
+    if (a.empty() || b.empty()) return result;
+
+    // (value, from a) sorted by value; midranks over runs of equal values
+    std::vector<std::pair<double, bool>> all;
+    all.reserve(a.size() + b.size());
+    for (double v : a) all.emplace_back(v, true);
+    for (double v : b) all.emplace_back(v, false);
+    std::sort(all.begin(), all.end(), [](const auto& x, const auto& y) { return x.first < y.first; });
+
+    const double n = (double) all.size();
+    double rank_sum_a = 0.0, tie_term = 0.0;
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j < all.size() && all[j].first == all[i].first) j++;
+        const double t = (double) (j - i);
+        const double midrank = (i + 1 + j) / 2.0; // Ranks i+1 .. j
+        for (size_t k = i; k < j; k++) {
+            if (all[k].second) rank_sum_a += midrank;
+        }
+        tie_term += t * t * t - t;
+        i = j;
+    }
+
+    const double n_a = result.n_a, n_b = result.n_b;
+    result.u = rank_sum_a - n_a * (n_a + 1) / 2.0;
+    result.prob_a_greater = result.u / (n_a * n_b);
+
+    if (tie_term == 0.0 && result.n_a <= kExactMaxSamples && result.n_b <= kExactMaxSamples) {
+        // U of a is an integer without ties; the null distribution is symmetric
+        const double lower = mann_whitney_exact_cdf(result.n_a, result.n_b, result.u);
+        const double upper = 1.0 - mann_whitney_exact_cdf(result.n_a, result.n_b, result.u - 1.0);
+        result.p_value = std::min(1.0, 2.0 * std::min(lower, upper));
+        result.exact = true;
+        return result;
+    }
+
+    const double mean = n_a * n_b / 2.0;
+    const double variance = n_a * n_b / 12.0 * ((n + 1.0) - tie_term / (n * (n - 1.0)));
+    if (variance <= 0.0) return result; // Every value equal: no evidence either way
+    const double z = std::max(0.0, std::fabs(result.u - mean) - 0.5) / std::sqrt(variance);
+    result.p_value = std::min(1.0, std::erfc(z / std::sqrt(2.0)));
+    return result;
+}
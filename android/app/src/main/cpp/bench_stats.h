@@ -0,0 +1,69 @@
+#pragma once
+
+// Summary statistics for repeated benchmark measurements.
+
+#include <string>
+#include <vector>
+
+struct SampleStats {
+    int n = 0;              // Samples kept after outlier rejection
+    int n_outliers = 0;
+    double mean = 0.0;
+    double median = 0.0;
+    double stddev = 0.0;    // Sample standard deviation (n - 1)
+    double ci95_low = 0.0;  // 95% confidence interval of the mean (Student's t)
+    double ci95_high = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+    std::vector<int> outliers; // Indices into the input samples
+};
+
+/**
+ * Summarize samples after rejecting outliers.
+ *
+ * Outlier rule (Tukey fences): with Q1/Q3 the lower/upper quartiles and
+ * IQR = Q3 - Q1, a sample outside [Q1 - 1.5 * IQR, Q3 + 1.5 * IQR] is rejected.
+ * The rule needs at least 4 samples; smaller sets are kept as-is. All remaining
+ * statistics are computed over the kept samples only.
+ */
+SampleStats compute_sample_stats(const std::vector<double>& samples);
+
+/**
+ * Two-sided 95% critical value of Student's t for the given degrees of freedom
+ */
+double student_t95(int dof);
+
+/**
+ * JSON object for the Dart side, e.g. {"n":10,"mean":...,"outliers":[3]}
+ */
+std::string sample_stats_json(const SampleStats& stats);
+
+struct LinearFit {
+    double slope = 0.0;
+    double intercept = 0.0;
+    double r2 = 0.0; // Coefficient of determination, 0 if undefined
+};
+
+/**
+ * Ordinary least-squares line y = intercept + slope * x through the points.
+ * Needs two distinct x values; otherwise the fit is all zeros.
+ */
+LinearFit fit_line(const std::vector<double>& xs, const std::vector<double>& ys);
+
+struct MannWhitneyResult {
+    int n_a = 0;
+    int n_b = 0;
+    double u = 0.0;             // U of a: pairs with a > b, ties counting half
+    double prob_a_greater = 0.5; // U / (n_a * n_b), P(a > b) + P(a = b) / 2
+    double p_value = 1.0;       // Two-sided
+    bool exact = false;         // Exact null distribution rather than the normal approximation
+};
+
+/**
+ * Mann-Whitney U test of whether samples a and b come from the same
+ * distribution, without assuming either is normal (latencies rarely are).
+ * Ranks are midranks over ties. Small tie-free samples (both sides <= 20)
+ * use the exact distribution of U; larger ones the normal approximation with
+ * tie and continuity corrections. O((n_a + n_b) log(n_a + n_b)).
+ */
+MannWhitneyResult mann_whitney_u(const std::vector<double>& a, const std::vector<double>& b);
@@ -0,0 +1,242 @@
+#include "cpu_variants.h"
+
+#include <dlfcn.h>
+#include <mutex>
+#include <sstream>
+#include <sys/stat.h>
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+#include "ggml-backend.h"
+#include "native_common.h"
+
+// Comma-separated variant names, filled in by CMake from the ggml-cpu-* targets
+#ifndef NG_CPU_VARIANTS
+#define NG_CPU_VARIANTS ""
+#endif
+
+namespace {
+
+std::mutex g_variant_mutex; // Guards the two below
+std::string g_active_variant;
+bool g_forced = false;
+
+std::vector<std::string> built_variants() {
+    std::vector<std::string> names;
+    std::stringstream ss(NG_CPU_VARIANTS);
+    std::string name;
+    while (std::getline(ss, name, ',')) {
+        if (!name.empty()) names.push_back(name);
+    }
+    return names;
+}
+
+/**
+ * Directory holding libneural_gauge_native.so; variants are installed next to it.
+ * On Android with uncompressed libs the file isn't on disk and "" is returned,
+ * in which case the linker resolves bare library names from the APK.
+ */
+std::string own_library_dir() {
+    Dl_info info {};
+    if (!dladdr((void*) &own_library_dir, &info) || !info.dli_fname) return "";
+    std::string path = info.dli_fname;
+    const size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos) return "";
+    struct stat st {};
+    if (stat(path.c_str(), &st) != 0) return "";
+    return path.substr(0, slash + 1);
+}
+
+std::string variant_library(const std::string& variant) {
+    const std::string file = "libggml-cpu-" + variant + ".so";
+    const std::string dir = own_library_dir();
+    struct stat st {};
+    if (!dir.empty() && stat((dir + file).c_str(), &st) == 0) return dir + file;
+    return file;
+}
+
+/**
+ * Score a variant without registering it: each variant's ggml_backend_score()
+ * checks the CPU features it was compiled for
+ */
+int score_variant(const std::string& variant) {
+    void* handle = dlopen(variant_library(variant).c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) return 0;
+    int score = 0;
+    auto score_fn = (ggml_backend_score_t) dlsym(handle, "ggml_backend_score");
+    if (score_fn) score = score_fn();
+    dlclose(handle);
+    return score;
+}
+
+std::vector<std::string> detected_features() {
+    std::vector<std::string> features;
+#if defined(__aarch64__) && defined(__linux__)
+    const unsigned long hwcap = getauxval(AT_HWCAP);
+    const unsigned long hwcap2 = getauxval(AT_HWCAP2);
+    (void) hwcap2;
+    if (hwcap & HWCAP_ASIMD) features.push_back("neon");
+    if (hwcap & HWCAP_ASIMDHP) features.push_back("fp16");
+    if (hwcap & HWCAP_ASIMDDP) features.push_back("dotprod");
+    if (hwcap & HWCAP_SVE) features.push_back("sve");
+#ifdef HWCAP2_I8MM
+    if (hwcap2 & HWCAP2_I8MM) features.push_back("i8mm");
+#endif
+#ifdef HWCAP2_SVE2
+    if (hwcap2 & HWCAP2_SVE2) features.push_back("sve2");
+#endif
+#ifdef HWCAP2_SME
+    if (hwcap2 & HWCAP2_SME) features.push_back("sme");
+#endif
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) features.push_back("sse4.2");
+    if (__builtin_cpu_supports("avx")) features.push_back("avx");
+    if (__builtin_cpu_supports("avx2")) features.push_back("avx2");
+    if (__builtin_cpu_supports("fma")) features.push_back("fma");
+    if (__builtin_cpu_supports("avx512f")) features.push_back("avx512f");
+    if (__builtin_cpu_supports("avx512bw")) features.push_back("avx512bw");
+    if (__builtin_cpu_supports("avx512vnni")) features.push_back("avx512vnni");
+#endif
+    return features;
+}
+
+/**
+ * Caller holds g_variant_mutex
+ */
+bool select_locked(const char* variant, std::string& error) {
+    const std::vector<std::string> names = built_variants();
+    if (names.empty()) {
+        g_active_variant = "static";
+        if (variant && *variant) {
+            error = "CPU backend is linked statically, no variants to choose from";
+            return false;
+        }
+        return true;
+    }
+
+    std::string chosen;
+    if (variant && *variant) {
+        if (score_variant(variant) <= 0) {
+            error = std::string("variant ") + variant + " is not built or not supported by this CPU";
+            return false;
+        }
+        chosen = variant;
+    } else {
+        int best = 0;
+        for (const std::string& name : names) {
+            const int score = score_variant(name);
+            if (score > best) {
+                best = score;
+                chosen = name;
+            }
+        }
+        if (chosen.empty()) {
+            error = "no CPU variant supports this CPU";
+            return false;
+        }
+    }
+
+    if (ggml_backend_reg_t current = ggml_backend_reg_by_name("CPU")) {
+        ggml_backend_unload(current);
+    }
+    if (!ggml_backend_load(variant_library(chosen).c_str())) {
+        g_active_variant.clear();
+        error = "failed to load libggml-cpu-" + chosen + ".so";
+        return false;
+    }
+    g_active_variant = chosen;
+    g_forced = variant && *variant;
+    LOGI("CPU: Using backend variant %s%s", chosen.c_str(), g_forced ? " (forced)" : "");
+    return true;
+}
+
+} // namespace
+
+std::vector<CpuVariantInfo> cpu_variants_list() {
+    std::vector<CpuVariantInfo> variants;
+    for (const std::string& name : built_variants()) {
+        CpuVariantInfo info;
+        info.name = name;
+        info.score = score_variant(name);
+        variants.push_back(info);
+    }
+    return variants;
+}
+
+void cpu_backend_ensure_loaded() {
+    std::lock_guard<std::mutex> lock(g_variant_mutex);
+    if (!g_active_variant.empty()) return;
+    std::string error;
+    if (!select_locked(nullptr, error)) LOGE("CPU: %s", error.c_str());
+}
+
+bool cpu_backend_select(const char* variant, std::string& error) {
+    std::lock_guard<std::mutex> lock(g_variant_mutex);
+    return select_locked(variant, error);
+}
+
+std::string cpu_backend_active_variant() {
+    std::lock_guard<std::mutex> lock(g_variant_mutex);
+    return g_active_variant;
+}
+
+void* cpu_backend_symbol(const char* name) {
+    ggml_backend_reg_t reg = ggml_backend_reg_by_name("CPU");
+    if (!reg) return nullptr;
+    if (void* fn = ggml_backend_reg_get_proc_address(reg, name)) return fn;
+
+    const std::string active = cpu_backend_active_variant();
+    if (active.empty() || active == "static") return dlsym(RTLD_DEFAULT, name);
+    // The variant is loaded already; RTLD_NOLOAD only takes another reference to it
+    void* handle = dlopen(variant_library(active).c_str(), RTLD_NOW | RTLD_NOLOAD);
+    if (!handle) return nullptr;
+    void* fn = dlsym(handle, name);
+    dlclose(handle);
+    return fn;
+}
+
+std::string cpu_backend_info_json() {
+    std::string active;
+    bool forced;
+    {
+        std::lock_guard<std::mutex> lock(g_variant_mutex);
+        active = g_active_variant;
+        forced = g_forced;
+    }
+
+    std::string json = "{\"dynamic\":" + std::string(built_variants().empty() ? "false" : "true");
+    json += ",\"active\":\"" + json_escape(active) + "\",\"forced\":" + (forced ? "true" : "false");
+
+    json += ",\"detected_features\":[";
+    const std::vector<std::string> features = detected_features();
+    for (size_t i = 0; i < features.size(); i++) {
+        json += (i > 0 ? ",\"" : "\"") + features[i] + "\"";
+    }
+
+    // What the registered backend reports it was compiled with (e.g. DOTPROD, MATMUL_INT8)
+    json += "],\"backend_features\":{";
+    ggml_backend_reg_t reg = ggml_backend_reg_by_name("CPU");
+    auto get_features = reg ? (ggml_backend_get_features_t) ggml_backend_reg_get_proc_address(
+                                  reg, "ggml_backend_get_features")
+                            : nullptr;
+    if (get_features) {
+        bool first = true;
+        for (ggml_backend_feature* f = get_features(reg); f && f->name; f++) {
+            json += (first ? "\"" : ",\"") + json_escape(f->name) + "\":\"" + json_escape(f->value) + "\"";
+            first = false;
+        }
+    }
+
+    json += "},\"variants\":[";
+    const std::vector<CpuVariantInfo> variants = cpu_variants_list();
+    for (size_t i = 0; i < variants.size(); i++) {
+        json += (i > 0 ? "," : "") + std::string("{\"name\":\"") + json_escape(variants[i].name) +
+                "\",\"score\":" + std::to_string(variants[i].score) + "}";
+    }
+    json += "]}";
+    return json;
+}
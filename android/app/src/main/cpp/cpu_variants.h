@@ -0,0 +1,50 @@
+#pragma once
+
+// Runtime selection among the ggml CPU backend variants built with
+// GGML_BACKEND_DL + GGML_CPU_ALL_VARIANTS (libggml-cpu-<variant>.so).
+
+#include <string>
+#include <vector>
+
+struct CpuVariantInfo {
+    std::string name;   // e.g. "android_armv8.2_1"
+    int score = 0;      // ggml_backend_score(): 0 = not supported on this CPU
+};
+
+/**
+ * Variants built into this package, with their score on this CPU.
+ * Empty when the backends are linked statically (no GGML_BACKEND_DL).
+ */
+std::vector<CpuVariantInfo> cpu_variants_list();
+
+/**
+ * Make sure a CPU backend is registered before a model is loaded; on first use
+ * picks the highest-scoring variant. No-op for static builds.
+ */
+void cpu_backend_ensure_loaded();
+
+/**
+ * Replace the registered CPU backend with the given variant, or the best one
+ * for variant == "" / nullptr. No model may be loaded while this runs.
+ * Returns: false with error set if the variant is unknown or unsupported here
+ */
+bool cpu_backend_select(const char* variant, std::string& error);
+
+/**
+ * Variant currently registered ("static" for non-DL builds, "" if none yet)
+ */
+std::string cpu_backend_active_variant();
+
+/**
+ * Address of a function the registered CPU backend exports: from its proc
+ * address table, else from the dynamic symbols of its library (not every
+ * function is in the table, e.g. ggml_threadpool_pause).
+ * Returns: nullptr if no CPU backend is registered or it lacks name
+ */
+void* cpu_backend_symbol(const char* name);
+
+/**
+ * JSON: {"dynamic","active","forced","detected_features":[..],
+ * "backend_features":{..},"variants":[{"name","score"}..]}
+ */
+std::string cpu_backend_info_json();
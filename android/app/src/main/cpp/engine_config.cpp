@@ -0,0 +1,219 @@
+#include "engine_config.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <unistd.h>
+
+#include "native_common.h"
+
+namespace {
+
+constexpr int32_t kMinContext = 64;
+constexpr int32_t kDefaultThreads = 4;
+constexpr int32_t kDefaultPoll = 50; // ggml_threadpool_params_default
+
+/**
+ * KV cache types llama.cpp accepts (see kv_cache_types in common/arg.cpp)
+ */
+bool is_kv_cache_type(int32_t type) {
+    switch (type) {
+        case GGML_TYPE_F32:
+        case GGML_TYPE_F16:
+        case GGML_TYPE_BF16:
+        case GGML_TYPE_Q8_0:
+        case GGML_TYPE_Q4_0:
+        case GGML_TYPE_Q4_1:
+        case GGML_TYPE_Q5_0:
+        case GGML_TYPE_Q5_1:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool is_quantized(int32_t type) {
+    return type != GGML_TYPE_F32 && type != GGML_TYPE_F16 && type != GGML_TYPE_BF16;
+}
+
+int32_t online_cpus() {
+    return (int32_t) std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+/**
+ * Clamp value into [lo, hi], logging the change under name
+ */
+int32_t clamp_logged(const char* name, int32_t value, int32_t lo, int32_t hi) {
+    const int32_t clamped = std::min(std::max(value, lo), hi);
+    if (clamped != value) LOGI("CONFIG: %s %d -> %d", name, value, clamped);
+    return clamped;
+}
+
+// Per thread, so the quant comparison thread can create contexts concurrently
+thread_local bool t_capturing = false;
+thread_local EngineContextReport t_report;
+
+/**
+ * Value of "... = <value> MiB" in a llama.cpp log line
+ */
+double parse_mib(const char* text) {
+    const char* eq = strrchr(text, '=');
+    return eq ? strtod(eq + 1, nullptr) : 0.0;
+}
+
+void engine_log_callback(ggml_log_level level, const char* text, void* /* user_data */) {
+    if (!text) return;
+    if (level == GGML_LOG_LEVEL_WARN || level == GGML_LOG_LEVEL_ERROR) {
+        LOGE("llama: %.*s", (int) strcspn(text, "\n"), text);
+    }
+    if (!t_capturing) return;
+    // e.g. "llama_context:        CPU compute buffer size =    17.25 MiB"
+    if (strstr(text, "compute buffer size =")) {
+        t_report.compute_buffer_mib += parse_mib(text);
+    } else if (strstr(text, "KV buffer size =")) {
+        t_report.kv_buffer_mib += parse_mib(text);
+    } else if (strstr(text, "Flash Attention was auto, set to ")) {
+        t_report.flash_attn = strstr(text, "set to enabled") ? 1 : 0;
+    }
+}
+
+} // namespace
+
+void engine_context_report_begin() {
+    static std::once_flag installed;
+    std::call_once(installed, [] { llama_log_set(engine_log_callback, nullptr); });
+    t_report = EngineContextReport();
+    t_capturing = true;
+}
+
+EngineContextReport engine_context_report_end() {
+    t_capturing = false;
+    return t_report;
+}
+
+EngineConfig engine_config_defaults() {
+    EngineConfig cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.version = kEngineConfigVersion;
+    cfg.size = sizeof(EngineConfig);
+    cfg.n_ctx = 512; // Smaller context for mobile
+    cfg.n_batch = 128;
+    cfg.n_ubatch = 128;
+    cfg.n_threads = kDefaultThreads;
+    cfg.n_threads_batch = kDefaultThreads;
+    cfg.type_k = GGML_TYPE_F16;
+    cfg.type_v = GGML_TYPE_F16;
+    cfg.flash_attn = LLAMA_FLASH_ATTN_TYPE_AUTO;
+    cfg.use_mmap = 1;
+    cfg.use_mlock = 0;
+    cfg.seed = 42;
+    cfg.huge_pages = 0;
+    cfg.poll = kDefaultPoll;
+    cfg.priority = GGML_SCHED_PRIO_NORMAL;
+    cfg.cpu_mask = 0;
+    cfg.strict_cpu = 0;
+    return cfg;
+}
+
+bool engine_config_import(const EngineConfig* in, EngineConfig& out, std::string& error) {
+    out = engine_config_defaults();
+    if (!in) return true;
+    if (in->version == 0 || in->version > kEngineConfigVersion) {
+        error = "unsupported engine config version " + std::to_string(in->version);
+        return false;
+    }
+    // Version 1 ends at seed; later versions only append
+    if (in->size < offsetof(EngineConfig, seed) + sizeof(uint32_t)) {
+        error = "engine config struct too small (" + std::to_string(in->size) + " bytes)";
+        return false;
+    }
+    memcpy(&out, in, std::min<size_t>(in->size, sizeof(EngineConfig)));
+    out.version = kEngineConfigVersion;
+    out.size = sizeof(EngineConfig);
+    return true;
+}
+
+llama_model_params engine_config_model_params(const EngineConfig& cfg) {
+    llama_model_params params = llama_model_default_params();
+    params.n_gpu_layers = 0; // CPU only for now
+    params.use_mmap = cfg.use_mmap != 0;
+    params.use_mlock = cfg.use_mlock != 0;
+    return params;
+}
+
+llama_context_params engine_config_context_params(EngineConfig& cfg, const llama_model* model) {
+    const int32_t n_ctx_train = std::max(llama_model_n_ctx_train(model), kMinContext);
+    if (cfg.n_ctx <= 0) cfg.n_ctx = n_ctx_train;
+    cfg.n_ctx = clamp_logged("n_ctx", cfg.n_ctx, kMinContext, n_ctx_train);
+    cfg.n_batch = clamp_logged("n_batch", cfg.n_batch, 1, cfg.n_ctx);
+    cfg.n_ubatch = clamp_logged("n_ubatch", cfg.n_ubatch, 1, cfg.n_batch);
+
+    if (cfg.n_threads <= 0) cfg.n_threads = std::min(kDefaultThreads, online_cpus());
+    if (cfg.n_threads_batch <= 0) cfg.n_threads_batch = cfg.n_threads;
+    cfg.n_threads = clamp_logged("n_threads", cfg.n_threads, 1, online_cpus());
+    cfg.n_threads_batch = clamp_logged("n_threads_batch", cfg.n_threads_batch, 1, online_cpus());
+
+    if (!is_kv_cache_type(cfg.type_k)) {
+        LOGI("CONFIG: type_k %d is not a KV cache type, using f16", cfg.type_k);
+        cfg.type_k = GGML_TYPE_F16;
+    }
+    if (!is_kv_cache_type(cfg.type_v)) {
+        LOGI("CONFIG: type_v %d is not a KV cache type, using f16", cfg.type_v);
+        cfg.type_v = GGML_TYPE_F16;
+    }
+    cfg.flash_attn = clamp_logged("flash_attn", cfg.flash_attn, LLAMA_FLASH_ATTN_TYPE_AUTO,
+                                  LLAMA_FLASH_ATTN_TYPE_ENABLED);
+    // llama.cpp refuses a quantized V cache without flash attention
+    if (is_quantized(cfg.type_v) && cfg.flash_attn == LLAMA_FLASH_ATTN_TYPE_DISABLED) {
+        LOGI("CONFIG: Quantized V cache needs flash attention, using f16");
+        cfg.type_v = GGML_TYPE_F16;
+    }
+    cfg.use_mmap = cfg.use_mmap ? 1 : 0;
+    cfg.use_mlock = cfg.use_mlock ? 1 : 0;
+    cfg.huge_pages = cfg.huge_pages ? 1 : 0;
+
+    cfg.poll = clamp_logged("poll", cfg.poll, 0, 100);
+    cfg.priority = clamp_logged("priority", cfg.priority, GGML_SCHED_PRIO_LOW, GGML_SCHED_PRIO_REALTIME);
+    const int32_t n_cpus = online_cpus();
+    const uint32_t cpus = n_cpus >= 32 ? ~0u : (1u << n_cpus) - 1;
+    if (cfg.cpu_mask & ~cpus) {
+        LOGI("CONFIG: cpu_mask 0x%x -> 0x%x", cfg.cpu_mask, cfg.cpu_mask & cpus);
+        cfg.cpu_mask &= cpus;
+    }
+    cfg.strict_cpu = cfg.strict_cpu && cfg.cpu_mask ? 1 : 0;
+
+    llama_context_params params = llama_context_default_params();
+    params.n_ctx = (uint32_t) cfg.n_ctx;
+    params.n_batch = (uint32_t) cfg.n_batch;
+    params.n_ubatch = (uint32_t) cfg.n_ubatch;
+    params.n_threads = cfg.n_threads;
+    params.n_threads_batch = cfg.n_threads_batch;
+    params.type_k = (ggml_type) cfg.type_k;
+    params.type_v = (ggml_type) cfg.type_v;
+    params.flash_attn_type = (llama_flash_attn_type) cfg.flash_attn;
+    return params;
+}
+
+void engine_config_read_back(EngineConfig& cfg, llama_context* ctx) {
+    cfg.n_ctx = (int32_t) llama_n_ctx(ctx);
+    cfg.n_batch = (int32_t) llama_n_batch(ctx);
+    cfg.n_ubatch = (int32_t) llama_n_ubatch(ctx);
+    cfg.n_threads = llama_n_threads(ctx);
+    cfg.n_threads_batch = llama_n_threads_batch(ctx);
+}
+
+std::string engine_config_json(const EngineConfig& cfg) {
+    char buf[640];
+    snprintf(buf, sizeof(buf),
+             "{\"version\":%u,\"n_ctx\":%d,\"n_batch\":%d,\"n_ubatch\":%d,\"n_threads\":%d,"
+             "\"n_threads_batch\":%d,\"type_k\":\"%s\",\"type_v\":\"%s\",\"flash_attn\":%d,"
+             "\"use_mmap\":%s,\"use_mlock\":%s,\"seed\":%u,\"huge_pages\":%s,\"poll\":%d,"
+             "\"priority\":%d,\"cpu_mask\":%u,\"strict_cpu\":%s}",
+             cfg.version, cfg.n_ctx, cfg.n_batch, cfg.n_ubatch, cfg.n_threads, cfg.n_threads_batch,
+             ggml_type_name((ggml_type) cfg.type_k), ggml_type_name((ggml_type) cfg.type_v),
+             cfg.flash_attn, cfg.use_mmap ? "true" : "false", cfg.use_mlock ? "true" : "false", cfg.seed,
+             cfg.huge_pages ? "true" : "false", cfg.poll, cfg.priority, cfg.cpu_mask,
+             cfg.strict_cpu ? "true" : "false");
+    return buf;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+// Engine configuration shared by the JNI and FFI load paths.
+//
+// EngineConfig is a plain C struct so Dart can pass it by pointer (mirrored by
+// EngineConfigStruct in engine_config.dart). It is versioned: callers set
+// version and size, new fields are only ever appended, and fields a smaller
+// (older) caller struct doesn't have keep their defaults.
+
+#include <cstdint>
+#include <string>
+
+#include "llama.h"
+
+constexpr uint32_t kEngineConfigVersion = 3;
+
+extern "C" {
+
+struct EngineConfig {
+    uint32_t version;        // kEngineConfigVersion the caller was built against
+    uint32_t size;           // sizeof(EngineConfig) as the caller sees it
+    int32_t n_ctx;           // 0 = the model's training context
+    int32_t n_batch;         // Logical batch (tokens per llama_decode call)
+    int32_t n_ubatch;        // Physical batch (tokens per graph compute)
+    int32_t n_threads;       // Decode threads, <= 0 = default
+    int32_t n_threads_batch; // Prompt/batch threads, <= 0 = same as n_threads
+    int32_t type_k;          // ggml_type of the K cache
+    int32_t type_v;          // ggml_type of the V cache; quantized needs flash attention
+    int32_t flash_attn;      // -1 auto, 0 off, 1 on
+    int32_t use_mmap;
+    int32_t use_mlock;
+    uint32_t seed;           // For sampled decoding; benchmark passes decode greedily
+    // Version 2
+    int32_t huge_pages;      // Advise transparent huge pages for weights, KV cache and compute buffers
+    // Version 3: compute threadpool (engine_threadpool.h)
+    int32_t poll;            // How long idle workers spin for the next graph before sleeping, 0-100
+    int32_t priority;        // ggml_sched_priority of the compute threads, -1 low .. 3 realtime
+    uint32_t cpu_mask;       // Bit i set: compute threads may run on CPU i; 0 = any CPU
+    int32_t strict_cpu;      // Pin each compute thread to its own CPU of cpu_mask
+};
+
+} // extern "C"
+
+/**
+ * Defaults of the benchmark engine: n_ctx 512, n_batch 128, 4 threads,
+ * F16 KV cache, flash attention auto, mmap on, mlock off, seed 42, huge pages off,
+ * poll 50 (ggml's default), normal priority, any CPU
+ */
+EngineConfig engine_config_defaults();
+
+/**
+ * Copy a caller's config over the defaults, honoring its size for older layouts.
+ * nullptr yields the defaults.
+ * Returns: false with error set for an unknown version or a truncated struct
+ */
+bool engine_config_import(const EngineConfig* in, EngineConfig& out, std::string& error);
+
+/**
+ * Model parameters for loading with cfg (mmap/mlock)
+ */
+llama_model_params engine_config_model_params(const EngineConfig& cfg);
+
+/**
+ * Clamp cfg against the loaded model and this device (context length, batch
+ * sizes, thread counts, KV types, threadpool settings), logging every adjustment, and build the
+ * context parameters from the result
+ */
+llama_context_params engine_config_context_params(EngineConfig& cfg, const llama_model* model);
+
+/**
+ * Replace the clamped sizes and thread counts in cfg with what the context
+ * actually uses (llama.cpp may round n_ctx up, for instance)
+ */
+void engine_config_read_back(EngineConfig& cfg, llama_context* ctx);
+
+/**
+ * What llama.cpp reported while creating a context on this thread
+ */
+struct EngineContextReport {
+    double compute_buffer_mib = 0.0; // Graph scratch buffers, summed over backends
+    double kv_buffer_mib = 0.0;      // KV cache buffers, summed over backends
+    int32_t flash_attn = -1;         // What "auto" resolved to, -1 if it wasn't auto
+};
+
+/**
+ * Start capturing the buffer sizes llama.cpp logs on this thread (its
+ * public API doesn't expose them). Installs the log callback on first use,
+ * which also forwards llama.cpp warnings and errors to our log.
+ */
+void engine_context_report_begin();
+
+/**
+ * Sizes captured on this thread since engine_context_report_begin()
+ */
+EngineContextReport engine_context_report_end();
+
+/**
+ * JSON: {"version","n_ctx","n_batch","n_ubatch","n_threads","n_threads_batch",
+ * "type_k","type_v","flash_attn","use_mmap","use_mlock","seed","huge_pages","poll","priority","cpu_mask","strict_cpu"},
+ * types by name (e.g. "f16")
+ */
+std::string engine_config_json(const EngineConfig& cfg);
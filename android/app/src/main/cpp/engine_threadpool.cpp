@@ -0,0 +1,86 @@
+#include "engine_threadpool.h"
+
+#include <cstdio>
+
+#include "cpu_variants.h"
+#include "native_common.h"
+
+namespace {
+
+ggml_threadpool_params pool_params(const EngineConfig& cfg, int32_t n_threads) {
+    ggml_threadpool_params params = ggml_threadpool_params_default(n_threads);
+    params.prio = (ggml_sched_priority) cfg.priority;
+    params.poll = (uint32_t) cfg.poll;
+    params.strict_cpu = cfg.strict_cpu != 0;
+    params.paused = true;
+    // No bit set leaves the threads' affinity alone
+    for (int cpu = 0; cpu < 32 && cpu < GGML_MAX_N_THREADS; cpu++) {
+        params.cpumask[cpu] = (cfg.cpu_mask >> cpu) & 1u;
+    }
+    return params;
+}
+
+} // namespace
+
+bool EngineThreadpool::create(const EngineConfig& cfg, std::string& error) {
+    release();
+    auto new_fn = (NewFn) cpu_backend_symbol("ggml_threadpool_new");
+    free_ = (PoolFn) cpu_backend_symbol("ggml_threadpool_free");
+    if (!new_fn || !free_) {
+        error = "CPU backend has no threadpool API";
+        return false;
+    }
+    pause_ = (PoolFn) cpu_backend_symbol("ggml_threadpool_pause");
+    resume_ = (PoolFn) cpu_backend_symbol("ggml_threadpool_resume");
+
+    ggml_threadpool_params params = pool_params(cfg, cfg.n_threads);
+    pool_ = new_fn(&params);
+    if (pool_ && cfg.n_threads_batch != cfg.n_threads) {
+        ggml_threadpool_params batch_params = pool_params(cfg, cfg.n_threads_batch);
+        pool_batch_ = new_fn(&batch_params);
+        if (!pool_batch_) release();
+    }
+    if (!pool_) {
+        error = "failed to create the threadpool";
+        return false;
+    }
+    cfg_ = cfg;
+    LOGI("THREADPOOL: %d/%d threads, poll %d, priority %d, cpu mask 0x%x%s", cfg.n_threads,
+         cfg.n_threads_batch, cfg.poll, cfg.priority, cfg.cpu_mask, cfg.strict_cpu ? " (strict)" : "");
+    return true;
+}
+
+void EngineThreadpool::attach(llama_context* ctx) const {
+    if (pool_ && ctx) llama_attach_threadpool(ctx, pool_, pool_batch_);
+}
+
+void EngineThreadpool::pause() {
+    // Both are no-ops on a pool already in that state, and a graph compute
+    // resumes a paused pool by itself, so no state is tracked here
+    if (!pool_ || !pause_) return;
+    pause_(pool_);
+    if (pool_batch_) pause_(pool_batch_);
+}
+
+void EngineThreadpool::resume() {
+    if (!pool_ || !resume_) return;
+    resume_(pool_);
+    if (pool_batch_) resume_(pool_batch_);
+}
+
+void EngineThreadpool::release() {
+    if (pool_batch_) free_(pool_batch_);
+    if (pool_) free_(pool_);
+    pool_ = nullptr;
+    pool_batch_ = nullptr;
+}
+
+std::string EngineThreadpool::json() const {
+    char buf[224];
+    snprintf(buf, sizeof(buf),
+             "{\"active\":%s,\"n_threads\":%d,\"n_threads_batch\":%d,\"poll\":%d,\"priority\":%d,"
+             "\"cpu_mask\":%u,\"strict_cpu\":%s,\"pausable\":%s}",
+             pool_ ? "true" : "false", cfg_.n_threads, cfg_.n_threads_batch, cfg_.poll, cfg_.priority,
+             cfg_.cpu_mask, cfg_.strict_cpu ? "true" : "false", pause_ ? "true" : "false");
+    return buf;
+}
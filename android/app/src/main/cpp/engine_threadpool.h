@@ -0,0 +1,81 @@
+#pragma once
+
+// Persistent compute threadpool of the engine context.
+//
+// Without an attached threadpool the ggml CPU backend starts and joins its
+// worker threads for every graph compute, i.e. once per generated token. The
+// engine instead creates a threadpool together with its context and attaches
+// it for the context's lifetime (a second one for prompt batches when
+// n_threads_batch differs), so the same threads serve every token and run.
+// The EngineConfig threadpool fields set it up:
+//   poll        how long a worker spins waiting for the next graph before it
+//               sleeps on a condition variable, 0 (sleep at once) to 100;
+//               spinning trades CPU time for wake-up latency between tokens
+//   priority    scheduling priority of the compute threads
+//   cpu_mask    CPUs the threads may run on, e.g. only the big cores
+//   strict_cpu  one CPU of the mask per thread instead of the whole mask
+// Between runs the pool is paused so idle workers block instead of spinning;
+// the first graph compute of the next run resumes it.
+//
+// The threadpool functions belong to the CPU backend, which may be loaded at
+// runtime (cpu_variants.h), so they are looked up in it rather than linked.
+// Needs ggml built without OpenMP, which would run the graph on its own threads.
+
+#include <string>
+
+#include "engine_config.h"
+#include "ggml.h"
+
+class EngineThreadpool {
+public:
+    /**
+     * Create the pools for cfg's thread counts and settings, releasing any previous ones.
+     * Pools start paused. The CPU backend must be registered.
+     * Returns: false with error set if the backend lacks the threadpool API or creation fails
+     */
+    bool create(const EngineConfig& cfg, std::string& error);
+
+    /**
+     * Use the pools for every graph ctx computes from now on
+     */
+    void attach(llama_context* ctx) const;
+
+    /**
+     * Put idle workers to sleep until resume() or the next graph compute.
+     * No-op if the backend doesn't export ggml_threadpool_pause.
+     */
+    void pause();
+
+    /**
+     * Wake the workers ahead of a run, so its first graph doesn't pay for it
+     */
+    void resume();
+
+    /**
+     * Free the pools; contexts they were attached to must be freed or detached first
+     */
+    void release();
+
+    bool active() const { return pool_ != nullptr; }
+
+    /**
+     * Config the pools were last created with
+     */
+    const EngineConfig& config() const { return cfg_; }
+
+    /**
+     * JSON: {"active","n_threads","n_threads_batch","poll","priority","cpu_mask","strict_cpu","pausable"}
+     */
+    std::string json() const;
+
+private:
+    typedef ggml_threadpool_t (*NewFn)(ggml_threadpool_params*);
+    typedef void (*PoolFn)(ggml_threadpool_t);
+
+    ggml_threadpool_t pool_ = nullptr;
+    ggml_threadpool_t pool_batch_ = nullptr; // nullptr: pool_ serves batches too
+    PoolFn free_ = nullptr;
+    PoolFn pause_ = nullptr;  // nullptr if the backend doesn't export it
+    PoolFn resume_ = nullptr;
+    EngineConfig cfg_{};
+};
@@ -0,0 +1,568 @@
+// Long-lived native inference worker.
+//
+// Dart submits load/run/dispose commands into a lock-free queue and returns
+// immediately; the worker executes them in order on its own thread, so a new
+// pass can be queued while the current one is still generating and starts with
+// no isolate round trip in between. The worker sleeps on an eventfd while the
+// queue is empty. Completions and tokens are posted back through callbacks that
+// Dart registers as NativeCallable.listener, i.e. onto the isolate's port.
+//
+// Pause, resume and cancel act on the running command directly instead of
+// queueing behind it. Cancel also drops every run submitted before it.
+
+#include <atomic>
+#include <cerrno>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "command_queue.h"
+#include "native_common.h"
+#include "native_engine.h"
+
+namespace {
+
+enum EngineCommandType : int32_t {
+    kLoad = 0,
+    kLoadRegion = 1,
+    kRun = 2,
+    kRepetitions = 3,
+    kDispose = 4,
+    kCpuVariants = 5,
+    kBandwidth = 6,
+    kFlashAttention = 7,
+    kKvDepth = 8,
+    kContention = 9,
+    kSessionRestore = 10,
+    kPerplexity = 11,
+    kEmbed = 12,
+    kEmbedBenchmark = 13,
+    kHugePages = 14,
+    kPollSweep = 15,
+};
+
+struct EngineCommand {
+    int64_t id = 0;
+    int32_t type = kLoad;
+    uint64_t generation = 0; // Stop generation at submit time
+    std::string text;        // Model path, cache path, prompt, evaluation text or
+                             // NUL-terminated texts to embed, back to back
+    std::string prompt;      // Prompt of commands that also take a model path
+    int64_t args[4] = {0, 0, 0, 0};
+    EngineConfig config = engine_config_defaults(); // Loads: copied at submit time
+};
+
+// Completion event: text is malloc'd (or null) and owned by the receiver
+typedef void (*EngineEventCallback)(int64_t id, int32_t type, int64_t result, char* text);
+// Token event: token is malloc'd and owned by the receiver
+typedef void (*EngineTokenCallback)(char* token, int64_t time_ms);
+
+constexpr size_t kQueueCapacity = 64;
+constexpr int64_t kResultCancelled = -2;
+
+CommandQueue<EngineCommand> g_queue(kQueueCapacity);
+std::atomic<int64_t> g_next_id{1};
+std::once_flag g_worker_once;
+int g_wake_fd = -1;
+
+// Guards the Dart callbacks, so after engine_worker_detach() returns none is running
+std::mutex g_callback_mutex;
+EngineEventCallback g_on_event = nullptr;
+EngineTokenCallback g_on_token = nullptr;
+
+void wake_worker() {
+    const uint64_t one = 1;
+    while (write(g_wake_fd, &one, sizeof(one)) < 0 && errno == EINTR) {}
+}
+
+void post_event(const EngineCommand& cmd, int64_t result, const char* text) {
+    std::lock_guard<std::mutex> lock(g_callback_mutex);
+    if (g_on_event) g_on_event(cmd.id, cmd.type, result, text ? strdup(text) : nullptr);
+}
+
+void forward_token(const char* token, int64_t time_ms) {
+    std::lock_guard<std::mutex> lock(g_callback_mutex);
+    if (g_on_token) g_on_token(strdup(token), time_ms);
+}
+
+/**
+ * Pointers to the texts packed back to back in text by pack_texts()
+ */
+std::vector<const char*> unpack_texts(const std::string& text) {
+    std::vector<const char*> texts;
+    for (size_t pos = 0; pos < text.size(); pos += strlen(text.c_str() + pos) + 1) {
+        texts.push_back(text.c_str() + pos);
+    }
+    return texts;
+}
+
+std::string pack_texts(const char* const* texts, int32_t n_texts) {
+    std::string packed;
+    for (int32_t i = 0; i < n_texts; i++) {
+        packed += texts[i] ? texts[i] : "";
+        packed += '\0';
+    }
+    return packed;
+}
+
+void execute(const EngineCommand& cmd) {
+    switch (cmd.type) {
+        case kLoad:
+            post_event(cmd, load_model_with_config(cmd.text.c_str(), &cmd.config), nullptr);
+            break;
+        case kLoadRegion:
+            post_event(cmd, load_model_region((int32_t) cmd.args[0], cmd.args[1], cmd.args[2],
+                                              cmd.text.c_str(), &cmd.config), nullptr);
+            break;
+        case kRun:
+        case kRepetitions:
+            if (cmd.generation != engine_stop_generation()) {
+                post_event(cmd, kResultCancelled, nullptr);
+                break;
+            }
+            if (cmd.type == kRun) {
+                // dispose_model() clears the callback, so set it for every run
+                set_token_callback(forward_token);
+                post_event(cmd, run_inference(cmd.text.c_str(), (int32_t) cmd.args[0]), nullptr);
+            } else {
+                const char* json = run_benchmark_repetitions(cmd.text.c_str(), (int32_t) cmd.args[0],
+                                                             (int32_t) cmd.args[1], (int32_t) cmd.args[2]);
+                post_event(cmd, 0, json);
+            }
+            break;
+        case kCpuVariants:
+        case kHugePages:
+            if (cmd.generation != engine_stop_generation()) {
+                post_event(cmd, kResultCancelled, nullptr);
+                break;
+            }
+            post_event(cmd, 0, (cmd.type == kCpuVariants ? run_cpu_variant_comparison : run_huge_page_comparison)(
+                                   cmd.text.c_str(), cmd.prompt.c_str(), (int32_t) cmd.args[0],
+                                   (int32_t) cmd.args[1], (int32_t) cmd.args[2]));
+            break;
+        case kFlashAttention:
+        case kKvDepth:
+            if (cmd.generation != engine_stop_generation()) {
+                post_event(cmd, kResultCancelled, nullptr);
+                break;
+            }
+            post_event(cmd, 0, (cmd.type == kFlashAttention ? run_flash_attention_comparison : run_kv_depth_sweep)(
+                                   cmd.text.c_str(), (int32_t) cmd.args[0], (int32_t) cmd.args[1],
+                                   (int32_t) cmd.args[2]));
+            break;
+        case kContention:
+            if (cmd.generation != engine_stop_generation()) {
+                post_event(cmd, kResultCancelled, nullptr);
+                break;
+            }
+            post_event(cmd, 0, run_context_contention((int32_t) cmd.args[0], (int32_t) cmd.args[1],
+                                                      (int32_t) cmd.args[2]));
+            break;
+        case kSessionRestore:
+            if (cmd.generation != engine_stop_generation()) {
+                post_event(cmd, kResultCancelled, nullptr);
+                break;
+            }
+            post_event(cmd, 0, run_session_restore_benchmark(cmd.text.c_str(), (int32_t) cmd.args[0]));
+            break;
+        case kPollSweep:
+            if (cmd.generation != engine_stop_generation()) {
+                post_event(cmd, kResultCancelled, nullptr);
+                break;
+            }
+            post_event(cmd, 0, run_threadpool_poll_sweep(cmd.text.c_str(), (int32_t) cmd.args[0],
+                                                         (int32_t) cmd.args[1]));
+            break;
+        case kPerplexity:
+            if (cmd.generation != engine_stop_generation()) {
+                post_event(cmd, kResultCancelled, nullptr);
+                break;
+            }
+            post_event(cmd, 0, run_perplexity(cmd.text.c_str(), (int32_t) cmd.args[0], (int32_t) cmd.args[1],
+                                              (int32_t) cmd.args[2]));
+            break;
+        case kEmbed:
+        case kEmbedBenchmark: {
+            if (cmd.generation != engine_stop_generation()) {
+                post_event(cmd, kResultCancelled, nullptr);
+                break;
+            }
+            const std::vector<const char*> texts = unpack_texts(cmd.text);
+            const char* json = cmd.type == kEmbed
+                ? run_embeddings(texts.data(), (int32_t) texts.size(), (int32_t) cmd.args[0],
+                                 (int32_t) cmd.args[1], reinterpret_cast<float*>(cmd.args[2]), cmd.args[3])
+                : run_embedding_benchmark(texts.data(), (int32_t) texts.size(), (int32_t) cmd.args[0],
+                                          (int32_t) cmd.args[1]);
+            post_event(cmd, 0, json);
+            break;
+        }
+        case kBandwidth:
+            post_event(cmd, 0, run_bandwidth_probe((int32_t) cmd.args[0]));
+            break;
+        case kDispose:
+            dispose_model();
+            post_event(cmd, 0, nullptr);
+            break;
+    }
+}
+
+void worker_loop() {
+    LOGI("WORKER: Engine worker started");
+    for (;;) {
+        EngineCommand cmd;
+        while (g_queue.pop(cmd)) {
+            // A cancel after the submit stops the command even if it lands before the start
+            engine_begin_queued_command(cmd.generation);
+            execute(cmd);
+            engine_end_queued_command();
+        }
+        // Idle: nothing queued to delay
+        session_snapshot_flush();
+        uint64_t count;
+        while (read(g_wake_fd, &count, sizeof(count)) < 0 && errno == EINTR) {}
+    }
+}
+
+void start_worker() {
+    g_wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (g_wake_fd < 0) {
+        LOGE("WORKER: eventfd failed: %s", strerror(errno));
+        return;
+    }
+    std::thread(worker_loop).detach();
+}
+
+int64_t submit(EngineCommand cmd) {
+    std::call_once(g_worker_once, start_worker);
+    if (g_wake_fd < 0) return -1;
+
+    cmd.id = g_next_id++;
+    cmd.generation = engine_stop_generation();
+    const int64_t id = cmd.id;
+    if (!g_queue.push(std::move(cmd))) {
+        LOGE("WORKER: Command queue full");
+        return -1;
+    }
+    wake_worker();
+    return id;
+}
+
+} // namespace
+
+extern "C" {
+
+/**
+ * Register the Dart completion and token listeners, starting the worker on first use.
+ * Callbacks run on the worker thread and must not block (NativeCallable.listener).
+ */
+void engine_worker_attach(EngineEventCallback on_event, EngineTokenCallback on_token) {
+    std::call_once(g_worker_once, start_worker);
+    std::lock_guard<std::mutex> lock(g_callback_mutex);
+    g_on_event = on_event;
+    g_on_token = on_token;
+}
+
+/**
+ * Unregister the Dart listeners; once this returns none of them will be called again
+ * and they can be closed. The worker keeps running for the next attach.
+ */
+void engine_worker_detach() {
+    std::lock_guard<std::mutex> lock(g_callback_mutex);
+    g_on_event = nullptr;
+    g_on_token = nullptr;
+}
+
+/**
+ * Queue a model load with an engine config (nullptr = defaults), copied now.
+ * Returns: command id, or -1 if the queue is full or the config version is unsupported
+ */
+int64_t engine_submit_load(const char* model_path, const EngineConfig* config) {
+    if (!model_path) return -1;
+    EngineCommand cmd;
+    std::string error;
+    if (!engine_config_import(config, cmd.config, error)) {
+        LOGE("WORKER: %s", error.c_str());
+        return -1;
+    }
+    cmd.type = kLoad;
+    cmd.text = model_path;
+    return submit(std::move(cmd));
+}
+
+/**
+ * Queue a region load with an engine config (nullptr = defaults); fd ownership
+ * passes to the engine as with load_model_region, even when the command can't be queued.
+ * Returns: command id, or -1 if the queue is full or the config version is unsupported
+ */
+int64_t engine_submit_load_region(int32_t fd, int64_t offset, int64_t length, const char* cache_path,
+                                  const EngineConfig* config) {
+    EngineCommand cmd;
+    std::string error;
+    if (!engine_config_import(config, cmd.config, error)) {
+        LOGE("WORKER: %s", error.c_str());
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    cmd.type = kLoadRegion;
+    cmd.text = cache_path ? cache_path : "";
+    cmd.args[0] = fd;
+    cmd.args[1] = offset;
+    cmd.args[2] = length;
+    const int64_t id = submit(std::move(cmd));
+    if (id < 0 && fd >= 0) close(fd);
+    return id;
+}
+
+/**
+ * Queue a generation pass; tokens are streamed to the token listener.
+ * Completion result: tokens generated, -1 on error, -2 if cancelled before starting.
+ * Returns: command id, or -1 if the queue is full
+ */
+int64_t engine_submit_run(const char* prompt, int32_t max_tokens) {
+    if (!prompt) return -1;
+    EngineCommand cmd;
+    cmd.type = kRun;
+    cmd.text = prompt;
+    cmd.args[0] = max_tokens;
+    return submit(std::move(cmd));
+}
+
+/**
+ * Queue a warm-up + repetition run; the completion carries the JSON report of
+ * run_benchmark_repetitions, or result -2 and no text if cancelled before starting.
+ * Returns: command id, or -1 if the queue is full
+ */
+int64_t engine_submit_repetitions(const char* prompt, int32_t n_tokens, int32_t n_warmup, int32_t n_reps) {
+    if (!prompt) return -1;
+    EngineCommand cmd;
+    cmd.type = kRepetitions;
+    cmd.text = prompt;
+    cmd.args[0] = n_tokens;
+    cmd.args[1] = n_warmup;
+    cmd.args[2] = n_reps;
+    return submit(std::move(cmd));
+}
+
+/**
+ * Queue a run of the repetition workload under every supported CPU variant
+ * (run_cpu_variant_comparison); leaves no model loaded. The
+ * completion carries its JSON report, or result -2 and no text if cancelled
+ * before starting, in which case the loaded model stays.
+ * Returns: command id, or -1 if the queue is full
+ */
+int64_t engine_submit_cpu_variant_comparison(const char* model_path, const char* prompt, int32_t n_tokens,
+                                             int32_t n_warmup, int32_t n_reps) {
+    if (!model_path || !prompt) return -1;
+    EngineCommand cmd;
+    cmd.type = kCpuVariants;
+    cmd.text = model_path;
+    cmd.prompt = prompt;
+    cmd.args[0] = n_tokens;
+    cmd.args[1] = n_warmup;
+    cmd.args[2] = n_reps;
+    return submit(std::move(cmd));
+}
+
+/**
+ * Queue a run of the repetition workload with huge pages off and on
+ * (run_huge_page_comparison); leaves no model loaded. The
+ * completion carries its JSON report, or result -2 and no text if cancelled
+ * before starting, in which case the loaded model stays.
+ * Returns: command id, or -1 if the queue is full
+ */
+int64_t engine_submit_huge_page_comparison(const char* model_path, const char* prompt, int32_t n_tokens,
+                                           int32_t n_warmup, int32_t n_reps) {
+    if (!model_path || !prompt) return -1;
+    EngineCommand cmd;
+    cmd.type = kHugePages;
+    cmd.text = model_path;
+    cmd.prompt = prompt;
+    cmd.args[0] = n_tokens;
+    cmd.args[1] = n_warmup;
+    cmd.args[2] = n_reps;
+    return submit(std::move(cmd));
+}
+
+/**
+ * Queue a flash attention off/on comparison at increasing context depths
+ * (run_flash_attention_comparison); leaves no model loaded. The completion
+ * carries its JSON report, or result -2 and no text if cancelled before starting.
+ * Returns: command id, or -1 if the queue is full
+ */
+int64_t engine_submit_flash_attention_comparison(const char* model_path, int32_t n_gen, int32_t max_depth,
+                                                 int32_t n_reps) {
+    if (!model_path) return -1;
+    EngineCommand cmd;
+    cmd.type = kFlashAttention;
+    cmd.text = model_path;
+    cmd.args[0] = n_gen;
+    cmd.args[1] = max_depth;
+    cmd.args[2] = n_reps;
+    return submit(std::move(cmd));
+}
+
+/**
+ * Queue a decode-speed-vs-KV-depth sweep (run_kv_depth_sweep); leaves no model
+ * loaded. The completion carries its JSON report, or result -2 and no text if
+ * cancelled before starting.
+ * Returns: command id, or -1 if the queue is full
+ */
+int64_t engine_submit_kv_depth_sweep(const char* model_path, int32_t n_gen, int32_t max_depth, int32_t n_reps) {
+    if (!model_path) return -1;
+    EngineCommand cmd;
+    cmd.type = kKvDepth;
+    cmd.text = model_path;
+    cmd.args[0] = n_gen;
+    cmd.args[1] = max_depth;
+    cmd.args[2] = n_reps;
+    return submit(std::move(cmd));
+}
+
+/**
+ * Queue a multi-context contention run on the loaded model (run_context_contention).
+ * The completion carries its JSON report, or result -2 and no text if cancelled
+ * before starting.
+ * Returns: command id, or -1 if the queue is full
+ */
+int64_t engine_submit_context_contention(int32_t max_contexts, int32_t n_tokens, int32_t overlap) {
+    EngineCommand cmd;
+    cmd.type = kContention;
+    cmd.args[0] = max_contexts;
+    cmd.args[1] = n_tokens;
+    cmd.args[2] = overlap;
+    return submit(std::move(cmd));
+}
+
+/**
+ * Queue a KV snapshot restore vs re-prefill comparison on the loaded model
+ * (run_session_restore_benchmark). The completion carries its JSON report, or
+ * result -2 and no text if cancelled before starting.
+ * Returns: command id, or -1 if the queue is full
+ */
+int64_t engine_submit_session_restore_benchmark(const char* prompt, int32_t n_reps) {
+    if (!prompt) return -1;
+    EngineCommand cmd;
+    cmd.type = kSessionRestore;
+    cmd.text = prompt;
+    cmd.args[0] = n_reps;
+    return submit(std::move(cmd));
+}
+
+/**
+ * Queue a threadpool poll level sweep on the loaded model (run_threadpool_poll_sweep).
+ * The completion carries its JSON report, or result -2 and no text if cancelled
+ * before starting.
+ * Returns: command id, or -1 if the queue is full
+ */
+int64_t engine_submit_threadpool_poll_sweep(const char* prompt, int32_t n_tokens, int32_t n_reps) {
+    if (!prompt) return -1;
+    EngineCommand cmd;
+    cmd.type = kPollSweep;
+    cmd.text = prompt;
+    cmd.args[0] = n_tokens;
+    cmd.args[1] = n_reps;
+    return submit(std::move(cmd));
+}
+
+/**
+ * Queue a perplexity evaluation of text on the loaded model (run_perplexity).
+ * The completion carries its JSON report, or result -2 and no text if cancelled
+ * before starting.
+ * Returns: command id, or -1 if the queue is full
+ */
+int64_t engine_submit_perplexity(const char* text, int32_t n_ctx, int32_t n_seq, int32_t max_chunks) {
+    if (!text) return -1;
+    EngineCommand cmd;
+    cmd.type = kPerplexity;
+    cmd.text = text;
+    cmd.args[0] = n_ctx;
+    cmd.args[1] = n_seq;
+    cmd.args[2] = max_chunks;
+    return submit(std::move(cmd));
+}
+
+/**
+ * Queue embedding n_texts texts into out, which holds out_capacity floats
+ * (run_embeddings). The texts are copied at submit time; out must stay allocated
+ * until the completion, which carries the JSON report, or result -2 and no text
+ * if cancelled before starting.
+ * Returns: command id, or -1 if the queue is full
+ */
+int64_t engine_submit_embeddings(const char* const* texts, int32_t n_texts, int32_t pooling, int32_t batch_size,
+                                 float* out, int64_t out_capacity) {
+    if (!texts || n_texts <= 0 || !out || out_capacity <= 0) return -1;
+    EngineCommand cmd;
+    cmd.type = kEmbed;
+    cmd.text = pack_texts(texts, n_texts);
+    cmd.args[0] = pooling;
+    cmd.args[1] = batch_size;
+    cmd.args[2] = reinterpret_cast<int64_t>(out);
+    cmd.args[3] = out_capacity;
+    return submit(std::move(cmd));
+}
+
+/**
+ * Queue an embedding throughput sweep over batch sizes (run_embedding_benchmark);
+ * the completion carries its JSON report, or result -2 and no text if cancelled
+ * before starting.
+ * Returns: command id, or -1 if the queue is full
+ */
+int64_t engine_submit_embedding_benchmark(const char* const* texts, int32_t n_texts, int32_t pooling,
+                                          int32_t max_batch) {
+    if (!texts || n_texts <= 0) return -1;
+    EngineCommand cmd;
+    cmd.type = kEmbedBenchmark;
+    cmd.text = pack_texts(texts, n_texts);
+    cmd.args[0] = pooling;
+    cmd.args[1] = max_batch;
+    return submit(std::move(cmd));
+}
+
+/**
+ * Queue the memory bandwidth probe (run_bandwidth_probe), so it never overlaps
+ * a pass; the completion carries its JSON report.
+ * Returns: command id, or -1 if the queue is full
+ */
+int64_t engine_submit_bandwidth_probe(int32_t n_threads) {
+    EngineCommand cmd;
+    cmd.type = kBandwidth;
+    cmd.args[0] = n_threads;
+    return submit(std::move(cmd));
+}
+
+/**
+ * Queue freeing the model; runs after everything queued before it
+ * Returns: command id, or -1 if the queue is full
+ */
+int64_t engine_submit_dispose() {
+    EngineCommand cmd;
+    cmd.type = kDispose;
+    return submit(std::move(cmd));
+}
+
+/**
+ * Pause the running generation before its next token
+ */
+void engine_pause() {
+    pause_inference();
+}
+
+/**
+ * Resume a paused generation
+ */
+void engine_resume() {
+    resume_inference();
+}
+
+/**
+ * Stop the running command and drop every run queued before this call.
+ * Loads and disposes still execute.
+ */
+void engine_cancel() {
+    stop_inference();
+}
+
+} // extern "C"
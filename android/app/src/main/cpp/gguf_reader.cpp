@@ -0,0 +1,421 @@
+#include "gguf_reader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "native_common.h"
+
+namespace {
+
+// GGUF metadata value types
+enum GgufValueType : uint32_t {
+    GGUF_UINT8 = 0, GGUF_INT8 = 1, GGUF_UINT16 = 2, GGUF_INT16 = 3,
+    GGUF_UINT32 = 4, GGUF_INT32 = 5, GGUF_FLOAT32 = 6, GGUF_BOOL = 7,
+    GGUF_STRING = 8, GGUF_ARRAY = 9, GGUF_UINT64 = 10, GGUF_INT64 = 11,
+    GGUF_FLOAT64 = 12, GGUF_VALUE_TYPE_COUNT,
+};
+
+constexpr uint32_t kGgufMagic = 0x46554747; // "GGUF" little-endian
+constexpr uint32_t kMaxDims = 4;            // GGML_MAX_DIMS
+
+// Block size / bytes per block for every ggml type id that can appear in a file.
+// Kept local (instead of using ggml_type_size) so this reader builds without ggml.
+struct TypeTraits {
+    const char* name;
+    uint32_t block_size; // 0 = unused/removed id
+    uint32_t type_size;
+};
+
+const TypeTraits kTypeTraits[] = {
+    {"f32", 1, 4},        {"f16", 1, 2},         {"q4_0", 32, 18},     {"q4_1", 32, 20},
+    {nullptr, 0, 0},      {nullptr, 0, 0},       {"q5_0", 32, 22},     {"q5_1", 32, 24},
+    {"q8_0", 32, 34},     {"q8_1", 32, 36},      {"q2_K", 256, 84},    {"q3_K", 256, 110},
+    {"q4_K", 256, 144},   {"q5_K", 256, 176},    {"q6_K", 256, 210},   {"q8_K", 256, 292},
+    {"iq2_xxs", 256, 66}, {"iq2_xs", 256, 74},   {"iq3_xxs", 256, 98}, {"iq1_s", 256, 50},
+    {"iq4_nl", 32, 18},   {"iq3_s", 256, 110},   {"iq2_s", 256, 82},   {"iq4_xs", 256, 136},
+    {"i8", 1, 1},         {"i16", 1, 2},         {"i32", 1, 4},        {"i64", 1, 8},
+    {"f64", 1, 8},        {"iq1_m", 256, 56},    {"bf16", 1, 2},       {nullptr, 0, 0},
+    {nullptr, 0, 0},      {nullptr, 0, 0},       {"tq1_0", 256, 54},   {"tq2_0", 256, 66},
+    {nullptr, 0, 0},      {nullptr, 0, 0},       {nullptr, 0, 0},      {"mxfp4", 32, 17},
+};
+constexpr uint32_t kNumTypes = sizeof(kTypeTraits) / sizeof(kTypeTraits[0]);
+
+/**
+ * Sequential reader over a file region with a small pread-backed buffer.
+ * Every read is bounds-checked against the region so a truncated file is
+ * reported instead of read past.
+ */
+class RegionReader {
+public:
+    RegionReader(int fd, uint64_t base, uint64_t size) : fd_(fd), base_(base), size_(size) {}
+
+    uint64_t pos() const { return pos_; }
+    uint64_t remaining() const { return size_ - pos_; }
+    bool truncated() const { return truncated_; }
+    bool io_error() const { return io_error_; }
+
+    bool read(void* dst, size_t n) {
+        if (n > remaining()) {
+            truncated_ = true;
+            return false;
+        }
+        uint8_t* out = static_cast<uint8_t*>(dst);
+        while (n > 0) {
+            if (buf_pos_ == buf_len_ && !fill()) return false;
+            const size_t take = std::min(n, buf_len_ - buf_pos_);
+            memcpy(out, buf_.data() + buf_pos_, take);
+            buf_pos_ += take;
+            pos_ += take;
+            out += take;
+            n -= take;
+        }
+        return true;
+    }
+
+    bool skip(uint64_t n) {
+        if (n > remaining()) {
+            truncated_ = true;
+            return false;
+        }
+        const uint64_t buffered = buf_len_ - buf_pos_;
+        if (n <= buffered) {
+            buf_pos_ += n;
+        } else {
+            buf_pos_ = buf_len_ = 0; // Drop the buffer and seek past large arrays
+        }
+        pos_ += n;
+        return true;
+    }
+
+    template <typename T>
+    bool read_value(T& value) { return read(&value, sizeof(T)); }
+
+    bool read_string(std::string& out) {
+        uint64_t len = 0;
+        if (!read_value(len)) return false;
+        if (len > remaining()) {
+            truncated_ = true;
+            return false;
+        }
+        out.resize(len);
+        return read(&out[0], len);
+    }
+
+private:
+    bool fill() {
+        if (buf_.empty()) buf_.resize(1 << 20);
+        const uint64_t want = std::min<uint64_t>(buf_.size(), remaining());
+        ssize_t got;
+        do {
+            got = pread(fd_, buf_.data(), want, base_ + pos_);
+        } while (got < 0 && errno == EINTR);
+        if (got <= 0) {
+            // Region claims more bytes than the file has
+            if (got == 0) truncated_ = true; else io_error_ = true;
+            return false;
+        }
+        buf_pos_ = 0;
+        buf_len_ = static_cast<size_t>(got);
+        return true;
+    }
+
+    int fd_;
+    uint64_t base_;
+    uint64_t size_;
+    uint64_t pos_ = 0;
+    std::vector<uint8_t> buf_;
+    size_t buf_pos_ = 0;
+    size_t buf_len_ = 0;
+    bool truncated_ = false;
+    bool io_error_ = false;
+};
+
+size_t scalar_size(uint32_t type) {
+    switch (type) {
+        case GGUF_UINT8: case GGUF_INT8: case GGUF_BOOL: return 1;
+        case GGUF_UINT16: case GGUF_INT16: return 2;
+        case GGUF_UINT32: case GGUF_INT32: case GGUF_FLOAT32: return 4;
+        case GGUF_UINT64: case GGUF_INT64: case GGUF_FLOAT64: return 8;
+        default: return 0;
+    }
+}
+
+bool read_scalar(RegionReader& r, uint32_t type, double& out) {
+    switch (type) {
+        case GGUF_UINT8:   { uint8_t v;  if (!r.read_value(v)) return false; out = v; return true; }
+        case GGUF_INT8:    { int8_t v;   if (!r.read_value(v)) return false; out = v; return true; }
+        case GGUF_BOOL:    { uint8_t v;  if (!r.read_value(v)) return false; out = v != 0; return true; }
+        case GGUF_UINT16:  { uint16_t v; if (!r.read_value(v)) return false; out = v; return true; }
+        case GGUF_INT16:   { int16_t v;  if (!r.read_value(v)) return false; out = v; return true; }
+        case GGUF_UINT32:  { uint32_t v; if (!r.read_value(v)) return false; out = v; return true; }
+        case GGUF_INT32:   { int32_t v;  if (!r.read_value(v)) return false; out = v; return true; }
+        case GGUF_FLOAT32: { float v;    if (!r.read_value(v)) return false; out = v; return true; }
+        case GGUF_UINT64:  { uint64_t v; if (!r.read_value(v)) return false; out = (double) v; return true; }
+        case GGUF_INT64:   { int64_t v;  if (!r.read_value(v)) return false; out = (double) v; return true; }
+        case GGUF_FLOAT64: { double v;   if (!r.read_value(v)) return false; out = v; return true; }
+        default: return false;
+    }
+}
+
+GgufStatus fail(RegionReader& r, std::string& error, const std::string& what) {
+    if (r.truncated()) {
+        error = "truncated while reading " + what;
+        return GgufStatus::kTruncated;
+    }
+    error = (r.io_error() ? "I/O error while reading " : "invalid ") + what;
+    return GgufStatus::kCorrupt;
+}
+
+} // namespace
+
+std::string GgufInfo::architecture() const {
+    auto it = strings.find("general.architecture");
+    return it != strings.end() ? it->second : std::string();
+}
+
+double GgufInfo::arch_number(const char* suffix, double fallback) const {
+    auto it = numbers.find(architecture() + "." + suffix);
+    return it != numbers.end() ? it->second : fallback;
+}
+
+std::string gguf_type_name(uint32_t type) {
+    if (type < kNumTypes && kTypeTraits[type].name) return kTypeTraits[type].name;
+    return "type" + std::to_string(type);
+}
+
+double gguf_type_bytes_per_element(uint32_t type) {
+    if (type >= kNumTypes || kTypeTraits[type].block_size == 0) return 0.0;
+    return (double) kTypeTraits[type].type_size / kTypeTraits[type].block_size;
+}
+
+GgufStatus gguf_read_info(int fd, uint64_t base_offset, uint64_t region_size,
+                          GgufInfo& info, std::string& error) {
+    RegionReader r(fd, base_offset, region_size);
+    info = GgufInfo();
+
+    uint32_t magic = 0;
+    if (!r.read_value(magic)) return fail(r, error, "magic");
+    if (magic != kGgufMagic) {
+        error = "not a GGUF file";
+        return GgufStatus::kCorrupt;
+    }
+    if (!r.read_value(info.version)) return fail(r, error, "version");
+    if (info.version < 2 || info.version > 3) {
+        error = "unsupported GGUF version " + std::to_string(info.version);
+        return GgufStatus::kCorrupt;
+    }
+
+    uint64_t n_tensors = 0;
+    if (!r.read_value(n_tensors) || !r.read_value(info.n_kv)) return fail(r, error, "counts");
+
+    // --- Metadata KV table ---
+    for (uint64_t i = 0; i < info.n_kv; i++) {
+        std::string key;
+        uint32_t type = 0;
+        if (!r.read_string(key) || !r.read_value(type)) return fail(r, error, "kv header");
+
+        if (type == GGUF_STRING) {
+            std::string value;
+            if (!r.read_string(value)) return fail(r, error, "kv '" + key + "'");
+            info.strings[key] = std::move(value);
+        } else if (type == GGUF_ARRAY) {
+            uint32_t elem_type = 0;
+            uint64_t count = 0;
+            if (!r.read_value(elem_type) || !r.read_value(count)) return fail(r, error, "array '" + key + "'");
+            if (elem_type == GGUF_STRING) {
+                // Tokenizer vocabularies: walk the lengths, skip the bytes
+                for (uint64_t j = 0; j < count; j++) {
+                    uint64_t len = 0;
+                    if (!r.read_value(len) || !r.skip(len)) return fail(r, error, "array '" + key + "'");
+                }
+            } else {
+                const size_t elem_size = scalar_size(elem_type);
+                if (elem_size == 0) {
+                    error = "invalid array type for '" + key + "'";
+                    return GgufStatus::kCorrupt;
+                }
+                if (count > UINT64_MAX / elem_size) {
+                    error = "array '" + key + "' is too large";
+                    return GgufStatus::kCorrupt;
+                }
+                if (!r.skip(count * elem_size)) return fail(r, error, "array '" + key + "'");
+            }
+        } else {
+            double value = 0.0;
+            if (type >= GGUF_VALUE_TYPE_COUNT) {
+                error = "invalid value type for '" + key + "'";
+                return GgufStatus::kCorrupt;
+            }
+            if (!read_scalar(r, type, value)) return fail(r, error, "kv '" + key + "'");
+            info.numbers[key] = value;
+        }
+    }
+
+    auto align_it = info.numbers.find("general.alignment");
+    if (align_it != info.numbers.end()) {
+        const uint64_t align = (uint64_t) align_it->second;
+        if (align == 0 || (align & (align - 1)) != 0) {
+            error = "general.alignment is not a power of two";
+            return GgufStatus::kCorrupt;
+        }
+        info.alignment = (uint32_t) align;
+    }
+
+    // --- Tensor-info table ---
+    // Each tensor-info entry is at least 32 bytes; don't trust a corrupt count for the reservation
+    info.tensors.reserve(std::min<uint64_t>(n_tensors, r.remaining() / 32));
+    for (uint64_t i = 0; i < n_tensors; i++) {
+        GgufTensorInfo t;
+        if (!r.read_string(t.name) || !r.read_value(t.n_dims)) return fail(r, error, "tensor info");
+        if (t.n_dims == 0 || t.n_dims > kMaxDims) {
+            error = "tensor '" + t.name + "' has " + std::to_string(t.n_dims) + " dims";
+            return GgufStatus::kCorrupt;
+        }
+        uint64_t n_elements = 1;
+        for (uint32_t d = 0; d < t.n_dims; d++) {
+            if (!r.read_value(t.ne[d])) return fail(r, error, "tensor '" + t.name + "'");
+            if (t.ne[d] <= 0 || (uint64_t) t.ne[d] > UINT64_MAX / n_elements) {
+                error = "tensor '" + t.name + "' has invalid shape";
+                return GgufStatus::kCorrupt;
+            }
+            n_elements *= (uint64_t) t.ne[d];
+        }
+        if (!r.read_value(t.type) || !r.read_value(t.offset)) return fail(r, error, "tensor '" + t.name + "'");
+
+        if (t.type >= kNumTypes || kTypeTraits[t.type].block_size == 0) {
+            error = "tensor '" + t.name + "' has unknown type " + std::to_string(t.type);
+            return GgufStatus::kCorrupt;
+        }
+        const TypeTraits& tt = kTypeTraits[t.type];
+        if (t.ne[0] % tt.block_size != 0) {
+            error = "tensor '" + t.name + "' row is not a multiple of the block size";
+            return GgufStatus::kCorrupt;
+        }
+        if (t.offset % info.alignment != 0) {
+            error = "tensor '" + t.name + "' data is not aligned";
+            return GgufStatus::kCorrupt;
+        }
+        if (n_elements / tt.block_size > UINT64_MAX / tt.type_size) {
+            error = "tensor '" + t.name + "' is too large";
+            return GgufStatus::kCorrupt;
+        }
+        t.nbytes = n_elements / tt.block_size * tt.type_size;
+        info.n_params += n_elements;
+        info.tensors.push_back(std::move(t));
+    }
+
+    info.data_offset = (r.pos() + info.alignment - 1) / info.alignment * info.alignment;
+
+    // --- Tensor extents ---
+    // Sort by offset so overlaps are detected in one pass
+    std::vector<const GgufTensorInfo*> by_offset;
+    by_offset.reserve(info.tensors.size());
+    for (const auto& t : info.tensors) by_offset.push_back(&t);
+    std::sort(by_offset.begin(), by_offset.end(),
+              [](const GgufTensorInfo* a, const GgufTensorInfo* b) { return a->offset < b->offset; });
+
+    uint64_t end = 0;
+    for (const GgufTensorInfo* t : by_offset) {
+        if (t->offset < end) {
+            error = "tensor '" + t->name + "' overlaps the previous tensor";
+            return GgufStatus::kCorrupt;
+        }
+        if (t->nbytes > UINT64_MAX - info.data_offset ||
+            t->offset > UINT64_MAX - info.data_offset - t->nbytes) {
+            error = "tensor '" + t->name + "' offset overflows";
+            return GgufStatus::kCorrupt;
+        }
+        end = t->offset + t->nbytes;
+    }
+    info.data_end = info.data_offset + end;
+    info.expected_bytes = (info.data_end + info.alignment - 1) / info.alignment * info.alignment;
+
+    if (info.data_end > region_size) {
+        error = "tensor data ends at " + std::to_string(info.data_end) +
+                " but file has " + std::to_string(region_size) + " bytes";
+        return GgufStatus::kTruncated;
+    }
+    if (region_size > info.expected_bytes) {
+        // Trailing bytes past the padded tensor data: not written by any gguf writer
+        error = "file has " + std::to_string(region_size - info.expected_bytes) + " unexpected trailing bytes";
+        return GgufStatus::kCorrupt;
+    }
+    return GgufStatus::kComplete;
+}
+
+GgufStatus gguf_read_info(const char* path, GgufInfo& info, std::string& error) {
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = std::string("cannot open: ") + strerror(errno);
+        return GgufStatus::kCorrupt;
+    }
+    struct stat st {};
+    GgufStatus status;
+    if (fstat(fd, &st) != 0) {
+        error = std::string("cannot stat: ") + strerror(errno);
+        status = GgufStatus::kCorrupt;
+    } else {
+        status = gguf_read_info(fd, 0, (uint64_t) st.st_size, info, error);
+    }
+    close(fd);
+    return status;
+}
+
+extern "C" {
+
+/**
+ * Validate a GGUF file without loading it: parses the header and tensor-info
+ * table and checks that every tensor lies inside the file.
+ * Returns: JSON with "status" ("complete" | "truncated" | "corrupt"), the
+ * architecture, parameter count, per-type tensor counts and the exact expected
+ * byte length. The pointer stays valid until the next call on this thread.
+ */
+const char* validate_gguf(const char* path) {
+    static thread_local std::string report;
+
+    const int64_t t_start = now_us();
+    GgufInfo info;
+    std::string error;
+    const GgufStatus status = gguf_read_info(path, info, error);
+    const double elapsed_ms = (now_us() - t_start) / 1000.0;
+
+    struct stat st {};
+    const uint64_t file_bytes = stat(path, &st) == 0 ? (uint64_t) st.st_size : 0;
+
+    std::map<std::string, int> type_counts;
+    for (const auto& t : info.tensors) type_counts[gguf_type_name(t.type)]++;
+
+    const char* status_str = status == GgufStatus::kComplete ? "complete"
+                           : status == GgufStatus::kTruncated ? "truncated" : "corrupt";
+    auto file_type = info.numbers.find("general.file_type");
+    auto model_name = info.strings.find("general.name");
+
+    report = "{\"status\":\"" + std::string(status_str) + "\"";
+    report += ",\"error\":\"" + json_escape(error) + "\"";
+    report += ",\"version\":" + std::to_string(info.version);
+    report += ",\"architecture\":\"" + json_escape(info.architecture()) + "\"";
+    report += ",\"name\":\"" + json_escape(model_name != info.strings.end() ? model_name->second : "") + "\"";
+    report += ",\"file_type\":" + std::to_string(file_type != info.numbers.end() ? (int) file_type->second : -1);
+    report += ",\"n_tensors\":" + std::to_string(info.tensors.size());
+    report += ",\"n_params\":" + std::to_string(info.n_params);
+    report += ",\"file_bytes\":" + std::to_string(file_bytes);
+    report += ",\"expected_bytes\":" + std::to_string(info.expected_bytes);
+    report += ",\"data_offset\":" + std::to_string(info.data_offset);
+    report += ",\"tensor_types\":{";
+    bool first = true;
+    for (const auto& kv : type_counts) {
+        report += (first ? "\"" : ",\"") + kv.first + "\":" + std::to_string(kv.second);
+        first = false;
+    }
+    char elapsed[32];
+    snprintf(elapsed, sizeof(elapsed), "%.3f", elapsed_ms);
+    report += "},\"elapsed_ms\":" + std::string(elapsed) + "}";
+
+    LOGI("GGUF: %s %s (%s) in %.2f ms", path, status_str, error.c_str(), elapsed_ms);
+    return report.c_str();
+}
+
+} // extern "C"
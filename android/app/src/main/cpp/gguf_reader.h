@@ -0,0 +1,69 @@
+#pragma once
+
+// Lightweight GGUF header reader.
+//
+// Parses only the header, the metadata KV table and the tensor-info table,
+// without touching tensor data or depending on ggml, so it can validate a
+// multi-GB file in milliseconds before llama.cpp is asked to load it.
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+struct GgufTensorInfo {
+    std::string name;
+    uint32_t type = 0;        // ggml_type id as stored in the file
+    uint32_t n_dims = 0;
+    int64_t ne[4] = {1, 1, 1, 1};
+    uint64_t offset = 0;      // Relative to the start of the data section
+    uint64_t nbytes = 0;
+};
+
+struct GgufInfo {
+    uint32_t version = 0;
+    uint32_t alignment = 32;
+    uint64_t n_kv = 0;
+    uint64_t data_offset = 0;     // Start of the tensor data, relative to the region start
+    uint64_t data_end = 0;        // End of the last tensor, relative to the region start
+    uint64_t expected_bytes = 0;  // data_end padded to the alignment, as written by gguf writers
+    uint64_t n_params = 0;
+
+    // Scalar metadata, keyed by the full GGUF key (e.g. "llama.block_count")
+    std::map<std::string, std::string> strings;
+    std::map<std::string, double> numbers;
+
+    std::vector<GgufTensorInfo> tensors;
+
+    std::string architecture() const;
+    // Numeric "<arch>.<suffix>" value, e.g. arch_number("block_count")
+    double arch_number(const char* suffix, double fallback = 0.0) const;
+};
+
+enum class GgufStatus {
+    kComplete,   // Header parsed and every tensor lies inside the region
+    kTruncated,  // Header or tensor data runs past the end of the region (e.g. partial download)
+    kCorrupt,    // Not a GGUF file, or the header is internally inconsistent
+};
+
+/**
+ * Parse the GGUF stored in [base_offset, base_offset + region_size) of fd.
+ * Returns: kComplete when the whole model is present; error describes any other result.
+ */
+GgufStatus gguf_read_info(int fd, uint64_t base_offset, uint64_t region_size,
+                          GgufInfo& info, std::string& error);
+
+/**
+ * Parse a standalone GGUF file
+ */
+GgufStatus gguf_read_info(const char* path, GgufInfo& info, std::string& error);
+
+/**
+ * Name of a ggml type id ("q4_K", "f16", ...), or "type<N>" for unknown ids
+ */
+std::string gguf_type_name(uint32_t type);
+
+/**
+ * Average bytes per element of a ggml type id (e.g. 1.0625 for q8_0), 0 for unknown ids
+ */
+double gguf_type_bytes_per_element(uint32_t type);
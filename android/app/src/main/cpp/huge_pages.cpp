@@ -0,0 +1,194 @@
+#include "huge_pages.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+#include <cerrno>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ggml-backend.h"
+#include "native_common.h"
+
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE 25 // Linux 6.1; older headers (and the NDK) may not define it
+#endif
+
+namespace {
+
+/**
+ * PMD huge page size from sysfs: 2 MiB on x86_64 and arm64 with 4 KiB pages
+ */
+uint64_t huge_page_bytes() {
+    static const uint64_t bytes = [] {
+        uint64_t value = 0;
+        if (FILE* f = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r")) {
+            if (fscanf(f, "%" SCNu64, &value) != 1) value = 0;
+            fclose(f);
+        }
+        return value > 0 ? value : (uint64_t) 2 << 20;
+    }();
+    return bytes;
+}
+
+bool is_anonymous(const MemoryMapping& m) {
+    return m.inode == 0 && (m.path.empty() || m.path.compare(0, 6, "[anon:") == 0 || m.path == "[heap]");
+}
+
+/**
+ * Advise one page-aligned range: the whole of it for future faults, the aligned
+ * interior collapsed now
+ */
+void advise_range(uintptr_t start, uintptr_t end, bool file, HugePageAdvice& advice, bool& collapse_supported) {
+    const uint64_t hp = huge_page_bytes();
+    if (madvise(reinterpret_cast<void*>(start), end - start, MADV_HUGEPAGE) != 0) {
+        advice.failures++;
+        return;
+    }
+    advice.ranges.push_back({start, end, file});
+    advice.advised_bytes += end - start;
+
+    const uintptr_t lo = (start + hp - 1) / hp * hp;
+    const uintptr_t hi = end / hp * hp;
+    if (hi <= lo || !collapse_supported) return;
+    if (madvise(reinterpret_cast<void*>(lo), hi - lo, MADV_COLLAPSE) == 0) {
+        advice.collapsed_bytes += hi - lo;
+    } else if (errno == EINVAL) {
+        // Kernel without MADV_COLLAPSE; khugepaged collapses the ranges later
+        collapse_supported = false;
+    } else {
+        advice.failures++;
+    }
+}
+
+void add_buffer(GgmlBufferRanges& buffers, const ggml_tensor* t) {
+    if (!t) return;
+    ggml_backend_buffer_t buffer = t->view_src ? t->view_src->buffer : t->buffer;
+    if (!buffer || !ggml_backend_buffer_is_host(buffer)) return;
+    const uintptr_t start = reinterpret_cast<uintptr_t>(ggml_backend_buffer_get_base(buffer));
+    const uintptr_t end = start + ggml_backend_buffer_get_size(buffer);
+    for (const auto& r : buffers.ranges) {
+        if (r.first == start) return;
+    }
+    buffers.ranges.emplace_back(start, end);
+}
+
+} // namespace
+
+std::vector<MemoryMapping> read_memory_mappings() {
+    std::vector<MemoryMapping> mappings;
+    FILE* f = fopen("/proc/self/maps", "r");
+    if (!f) return mappings;
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+        MemoryMapping m;
+        unsigned long long start = 0, end = 0, inode = 0;
+        int path_pos = 0;
+        if (sscanf(line, "%llx-%llx %*s %*s %*s %llu %n", &start, &end, &inode, &path_pos) < 3) continue;
+        m.start = (uintptr_t) start;
+        m.end = (uintptr_t) end;
+        m.inode = inode;
+        m.path = line + path_pos;
+        while (!m.path.empty() && (m.path.back() == '\n' || m.path.back() == ' ')) m.path.pop_back();
+        mappings.push_back(std::move(m));
+    }
+    fclose(f);
+    return mappings;
+}
+
+bool collect_ggml_buffers(ggml_tensor* t, bool ask, void* user_data) {
+    GgmlBufferRanges& buffers = *static_cast<GgmlBufferRanges*>(user_data);
+    if (!ask || !buffers.collecting) return false;
+    add_buffer(buffers, t);
+    for (const ggml_tensor* src : t->src) add_buffer(buffers, src);
+    return false;
+}
+
+HugePageAdvice advise_huge_pages(const GgmlBufferRanges& buffers, const char* model_path) {
+    HugePageAdvice advice;
+    bool collapse_supported = true;
+    struct stat st;
+    const uint64_t model_inode = model_path && stat(model_path, &st) == 0 ? (uint64_t) st.st_ino : 0;
+    const uintptr_t page = (uintptr_t) sysconf(_SC_PAGESIZE);
+
+    for (const MemoryMapping& m : read_memory_mappings()) {
+        if (model_inode != 0 && m.inode == model_inode) {
+            advise_range(m.start, m.end, true, advice, collapse_supported);
+            continue;
+        }
+        if (!is_anonymous(m)) continue;
+        // Only the pages a buffer covers: the rest of the mapping may belong to anyone
+        for (const auto& r : buffers.ranges) {
+            const uintptr_t lo = (std::max(r.first, m.start) + page - 1) / page * page;
+            const uintptr_t hi = std::min(r.second, m.end) / page * page;
+            if (hi > lo && hi - lo >= huge_page_bytes()) advise_range(lo, hi, false, advice, collapse_supported);
+        }
+    }
+    LOGI("THP: Advised %zu ranges (%.1f MiB), collapsed %.1f MiB, %d failures", advice.ranges.size(),
+         advice.advised_bytes / 1048576.0, advice.collapsed_bytes / 1048576.0, advice.failures);
+    return advice;
+}
+
+HugePageUsage read_huge_page_usage(const HugePageAdvice& advice) {
+    HugePageUsage usage;
+    FILE* f = fopen("/proc/self/smaps", "r");
+    if (!f) return usage;
+
+    char line[4096];
+    const HugePageRange* current = nullptr;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long start = 0, end = 0;
+        char key[64];
+        unsigned long long kb = 0;
+        if (sscanf(line, "%llx-%llx ", &start, &end) == 2 && strchr(line, '-') < strchr(line, ' ')) {
+            // A new mapping; it may be a piece of an advised range that madvise split
+            current = nullptr;
+            for (const HugePageRange& r : advice.ranges) {
+                if ((uintptr_t) start >= r.start && (uintptr_t) start < r.end) {
+                    current = &r;
+                    break;
+                }
+            }
+            continue;
+        }
+        if (sscanf(line, "%63[^:]: %llu kB", key, &kb) != 2) continue;
+        const double mib = kb / 1024.0;
+        const bool huge = strcmp(key, "AnonHugePages") == 0 || strcmp(key, "FilePmdMapped") == 0 ||
+                          strcmp(key, "ShmemPmdMapped") == 0;
+        if (huge) usage.process_huge_mib += mib;
+        if (!current) continue;
+        if (strcmp(key, "Rss") == 0) {
+            (current->file ? usage.weights_mib : usage.anon_mib) += mib;
+        } else if (huge) {
+            (current->file ? usage.weights_huge_mib : usage.anon_huge_mib) += mib;
+        }
+    }
+    fclose(f);
+    return usage;
+}
+
+std::string transparent_huge_page_mode() {
+    FILE* f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (!f) return "unsupported";
+    char buf[128] = {0};
+    const bool ok = fgets(buf, sizeof(buf), f) != nullptr;
+    fclose(f);
+    // e.g. "always [madvise] never": the bracketed one is active
+    const char* open = ok ? strchr(buf, '[') : nullptr;
+    const char* close = open ? strchr(open, ']') : nullptr;
+    return close ? std::string(open + 1, close) : "unsupported";
+}
+
+std::string huge_page_report_json(const HugePageAdvice& advice, const HugePageUsage& usage) {
+    char buf[384];
+    snprintf(buf, sizeof(buf),
+             "{\"thp\":\"%s\",\"ranges\":%zu,\"advised_mib\":%.2f,\"collapsed_mib\":%.2f,\"failures\":%d,"
+             "\"weights_mib\":%.2f,\"weights_huge_mib\":%.2f,\"anon_mib\":%.2f,\"anon_huge_mib\":%.2f,"
+             "\"process_huge_mib\":%.2f}",
+             transparent_huge_page_mode().c_str(), advice.ranges.size(), advice.advised_bytes / 1048576.0,
+             advice.collapsed_bytes / 1048576.0, advice.failures, usage.weights_mib, usage.weights_huge_mib,
+             usage.anon_mib, usage.anon_huge_mib, usage.process_huge_mib);
+    return buf;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+// Transparent huge pages for the engine's memory.
+//
+// Decoding reads every weight once per token, so with 4 KiB pages a large model
+// walks through hundreds of thousands of TLB entries per token. ggml allocates
+// the weights (mmap), the KV cache and the compute buffers itself, so instead
+// of allocating them, the engine collects the host buffers one decode touches
+// (through the scheduler's eval callback) and the model file's mappings, marks
+// them MADV_HUGEPAGE and collapses their 2 MiB-aligned interiors right away with
+// MADV_COLLAPSE (Linux 6.1+; older kernels leave it to khugepaged). Memory the
+// Dart VM or other threads map meanwhile is left alone. What actually ended up
+// on huge pages is read back from /proc/self/smaps.
+//
+// Anonymous memory (KV cache, compute buffers, weights loaded without mmap) can
+// use THP whenever the kernel's mode isn't "never". Mmapped weights are page
+// cache: they only end up on huge pages where the filesystem caches the file in
+// PMD-sized folios, so on many devices weights_huge_mib stays 0 and use_mmap
+// off is the way to get the weights onto huge pages.
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct ggml_tensor;
+
+struct MemoryMapping {
+    uintptr_t start = 0;
+    uintptr_t end = 0;
+    uint64_t inode = 0;
+    std::string path; // Empty or "[anon:...]" for anonymous memory
+};
+
+struct HugePageRange {
+    uintptr_t start = 0;
+    uintptr_t end = 0;
+    bool file = false; // Model file mapping (weights) rather than anonymous memory
+};
+
+struct HugePageAdvice {
+    std::vector<HugePageRange> ranges;
+    uint64_t advised_bytes = 0;
+    uint64_t collapsed_bytes = 0; // Aligned bytes MADV_COLLAPSE accepted
+    int failures = 0;             // madvise calls the kernel rejected, other than an
+                                  // MADV_COLLAPSE it doesn't implement
+};
+
+// Host ggml buffers (weights, KV cache, compute buffers) as [start, end) ranges
+struct GgmlBufferRanges {
+    std::vector<std::pair<uintptr_t, uintptr_t>> ranges;
+    bool collecting = false; // Only while the probe decode runs
+};
+
+struct HugePageUsage {
+    double weights_mib = 0.0;      // Resident model file pages
+    double weights_huge_mib = 0.0; // ... mapped by huge pages (FilePmdMapped)
+    double anon_mib = 0.0;         // Resident advised anonymous memory
+    double anon_huge_mib = 0.0;    // ... on huge pages (AnonHugePages)
+    double process_huge_mib = 0.0; // Whole process, advised or not
+};
+
+/**
+ * Mappings of this process, from /proc/self/maps
+ */
+std::vector<MemoryMapping> read_memory_mappings();
+
+/**
+ * Scheduler eval callback (llama_context_params::cb_eval, user data a
+ * GgmlBufferRanges): while collecting, records the buffers of every node and its
+ * sources. Never asks to see a result, so graphs compute as without a callback.
+ */
+bool collect_ggml_buffers(ggml_tensor* t, bool ask, void* user_data);
+
+/**
+ * Advise huge pages for the mappings of model_path and for the parts of the
+ * ggml buffers in buffers that lie in anonymous memory
+ */
+HugePageAdvice advise_huge_pages(const GgmlBufferRanges& buffers, const char* model_path);
+
+/**
+ * Resident and huge-page-backed memory of the advised ranges, from /proc/self/smaps
+ */
+HugePageUsage read_huge_page_usage(const HugePageAdvice& advice);
+
+/**
+ * THP mode of the kernel ("always", "madvise", "never"), or "unsupported"
+ */
+std::string transparent_huge_page_mode();
+
+/**
+ * JSON: {"thp","ranges","advised_mib","collapsed_mib","failures","weights_mib",
+ * "weights_huge_mib","anon_mib","anon_huge_mib","process_huge_mib"}
+ */
+std::string huge_page_report_json(const HugePageAdvice& advice, const HugePageUsage& usage);
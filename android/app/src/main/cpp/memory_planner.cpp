@@ -0,0 +1,232 @@
+#include "memory_planner.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "native_common.h"
+
+namespace {
+
+constexpr int32_t kMinContext = 64;          // As in engine_config.cpp
+constexpr uint32_t kKvPadding = 256;         // llama.cpp pads the KV cache size to this
+constexpr double kBudgetFraction = 0.8;      // The low-memory killer acts before MemAvailable reaches 0
+constexpr uint64_t kBaseOverheadBytes = 24ull << 20;
+constexpr uint64_t kBytesPerVocabEntry = 96; // Token text, scores and lookup tables
+
+double to_mib(uint64_t bytes) {
+    return bytes / 1048576.0;
+}
+
+/**
+ * Model shape from the GGUF metadata, with llama.cpp's defaults for missing keys
+ */
+struct ModelShape {
+    int64_t n_layer = 0;
+    int64_t n_embd = 0;
+    int64_t n_head = 0;
+    int64_t n_embd_k_gqa = 0; // K row of one layer over all KV heads
+    int64_t n_embd_v_gqa = 0;
+    int64_t n_ff = 0;
+    int64_t n_vocab = 0;
+    int32_t n_ctx_train = 0;
+    uint64_t weight_bytes = 0;
+};
+
+ModelShape read_shape(const GgufInfo& info) {
+    ModelShape s;
+    s.n_layer = (int64_t) info.arch_number("block_count");
+    s.n_embd = (int64_t) info.arch_number("embedding_length");
+    s.n_head = std::max<int64_t>(1, (int64_t) info.arch_number("attention.head_count", 1));
+    const int64_t n_head_kv = (int64_t) info.arch_number("attention.head_count_kv", (double) s.n_head);
+    const int64_t head_k = (int64_t) info.arch_number("attention.key_length", (double) (s.n_embd / s.n_head));
+    const int64_t head_v = (int64_t) info.arch_number("attention.value_length", (double) (s.n_embd / s.n_head));
+    s.n_embd_k_gqa = head_k * n_head_kv;
+    s.n_embd_v_gqa = head_v * n_head_kv;
+    s.n_ff = (int64_t) info.arch_number("feed_forward_length", (double) (4 * s.n_embd));
+    s.n_ctx_train = (int32_t) info.arch_number("context_length", 2048);
+    for (const GgufTensorInfo& t : info.tensors) {
+        s.weight_bytes += t.nbytes;
+        if (t.name == "token_embd.weight") s.n_vocab = t.ne[1];
+    }
+    return s;
+}
+
+MemoryEstimate estimate_shape(const ModelShape& s, const EngineConfig& cfg) {
+    MemoryEstimate e;
+    const int32_t n_ctx_train = std::max(s.n_ctx_train, kMinContext);
+    e.n_ctx = cfg.n_ctx <= 0 ? n_ctx_train : std::min(std::max(cfg.n_ctx, kMinContext), n_ctx_train);
+    e.type_k = cfg.type_k;
+    e.type_v = cfg.type_v;
+    e.weight_bytes = s.weight_bytes;
+
+    const uint64_t kv_size = ((uint64_t) e.n_ctx + kKvPadding - 1) / kKvPadding * kKvPadding;
+    const double row_bytes = s.n_embd_k_gqa * gguf_type_bytes_per_element((uint32_t) cfg.type_k) +
+                             s.n_embd_v_gqa * gguf_type_bytes_per_element((uint32_t) cfg.type_v);
+    e.kv_bytes = (uint64_t) ((double) s.n_layer * kv_size * row_bytes);
+
+    // The graph allocator reuses memory between ops, so the peak is roughly the
+    // largest intermediate plus a few hidden-state-sized tensors. Auto flash
+    // attention resolves to on for the CPU backend.
+    const uint64_t n_ubatch = (uint64_t) std::max(1, std::min(cfg.n_ubatch, std::min(cfg.n_batch, e.n_ctx)));
+    const uint64_t attention = cfg.flash_attn == LLAMA_FLASH_ATTN_TYPE_DISABLED
+        ? n_ubatch * kv_size * (uint64_t) s.n_head * sizeof(float) : n_ubatch * (uint64_t) s.n_embd * sizeof(float);
+    const uint64_t ffn = 3 * n_ubatch * (uint64_t) s.n_ff * sizeof(float);
+    const uint64_t logits = n_ubatch * (uint64_t) s.n_vocab * sizeof(float);
+    e.compute_bytes = std::max({attention, ffn, logits}) + 6 * n_ubatch * (uint64_t) s.n_embd * sizeof(float);
+
+    // Output buffer: logits of one sequence (n_seq_max 1)
+    e.overhead_bytes = kBaseOverheadBytes + (uint64_t) s.n_vocab * (kBytesPerVocabEntry + sizeof(float));
+    e.total_bytes = e.weight_bytes + e.kv_bytes + e.compute_bytes + e.overhead_bytes;
+    e.weights_mapped = cfg.use_mmap && !cfg.use_mlock;
+    e.committed_bytes = e.total_bytes - (e.weights_mapped ? e.weight_bytes : 0);
+    return e;
+}
+
+std::string estimate_json(const MemoryEstimate& e) {
+    char buf[384];
+    snprintf(buf, sizeof(buf),
+             "{\"n_ctx\":%d,\"type_k\":\"%s\",\"type_v\":\"%s\",\"weights_mib\":%.2f,\"kv_mib\":%.2f,"
+             "\"compute_mib\":%.2f,\"overhead_mib\":%.2f,\"total_mib\":%.2f,\"weights_mapped\":%s,"
+             "\"committed_mib\":%.2f}",
+             e.n_ctx, gguf_type_name((uint32_t) e.type_k).c_str(), gguf_type_name((uint32_t) e.type_v).c_str(),
+             to_mib(e.weight_bytes), to_mib(e.kv_bytes), to_mib(e.compute_bytes), to_mib(e.overhead_bytes),
+             to_mib(e.total_bytes), e.weights_mapped ? "true" : "false", to_mib(e.committed_bytes));
+    return buf;
+}
+
+double error_pct(double predicted, double measured) {
+    return measured > 0.0 ? (predicted - measured) / measured * 100.0 : 0.0;
+}
+
+/**
+ * One /proc/meminfo field (format "Key: %llu kB") in bytes, 0 if missing
+ */
+uint64_t read_meminfo(const char* format) {
+    FILE* f = fopen("/proc/meminfo", "r");
+    if (!f) return 0;
+    char line[256];
+    uint64_t kb = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, format, &kb) == 1) break;
+    }
+    fclose(f);
+    return kb * 1024;
+}
+
+} // namespace
+
+uint64_t read_mem_available() {
+    return read_meminfo("MemAvailable: %" SCNu64 " kB");
+}
+
+uint64_t read_mem_total() {
+    return read_meminfo("MemTotal: %" SCNu64 " kB");
+}
+
+MemoryEstimate estimate_memory(const GgufInfo& info, const EngineConfig& cfg) {
+    return estimate_shape(read_shape(info), cfg);
+}
+
+MemoryPlan plan_memory(const GgufInfo& info, const EngineConfig& requested, uint64_t available_bytes,
+                       uint64_t mem_total_bytes) {
+    MemoryPlan plan;
+    plan.available_bytes = available_bytes;
+    plan.budget_bytes = (uint64_t) (available_bytes * kBudgetFraction);
+    plan.mem_total_bytes = mem_total_bytes;
+    plan.config = requested;
+    const uint64_t total_budget = (uint64_t) (mem_total_bytes * kBudgetFraction);
+
+    const ModelShape shape = read_shape(info);
+    if (shape.n_layer <= 0 || shape.n_embd <= 0 || shape.weight_bytes == 0) {
+        plan.verdict = "error";
+        plan.reason = "model shape missing from the GGUF metadata";
+        return plan;
+    }
+    plan.requested = estimate_shape(shape, requested);
+    plan.suggested = plan.requested;
+    if (available_bytes == 0) {
+        // No /proc/meminfo: nothing to compare with, don't block the load
+        plan.verdict = "fits";
+        plan.reason = "MemAvailable unknown";
+        return plan;
+    }
+
+    // Keep the context where possible: try a q8_0 cache before halving it
+    std::vector<std::pair<int32_t, int32_t>> kv_types = {{requested.type_k, requested.type_v}};
+    // A quantized V cache needs flash attention
+    const int32_t q8_v = requested.flash_attn == LLAMA_FLASH_ATTN_TYPE_DISABLED ? requested.type_v : GGML_TYPE_Q8_0;
+    if (requested.type_k != GGML_TYPE_Q8_0 || requested.type_v != q8_v) kv_types.push_back({GGML_TYPE_Q8_0, q8_v});
+
+    for (int32_t n_ctx = plan.requested.n_ctx; ; n_ctx /= 2) {
+        for (const auto& kv : kv_types) {
+            EngineConfig cfg = requested;
+            cfg.n_ctx = n_ctx;
+            cfg.type_k = kv.first;
+            cfg.type_v = kv.second;
+            const MemoryEstimate e = estimate_shape(shape, cfg);
+            plan.suggested = e;
+            plan.config = cfg;
+            if (e.committed_bytes <= plan.budget_bytes && (total_budget == 0 || e.total_bytes <= total_budget)) {
+                const bool same = e.n_ctx == plan.requested.n_ctx && cfg.type_k == requested.type_k &&
+                                  cfg.type_v == requested.type_v;
+                plan.verdict = same ? "fits" : "adjusted";
+                char buf[160];
+                snprintf(buf, sizeof(buf), "%.0f of %.0f MiB budget", to_mib(e.committed_bytes),
+                         to_mib(plan.budget_bytes));
+                plan.reason = buf;
+                if (e.weights_mapped) {
+                    snprintf(buf, sizeof(buf), " plus %.0f MiB of mapped weights", to_mib(e.weight_bytes));
+                    plan.reason += buf;
+                    // Still loads, but pages of the weights get evicted and read back while decoding
+                    if (e.total_bytes > plan.budget_bytes) plan.reason += " (more than fits in the page cache)";
+                }
+                if (!same) {
+                    snprintf(buf, sizeof(buf), "; requested config needs %.0f MiB",
+                             to_mib(plan.requested.committed_bytes));
+                    plan.reason += buf;
+                }
+                return plan;
+            }
+        }
+        if (n_ctx / 2 < std::min(kMinPlannedContext, plan.requested.n_ctx) || n_ctx <= kMinContext) break;
+    }
+
+    plan.verdict = "does_not_fit";
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "needs at least %.0f MiB committed (%.0f MiB with %s weights of %.0f MiB), budget %.0f MiB of "
+             "%.0f MiB available and %.0f MiB of %.0f MiB RAM",
+             to_mib(plan.suggested.committed_bytes), to_mib(plan.suggested.total_bytes),
+             plan.suggested.weights_mapped ? "mapped" : "loaded", to_mib(plan.suggested.weight_bytes),
+             to_mib(plan.budget_bytes), to_mib(available_bytes), to_mib(total_budget), to_mib(mem_total_bytes));
+    plan.reason = buf;
+    return plan;
+}
+
+std::string memory_plan_json(const MemoryPlan& plan) {
+    char buf[160];
+    snprintf(buf, sizeof(buf), ",\"available_mib\":%.2f,\"budget_mib\":%.2f,\"mem_total_mib\":%.2f",
+             to_mib(plan.available_bytes), to_mib(plan.budget_bytes), to_mib(plan.mem_total_bytes));
+    return "{\"verdict\":\"" + plan.verdict + "\",\"reason\":\"" + json_escape(plan.reason) + "\"" + buf +
+           ",\"requested\":" + estimate_json(plan.requested) + ",\"suggested\":" + estimate_json(plan.suggested) +
+           ",\"config\":" + engine_config_json(plan.config) + "}";
+}
+
+std::string memory_calibration_json(const MemoryCalibration& c) {
+    const MemoryEstimate& p = c.predicted;
+    // The measured total counts the same parts as the prediction, with its overhead
+    const double measured_total = c.weights_mib + c.kv_mib + c.compute_mib + to_mib(p.overhead_bytes);
+    char buf[640];
+    snprintf(buf, sizeof(buf),
+             "{\"predicted\":%s,\"measured\":{\"weights_mib\":%.2f,\"kv_mib\":%.2f,\"compute_mib\":%.2f,"
+             "\"total_mib\":%.2f,\"rss_delta_mib\":%.2f,\"available_drop_mib\":%.2f},"
+             "\"error_pct\":{\"weights\":%.2f,\"kv\":%.2f,\"compute\":%.2f,\"total\":%.2f}}",
+             estimate_json(p).c_str(), c.weights_mib, c.kv_mib, c.compute_mib, measured_total, c.rss_delta_mib,
+             c.available_drop_mib, error_pct(to_mib(p.weight_bytes), c.weights_mib),
+             error_pct(to_mib(p.kv_bytes), c.kv_mib), error_pct(to_mib(p.compute_bytes), c.compute_mib),
+             error_pct(to_mib(p.total_bytes), measured_total));
+    return buf;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+// Memory-fit planner: predicts what loading a model with a config will take,
+// before llama.cpp is asked to, so a model too large for the device fails with
+// a message instead of getting the process killed halfway through the load.
+//
+// Everything comes from the GGUF header (gguf_reader.h): the weights are the
+// tensor bytes, the KV cache is layers x padded context x (K + V row bytes for
+// the KV heads) in the cache types, and the compute buffer is modeled on the
+// largest intermediate of a ubatch (attention scores without flash attention,
+// the FFN activations, or the logits). Mmapped weights are page cache the kernel
+// can drop and read back, and MemAvailable already counts them as available
+// (prefetched or not), so only the committed part (buffers, plus the weights when
+// they are read into memory or locked) is compared with MemAvailable from
+// /proc/meminfo, less a safety margin because Android's low-memory killer acts
+// well before it reaches zero. The whole footprint, mapped weights included, is
+// compared with the same fraction of MemTotal. A config that doesn't fit is
+// retried with a q8_0 KV cache, then with half the context, down to
+// kMinPlannedContext.
+//
+// The compute model is approximate by nature, so every load records what
+// llama.cpp actually allocated next to the prediction (MemoryCalibration).
+
+#include <cstdint>
+#include <string>
+
+#include "engine_config.h"
+#include "gguf_reader.h"
+
+constexpr int32_t kMinPlannedContext = 256;
+
+struct MemoryEstimate {
+    int32_t n_ctx = 0;
+    int32_t type_k = 0;
+    int32_t type_v = 0;
+    uint64_t weight_bytes = 0;
+    uint64_t kv_bytes = 0;
+    uint64_t compute_bytes = 0;
+    uint64_t overhead_bytes = 0; // Tokenizer, graph metadata, output buffer, thread stacks
+    uint64_t total_bytes = 0;
+    bool weights_mapped = false;  // mmapped and not locked: reclaimable page cache
+    uint64_t committed_bytes = 0; // total_bytes less mapped weights
+};
+
+struct MemoryPlan {
+    std::string verdict; // "fits" | "adjusted" | "does_not_fit" | "error"
+    std::string reason;
+    uint64_t available_bytes = 0; // MemAvailable plus the buffers of a model the load replaces
+    uint64_t budget_bytes = 0;    // The part of it the plan may use
+    uint64_t mem_total_bytes = 0; // MemTotal, which the whole footprint is checked against
+    MemoryEstimate requested;
+    MemoryEstimate suggested;     // Equal to requested when it fits
+    EngineConfig config{};        // Requested config with the suggested n_ctx and KV types
+};
+
+/**
+ * MemAvailable from /proc/meminfo in bytes, 0 if unreadable
+ */
+uint64_t read_mem_available();
+
+/**
+ * MemTotal from /proc/meminfo in bytes, 0 if unreadable
+ */
+uint64_t read_mem_total();
+
+/**
+ * Predicted footprint of loading the model described by info with cfg.
+ * n_ctx is clamped like the engine does (0 = training context).
+ */
+MemoryEstimate estimate_memory(const GgufInfo& info, const EngineConfig& cfg);
+
+/**
+ * Find the config closest to requested that fits available_bytes and
+ * mem_total_bytes (see above)
+ */
+MemoryPlan plan_memory(const GgufInfo& info, const EngineConfig& requested, uint64_t available_bytes,
+                       uint64_t mem_total_bytes);
+
+/**
+ * JSON: {"verdict","reason","available_mib","budget_mib","mem_total_mib","requested":{estimate},
+ * "suggested":{estimate},"config":{engine config}}, estimates as
+ * {"n_ctx","type_k","type_v","weights_mib","kv_mib","compute_mib","overhead_mib","total_mib",
+ * "weights_mapped","committed_mib"}
+ */
+std::string memory_plan_json(const MemoryPlan& plan);
+
+/**
+ * Predicted vs measured footprint of one load
+ */
+struct MemoryCalibration {
+    MemoryEstimate predicted;
+    double weights_mib = 0.0;   // llama_model_size
+    double kv_mib = 0.0;        // KV buffers llama.cpp allocated
+    double compute_mib = 0.0;   // Compute buffers llama.cpp allocated
+    double rss_delta_mib = 0.0; // VmRSS growth over the load (weights only count once touched)
+    double available_drop_mib = 0.0; // MemAvailable drop over the load
+};
+
+/**
+ * JSON: {"predicted":{estimate},"measured":{"weights_mib","kv_mib","compute_mib","total_mib",
+ * "rss_delta_mib","available_drop_mib"},"error_pct":{"weights","kv","compute","total"}},
+ * errors as (predicted - measured) / measured
+ */
+std::string memory_calibration_json(const MemoryCalibration& calibration);
@@ -0,0 +1,389 @@
+// Parallel memory-mapped content hashing for model integrity.
+//
+// The file is memory-mapped and split into fixed-size chunks that are hashed
+// on all cores. Chunk hashes are the leaves of a binary Merkle tree whose root
+// identifies the whole file. A manifest stores the chunk size, file size, root
+// and every leaf, so a later check can verify the full file, or the chunks a
+// partial download already holds and then only the ones the resumed download
+// wrote. Only a manifest published with the model catches a bad download; one
+// created from the downloaded file can only catch later storage corruption.
+//
+// The hash is XXH64: it catches storage corruption and broken downloads at
+// several GB/s per core, but it is not a defence against deliberate tampering.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "native_common.h"
+
+namespace {
+
+constexpr uint64_t kDefaultChunkBytes = 4ull << 20;
+constexpr uint64_t kLeafLineBytes = 17; // 16 hex digits and a newline
+
+// ---------------------------------------------------------------------------
+// XXH64 (reference algorithm by Yann Collet, BSD-2)
+// ---------------------------------------------------------------------------
+
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t read64(const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+inline uint32_t read32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    acc = rotl64(acc, 31);
+    return acc * kPrime1;
+}
+
+inline uint64_t xxh_merge(uint64_t acc, uint64_t val) {
+    acc ^= xxh_round(0, val);
+    return acc * kPrime1 + kPrime4;
+}
+
+uint64_t xxh64(const uint8_t* p, size_t len, uint64_t seed) {
+    const uint8_t* const end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        const uint8_t* const limit = end - 32;
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        do {
+            v1 = xxh_round(v1, read64(p));      p += 8;
+            v2 = xxh_round(v2, read64(p));      p += 8;
+            v3 = xxh_round(v3, read64(p));      p += 8;
+            v4 = xxh_round(v4, read64(p));      p += 8;
+        } while (p <= limit);
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxh_merge(h, v1);
+        h = xxh_merge(h, v2);
+        h = xxh_merge(h, v3);
+        h = xxh_merge(h, v4);
+    } else {
+        h = seed + kPrime5;
+    }
+
+    h += (uint64_t) len;
+    while (p + 8 <= end) {
+        h ^= xxh_round(0, read64(p));
+        h = rotl64(h, 27) * kPrime1 + kPrime4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t) read32(p) * kPrime1;
+        h = rotl64(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * kPrime5;
+        h = rotl64(h, 11) * kPrime1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+// ---------------------------------------------------------------------------
+// Merkle tree over chunk hashes
+// ---------------------------------------------------------------------------
+
+/**
+ * Root of the binary tree over the leaves. Each parent is XXH64 of its two
+ * children seeded with the level, an odd node at the end of a level is
+ * carried up unchanged.
+ */
+uint64_t merkle_root(std::vector<uint64_t> level) {
+    if (level.empty()) return xxh64(nullptr, 0, 0);
+    uint64_t depth = 1;
+    while (level.size() > 1) {
+        std::vector<uint64_t> next;
+        next.reserve((level.size() + 1) / 2);
+        for (size_t i = 0; i + 1 < level.size(); i += 2) {
+            const uint64_t pair[2] = {level[i], level[i + 1]};
+            next.push_back(xxh64(reinterpret_cast<const uint8_t*>(pair), sizeof(pair), depth));
+        }
+        if (level.size() % 2 == 1) next.push_back(level.back());
+        level.swap(next);
+        depth++;
+    }
+    return level[0];
+}
+
+struct Manifest {
+    uint64_t chunk_bytes = kDefaultChunkBytes;
+    uint64_t file_bytes = 0;
+    uint64_t root = 0;
+    std::vector<uint64_t> leaves;
+};
+
+bool write_manifest(const std::string& path, const Manifest& m) {
+    const std::string tmp_path = path + ".tmp";
+    FILE* f = fopen(tmp_path.c_str(), "w");
+    if (!f) return false;
+    fprintf(f, "ngm1 %" PRIu64 " %" PRIu64 " %016" PRIx64 "\n", m.chunk_bytes, m.file_bytes, m.root);
+    for (const uint64_t leaf : m.leaves) fprintf(f, "%016" PRIx64 "\n", leaf);
+    const bool ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    if (fclose(f) != 0 || !ok) {
+        remove(tmp_path.c_str());
+        return false;
+    }
+    return rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+/**
+ * Returns: false if the manifest is missing or malformed. The leaf count from its
+ * header is checked against the manifest's size before anything is allocated.
+ */
+bool read_manifest(const std::string& path, Manifest& m) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return false;
+    struct stat st {};
+    bool ok = fstat(fileno(f), &st) == 0 &&
+              fscanf(f, "ngm1 %" SCNu64 " %" SCNu64 " %" SCNx64, &m.chunk_bytes, &m.file_bytes, &m.root) == 3 &&
+              m.chunk_bytes > 0 && m.chunk_bytes % (uint64_t) sysconf(_SC_PAGESIZE) == 0;
+    const uint64_t n_chunks = ok ? m.file_bytes / m.chunk_bytes + (m.file_bytes % m.chunk_bytes != 0) : 0;
+    ok = ok && n_chunks <= (uint64_t) st.st_size / kLeafLineBytes;
+    if (ok) {
+        m.leaves.resize(n_chunks);
+        for (uint64_t i = 0; ok && i < n_chunks; i++) {
+            ok = fscanf(f, "%" SCNx64, &m.leaves[i]) == 1;
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// Parallel chunk hashing
+// ---------------------------------------------------------------------------
+
+struct HashRun {
+    std::string error;
+    uint64_t file_bytes = 0;
+    uint64_t bytes_hashed = 0;
+    uint64_t chunks_hashed = 0;
+    int n_threads = 0;
+    double elapsed_ms = 0.0;
+};
+
+/**
+ * Hash chunks [first_chunk, leaves.size()) of the file in parallel into leaves.
+ * leaves must already be sized for the whole file.
+ */
+bool hash_chunks(const char* path, uint64_t chunk_bytes, uint64_t first_chunk,
+                 std::vector<uint64_t>& leaves, HashRun& run) {
+    const int64_t t_start = now_us();
+
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        run.error = std::string("cannot open: ") + strerror(errno);
+        return false;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        run.error = std::string("cannot stat: ") + strerror(errno);
+        close(fd);
+        return false;
+    }
+    run.file_bytes = (uint64_t) st.st_size;
+    const uint64_t n_chunks = (run.file_bytes + chunk_bytes - 1) / chunk_bytes;
+    leaves.resize(n_chunks);
+    if (first_chunk >= n_chunks) {
+        close(fd);
+        return true;
+    }
+
+    // Map only from the first chunk we need; mmap offsets must be page aligned,
+    // and chunk sizes are always a multiple of the page size
+    const uint64_t map_offset = first_chunk * chunk_bytes;
+    const size_t map_len = (size_t) (run.file_bytes - map_offset);
+    void* map = mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE, fd, (off_t) map_offset);
+    close(fd);
+    if (map == MAP_FAILED) {
+        run.error = std::string("mmap failed: ") + strerror(errno);
+        return false;
+    }
+    madvise(map, map_len, MADV_SEQUENTIAL);
+    const uint8_t* base = static_cast<const uint8_t*>(map);
+
+    std::atomic<uint64_t> next_chunk{first_chunk};
+    auto worker = [&]() {
+        for (uint64_t c = next_chunk++; c < n_chunks; c = next_chunk++) {
+            const uint64_t start = c * chunk_bytes;
+            const uint64_t len = std::min(chunk_bytes, run.file_bytes - start);
+            leaves[c] = xxh64(base + (start - map_offset), (size_t) len, 0);
+        }
+    };
+
+    const uint64_t n_work = n_chunks - first_chunk;
+    run.n_threads = (int) std::min<uint64_t>(std::max(1u, std::thread::hardware_concurrency()), n_work);
+    std::vector<std::thread> threads;
+    for (int i = 1; i < run.n_threads; i++) threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads) t.join();
+
+    munmap(map, map_len);
+    run.chunks_hashed = n_work;
+    run.bytes_hashed = map_len;
+    run.elapsed_ms = (now_us() - t_start) / 1000.0;
+    return true;
+}
+
+std::string build_report(const char* status, const HashRun& run, uint64_t root,
+                         const std::vector<uint64_t>& bad_chunks, uint64_t chunk_bytes) {
+    const double gbps = run.elapsed_ms > 0 ? run.bytes_hashed / (run.elapsed_ms * 1e6) : 0.0;
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "{\"status\":\"%s\",\"root\":\"%016" PRIx64 "\",\"file_bytes\":%" PRIu64
+             ",\"chunk_bytes\":%" PRIu64 ",\"chunks_hashed\":%" PRIu64 ",\"bytes_hashed\":%" PRIu64
+             ",\"threads\":%d,\"elapsed_ms\":%.2f,\"gbps\":%.3f,",
+             status, root, run.file_bytes, chunk_bytes, run.chunks_hashed, run.bytes_hashed,
+             run.n_threads, run.elapsed_ms, gbps);
+    std::string json = buf;
+    json += "\"error\":\"" + json_escape(run.error) + "\",\"bad_chunks\":[";
+    for (size_t i = 0; i < bad_chunks.size(); i++) {
+        json += (i > 0 ? "," : "") + std::to_string(bad_chunks[i]);
+    }
+    json += "]}";
+    return json;
+}
+
+} // namespace
+
+extern "C" {
+
+/**
+ * Hash the whole model and write its manifest (chunk size, file size, root, leaves)
+ * chunk_size_mb: leaf size, 0 = default (4 MB)
+ * Returns: JSON report ("status" is "ok" or "error"); valid until the next call on this thread
+ */
+const char* hash_model_create_manifest(const char* model_path, const char* manifest_path,
+                                       int32_t chunk_size_mb) {
+    static thread_local std::string report;
+
+    Manifest m;
+    if (chunk_size_mb > 0) m.chunk_bytes = (uint64_t) chunk_size_mb << 20;
+
+    HashRun run;
+    bool ok = hash_chunks(model_path, m.chunk_bytes, 0, m.leaves, run);
+    if (ok) {
+        m.file_bytes = run.file_bytes;
+        m.root = merkle_root(m.leaves);
+        ok = write_manifest(manifest_path, m);
+        if (!ok) run.error = "cannot write manifest";
+    }
+
+    report = build_report(ok ? "ok" : "error", run, m.root, {}, m.chunk_bytes);
+    LOGI("HASH: manifest for %s: %s", model_path, report.c_str());
+    return report.c_str();
+}
+
+/**
+ * Verify a model against its manifest
+ * from_offset: only chunks overlapping [from_offset, EOF) are re-hashed, e.g. the
+ * byte where a download resumed; 0 verifies the whole file and its Merkle root
+ * Returns: JSON report with "status" "ok", "mismatch" or "error" and the indices of
+ * mismatching chunks; valid until the next call on this thread
+ */
+const char* hash_model_verify(const char* model_path, const char* manifest_path, int64_t from_offset) {
+    static thread_local std::string report;
+
+    Manifest m;
+    HashRun run;
+    if (!read_manifest(manifest_path, m)) {
+        run.error = "cannot read manifest";
+        report = build_report("error", run, 0, {}, m.chunk_bytes);
+        return report.c_str();
+    }
+
+    const uint64_t first_chunk = from_offset > 0 ? (uint64_t) from_offset / m.chunk_bytes : 0;
+    std::vector<uint64_t> leaves = m.leaves; // Chunks before first_chunk keep their manifest value
+    if (!hash_chunks(model_path, m.chunk_bytes, first_chunk, leaves, run)) {
+        report = build_report("error", run, 0, {}, m.chunk_bytes);
+        return report.c_str();
+    }
+
+    std::vector<uint64_t> bad_chunks;
+    if (run.file_bytes != m.file_bytes) {
+        run.error = "file has " + std::to_string(run.file_bytes) + " bytes, manifest expects " +
+                    std::to_string(m.file_bytes);
+    } else {
+        for (uint64_t c = first_chunk; c < leaves.size(); c++) {
+            if (leaves[c] != m.leaves[c]) bad_chunks.push_back(c);
+        }
+    }
+
+    const uint64_t root = merkle_root(leaves);
+    const bool ok = run.error.empty() && bad_chunks.empty() && root == m.root;
+    report = build_report(ok ? "ok" : "mismatch", run, root, bad_chunks, m.chunk_bytes);
+    LOGI("HASH: verify %s from %lld: %s", model_path, (long long) from_offset, report.c_str());
+    return report.c_str();
+}
+
+/**
+ * Check the complete chunks of a partly downloaded model against its manifest,
+ * before a download resumes on top of them
+ * Returns: JSON report with "status" "ok" or "mismatch" and the indices of mismatching
+ * chunks; chunks from the first bad one on, and a partial last chunk, must be
+ * downloaded again. "error" if the file is longer than the manifest's. Valid until
+ * the next call on this thread.
+ */
+const char* hash_model_verify_prefix(const char* model_path, const char* manifest_path) {
+    static thread_local std::string report;
+
+    Manifest m;
+    HashRun run;
+    if (!read_manifest(manifest_path, m)) {
+        run.error = "cannot read manifest";
+        report = build_report("error", run, 0, {}, m.chunk_bytes);
+        return report.c_str();
+    }
+
+    std::vector<uint64_t> leaves;
+    if (!hash_chunks(model_path, m.chunk_bytes, 0, leaves, run)) {
+        report = build_report("error", run, 0, {}, m.chunk_bytes);
+        return report.c_str();
+    }
+    if (run.file_bytes > m.file_bytes) {
+        run.error = "file has " + std::to_string(run.file_bytes) + " bytes, manifest expects " +
+                    std::to_string(m.file_bytes);
+        report = build_report("error", run, 0, {}, m.chunk_bytes);
+        return report.c_str();
+    }
+
+    // A partial last chunk can't be compared; the download rewrites it
+    const uint64_t full_chunks = run.file_bytes == m.file_bytes ? leaves.size() : run.file_bytes / m.chunk_bytes;
+    std::vector<uint64_t> bad_chunks;
+    for (uint64_t c = 0; c < full_chunks; c++) {
+        if (leaves[c] != m.leaves[c]) bad_chunks.push_back(c);
+    }
+
+    report = build_report(bad_chunks.empty() ? "ok" : "mismatch", run, m.root, bad_chunks, m.chunk_bytes);
+    LOGI("HASH: verify prefix of %s: %s", model_path, report.c_str());
+    return report.c_str();
+}
+
+} // extern "C"
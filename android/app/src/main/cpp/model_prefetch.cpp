@@ -0,0 +1,322 @@
+// Speculative model prefetch.
+//
+// Reading a multi-GB GGUF from flash takes seconds, and without a prefetch it
+// all happens between "start" and the first token. As soon as a model is
+// selected, a background native thread reads it into the page cache in the
+// order the first pass touches it: the header, the token embeddings, the
+// layers from first to last, then the output tensors.
+// The kernel caps readahead(2) and fadvise(WILLNEED) at the device's readahead
+// window per call, so a hint alone leaves most of a large file on flash. Each
+// chunk is therefore read for real, while the next one is already requested
+// with readahead to keep the device queue full.
+// Dart polls the status (bytes read, bytes resident) and a new selection or
+// cancel stops it between chunks.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "gguf_reader.h"
+#include "native_common.h"
+
+namespace {
+
+constexpr uint64_t kChunkBytes = 2ull << 20;           // Per read; also the cancel granularity
+constexpr uint64_t kResidencyEveryBytes = 64ull << 20; // Resident bytes are re-counted this often
+
+struct PrefetchExtent {
+    uint64_t offset; // Absolute file offset
+    uint64_t length;
+};
+
+std::mutex g_pf_mutex;                      // Guards g_pf_state, g_pf_path, g_pf_order and g_pf_error
+std::atomic<bool> g_pf_cancel{false};
+std::atomic<uint64_t> g_pf_total{0};
+std::atomic<uint64_t> g_pf_read{0};
+std::atomic<uint64_t> g_pf_resident_before{0};
+std::atomic<uint64_t> g_pf_resident{0};
+std::atomic<int64_t> g_pf_start_us{0};
+std::atomic<int64_t> g_pf_end_us{0};
+std::string g_pf_state = "idle";            // "idle" | "running" | "done" | "cancelled" | "error"
+std::string g_pf_path;
+std::string g_pf_order;                     // "layers" | "sequential"
+std::string g_pf_error;
+
+/**
+ * The prefetch thread, cancelled and joined at exit: a prefetch may still be
+ * running when the process exits, and destroying a joinable std::thread aborts
+ */
+struct PrefetchThread {
+    std::thread thread;
+    ~PrefetchThread() {
+        g_pf_cancel = true;
+        if (thread.joinable()) thread.join();
+    }
+};
+PrefetchThread g_pf_thread; // Last, so it is destroyed before the state the worker writes
+
+/**
+ * Execution rank of a tensor: embeddings, then blk.0 ... blk.N, then the rest
+ * (output norm, output)
+ */
+uint64_t tensor_rank(const std::string& name) {
+    if (name.compare(0, 10, "token_embd") == 0) return 0;
+    if (name.compare(0, 4, "blk.") == 0) return 1 + strtoull(name.c_str() + 4, nullptr, 10);
+    return UINT64_MAX;
+}
+
+/**
+ * Extents of [base, base + size) of fd in first-pass order; the whole region
+ * front to back if it doesn't parse as a complete GGUF
+ */
+std::vector<PrefetchExtent> prefetch_plan(int fd, uint64_t base, uint64_t size, std::string& order) {
+    GgufInfo info;
+    std::string error;
+    if (gguf_read_info(fd, base, size, info, error) != GgufStatus::kComplete) {
+        LOGI("PREFETCH: No tensor layout (%s), reading front to back", error.c_str());
+        order = "sequential";
+        return {{base, size}};
+    }
+
+    std::vector<const GgufTensorInfo*> tensors;
+    tensors.reserve(info.tensors.size());
+    for (const GgufTensorInfo& t : info.tensors) tensors.push_back(&t);
+    std::stable_sort(tensors.begin(), tensors.end(), [](const GgufTensorInfo* a, const GgufTensorInfo* b) {
+        const uint64_t ra = tensor_rank(a->name), rb = tensor_rank(b->name);
+        return ra != rb ? ra < rb : a->offset < b->offset;
+    });
+
+    std::vector<PrefetchExtent> plan = {{base, info.data_offset}};
+    for (const GgufTensorInfo* t : tensors) {
+        const uint64_t offset = base + info.data_offset + t->offset;
+        // Tensors adjacent in both orders (e.g. the weights of one layer) become one extent
+        if (plan.back().offset + plan.back().length == offset) {
+            plan.back().length += t->nbytes;
+        } else {
+            plan.push_back({offset, t->nbytes});
+        }
+    }
+    order = "layers";
+    return plan;
+}
+
+/**
+ * Split the plan into reads of at most kChunkBytes
+ */
+std::vector<PrefetchExtent> plan_chunks(const std::vector<PrefetchExtent>& plan) {
+    std::vector<PrefetchExtent> chunks;
+    for (const PrefetchExtent& e : plan) {
+        for (uint64_t done = 0; done < e.length; done += kChunkBytes) {
+            chunks.push_back({e.offset + done, std::min(kChunkBytes, e.length - done)});
+        }
+    }
+    return chunks;
+}
+
+/**
+ * Read [offset, offset + length) of fd into scratch (contents discarded)
+ * Returns: false on a read error; a short file just ends the read
+ */
+bool read_chunk(int fd, const PrefetchExtent& chunk, std::vector<char>& scratch) {
+    uint64_t done = 0;
+    while (done < chunk.length) {
+        const ssize_t n = pread(fd, scratch.data(), (size_t) (chunk.length - done), (off_t) (chunk.offset + done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (n == 0) break;
+        done += (uint64_t) n;
+    }
+    return true;
+}
+
+/**
+ * Page-cache residency of a file region through a read-only mapping (nothing
+ * is faulted in; mincore only reports)
+ */
+class ResidencyCounter {
+public:
+    ResidencyCounter(int fd, uint64_t base, uint64_t size) {
+        const uint64_t page = (uint64_t) sysconf(_SC_PAGESIZE);
+        map_offset_ = base / page * page;
+        map_len_ = (size_t) (base + size - map_offset_);
+        page_ = page;
+        addr_ = mmap(nullptr, map_len_, PROT_READ, MAP_SHARED, fd, (off_t) map_offset_);
+        if (addr_ == MAP_FAILED) {
+            addr_ = nullptr;
+        } else {
+            pages_.resize((map_len_ + page - 1) / page);
+        }
+    }
+    ~ResidencyCounter() {
+        if (addr_) munmap(addr_, map_len_);
+    }
+    ResidencyCounter(const ResidencyCounter&) = delete;
+    ResidencyCounter& operator=(const ResidencyCounter&) = delete;
+
+    /**
+     * Returns: resident bytes, or 0 if residency can't be read
+     */
+    uint64_t count() {
+        if (!addr_ || mincore(addr_, map_len_, pages_.data()) != 0) return 0;
+        uint64_t resident = 0;
+        for (unsigned char p : pages_) resident += p & 1;
+        return std::min<uint64_t>(resident * page_, map_len_);
+    }
+
+private:
+    void* addr_ = nullptr;
+    uint64_t map_offset_ = 0;
+    size_t map_len_ = 0;
+    uint64_t page_ = 4096;
+    std::vector<unsigned char> pages_;
+};
+
+void finish(const char* state, const std::string& error = std::string()) {
+    g_pf_end_us = now_us();
+    std::lock_guard<std::mutex> lock(g_pf_mutex);
+    g_pf_state = state;
+    g_pf_error = error;
+}
+
+void prefetch_worker(int fd, uint64_t size) {
+    std::string order;
+    const std::vector<PrefetchExtent> plan = prefetch_plan(fd, 0, size, order);
+    {
+        std::lock_guard<std::mutex> lock(g_pf_mutex);
+        g_pf_order = order;
+    }
+    uint64_t total = 0;
+    for (const PrefetchExtent& e : plan) total += e.length;
+    g_pf_total = total;
+
+    ResidencyCounter residency(fd, 0, size);
+    g_pf_resident_before = residency.count();
+    g_pf_resident = g_pf_resident_before.load();
+
+    const std::vector<PrefetchExtent> chunks = plan_chunks(plan);
+    std::vector<char> scratch(kChunkBytes);
+    std::string error;
+    uint64_t since_count = 0;
+    for (size_t i = 0; i < chunks.size() && !g_pf_cancel; i++) {
+        if (i + 1 < chunks.size()) {
+            // Only a hint (a filesystem without readahead still takes the fadvise one)
+            const PrefetchExtent& next = chunks[i + 1];
+            if (readahead(fd, (off64_t) next.offset, (size_t) next.length) != 0) {
+                posix_fadvise(fd, (off_t) next.offset, (off_t) next.length, POSIX_FADV_WILLNEED);
+            }
+        }
+        if (!read_chunk(fd, chunks[i], scratch)) {
+            error = std::string("read: ") + strerror(errno);
+            break;
+        }
+        g_pf_read += chunks[i].length;
+        since_count += chunks[i].length;
+        if (since_count >= kResidencyEveryBytes) {
+            since_count = 0;
+            g_pf_resident = residency.count();
+        }
+    }
+    const uint64_t resident = residency.count();
+    g_pf_resident = resident;
+    close(fd);
+
+    LOGI("PREFETCH: %s %.1f MiB (%s order), %.1f -> %.1f MiB resident in %.0f ms%s%s",
+         g_pf_cancel ? "Cancelled after" : "Read", g_pf_read / 1048576.0, order.c_str(),
+         g_pf_resident_before / 1048576.0, resident / 1048576.0, (now_us() - g_pf_start_us) / 1000.0,
+         error.empty() ? "" : ", ", error.c_str());
+    finish(!error.empty() ? "error" : g_pf_cancel ? "cancelled" : "done", error);
+}
+
+} // namespace
+
+extern "C" {
+
+/**
+ * Start pulling model_path into the page cache on a background thread, in
+ * first-pass order; a prefetch already running (e.g. for the previously
+ * selected model) is cancelled first.
+ * Returns: 0 if started, -1 if the file can't be opened
+ */
+int32_t start_model_prefetch(const char* model_path) {
+    if (!model_path) return -1;
+    g_pf_cancel = true;
+    if (g_pf_thread.thread.joinable()) g_pf_thread.thread.join();
+    g_pf_cancel = false;
+    g_pf_total = 0;
+    g_pf_read = 0;
+    g_pf_resident_before = 0;
+    g_pf_resident = 0;
+    g_pf_start_us = now_us();
+    g_pf_end_us = 0;
+
+    const int fd = open(model_path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size <= 0) {
+        const std::string error = std::string("open: ") + strerror(fd < 0 ? errno : EINVAL);
+        if (fd >= 0) close(fd);
+        LOGE("PREFETCH: %s: %s", model_path, error.c_str());
+        g_pf_end_us = g_pf_start_us.load();
+        std::lock_guard<std::mutex> lock(g_pf_mutex);
+        g_pf_state = "error";
+        g_pf_path = model_path;
+        g_pf_order.clear();
+        g_pf_error = error;
+        return -1;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(g_pf_mutex);
+        g_pf_state = "running";
+        g_pf_path = model_path;
+        g_pf_order.clear();
+        g_pf_error.clear();
+    }
+    g_pf_thread.thread = std::thread(prefetch_worker, fd, (uint64_t) st.st_size);
+    return 0;
+}
+
+/**
+ * Returns: JSON {"state","path","order","total_bytes","read_bytes",
+ * "resident_before_bytes","resident_bytes","progress","elapsed_ms","error"};
+ * state is "idle", "running", "done", "cancelled" or "error", progress is
+ * read / total. Resident bytes count the whole file (page cache, via mincore).
+ * Valid until the next call.
+ */
+const char* get_model_prefetch_status() {
+    static std::string json;
+    const uint64_t total = g_pf_total;
+    const uint64_t read = g_pf_read;
+    const int64_t start = g_pf_start_us, end = g_pf_end_us;
+    const double elapsed_ms = start > 0 ? ((end > 0 ? end : now_us()) - start) / 1000.0 : 0.0;
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             ",\"total_bytes\":%llu,\"read_bytes\":%llu,\"resident_before_bytes\":%llu,"
+             "\"resident_bytes\":%llu,\"progress\":%.4f,\"elapsed_ms\":%.1f",
+             (unsigned long long) total, (unsigned long long) read,
+             (unsigned long long) g_pf_resident_before.load(), (unsigned long long) g_pf_resident.load(),
+             total > 0 ? (double) read / total : 0.0, elapsed_ms);
+    std::lock_guard<std::mutex> lock(g_pf_mutex);
+    json = "{\"state\":\"" + g_pf_state + "\",\"path\":\"" + json_escape(g_pf_path) + "\",\"order\":\"" +
+           g_pf_order + "\"" + buf + ",\"error\":\"" + json_escape(g_pf_error) + "\"}";
+    return json.c_str();
+}
+
+/**
+ * Cancel the running prefetch; takes effect after the current chunk
+ */
+void cancel_model_prefetch() {
+    g_pf_cancel = true;
+}
+
+} // extern "C"
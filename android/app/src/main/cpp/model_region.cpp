@@ -0,0 +1,153 @@
+#include "model_region.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+#include "gguf_reader.h"
+#include "native_common.h"
+
+namespace {
+
+/**
+ * copy_file_range via syscall: older Android libc versions don't export the wrapper
+ */
+ssize_t copy_range(int fd_in, off_t* off_in, int fd_out, size_t len) {
+#ifdef SYS_copy_file_range
+    return syscall(SYS_copy_file_range, fd_in, off_in, fd_out, nullptr, len, 0u);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/**
+ * Copy [offset, offset + length) of fd_in to the start of fd_out.
+ * Falls back to pread/write when the kernel or filesystem can't copy in place.
+ */
+bool copy_region(int fd_in, uint64_t offset, uint64_t length, int fd_out, std::string& error) {
+    off_t off_in = (off_t) offset;
+    uint64_t left = length;
+    bool in_kernel = true;
+    std::vector<uint8_t> buf;
+
+    while (left > 0) {
+        const size_t chunk = (size_t) std::min<uint64_t>(left, 64ull << 20);
+        ssize_t n;
+        if (in_kernel) {
+            n = copy_range(fd_in, &off_in, fd_out, chunk);
+            if (n < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)) {
+                in_kernel = false;
+                continue;
+            }
+        } else {
+            if (buf.empty()) buf.resize(4 << 20);
+            n = pread(fd_in, buf.data(), std::min(chunk, buf.size()), off_in);
+            if (n > 0) {
+                for (ssize_t done = 0; done < n;) {
+                    const ssize_t w = write(fd_out, buf.data() + done, (size_t) (n - done));
+                    if (w < 0 && errno == EINTR) continue;
+                    if (w <= 0) {
+                        error = std::string("write failed: ") + strerror(errno);
+                        return false;
+                    }
+                    done += w;
+                }
+                off_in += n;
+            }
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            error = n == 0 ? "container ended before the region" : std::string("copy failed: ") + strerror(errno);
+            return false;
+        }
+        left -= (uint64_t) n;
+    }
+    return true;
+}
+
+/**
+ * A cached copy is reusable if it is a complete GGUF of the same length whose
+ * header bytes match the region's
+ */
+bool cached_copy_matches(int fd, uint64_t offset, uint64_t length, const char* cache_path) {
+    GgufInfo info;
+    std::string error;
+    if (gguf_read_info(cache_path, info, error) != GgufStatus::kComplete) return false;
+
+    const int cache_fd = open(cache_path, O_RDONLY | O_CLOEXEC);
+    if (cache_fd < 0) return false;
+    struct stat st {};
+    bool same = fstat(cache_fd, &st) == 0 && (uint64_t) st.st_size == length;
+    if (same) {
+        const size_t n = (size_t) std::min<uint64_t>(info.data_offset, 1 << 20);
+        std::vector<uint8_t> a(n), b(n);
+        same = pread(fd, a.data(), n, (off_t) offset) == (ssize_t) n &&
+               pread(cache_fd, b.data(), n, 0) == (ssize_t) n &&
+               memcmp(a.data(), b.data(), n) == 0;
+    }
+    close(cache_fd);
+    return same;
+}
+
+} // namespace
+
+bool resolve_model_region(int fd, uint64_t offset, uint64_t length, const char* cache_path,
+                          ModelRegionResult& result) {
+    const int64_t t_start = now_us();
+    result = ModelRegionResult();
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        result.error = std::string("bad fd: ") + strerror(errno);
+        return false;
+    }
+    if (offset > (uint64_t) st.st_size || length > (uint64_t) st.st_size - offset) {
+        result.error = "region exceeds container size";
+        return false;
+    }
+
+    GgufInfo info;
+    const GgufStatus status = gguf_read_info(fd, offset, length, info, result.error);
+    if (status != GgufStatus::kComplete) {
+        result.error = "region is not a complete GGUF: " + result.error;
+        return false;
+    }
+
+    if (offset == 0 && length == (uint64_t) st.st_size) {
+        result.path = "/proc/self/fd/" + std::to_string(fd);
+        result.mode = "direct";
+    } else if (!cache_path || !*cache_path) {
+        result.error = "region at a non-zero offset needs a cache path";
+        return false;
+    } else {
+        result.path = cache_path;
+        result.mode = "materialized";
+        if (!cached_copy_matches(fd, offset, length, cache_path)) {
+            const std::string tmp_path = std::string(cache_path) + ".tmp";
+            const int out_fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (out_fd < 0) {
+                result.error = std::string("cannot create cache: ") + strerror(errno);
+                return false;
+            }
+            bool ok = copy_region(fd, offset, length, out_fd, result.error);
+            ok = close(out_fd) == 0 && ok;
+            if (!ok || rename(tmp_path.c_str(), cache_path) != 0) {
+                remove(tmp_path.c_str());
+                if (result.error.empty()) result.error = "cannot finalize cache copy";
+                return false;
+            }
+            result.bytes_copied = length;
+        }
+    }
+
+    result.elapsed_ms = (now_us() - t_start) / 1000.0;
+    LOGI("REGION: fd=%d offset=%llu length=%llu -> %s (%s, %.1f ms)", fd,
+         (unsigned long long) offset, (unsigned long long) length,
+         result.path.c_str(), result.mode.c_str(), result.elapsed_ms);
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Model regions: a GGUF stored at (fd, offset, length) inside an uncompressed
+// container such as an APK asset or a plain archive.
+
+#include <cstdint>
+#include <string>
+
+struct ModelRegionResult {
+    std::string path;   // Path llama.cpp should open
+    std::string mode;   // "direct" (no copy) or "materialized" (one-time in-kernel copy)
+    std::string error;
+    uint64_t bytes_copied = 0;
+    double elapsed_ms = 0.0;
+};
+
+/**
+ * Validate the GGUF inside [offset, offset + length) of fd and resolve a path
+ * llama.cpp can load from.
+ *
+ * llama.cpp only opens models by path and expects the GGUF at byte 0, so:
+ *  - a region covering the whole file is opened as /proc/self/fd/<fd> and
+ *    memory-mapped in place, with no copy;
+ *  - a region at a non-zero offset is copied once to cache_path with
+ *    copy_file_range (reflinked on filesystems that support it, never through
+ *    a userspace buffer), and reused on later launches.
+ * The fd must stay open for as long as a "direct" model is loaded.
+ * Returns: false with result.error set if the region is not a complete GGUF.
+ */
+bool resolve_model_region(int fd, uint64_t offset, uint64_t length, const char* cache_path,
+                          ModelRegionResult& result);
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#define LOG_TAG "NeuralGauge"
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#else
+// Host builds (Linux tools and tests) log to stderr instead of logcat
+#define LOGI(...) do { fprintf(stderr, "I/" LOG_TAG ": " __VA_ARGS__); fputc('\n', stderr); } while (0)
+#define LOGE(...) do { fprintf(stderr, "E/" LOG_TAG ": " __VA_ARGS__); fputc('\n', stderr); } while (0)
+#endif
+
+/**
+ * Monotonic timestamp in microseconds
+ */
+inline int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+/**
+ * Read a "Vm*" field (e.g. "VmRSS", "VmHWM") from /proc/self/status in MB
+ * Returns: 0.0 if the field is not available
+ */
+inline double read_proc_status_mb(const char* key) {
+    FILE* f = fopen("/proc/self/status", "r");
+    if (!f) return 0.0;
+
+    char line[256];
+    const size_t key_len = strlen(key);
+    double value_mb = 0.0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, key, key_len) == 0 && line[key_len] == ':') {
+            value_mb = strtoull(line + key_len + 1, nullptr, 10) / 1024.0;
+            break;
+        }
+    }
+    fclose(f);
+    return value_mb;
+}
+
+/**
+ * Reset the process peak RSS (VmHWM) so the next phase can be measured on its own
+ * Returns: false if the kernel does not allow it, in which case VmHWM keeps its old peak
+ */
+inline bool reset_peak_rss() {
+    FILE* f = fopen("/proc/self/clear_refs", "w");
+    if (!f) return false;
+    const bool ok = fputs("5", f) >= 0;
+    return fclose(f) == 0 && ok;
+}
+
+/**
+ * Escape a string for embedding in the JSON reports returned to Dart
+ */
+inline std::string json_escape(const std::string& in) {
+    std::string out;
+    out.reserve(in.size() + 2);
+    for (const char c : in) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n";  break;
+            case '\r': out += "\\r";  break;
+            case '\t': out += "\\t";  break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
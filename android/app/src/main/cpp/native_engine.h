@@ -0,0 +1,48 @@
+#pragma once
+
+// FFI engine entry points implemented in native_lib.cpp, shared with the other
+// native modules that drive the engine (e.g. the engine worker).
+
+#include <cstdint>
+
+#include "engine_config.h"
+
+extern "C" {
+
+typedef void (*TokenCallback)(const char* token, int64_t time_ms);
+
+int32_t load_model(const char* model_path);
+int32_t load_model_with_config(const char* model_path, const EngineConfig* config);
+int32_t load_model_region(int32_t fd, int64_t offset, int64_t length, const char* cache_path,
+                          const EngineConfig* config);
+int32_t run_inference(const char* prompt, int32_t max_tokens);
+const char* run_benchmark_repetitions(const char* prompt, int32_t n_tokens,
+                                      int32_t n_warmup, int32_t n_reps);
+const char* run_cpu_variant_comparison(const char* model_path, const char* prompt, int32_t n_tokens,
+                                       int32_t n_warmup, int32_t n_reps);
+const char* run_huge_page_comparison(const char* model_path, const char* prompt, int32_t n_tokens,
+                                     int32_t n_warmup, int32_t n_reps);
+const char* run_flash_attention_comparison(const char* model_path, int32_t n_gen, int32_t max_depth,
+                                           int32_t n_reps);
+const char* run_kv_depth_sweep(const char* model_path, int32_t n_gen, int32_t max_depth, int32_t n_reps);
+const char* run_context_contention(int32_t max_contexts, int32_t n_tokens, int32_t overlap);
+const char* run_bandwidth_probe(int32_t n_threads);
+const char* run_session_restore_benchmark(const char* prompt, int32_t n_reps);
+const char* run_threadpool_poll_sweep(const char* prompt, int32_t n_tokens, int32_t n_reps);
+const char* run_perplexity(const char* text, int32_t n_ctx, int32_t n_seq, int32_t max_chunks);
+const char* run_embeddings(const char* const* texts, int32_t n_texts, int32_t pooling, int32_t batch_size,
+                           float* out, int64_t out_capacity);
+const char* run_embedding_benchmark(const char* const* texts, int32_t n_texts, int32_t pooling, int32_t max_batch);
+void dispose_model();
+void session_snapshot_flush();
+void set_token_callback(TokenCallback callback);
+void stop_inference();
+uint64_t engine_stop_generation();
+void engine_begin_queued_command(uint64_t generation);
+void engine_end_queued_command();
+void engine_lock();
+void engine_unlock();
+void pause_inference();
+void resume_inference();
+
+} // extern "C"
@@ -1,89 +1,390 @@
 #include <jni.h>
-#include <android/log.h>
 #include <string>
 #include <vector>
 #include <memory>
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <cerrno>
+#include <cmath>
+#include <thread>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // llama.cpp includes
 #include <atomic>
 #include "llama.h"
-
-#define LOG_TAG "NeuralGauge"
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#include "bandwidth_probe.h"
+#include "bench_stats.h"
+#include "cpu_variants.h"
+#include "engine_config.h"
+#include "engine_threadpool.h"
+#include "gguf_reader.h"
+#include "huge_pages.h"
+#include "memory_planner.h"
+#include "model_region.h"
+#include "native_engine.h"
+#include "perf_counters.h"
+#include "power_telemetry.h"
+#include "session_cache.h"
+#include "native_common.h"
 
 // Global state
 static llama_model* g_model = nullptr;
 static llama_context* g_ctx = nullptr;
 static bool g_is_loaded = false;
 static std::string g_generated_text; // Store generated text
-static std::atomic<bool> g_stop_inference{false};
+static int g_model_fd = -1; // Container fd backing a "direct" region model, owned by us
+
+// Engine lifecycle: the mutex is held for the whole of every load, run and dispose,
+// so "lock acquired" means the engine is idle and nothing is using g_model/g_ctx
+static std::timed_mutex g_engine_mutex;
+static std::atomic<bool> g_shutdown_requested{false};
+static std::atomic<int64_t> g_stop_requested_us{0};
+static std::atomic<int64_t> g_last_cancel_latency_us{-1};
+
+// Stop requests: stop_inference() advances the stop generation, and the running
+// command is stopped once it differs from the generation the command started
+// under. Nothing clears a stop, so one that lands just before a command starts
+// isn't lost to a reset. Commands from the engine worker start under the
+// generation of their submit (engine_begin_queued_command), so a cancel between
+// submit and start stops them too.
+static std::atomic<uint64_t> g_stop_generation{0};
+static std::atomic<uint64_t> g_command_generation{0};
+static thread_local bool t_queued_command = false;
+static thread_local uint64_t t_queued_generation = 0;
+static thread_local int t_command_depth = 0;
+
+/**
+ * Whether the running command was asked to stop
+ */
+static bool stop_requested() {
+    return g_stop_generation.load(std::memory_order_relaxed) != g_command_generation.load(std::memory_order_relaxed);
+}
+
+/**
+ * Starts a command: the outermost scope on a thread sets the generation stops are
+ * counted from, so entry points that call each other share one. Declare it after
+ * the engine lock in entry points that hold the lock throughout.
+ */
+struct CommandScope {
+    CommandScope() {
+        if (t_command_depth++ == 0) {
+            g_command_generation = t_queued_command ? t_queued_generation : g_stop_generation.load();
+        }
+    }
+    ~CommandScope() { t_command_depth--; }
+};
+
+/**
+ * ggml abort callback: checked between graph nodes, so a stop request interrupts
+ * a long prefill mid-graph instead of waiting for the next token
+ */
+static bool engine_abort_callback(void* /* data */) {
+    return stop_requested();
+}
+
+/**
+ * Records how long the engine took to go idle after a stop request.
+ * Declared after the engine lock so it runs just before the lock is released.
+ */
+struct CancelLatencyRecorder {
+    ~CancelLatencyRecorder() {
+        if (stop_requested()) {
+            g_last_cancel_latency_us = now_us() - g_stop_requested_us.load();
+        }
+    }
+};
+
+// Compute threads of g_ctx (engine_threadpool.h), guarded by g_engine_mutex
+static EngineThreadpool g_threadpool;
+
+/**
+ * Wakes the threadpool for a run on g_ctx and pauses it again when the run
+ * returns, so its workers don't spin between runs. A detached run leaves the
+ * pool paused and lets the backend start its threads per graph instead.
+ * Declare after the engine lock.
+ */
+struct ThreadpoolRun {
+    explicit ThreadpoolRun(bool detach = false) : detached(detach) {
+        if (detached) {
+            llama_detach_threadpool(g_ctx);
+        } else {
+            g_threadpool.resume();
+        }
+    }
+    ~ThreadpoolRun() {
+        if (detached) {
+            g_threadpool.attach(g_ctx);
+        } else {
+            g_threadpool.pause();
+        }
+    }
+
+    const bool detached;
+};
 
-// Token callback function pointer (set from Dart)
-typedef void (*TokenCallback)(const char* token, int64_t time_ms);
+// Config last requested, which the CPU variant comparison reloads with, the
+// effective config of the loaded model (both guarded by g_engine_mutex), and the
+// latter as JSON
+static EngineConfig g_requested_config = engine_config_defaults();
+static EngineConfig g_loaded_config = engine_config_defaults();
+static EngineContextReport g_context_report; // Buffer sizes of g_ctx, guarded by g_engine_mutex
+static std::mutex g_config_json_mutex; // Guards g_engine_config_json
+static std::string g_engine_config_json;
+
+// KV snapshots of prefilled prompts (session_cache.h); an empty directory disables them
+static SessionKey g_session_key;        // Model and context part of the key, guarded by g_engine_mutex
+static bool g_session_key_valid = false;
+// Only the first pass after a load restores; later passes prefill as any other
+static bool g_session_restore_armed = false;
+// Snapshot the last pass left to save, written by session_snapshot_flush() when
+// the worker is idle (guarded by g_engine_mutex)
+struct PendingSessionSave {
+    std::string path;
+    SessionKey key;
+    std::vector<llama_token> tokens;
+    double prefill_ms = 0.0;
+    SessionSnapshotResult restore;
+};
+static PendingSessionSave g_session_pending;
+static std::mutex g_session_mutex;      // Guards g_session_dir and g_session_report
+static std::string g_session_dir;
+static std::string g_session_report;
+
+// Embeddings context on the loaded model, created on first use with the requested
+// pooling (guarded by g_engine_mutex); g_embedding_dim is readable without the lock
+static llama_context* g_embd_ctx = nullptr;
+static int32_t g_embd_pooling = LLAMA_POOLING_TYPE_UNSPECIFIED;
+static std::atomic<int32_t> g_embedding_dim{0};
+
+// Huge page advice for the mappings of the loaded model and context (huge_pages.h),
+// empty unless its config asked for huge pages
+static std::mutex g_huge_page_mutex; // Guards g_huge_page_advice
+static HugePageAdvice g_huge_page_advice;
+// Eval callback data of a huge-page context: outlives it, guarded by g_engine_mutex
+static GgmlBufferRanges g_ggml_buffers;
+
+// KV and compute buffers of the loaded context, which a load frees before it allocates
+// its own, and the predicted vs measured footprint of the last load (memory_planner.h)
+static std::atomic<int64_t> g_loaded_buffer_bytes{0};
+static std::mutex g_memory_mutex; // Guards g_memory_calibration
+static std::string g_memory_calibration;
+
+// Memory traffic of one decode step of the loaded model, for the roofline bound
+static std::atomic<int64_t> g_decode_weight_bytes{0};
+static std::atomic<int64_t> g_kv_bytes_per_position{0};
+
+// Optional hardware counters sampled around each llama_decode of run_inference
+static std::atomic<bool> g_perf_enabled{false};
+static std::mutex g_perf_report_mutex; // Guards g_perf_report
+static std::string g_perf_report;
+
+// Battery energy of the measured repetitions (power_telemetry.h), off by default
+static std::mutex g_power_mutex; // Guards the two below
+static bool g_power_enabled = false;
+static std::string g_power_root;
+static constexpr int kPowerIntervalMs = 100;
+static constexpr int kPowerBaselineMs = 3000;
+
+// Pause gate for the generation loop; a stop request always releases it
+static std::mutex g_pause_mutex;
+static std::condition_variable g_pause_cv;
+static bool g_paused = false;
+
+/**
+ * Block between tokens while the engine is paused
+ */
+static void wait_while_paused() {
+    std::unique_lock<std::mutex> lock(g_pause_mutex);
+    g_pause_cv.wait(lock, [] { return !g_paused || stop_requested(); });
+}
+
+// Token callback function pointer (set from Dart); TokenCallback is in native_engine.h
 static TokenCallback g_token_callback = nullptr;
 
-extern "C" {
+/**
+ * Close the container fd of a region-loaded model, if any
+ */
+static void release_model_fd() {
+    if (g_model_fd >= 0) {
+        close(g_model_fd);
+        g_model_fd = -1;
+    }
+}
 
 /**
- * Load a GGUF model from the given file path
+ * Free the embeddings context, if any; the caller holds the engine lock
+ */
+static void free_embedding_context() {
+    if (g_embd_ctx) {
+        llama_free(g_embd_ctx);
+        g_embd_ctx = nullptr;
+    }
+}
+
+/**
+ * Load path shared by JNI and FFI: replaces any loaded model with the one at
+ * model_path, created with requested clamped to the model and device
  * Returns: 0 on success, -1 on failure
  */
-JNIEXPORT jint JNICALL
-Java_com_neuralgauge_neural_1gauge_NativeLib_loadModel(
-    JNIEnv* env,
-    jobject /* this */,
-    jstring model_path
-) {
-    const char* path = env->GetStringUTFChars(model_path, nullptr);
-    LOGI("Loading model from: %s", path);
+static int32_t load_model_internal(const char* model_path, const EngineConfig& requested) {
+    std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+    g_shutdown_requested = false;
 
     // Clean up previous model if exists
     if (g_is_loaded) {
+        free_embedding_context();
         if (g_ctx) llama_free(g_ctx);
+        g_threadpool.release();
         if (g_model) llama_model_free(g_model);
+        g_ctx = nullptr;
+        g_model = nullptr;
         g_is_loaded = false;
     }
-
+    release_model_fd();
+    g_session_key_valid = false;
+    g_session_pending = PendingSessionSave();
+    g_loaded_buffer_bytes = 0;
+    {
+        std::lock_guard<std::mutex> huge_lock(g_huge_page_mutex);
+        g_huge_page_advice = HugePageAdvice();
+    }
+    const double rss_before = read_proc_status_mb("VmRSS");
+    const uint64_t available_before = read_mem_available();
+    
     // Initialize llama backend
     llama_backend_init();
-
-    // Model parameters
-    llama_model_params model_params = llama_model_default_params();
-    model_params.n_gpu_layers = 0; // CPU only for now
+    cpu_backend_ensure_loaded();
+    
+    g_requested_config = requested;
+    EngineConfig cfg = requested;
 
     // Load model
-    g_model = llama_model_load_from_file(path, model_params);
-    env->ReleaseStringUTFChars(model_path, path);
-
+    g_model = llama_model_load_from_file(model_path, engine_config_model_params(cfg));
     if (!g_model) {
-        LOGE("Failed to load model");
+        LOGE("FFI: Failed to load model");
         return -1;
     }
-
-    // Context parameters
-    llama_context_params ctx_params = llama_context_default_params();
-    ctx_params.n_ctx = 2048;  // Context size, reasonable default
-    // ctx_params.n_batch = 512; // default is 2048 in new API usually, let's leave default or set explicit
-    ctx_params.n_threads = 4; // Adjust based on device
-
+    
     // Create context
+    llama_context_params ctx_params = engine_config_context_params(cfg, g_model);
+    g_ggml_buffers = GgmlBufferRanges();
+    if (cfg.huge_pages) {
+        ctx_params.cb_eval = collect_ggml_buffers;
+        ctx_params.cb_eval_user_data = &g_ggml_buffers;
+    }
+    engine_context_report_begin();
     g_ctx = llama_init_from_model(g_model, ctx_params);
+    g_context_report = engine_context_report_end();
     if (!g_ctx) {
-        LOGE("Failed to create context");
+        LOGE("FFI: Failed to create context");
         llama_model_free(g_model);
         g_model = nullptr;
         return -1;
     }
+    llama_set_abort_callback(g_ctx, engine_abort_callback, nullptr);
+    if (cfg.huge_pages) {
+        // One decode shows which host buffers the graph uses: weights, KV cache, compute
+        llama_token probe = llama_vocab_bos(llama_model_get_vocab(g_model));
+        if (probe < 0) probe = 0;
+        g_ggml_buffers.collecting = true;
+        if (llama_decode(g_ctx, llama_batch_get_one(&probe, 1)) != 0) {
+            LOGE("FFI: Buffer probe decode failed, huge pages only for the model file");
+        }
+        g_ggml_buffers.collecting = false;
+        llama_memory_clear(llama_get_memory(g_ctx), true);
+    }
+    std::string threadpool_error;
+    if (g_threadpool.create(cfg, threadpool_error)) {
+        g_threadpool.attach(g_ctx);
+    } else {
+        // The backend then starts its threads per graph, as without a pool
+        LOGE("FFI: %s, compute threads are not persistent", threadpool_error.c_str());
+    }
+    if (cfg.huge_pages) {
+        HugePageAdvice advice = advise_huge_pages(g_ggml_buffers, model_path);
+        std::lock_guard<std::mutex> huge_lock(g_huge_page_mutex);
+        g_huge_page_advice = std::move(advice);
+    }
+    engine_config_read_back(cfg, g_ctx);
+    if (cfg.flash_attn == LLAMA_FLASH_ATTN_TYPE_AUTO && g_context_report.flash_attn >= 0) {
+        cfg.flash_attn = g_context_report.flash_attn;
+    }
+    g_loaded_config = cfg;
+    {
+        std::lock_guard<std::mutex> config_lock(g_config_json_mutex);
+        g_engine_config_json = engine_config_json(cfg);
+    }
+    g_session_key_valid = session_key_init(model_path, cfg, g_session_key);
+    g_session_restore_armed = g_session_key_valid;
+    g_loaded_buffer_bytes = (int64_t) ((g_context_report.kv_buffer_mib + g_context_report.compute_buffer_mib) * 1048576.0);
+
+    // How far the planner's prediction for the effective config was off
+    GgufInfo gguf;
+    std::string gguf_error;
+    if (gguf_read_info(model_path, gguf, gguf_error) == GgufStatus::kComplete) {
+        MemoryCalibration calibration;
+        calibration.predicted = estimate_memory(gguf, cfg);
+        calibration.weights_mib = llama_model_size(g_model) / 1048576.0;
+        calibration.kv_mib = g_context_report.kv_buffer_mib;
+        calibration.compute_mib = g_context_report.compute_buffer_mib;
+        calibration.rss_delta_mib = read_proc_status_mb("VmRSS") - rss_before;
+        const uint64_t available_after = read_mem_available();
+        calibration.available_drop_mib =
+            available_before > 0 && available_after > 0 ? ((double) available_before - available_after) / 1048576.0 : 0.0;
+        const std::string json = memory_calibration_json(calibration);
+        LOGI("MEMORY: Calibration %s", json.c_str());
+        std::lock_guard<std::mutex> memory_lock(g_memory_mutex);
+        g_memory_calibration = json;
+    }
 
+    // K and V rows of every layer are read once per cached position
+    const int32_t n_head = llama_model_n_head(g_model);
+    const int64_t n_embd_kv = n_head > 0
+        ? (int64_t) llama_model_n_embd(g_model) / n_head * llama_model_n_head_kv(g_model)
+        : 0;
+    g_decode_weight_bytes = (int64_t) llama_model_size(g_model);
+    g_embedding_dim = llama_model_n_embd(g_model);
+    g_kv_bytes_per_position = (int64_t) llama_model_n_layer(g_model) * n_embd_kv *
+                              (ggml_type_size(ctx_params.type_k) + ggml_type_size(ctx_params.type_v));
+    
     g_is_loaded = true;
-    LOGI("Model loaded successfully");
+    LOGI("FFI: Model loaded successfully: %s (compute %.1f MiB, KV %.1f MiB)",
+         engine_config_json(cfg).c_str(), g_context_report.compute_buffer_mib, g_context_report.kv_buffer_mib);
     return 0;
 }
 
+extern "C" {
+
+/**
+ * Load a GGUF model from the given file path
+ * Returns: 0 on success, -1 on failure
+ */
+JNIEXPORT jint JNICALL
+Java_com_neuralgauge_neural_1gauge_NativeLib_loadModel(
+    JNIEnv* env,
+    jobject /* this */,
+    jstring model_path
+) {
+    const char* path = env->GetStringUTFChars(model_path, nullptr);
+    const std::string path_copy = path;
+    env->ReleaseStringUTFChars(model_path, path);
+    LOGI("Loading model from: %s", path_copy.c_str());
+
+    // Same engine as the FFI path; the JNI API has always used a 2048 context
+    EngineConfig cfg = engine_config_defaults();
+    cfg.n_ctx = 2048;
+    cfg.n_batch = 2048;
+    cfg.n_ubatch = 512;
+    return load_model_internal(path_copy.c_str(), cfg);
+}
+
 /**
  * Set the token callback function
  */
@@ -107,7 +408,11 @@ Java_com_neuralgauge_neural_1gauge_NativeLib_runInference(
     jstring prompt_str,
     jint max_tokens
 ) {
-    g_stop_inference = false;
+    std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+    if (g_shutdown_requested) return -1;
+    CommandScope command;
+    CancelLatencyRecorder cancel_latency;
+    ThreadpoolRun threadpool_run;
     if (!g_is_loaded || !g_ctx) {
         LOGE("Model not loaded");
         return -1;
@@ -151,7 +456,14 @@ Java_com_neuralgauge_neural_1gauge_NativeLib_runInference(
     // Evaluate prompt
     // llama_batch_get_one ( tokens, n_tokens ) -> helper
     // It sets pos to 0, 1, 2... automatically for this batch
-    if (llama_decode(g_ctx, llama_batch_get_one(tokens.data(), n_tokens))) {
+    // rc 2 is the abort callback: a stop during prompt eval, not an error
+    const int32_t prompt_rc = llama_decode(g_ctx, llama_batch_get_one(tokens.data(), n_tokens));
+    if (prompt_rc == 2) {
+        LOGI("Prompt evaluation aborted");
+        llama_sampler_free(smpl);
+        return 0;
+    }
+    if (prompt_rc != 0) {
         LOGE("Failed to evaluate prompt");
         llama_sampler_free(smpl);
         return -1;
@@ -160,7 +472,7 @@ Java_com_neuralgauge_neural_1gauge_NativeLib_runInference(
     // Generate tokens
     int n_generated = 0;
     for (int i = 0; i < max_tokens; i++) {
-        if (g_stop_inference) break;
+        if (stop_requested()) break;
         auto start_time = std::chrono::high_resolution_clock::now();
 
         // Sample next token
@@ -199,7 +511,12 @@ Java_com_neuralgauge_neural_1gauge_NativeLib_runInference(
         llama_batch batch = llama_batch_get_one(&new_token, 1);
         // Note: Position is tracked automatically since batch.pos is NULL
 
-        if (llama_decode(g_ctx, batch)) {
+        const int32_t rc = llama_decode(g_ctx, batch);
+        if (rc == 2) {
+            LOGI("Decode aborted at step %d", i);
+            break;
+        }
+        if (rc != 0) {
             LOGE("Failed to evaluate token");
             break;
         }
@@ -240,21 +557,7 @@ Java_com_neuralgauge_neural_1gauge_NativeLib_disposeModel(
     JNIEnv* env,
     jobject /* this */
 ) {
-    LOGI("Disposing model");
-    
-    if (g_ctx) {
-        llama_free(g_ctx);
-        g_ctx = nullptr;
-    }
-    
-    if (g_model) {
-        llama_model_free(g_model);
-        g_model = nullptr;
-    }
-    
-    llama_backend_free();
-    g_is_loaded = false;
-    g_token_callback = nullptr;
+    dispose_model();
 }
 
 // ============================================================================
@@ -262,51 +565,184 @@ Java_com_neuralgauge_neural_1gauge_NativeLib_disposeModel(
 // ============================================================================
 
 /**
- * Load model - FFI version for Dart
+ * Load model with the default engine config - FFI version for Dart
  * Returns: 0 on success, -1 on failure
  */
 int32_t load_model(const char* model_path) {
+    return load_model_with_config(model_path, nullptr);
+}
+
+/**
+ * Load model with the given engine config (nullptr = defaults) - FFI version for Dart.
+ * The config is clamped to the model and device; see get_engine_config().
+ * Returns: 0 on success, -1 on failure or an unsupported config version
+ */
+int32_t load_model_with_config(const char* model_path, const EngineConfig* config) {
     LOGI("FFI: Loading model from: %s", model_path);
-    
-    // Clean up previous model if exists
-    if (g_is_loaded) {
-        if (g_ctx) llama_free(g_ctx);
-        if (g_model) llama_model_free(g_model);
-        g_is_loaded = false;
+    EngineConfig cfg;
+    std::string error;
+    if (!engine_config_import(config, cfg, error)) {
+        LOGE("FFI: %s", error.c_str());
+        return -1;
     }
-    
-    // Initialize llama backend
-    llama_backend_init();
-    
-    // Model parameters
-    llama_model_params model_params = llama_model_default_params();
-    model_params.n_gpu_layers = 0; // CPU only for now
-    
-    // Load model
-    g_model = llama_model_load_from_file(model_path, model_params);
-    if (!g_model) {
-        LOGE("FFI: Failed to load model");
+    return load_model_internal(model_path, cfg);
+}
+
+/**
+ * Plan of loading the model gguf_read_info returned status and info for, with config, as JSON
+ */
+static std::string plan_memory_json(const EngineConfig* config, GgufStatus status, const GgufInfo& info,
+                                    const std::string& read_error) {
+    MemoryPlan plan;
+    EngineConfig cfg;
+    std::string error;
+    if (!engine_config_import(config, cfg, error)) {
+        plan.verdict = "error";
+        plan.reason = error;
+    } else if (status != GgufStatus::kComplete) {
+        plan.verdict = "error";
+        plan.reason = read_error;
+        plan.config = cfg;
+    } else {
+        plan = plan_memory(info, cfg, read_mem_available() + (uint64_t) g_loaded_buffer_bytes.load(),
+                           read_mem_total());
+    }
+    return memory_plan_json(plan);
+}
+
+/**
+ * Predict the memory loading model_path with config (nullptr = defaults) takes
+ * and compare it with MemAvailable and MemTotal, counting the buffers of a loaded
+ * model (which the load frees) as available. Reads only the GGUF header and
+ * doesn't take the engine lock - FFI version for Dart
+ * Returns: JSON (see memory_plan_json in memory_planner.h) whose "config" is the
+ * config to load with; verdict "error" if the file or config can't be read.
+ * Valid until the next call on this thread.
+ */
+const char* plan_model_memory(const char* model_path, const EngineConfig* config) {
+    static thread_local std::string report;
+    GgufInfo info;
+    std::string error;
+    const GgufStatus status = gguf_read_info(model_path, info, error);
+    report = plan_memory_json(config, status, info, error);
+    LOGI("MEMORY: Plan for %s: %s", model_path, report.c_str());
+    return report.c_str();
+}
+
+/**
+ * plan_model_memory for a model stored as length bytes at offset in fd, as
+ * load_model_region takes it; fd stays open and owned by the caller
+ * Returns: JSON as plan_model_memory. Valid until the next call on this thread.
+ */
+const char* plan_model_region_memory(int32_t fd, int64_t offset, int64_t length, const EngineConfig* config) {
+    static thread_local std::string report;
+    GgufInfo info;
+    std::string error;
+    const GgufStatus status = gguf_read_info(fd, (uint64_t) offset, (uint64_t) length, info, error);
+    report = plan_memory_json(config, status, info, error);
+    LOGI("MEMORY: Plan for region %d@%lld+%lld: %s", fd, (long long) offset, (long long) length, report.c_str());
+    return report.c_str();
+}
+
+/**
+ * Returns: JSON of the predicted vs measured footprint of the last load (see
+ * memory_calibration_json in memory_planner.h), or "" before the first load.
+ * Valid until the next call.
+ */
+const char* get_memory_calibration() {
+    static std::string json;
+    std::lock_guard<std::mutex> lock(g_memory_mutex);
+    json = g_memory_calibration;
+    return json.c_str();
+}
+
+/**
+ * Fill out with the default engine config - FFI version for Dart
+ */
+void get_default_engine_config(EngineConfig* out) {
+    if (out) *out = engine_config_defaults();
+}
+
+/**
+ * Returns: JSON of the effective engine config of the loaded model (see
+ * engine_config.h), or "" if none is loaded. Valid until the next call.
+ */
+const char* get_engine_config() {
+    static std::string json;
+    std::lock_guard<std::mutex> lock(g_config_json_mutex);
+    json = g_engine_config_json;
+    return json.c_str();
+}
+
+/**
+ * Load a GGUF stored at [offset, offset + length) of fd inside an uncompressed
+ * container (e.g. an APK asset) - FFI version for Dart
+ * cache_path: where a region at a non-zero offset is materialized; see model_region.h
+ * config: engine config as for load_model_with_config (nullptr = defaults)
+ * Takes ownership of fd: it is closed on failure, right after loading a
+ * materialized region, or when a directly mapped model is disposed/replaced.
+ * Returns: 0 on success, -1 on failure
+ */
+int32_t load_model_region(int32_t fd, int64_t offset, int64_t length, const char* cache_path,
+                          const EngineConfig* config) {
+    LOGI("FFI: Loading model from fd %d at offset %lld (%lld bytes)", fd, (long long) offset, (long long) length);
+    if (fd < 0) return -1;
+
+    EngineConfig cfg;
+    std::string error;
+    if (!engine_config_import(config, cfg, error)) {
+        LOGE("FFI: %s", error.c_str());
+        close(fd);
         return -1;
     }
-    
-    // Context parameters
-    llama_context_params ctx_params = llama_context_default_params();
-    ctx_params.n_ctx = 512;  // Smaller context for mobile
-    ctx_params.n_batch = 128;
-    ctx_params.n_threads = 4;
-    
-    // Create context
-    g_ctx = llama_init_from_model(g_model, ctx_params);
-    if (!g_ctx) {
-        LOGE("FFI: Failed to create context");
-        llama_model_free(g_model);
-        g_model = nullptr;
+
+    ModelRegionResult region;
+    if (offset < 0 || length <= 0 ||
+        !resolve_model_region(fd, (uint64_t) offset, (uint64_t) length, cache_path, region)) {
+        LOGE("FFI: Invalid model region: %s", region.error.c_str());
+        close(fd);
         return -1;
     }
+
+    const int32_t rc = load_model_internal(region.path.c_str(), cfg);
+    if (rc == 0 && region.mode == "direct") {
+        g_model_fd = fd; // llama.cpp mapped /proc/self/fd/<fd>; keep it open with the model
+    } else {
+        close(fd);
+    }
+    return rc;
+}
+
+/**
+ * Close a region fd that was not handed to load_model_region - FFI version for Dart
+ */
+void release_model_region_fd(int32_t fd) {
+    if (fd >= 0) close(fd);
+}
     
-    g_is_loaded = true;
-    LOGI("FFI: Model loaded successfully");
-    return 0;
+
+/**
+ * Snapshot file of key in the session directory, or "" if snapshots are disabled
+ */
+static std::string session_snapshot_file(const SessionKey& key) {
+    std::lock_guard<std::mutex> lock(g_session_mutex);
+    return g_session_dir.empty() ? "" : session_snapshot_path(g_session_dir, key);
+}
+
+/**
+ * Remember how the last run got its prompt into the KV cache, for get_session_report()
+ */
+static void record_session_report(int n_prompt, double prefill_ms, const SessionSnapshotResult& restore,
+                                  const SessionSnapshotResult& save) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "\"prompt_tokens\":%d,\"prefill_ms\":%.3f,", n_prompt, prefill_ms);
+    const bool enabled = !restore.status.empty();
+    std::string json = std::string("{\"enabled\":") + (enabled ? "true" : "false") +
+                       ",\"source\":\"" + (restore.status == "restored" ? "restored" : "prefilled") + "\"," + buf +
+                       "\"restore\":" + (enabled ? session_snapshot_json(restore) : "null") +
+                       ",\"save\":" + (save.status.empty() ? "null" : session_snapshot_json(save)) + "}";
+    std::lock_guard<std::mutex> lock(g_session_mutex);
+    g_session_report = std::move(json);
 }
 
 /**
@@ -314,7 +750,13 @@ int32_t load_model(const char* model_path) {
  * Returns: number of tokens generated, or -1 on error
  */
 int32_t run_inference(const char* prompt, int32_t max_tokens) {
-    g_stop_inference = false;
+    std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+    if (g_shutdown_requested) {
+        LOGI("FFI: Engine shutting down, not starting inference");
+        return -1;
+    }
+    CommandScope command;
+    CancelLatencyRecorder cancel_latency;
     if (!g_is_loaded || !g_model || !g_ctx) {
         LOGE("FFI: Model not loaded");
         return -1;
@@ -345,19 +787,57 @@ int32_t run_inference(const char* prompt, int32_t max_tokens) {
 
     LOGI("FFI: Prompt tokenized to %d tokens", n_prompt_tokens);
     
-    // Process prompt
-    llama_batch batch = llama_batch_get_one(tokens.data(), n_prompt_tokens);
-    if (llama_decode(g_ctx, batch) != 0) {
-        LOGE("FFI: Failed to decode prompt");
-        return -1;
+    // Counters are opened here, on the calling thread, so ggml's compute threads inherit them
+    PerfCounters perf;
+    PerfRunStats perf_run;
+    const bool use_perf = g_perf_enabled && perf.open();
+    // Inherited counts only reach this thread when a compute thread exits, which
+    // the pool's threads never do; counted runs use per-graph threads instead and
+    // never wake the pool
+    ThreadpoolRun threadpool_run(use_perf);
+    PerfSample perf_before, perf_after;
+
+    // On the first pass after a load, restore the prefilled prompt from its
+    // snapshot if one matches, else prefill it
+    SessionKey session_key = g_session_key;
+    session_key.prompt_hash = session_prompt_hash(tokens);
+    const std::string snapshot = g_session_key_valid ? session_snapshot_file(session_key) : "";
+    const bool try_restore = g_session_restore_armed;
+    g_session_restore_armed = false;
+    SessionSnapshotResult restore;
+    if (!snapshot.empty() && try_restore) restore = session_snapshot_restore(snapshot, session_key, tokens, g_ctx);
+
+    double prefill_ms = 0.0;
+    llama_batch batch;
+    if (restore.status != "restored") {
+        batch = llama_batch_get_one(tokens.data(), n_prompt_tokens);
+        const int64_t t_prefill = now_us();
+        if (use_perf) perf.read(perf_before);
+        const int32_t prompt_rc = llama_decode(g_ctx, batch);
+        if (use_perf && perf.read(perf_after)) perf_run.prefill = perf_delta(perf_before, perf_after);
+        prefill_ms = (now_us() - t_prefill) / 1000.0;
+        if (prompt_rc == 2) {
+            LOGI("FFI: Prompt decode aborted");
+            return 0;
+        }
+        if (prompt_rc != 0) {
+            LOGE("FFI: Failed to decode prompt");
+            return -1;
+        }
+        // Written once the worker is idle, so the disk I/O isn't timed with any pass
+        if (restore.status == "missing" || restore.status == "stale") {
+            g_session_pending = {snapshot, session_key, tokens, prefill_ms, restore};
+        }
     }
+    record_session_report(n_prompt_tokens, prefill_ms, restore, SessionSnapshotResult());
     
     // Generate tokens
     int n_generated = 0;
     std::string generated_text;
     
     for (int i = 0; i < max_tokens; i++) {
-        if (g_stop_inference) break;
+        wait_while_paused();
+        if (stop_requested()) break;
         // Sample next token
         auto* logits = llama_get_logits_ith(g_ctx, -1);
         if (!logits) {
@@ -408,7 +888,14 @@ int32_t run_inference(const char* prompt, int32_t max_tokens) {
         batch = llama_batch_get_one(&new_token, 1);
         // Note: Position is tracked automatically since batch.pos is NULL
 
-        if (llama_decode(g_ctx, batch) != 0) {
+        if (use_perf) perf.read(perf_before);
+        const int32_t rc = llama_decode(g_ctx, batch);
+        if (use_perf && perf.read(perf_after)) perf_run.steps.push_back(perf_delta(perf_before, perf_after));
+        if (rc == 2) {
+            LOGI("FFI: Decode aborted at step %d", i);
+            break;
+        }
+        if (rc != 0) {
             LOGE("FFI: Failed to decode token step %d", i);
             break;
         }
@@ -418,53 +905,1792 @@ int32_t run_inference(const char* prompt, int32_t max_tokens) {
     
     // Store generated text in global variable
     g_generated_text = generated_text;
+
+    if (g_perf_enabled) {
+        std::lock_guard<std::mutex> perf_lock(g_perf_report_mutex);
+        g_perf_report = perf_report_json(perf, perf_run);
+    }
     
     LOGI("FFI: Generated %d tokens: %s", n_generated, generated_text.c_str());
     return n_generated;
 }
 
 /**
- * Dispose model - FFI version for Dart
+ * User + system CPU time of the whole process, compute threads included
  */
-void dispose_model() {
-    LOGI("FFI: Disposing model");
-    
-    if (g_ctx) {
-        llama_free(g_ctx);
-        g_ctx = nullptr;
-    }
-    
-    if (g_model) {
-        llama_model_free(g_model);
-        g_model = nullptr;
-    }
-    
-    llama_backend_free();
-    g_is_loaded = false;
-    g_token_callback = nullptr;
+static double process_cpu_ms() {
+    rusage usage {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
 }
 
 /**
- * Set token callback - FFI version for Dart
+ * One measured pass of the repetition harness: clear KV, prefill the prompt,
+ * then greedy-decode exactly n_tokens (EOG ignored so every pass does the same work).
+ * step_ms, if given, gets the latency of every decode step appended, and
+ * decode_cpu_ms the process CPU time the decode steps took.
+ * Caller holds the engine lock.
+ * Returns: false on decode failure or abort
  */
-void set_token_callback(TokenCallback callback) {
-    LOGI("FFI: Setting token callback");
-    g_token_callback = callback;
-}
+static bool measure_pass(const std::vector<llama_token>& prompt_tokens, int n_tokens,
+                         double& prefill_tps, double& decode_tps, std::vector<double>* step_ms = nullptr,
+                         double* decode_cpu_ms = nullptr) {
+    llama_memory_clear(llama_get_memory(g_ctx), true);
 
-/**
- * Get generated text - FFI version for Dart
- * Returns: pointer to generated text string
- */
-const char* get_generated_text() {
-    return g_generated_text.c_str();
+    std::vector<llama_token> tokens(prompt_tokens);
+    const int64_t t_prefill = now_us();
+    if (llama_decode(g_ctx, llama_batch_get_one(tokens.data(), (int32_t) tokens.size())) != 0) {
+        return false;
+    }
+    const int64_t prefill_us = now_us() - t_prefill;
+
+    const llama_vocab* vocab = llama_model_get_vocab(g_model);
+    const int n_vocab = llama_vocab_n_tokens(vocab);
+    const double cpu_decode = decode_cpu_ms ? process_cpu_ms() : 0.0;
+    const int64_t t_decode = now_us();
+    int64_t t_step = t_decode;
+    for (int i = 0; i < n_tokens; i++) {
+        if (stop_requested()) return false;
+        const float* logits = llama_get_logits_ith(g_ctx, -1);
+        llama_token new_token = (llama_token) (std::max_element(logits, logits + n_vocab) - logits);
+        if (llama_decode(g_ctx, llama_batch_get_one(&new_token, 1)) != 0) return false;
+        if (step_ms) {
+            const int64_t t = now_us();
+            step_ms->push_back((t - t_step) / 1000.0);
+            t_step = t;
+        }
+    }
+    const int64_t decode_us = now_us() - t_decode;
+    if (decode_cpu_ms) *decode_cpu_ms = process_cpu_ms() - cpu_decode;
+
+    prefill_tps = prefill_us > 0 ? tokens.size() * 1e6 / prefill_us : 0.0;
+    decode_tps = decode_us > 0 ? n_tokens * 1e6 / decode_us : 0.0;
+    return true;
 }
 
 /**
- * Stop inference - FFI version for Dart
+ * Run n_warmup discarded passes, then n_reps measured passes of the same
+ * workload on the loaded model - FFI version for Dart.
+ * Warm-up absorbs first-touch page faults of the mmapped weights and CPU
+ * frequency ramp-up; see bench_stats.h for the outlier rule.
+ * Returns: JSON {"status","warmup","repetitions","prompt_tokens","n_tokens",
+ * "prefill":{stats},"decode":{stats},"prefill_samples":[..],"decode_samples":[..],
+ * "decode_step_ms":[..],"energy":{..}}, the step latencies of all measured passes in
+ * order; energy as energy_report_json over the measured passes, per generated token,
+ * or null without power telemetry (set_power_telemetry). Status is "ok",
+ * "cancelled" or "error". Valid until the next call.
  */
-void stop_inference() {
-    g_stop_inference = true;
+const char* run_benchmark_repetitions(const char* prompt, int32_t n_tokens,
+                                      int32_t n_warmup, int32_t n_reps) {
+    static std::string report;
+    std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+    CommandScope command;
+    CancelLatencyRecorder cancel_latency;
+    ThreadpoolRun threadpool_run;
+
+    auto error_report = [](const char* status, const char* error) {
+        report = std::string("{\"status\":\"") + status + "\",\"error\":\"" + error + "\"}";
+        return report.c_str();
+    };
+    if (g_shutdown_requested) return error_report("cancelled", "engine shutting down");
+    if (!g_is_loaded || !g_model || !g_ctx) return error_report("error", "model not loaded");
+    if (!prompt || n_tokens <= 0 || n_warmup < 0 || n_reps <= 0) return error_report("error", "invalid arguments");
+
+    const llama_vocab* vocab = llama_model_get_vocab(g_model);
+    const int n_prompt = -llama_tokenize(vocab, prompt, strlen(prompt), nullptr, 0, true, true);
+    std::vector<llama_token> tokens(n_prompt);
+    if (n_prompt <= 0 ||
+        llama_tokenize(vocab, prompt, strlen(prompt), tokens.data(), tokens.size(), true, true) < 0) {
+        return error_report("error", "failed to tokenize prompt");
+    }
+    n_tokens = std::min<int32_t>(n_tokens, (int32_t) llama_n_ctx(g_ctx) - n_prompt - 1);
+    if (n_tokens <= 0) return error_report("error", "prompt does not fit the context");
+
+    PowerSampler power;
+    PowerWindow power_baseline;
+    bool use_power = false;
+    {
+        std::lock_guard<std::mutex> power_lock(g_power_mutex);
+        std::string power_error;
+        if (g_power_enabled && !(use_power = power.open(g_power_root, power_error))) {
+            LOGE("FFI: No energy measurement: %s", power_error.c_str());
+        }
+    }
+
+    std::vector<double> prefill_samples, decode_samples, step_ms;
+    step_ms.reserve((size_t) n_reps * n_tokens);
+    for (int pass = 0; pass < n_warmup + n_reps; pass++) {
+        if (pass == n_warmup && use_power) {
+            // Idle draw right before the measured passes, with the compute threads asleep
+            g_threadpool.pause();
+            power.start(kPowerIntervalMs);
+            std::this_thread::sleep_for(std::chrono::milliseconds(kPowerBaselineMs));
+            power_baseline = power.stop();
+            g_threadpool.resume();
+            power.start(kPowerIntervalMs);
+        }
+        double prefill_tps = 0.0, decode_tps = 0.0;
+        if (!measure_pass(tokens, n_tokens, prefill_tps, decode_tps, pass < n_warmup ? nullptr : &step_ms)) {
+            return stop_requested() ? error_report("cancelled", "stopped")
+                                    : error_report("error", "decode failed");
+        }
+        if (pass < n_warmup) {
+            LOGI("FFI: Warm-up %d/%d: decode %.2f t/s", pass + 1, n_warmup, decode_tps);
+            continue;
+        }
+        LOGI("FFI: Repetition %d/%d: prefill %.2f t/s, decode %.2f t/s",
+             pass - n_warmup + 1, n_reps, prefill_tps, decode_tps);
+        prefill_samples.push_back(prefill_tps);
+        decode_samples.push_back(decode_tps);
+    }
+    std::string energy = "null";
+    if (use_power) {
+        energy = energy_report_json(power.supply(), power_baseline, power.stop(), (int64_t) n_reps * n_tokens);
+        LOGI("FFI: Energy %s", energy.c_str());
+    }
+    llama_memory_clear(llama_get_memory(g_ctx), true);
+
+    auto samples_json = [](const std::vector<double>& samples) {
+        std::string json = "[";
+        char buf[32];
+        for (size_t i = 0; i < samples.size(); i++) {
+            snprintf(buf, sizeof(buf), "%s%.4f", i > 0 ? "," : "", samples[i]);
+            json += buf;
+        }
+        return json + "]";
+    };
+    const SampleStats decode_stats = compute_sample_stats(decode_samples);
+    report = "{\"status\":\"ok\",\"warmup\":" + std::to_string(n_warmup) +
+             ",\"repetitions\":" + std::to_string(n_reps) +
+             ",\"prompt_tokens\":" + std::to_string(n_prompt) +
+             ",\"n_tokens\":" + std::to_string(n_tokens) +
+             ",\"prefill\":" + sample_stats_json(compute_sample_stats(prefill_samples)) +
+             ",\"decode\":" + sample_stats_json(decode_stats) +
+             ",\"prefill_samples\":" + samples_json(prefill_samples) +
+             ",\"decode_samples\":" + samples_json(decode_samples) +
+             ",\"decode_step_ms\":" + samples_json(step_ms) + ",\"energy\":" + energy + "}";
+    LOGI("FFI: Decode %.2f t/s (median %.2f, sd %.2f, 95%% CI %.2f-%.2f, %d outliers)",
+         decode_stats.mean, decode_stats.median, decode_stats.stddev,
+         decode_stats.ci95_low, decode_stats.ci95_high, decode_stats.n_outliers);
+    return report.c_str();
+}
+
+/**
+ * Directory for KV session snapshots ("" or nullptr = disabled) - FFI version for Dart.
+ * With a directory set, the first run_inference after a load restores a prompt
+ * prefilled before, with the same model file and context layout, instead of
+ * prefilling it again.
+ * Returns: 0 on success, -1 if the directory can't be created
+ */
+int32_t set_session_cache_dir(const char* dir) {
+    const std::string path = dir ? dir : "";
+    if (!path.empty() && mkdir(path.c_str(), 0700) != 0 && errno != EEXIST) {
+        LOGE("FFI: Can't create session directory %s: %s", path.c_str(), strerror(errno));
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(g_session_mutex);
+    g_session_dir = path;
+    return 0;
+}
+
+/**
+ * Returns: JSON {"enabled","source","prompt_tokens","prefill_ms","restore","save"}
+ * describing how the last run_inference got its prompt into the KV cache;
+ * "source" is "restored" or "prefilled", "restore"/"save" are snapshot results
+ * (see session_cache.h) or null; "save" stays null until session_snapshot_flush()
+ * has written the snapshot. "" before the first run. Valid until the next call.
+ */
+const char* get_session_report() {
+    static std::string json;
+    std::lock_guard<std::mutex> lock(g_session_mutex);
+    json = g_session_report;
+    return json.c_str();
+}
+
+/**
+ * Write the snapshot the last run_inference left pending: prefill its prompt
+ * again and save the state. Called by the engine worker when its queue is empty,
+ * so neither the prefill nor the disk I/O lands in a measured pass. A load or
+ * dispose drops the pending snapshot.
+ */
+void session_snapshot_flush() {
+    std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+    if (g_session_pending.path.empty()) return;
+    PendingSessionSave pending = std::move(g_session_pending);
+    g_session_pending = PendingSessionSave();
+    if (!g_is_loaded || !g_ctx || g_shutdown_requested) return;
+    CommandScope command;
+    ThreadpoolRun threadpool_run;
+
+    llama_memory_clear(llama_get_memory(g_ctx), true);
+    if (llama_decode(g_ctx, llama_batch_get_one(pending.tokens.data(), (int32_t) pending.tokens.size())) != 0) {
+        LOGI("SESSION: Prompt prefill for the snapshot failed or was stopped");
+        llama_memory_clear(llama_get_memory(g_ctx), true);
+        return;
+    }
+    const SessionSnapshotResult save = session_snapshot_save(pending.path, pending.key, pending.tokens, g_ctx);
+    llama_memory_clear(llama_get_memory(g_ctx), true);
+    record_session_report((int) pending.tokens.size(), pending.prefill_ms, pending.restore, save);
+}
+
+/**
+ * Compare re-prefilling prompt with restoring its KV snapshot, n_reps times
+ * each, on the loaded model - FFI version for Dart. The page cache is dropped
+ * for the snapshot before every restore, as after a cold start.
+ * Needs a session directory (set_session_cache_dir); the snapshot is left there.
+ * Returns: JSON {"status","prompt_tokens","repetitions","snapshot_bytes","save_ms",
+ * "cold_reads","first_token_match","prefill_ms":{stats},"restore_ms":{stats},"speedup"};
+ * speedup is median prefill / median restore. Valid until the next call.
+ */
+const char* run_session_restore_benchmark(const char* prompt, int32_t n_reps) {
+    static std::string report;
+    std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+    CommandScope command;
+    CancelLatencyRecorder cancel_latency;
+    ThreadpoolRun threadpool_run;
+
+    auto error_report = [](const char* status, const std::string& error) {
+        report = std::string("{\"status\":\"") + status + "\",\"error\":\"" + json_escape(error) + "\"}";
+        return report.c_str();
+    };
+    if (g_shutdown_requested) return error_report("cancelled", "engine shutting down");
+    if (!g_is_loaded || !g_model || !g_ctx) return error_report("error", "model not loaded");
+    if (!prompt || n_reps <= 0) return error_report("error", "invalid arguments");
+
+    const llama_vocab* vocab = llama_model_get_vocab(g_model);
+    const int n_prompt = -llama_tokenize(vocab, prompt, strlen(prompt), nullptr, 0, true, true);
+    std::vector<llama_token> tokens(std::max(n_prompt, 0));
+    if (n_prompt <= 0 ||
+        llama_tokenize(vocab, prompt, strlen(prompt), tokens.data(), tokens.size(), true, true) < 0) {
+        return error_report("error", "failed to tokenize prompt");
+    }
+    if (n_prompt >= (int) llama_n_ctx(g_ctx)) return error_report("error", "prompt does not fit the context");
+
+    SessionKey key = g_session_key;
+    key.prompt_hash = session_prompt_hash(tokens);
+    const std::string snapshot = g_session_key_valid ? session_snapshot_file(key) : "";
+    if (snapshot.empty()) return error_report("error", "session snapshots are disabled");
+
+    const int n_vocab = llama_vocab_n_tokens(vocab);
+    auto first_token = [n_vocab]() {
+        const float* logits = llama_get_logits_ith(g_ctx, -1);
+        return (llama_token) (std::max_element(logits, logits + n_vocab) - logits);
+    };
+    llama_memory_t mem = llama_get_memory(g_ctx);
+
+    std::vector<double> prefill_ms, restore_ms;
+    SessionSnapshotResult save;
+    llama_token prefilled_token = -1;
+    for (int rep = 0; rep < n_reps; rep++) {
+        if (stop_requested()) return error_report("cancelled", "stopped");
+        llama_memory_clear(mem, true);
+        const int64_t t_prefill = now_us();
+        if (llama_decode(g_ctx, llama_batch_get_one(tokens.data(), n_prompt)) != 0) {
+            return stop_requested() ? error_report("cancelled", "stopped")
+                                    : error_report("error", "prompt decode failed");
+        }
+        prefill_ms.push_back((now_us() - t_prefill) / 1000.0);
+        if (rep == 0) {
+            prefilled_token = first_token();
+            save = session_snapshot_save(snapshot, key, tokens, g_ctx);
+            if (save.status != "saved") return error_report("error", "snapshot save failed: " + save.reason);
+        }
+    }
+
+    bool cold_reads = true;
+    bool first_token_match = true;
+    for (int rep = 0; rep < n_reps; rep++) {
+        if (stop_requested()) return error_report("cancelled", "stopped");
+        cold_reads = session_snapshot_evict(snapshot) && cold_reads;
+        llama_memory_clear(mem, true);
+        const SessionSnapshotResult restore = session_snapshot_restore(snapshot, key, tokens, g_ctx);
+        if (restore.status != "restored") {
+            return error_report("error", "snapshot restore failed: " + restore.status + " " + restore.reason);
+        }
+        restore_ms.push_back(restore.elapsed_ms);
+        first_token_match = first_token_match && first_token() == prefilled_token;
+    }
+    llama_memory_clear(mem, true);
+
+    const SampleStats prefill_stats = compute_sample_stats(prefill_ms);
+    const SampleStats restore_stats = compute_sample_stats(restore_ms);
+    const double speedup = restore_stats.median > 0 ? prefill_stats.median / restore_stats.median : 0.0;
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "{\"status\":\"ok\",\"prompt_tokens\":%d,\"repetitions\":%d,\"snapshot_bytes\":%llu,"
+             "\"save_ms\":%.3f,\"cold_reads\":%s,\"first_token_match\":%s,\"speedup\":%.3f,",
+             n_prompt, n_reps, (unsigned long long) save.bytes, save.elapsed_ms,
+             cold_reads ? "true" : "false", first_token_match ? "true" : "false", speedup);
+    report = std::string(buf) + "\"prefill_ms\":" + sample_stats_json(prefill_stats) +
+             ",\"restore_ms\":" + sample_stats_json(restore_stats) + "}";
+    LOGI("FFI: %d-token prompt: prefill %.2f ms, restore %.2f ms (%.1fx, %llu bytes)",
+         n_prompt, prefill_stats.median, restore_stats.median, speedup, (unsigned long long) save.bytes);
+    return report.c_str();
+}
+
+/**
+ * Force a CPU backend variant ("" = best for this CPU) - FFI version for Dart.
+ * Only allowed while no model is loaded.
+ * Returns: 0 on success, -1 on failure
+ */
+int32_t select_cpu_variant(const char* variant) {
+    std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+    if (g_is_loaded) {
+        LOGE("FFI: Dispose the model before switching CPU variants");
+        return -1;
+    }
+    std::string error;
+    if (!cpu_backend_select(variant, error)) {
+        LOGE("FFI: %s", error.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Returns: JSON with the active CPU variant, detected and backend features and
+ * the variants built into this package (see cpu_variants.h). Valid until the next call.
+ */
+const char* get_cpu_backend_info() {
+    static std::string info;
+    info = cpu_backend_info_json();
+    return info.c_str();
+}
+
+/**
+ * Load model_path with every CPU variant this device supports in turn, using
+ * the engine config of the last load, and run the warm-up + repetition workload
+ * on each, so the uplift of each ISA level can be measured on one device. The
+ * loaded model is disposed before the first variant loads; afterwards the best
+ * variant is selected again and no model is loaded. A stop before the first
+ * variant leaves the loaded model alone.
+ * Returns: JSON {"status","variants":[{"name","score","status","report"}..]},
+ * report as returned by run_benchmark_repetitions. Valid until the next call.
+ */
+const char* run_cpu_variant_comparison(const char* model_path, const char* prompt, int32_t n_tokens,
+                                       int32_t n_warmup, int32_t n_reps) {
+    static std::string report;
+    CommandScope command;
+    const std::vector<CpuVariantInfo> variants = cpu_variants_list();
+    bool cancelled = false;
+    bool replaced = false; // The loaded model was disposed for a variant
+    std::string entries;
+    EngineConfig requested;
+    {
+        std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+        requested = g_requested_config;
+    }
+
+    for (const CpuVariantInfo& variant : variants) {
+        std::string entry = "{\"name\":\"" + json_escape(variant.name) +
+                            "\",\"score\":" + std::to_string(variant.score);
+        if (variant.score <= 0) {
+            entry += ",\"status\":\"unsupported\"}";
+        } else if (cancelled || stop_requested() || g_shutdown_requested) {
+            cancelled = true;
+            entry += ",\"status\":\"cancelled\"}";
+        } else {
+            dispose_model();
+            replaced = true;
+            if (select_cpu_variant(variant.name.c_str()) != 0 || load_model_internal(model_path, requested) != 0) {
+                entry += ",\"status\":\"load_failed\"}";
+            } else if (stop_requested()) {
+                // The load cleared g_shutdown_requested, the stop generation still tells
+                cancelled = true;
+                entry += ",\"status\":\"cancelled\"}";
+            } else {
+                const std::string run = run_benchmark_repetitions(prompt, n_tokens, n_warmup, n_reps);
+                cancelled = run.find("\"status\":\"cancelled\"") != std::string::npos;
+                entry += ",\"status\":\"" + std::string(cancelled ? "cancelled" : "ok") + "\",\"report\":" + run + "}";
+            }
+        }
+        entries += (entries.empty() ? "" : ",") + entry;
+    }
+
+    if (replaced) {
+        dispose_model();
+        select_cpu_variant("");
+    }
+    report = "{\"status\":\"" + std::string(variants.empty() ? "error" : cancelled ? "cancelled" : "ok") +
+             "\",\"variants\":[" + entries + "]}";
+    return report.c_str();
+}
+
+/**
+ * Returns: JSON of the huge page advice for the loaded model and how much of
+ * its memory is on huge pages right now (see huge_page_report_json; "ranges" is
+ * 0 unless it was loaded with huge_pages). Valid until the next call.
+ */
+const char* get_huge_page_report() {
+    static std::string json;
+    HugePageAdvice advice;
+    {
+        std::lock_guard<std::mutex> lock(g_huge_page_mutex);
+        advice = g_huge_page_advice;
+    }
+    json = huge_page_report_json(advice, read_huge_page_usage(advice));
+    return json.c_str();
+}
+
+/**
+ * Load model_path with the engine config of the last load, first with huge
+ * pages off, then on, and run the warm-up + repetition workload on each.
+ * Memory is read from smaps after the workload, once the weights and KV cache
+ * have been touched. Leaves no model loaded, unless a stop lands before the
+ * first load, which leaves the loaded model alone.
+ * Returns: JSON {"status","settings":[{"huge_pages","status","memory","report"}..]},
+ * memory as returned by get_huge_page_report, report as returned by
+ * run_benchmark_repetitions. Valid until the next call.
+ */
+const char* run_huge_page_comparison(const char* model_path, const char* prompt, int32_t n_tokens,
+                                     int32_t n_warmup, int32_t n_reps) {
+    static std::string report;
+    CommandScope command;
+    bool cancelled = false;
+    bool replaced = false; // The loaded model was disposed for a setting
+    std::string settings;
+    EngineConfig requested;
+    {
+        std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+        requested = g_requested_config;
+    }
+
+    for (const int32_t huge_pages : {0, 1}) {
+        std::string entry = std::string("{\"huge_pages\":") + (huge_pages ? "true" : "false");
+        EngineConfig cfg = requested;
+        cfg.huge_pages = huge_pages;
+        if (cancelled || stop_requested() || g_shutdown_requested) {
+            cancelled = true;
+            entry += ",\"status\":\"cancelled\"}";
+        } else {
+            dispose_model();
+            replaced = true;
+            if (load_model_internal(model_path, cfg) != 0) {
+                entry += ",\"status\":\"load_failed\"}";
+            } else if (stop_requested()) {
+                cancelled = true;
+                entry += ",\"status\":\"cancelled\"}";
+            } else {
+                const std::string run = run_benchmark_repetitions(prompt, n_tokens, n_warmup, n_reps);
+                cancelled = run.find("\"status\":\"cancelled\"") != std::string::npos;
+                const std::string memory = get_huge_page_report();
+                LOGI("FFI: Huge pages %s: %s", huge_pages ? "on" : "off", memory.c_str());
+                entry += ",\"status\":\"" + std::string(cancelled ? "cancelled" : "ok") + "\",\"memory\":" +
+                         memory + ",\"report\":" + run + "}";
+            }
+        }
+        settings += (settings.empty() ? "" : ",") + entry;
+    }
+
+    if (replaced) dispose_model();
+    report = "{\"status\":\"" + std::string(cancelled ? "cancelled" : "ok") + "\",\"settings\":[" + settings + "]}";
+    return report.c_str();
+}
+
+// Poll levels of the threadpool sweep, from sleeping at once to ggml's longest spin
+static constexpr int32_t kPollLevels[] = {0, 1, 10, 50, 100};
+static constexpr int kIdleWindowMs = 500;
+
+/**
+ * Percentile with linear interpolation between the closest ranks
+ */
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    const double rank = p / 100.0 * (v.size() - 1);
+    const size_t lo = (size_t) rank;
+    const size_t hi = std::min(lo + 1, v.size() - 1);
+    return v[lo] + (v[hi] - v[lo]) * (rank - lo);
+}
+
+/**
+ * Process CPU usage over the next window_ms of sleeping on this thread, in
+ * percent of one core
+ */
+static double idle_cpu_pct(int window_ms) {
+    const double cpu_before = process_cpu_ms();
+    const int64_t t_before = now_us();
+    std::this_thread::sleep_for(std::chrono::milliseconds(window_ms));
+    const double wall_ms = (now_us() - t_before) / 1000.0;
+    return wall_ms > 0.0 ? (process_cpu_ms() - cpu_before) / wall_ms * 100.0 : 0.0;
+}
+
+/**
+ * Decode the same workload on the loaded model with its threadpool recreated
+ * at each poll level (kPollLevels): one warm-up and n_reps measured passes per
+ * level, recording every step latency and the CPU time the decode steps took,
+ * then the CPU the idle pool uses for kIdleWindowMs after the last pass, first
+ * unpaused, then paused. CPU time is the whole process's (getrusage), so the
+ * app should stay idle meanwhile. The pool is put back to the loaded config.
+ * Returns: JSON {"status","prompt_tokens","n_tokens","repetitions","idle_window_ms",
+ * "threadpool":{..},"levels":[{"poll","decode":{stats},"step_ms":{"mean","p50","p90","p99","max"},
+ * "cpu_ms_per_token","cpu_cores","idle_cpu_pct","paused_idle_cpu_pct"}..]},
+ * threadpool as EngineThreadpool::json, decode stats in t/s, cpu_cores the mean
+ * number of busy cores while decoding; status is "ok", "cancelled" or "error".
+ * Valid until the next call.
+ */
+const char* run_threadpool_poll_sweep(const char* prompt, int32_t n_tokens, int32_t n_reps) {
+    static std::string report;
+    std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+    CommandScope command;
+    CancelLatencyRecorder cancel_latency;
+
+    auto error_report = [](const char* status, const std::string& error) {
+        report = std::string("{\"status\":\"") + status + "\",\"error\":\"" + json_escape(error) + "\"}";
+        return report.c_str();
+    };
+    if (g_shutdown_requested) return error_report("cancelled", "engine shutting down");
+    if (!g_is_loaded || !g_model || !g_ctx) return error_report("error", "model not loaded");
+    if (!g_threadpool.active()) return error_report("error", "no threadpool attached");
+    if (!prompt || n_tokens <= 0 || n_reps <= 0) return error_report("error", "invalid arguments");
+
+    const llama_vocab* vocab = llama_model_get_vocab(g_model);
+    const int n_prompt = -llama_tokenize(vocab, prompt, strlen(prompt), nullptr, 0, true, true);
+    std::vector<llama_token> tokens(n_prompt);
+    if (n_prompt <= 0 ||
+        llama_tokenize(vocab, prompt, strlen(prompt), tokens.data(), tokens.size(), true, true) < 0) {
+        return error_report("error", "failed to tokenize prompt");
+    }
+    n_tokens = std::min<int32_t>(n_tokens, (int32_t) llama_n_ctx(g_ctx) - n_prompt - 1);
+    if (n_tokens <= 0) return error_report("error", "prompt does not fit the context");
+
+    const EngineConfig loaded = g_threadpool.config();
+    std::string levels, error;
+    const char* status = "ok";
+    for (const int32_t poll : kPollLevels) {
+        EngineConfig cfg = loaded;
+        cfg.poll = poll;
+        llama_detach_threadpool(g_ctx);
+        if (!g_threadpool.create(cfg, error)) {
+            status = "error";
+            break;
+        }
+        g_threadpool.attach(g_ctx);
+        g_threadpool.resume();
+
+        std::vector<double> decode_samples, step_ms;
+        step_ms.reserve((size_t) n_reps * n_tokens);
+        double cpu_ms = 0.0;
+        for (int pass = 0; pass <= n_reps; pass++) {
+            double prefill_tps = 0.0, decode_tps = 0.0, pass_cpu_ms = 0.0;
+            // Pass 0 warms up the new pool's threads
+            if (!measure_pass(tokens, n_tokens, prefill_tps, decode_tps, pass > 0 ? &step_ms : nullptr,
+                              &pass_cpu_ms)) {
+                status = stop_requested() ? "cancelled" : "error";
+                error = "decode failed";
+                break;
+            }
+            if (pass == 0) continue;
+            decode_samples.push_back(decode_tps);
+            cpu_ms += pass_cpu_ms;
+        }
+        if (strcmp(status, "ok") != 0) break;
+
+        const double idle_pct = idle_cpu_pct(kIdleWindowMs);
+        g_threadpool.pause();
+        const double paused_pct = idle_cpu_pct(kIdleWindowMs);
+
+        double decode_ms = 0.0;
+        for (const double ms : step_ms) decode_ms += ms;
+        const double n_steps = (double) step_ms.size();
+        const SampleStats decode_stats = compute_sample_stats(decode_samples);
+        char buf[512];
+        snprintf(buf, sizeof(buf),
+                 "{\"poll\":%d,\"step_ms\":{\"mean\":%.4f,\"p50\":%.4f,\"p90\":%.4f,\"p99\":%.4f,\"max\":%.4f},"
+                 "\"cpu_ms_per_token\":%.4f,\"cpu_cores\":%.3f,\"idle_cpu_pct\":%.2f,\"paused_idle_cpu_pct\":%.2f,"
+                 "\"decode\":",
+                 poll, decode_ms / n_steps, percentile(step_ms, 50.0), percentile(step_ms, 90.0),
+                 percentile(step_ms, 99.0), *std::max_element(step_ms.begin(), step_ms.end()), cpu_ms / n_steps,
+                 decode_ms > 0.0 ? cpu_ms / decode_ms : 0.0, idle_pct, paused_pct);
+        levels += (levels.empty() ? "" : ",") + std::string(buf) + sample_stats_json(decode_stats) + "}";
+        LOGI("FFI: Poll %d: step p50 %.2f ms, p99 %.2f ms, %.2f CPU ms/token, idle %.1f%% (paused %.1f%%)",
+             poll, percentile(step_ms, 50.0), percentile(step_ms, 99.0), cpu_ms / n_steps, idle_pct, paused_pct);
+    }
+    llama_memory_clear(llama_get_memory(g_ctx), true);
+
+    // Back to the pool the model was loaded with
+    llama_detach_threadpool(g_ctx);
+    std::string restore_error;
+    if (g_threadpool.create(loaded, restore_error)) {
+        g_threadpool.attach(g_ctx);
+    } else {
+        LOGE("FFI: %s, compute threads are not persistent", restore_error.c_str());
+    }
+
+    if (strcmp(status, "ok") != 0) return error_report(status, error);
+    report = "{\"status\":\"ok\",\"prompt_tokens\":" + std::to_string(n_prompt) +
+             ",\"n_tokens\":" + std::to_string(n_tokens) + ",\"repetitions\":" + std::to_string(n_reps) +
+             ",\"idle_window_ms\":" + std::to_string(kIdleWindowMs) + ",\"threadpool\":" + g_threadpool.json() +
+             ",\"levels\":[" + levels + "]}";
+    return report.c_str();
+}
+
+/**
+ * Tokenize the synthetic text the depth measurements fill the KV cache with
+ * (BOS first). Its content doesn't matter, attention cost only depends on the length.
+ * Returns: false if the vocab yields fewer than 2 tokens
+ */
+static bool tokenize_filler(const llama_vocab* vocab, std::vector<llama_token>& filler) {
+    static const char* kFiller =
+        "The quick brown fox jumps over the lazy dog while the river keeps running to the sea, "
+        "and every evening the old lighthouse keeper writes another page of his long story.";
+    const int n_filler = -llama_tokenize(vocab, kFiller, strlen(kFiller), nullptr, 0, true, false);
+    if (n_filler < 2) return false;
+    filler.resize(n_filler);
+    return llama_tokenize(vocab, kFiller, strlen(kFiller), filler.data(), filler.size(), true, false) >= 0;
+}
+
+/**
+ * Prefill `depth` filler tokens, then greedy-decode n_gen tokens on top of them,
+ * with an empty KV cache at the start. At depth 0 only BOS is decoded (untimed)
+ * to get the first logits. Caller holds the engine lock.
+ * Returns: false on decode failure or abort, with the failing step in error
+ */
+static bool measure_at_depth(const std::vector<llama_token>& filler, int depth, int n_gen,
+                             double& prefill_tps, double& decode_tps, std::string& error) {
+    llama_memory_clear(llama_get_memory(g_ctx), true);
+    if (depth == 0) {
+        llama_token bos = filler[0];
+        const int32_t rc = llama_decode(g_ctx, llama_batch_get_one(&bos, 1));
+        if (rc != 0) {
+            error = "BOS decode failed (rc " + std::to_string(rc) + ")";
+            return false;
+        }
+    }
+
+    std::vector<llama_token> tokens(depth);
+    for (int i = 0; i < depth; i++) {
+        // The first pass over the filler includes BOS, later ones don't repeat it
+        tokens[i] = i < (int) filler.size() ? filler[i] : filler[1 + (i - 1) % (filler.size() - 1)];
+    }
+    const int n_batch = (int) llama_n_batch(g_ctx);
+    const int64_t t_prefill = now_us();
+    for (int i = 0; i < depth; i += n_batch) {
+        const int n = std::min(n_batch, depth - i);
+        const int32_t rc = llama_decode(g_ctx, llama_batch_get_one(tokens.data() + i, n));
+        if (rc != 0) {
+            error = "prefill decode failed at token " + std::to_string(i) + " (rc " + std::to_string(rc) + ")";
+            return false;
+        }
+    }
+    const int64_t prefill_us = now_us() - t_prefill;
+
+    const llama_vocab* vocab = llama_model_get_vocab(g_model);
+    const int n_vocab = llama_vocab_n_tokens(vocab);
+    const int64_t t_decode = now_us();
+    for (int i = 0; i < n_gen; i++) {
+        if (stop_requested()) {
+            error = "stopped";
+            return false;
+        }
+        const float* logits = llama_get_logits_ith(g_ctx, -1);
+        llama_token new_token = (llama_token) (std::max_element(logits, logits + n_vocab) - logits);
+        const int32_t rc = llama_decode(g_ctx, llama_batch_get_one(&new_token, 1));
+        if (rc != 0) {
+            error = "decode failed at step " + std::to_string(i) + " (rc " + std::to_string(rc) + ")";
+            return false;
+        }
+    }
+    const int64_t decode_us = now_us() - t_decode;
+
+    prefill_tps = prefill_us > 0 ? depth * 1e6 / prefill_us : 0.0;
+    decode_tps = decode_us > 0 ? n_gen * 1e6 / decode_us : 0.0;
+    return true;
+}
+
+/**
+ * Load model_path with flash attention off and then on (otherwise the engine
+ * config of the last load, with the context grown to fit max_depth + n_gen),
+ * and at each context depth up to max_depth measure prefill of that many tokens
+ * and decode of n_gen tokens on top of them, n_reps times. Leaves no model loaded.
+ * The on run uses the KV cache types the off run ended up with (a quantized V
+ * cache falls back to f16 without flash attention), so both settings hold the
+ * same cache; kv_types_differ is set if they still don't.
+ * Returns: JSON {"status","n_gen","repetitions","kv_types_differ","settings":[{"flash_attn",
+ * "status","n_ctx","type_k","type_v","compute_buffer_mib","kv_buffer_mib","depths":[{"depth",
+ * "status","prefill":{stats},"decode":{stats}}..]}..]}; status is "ok", "cancelled" or
+ * "error", and a depth that doesn't fit the context is "skipped". Valid until the next call.
+ */
+const char* run_flash_attention_comparison(const char* model_path, int32_t n_gen, int32_t max_depth,
+                                           int32_t n_reps) {
+    static std::string report;
+    CommandScope command;
+    if (!model_path || n_gen <= 0 || max_depth <= 0 || n_reps <= 0) {
+        report = "{\"status\":\"error\",\"error\":\"invalid arguments\"}";
+        return report.c_str();
+    }
+
+    EngineConfig requested;
+    {
+        std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+        requested = g_requested_config;
+    }
+    requested.n_ctx = std::max(requested.n_ctx, max_depth + n_gen);
+
+    std::vector<int> depths;
+    for (int depth = 128; depth < max_depth; depth *= 2) depths.push_back(depth);
+    depths.push_back(max_depth);
+
+    bool cancelled = false;
+    std::string settings;
+    std::vector<std::pair<int32_t, int32_t>> kv_types; // type_k, type_v of each loaded setting
+    for (const int flash_attn : {LLAMA_FLASH_ATTN_TYPE_DISABLED, LLAMA_FLASH_ATTN_TYPE_ENABLED}) {
+        std::string entry = "{\"flash_attn\":" + std::to_string(flash_attn);
+        EngineConfig cfg = requested;
+        cfg.flash_attn = flash_attn;
+        if (!kv_types.empty()) {
+            cfg.type_k = kv_types.front().first;
+            cfg.type_v = kv_types.front().second;
+        }
+        dispose_model();
+        if (cancelled || stop_requested() || g_shutdown_requested) {
+            cancelled = true;
+            settings += (settings.empty() ? "" : ",") + entry + ",\"status\":\"cancelled\"}";
+            continue;
+        }
+        if (load_model_internal(model_path, cfg) != 0) {
+            settings += (settings.empty() ? "" : ",") + entry + ",\"status\":\"load_failed\"}";
+            continue;
+        }
+
+        std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+        CancelLatencyRecorder cancel_latency;
+        ThreadpoolRun threadpool_run;
+
+        std::vector<llama_token> filler;
+        if (!tokenize_filler(llama_model_get_vocab(g_model), filler)) {
+            settings += (settings.empty() ? "" : ",") + entry + ",\"status\":\"error\"}";
+            continue;
+        }
+
+        const int n_ctx = (int) llama_n_ctx(g_ctx);
+        kv_types.emplace_back(g_loaded_config.type_k, g_loaded_config.type_v);
+        char buf[224];
+        snprintf(buf, sizeof(buf),
+                 ",\"n_ctx\":%d,\"type_k\":\"%s\",\"type_v\":\"%s\",\"compute_buffer_mib\":%.2f,"
+                 "\"kv_buffer_mib\":%.2f",
+                 n_ctx, ggml_type_name((ggml_type) g_loaded_config.type_k),
+                 ggml_type_name((ggml_type) g_loaded_config.type_v), g_context_report.compute_buffer_mib,
+                 g_context_report.kv_buffer_mib);
+        std::string depth_entries;
+        bool failed = false;
+        for (const int depth : depths) {
+            if (depth + n_gen > n_ctx) {
+                depth_entries += (depth_entries.empty() ? "" : ",") + std::string("{\"depth\":") +
+                                 std::to_string(depth) + ",\"status\":\"skipped\"}";
+                continue;
+            }
+            std::vector<double> prefill_samples, decode_samples;
+            for (int rep = 0; rep < n_reps && !failed; rep++) {
+                double prefill_tps = 0.0, decode_tps = 0.0;
+                std::string error;
+                if (!measure_at_depth(filler, depth, n_gen, prefill_tps, decode_tps, error)) {
+                    LOGE("FFI: Flash attention %s, depth %d: %s", flash_attn ? "on" : "off", depth, error.c_str());
+                    failed = true;
+                    break;
+                }
+                prefill_samples.push_back(prefill_tps);
+                decode_samples.push_back(decode_tps);
+            }
+            if (failed) break;
+            const SampleStats decode_stats = compute_sample_stats(decode_samples);
+            LOGI("FFI: Flash attention %s, depth %d: decode %.2f t/s", flash_attn ? "on" : "off",
+                 depth, decode_stats.mean);
+            depth_entries += (depth_entries.empty() ? "" : ",") + std::string("{\"depth\":") +
+                             std::to_string(depth) + ",\"status\":\"ok\"" +
+                             ",\"prefill\":" + sample_stats_json(compute_sample_stats(prefill_samples)) +
+                             ",\"decode\":" + sample_stats_json(decode_stats) + "}";
+        }
+        llama_memory_clear(llama_get_memory(g_ctx), true);
+
+        cancelled = failed && stop_requested();
+        const char* status = !failed ? "ok" : cancelled ? "cancelled" : "error";
+        settings += (settings.empty() ? "" : ",") + entry + ",\"status\":\"" + status + "\"" + buf +
+                    ",\"depths\":[" + depth_entries + "]}";
+    }
+
+    dispose_model();
+    const bool kv_types_differ = kv_types.size() == 2 && kv_types[0] != kv_types[1];
+    report = "{\"status\":\"" + std::string(cancelled ? "cancelled" : "ok") +
+             "\",\"n_gen\":" + std::to_string(n_gen) + ",\"repetitions\":" + std::to_string(n_reps) +
+             ",\"kv_types_differ\":" + (kv_types_differ ? "true" : "false") +
+             ",\"settings\":[" + settings + "]}";
+    return report.c_str();
+}
+
+/**
+ * Decode speed against KV-cache depth: load model_path with the engine config of
+ * the last load (context grown to max_depth + n_gen, batch raised to 512 so the
+ * synthetic prefill is fast), then at depths 0, 512, 1024, ... up to max_depth
+ * fill the cache and time n_gen greedy decode steps, n_reps times. Leaves no
+ * model loaded.
+ * The fit is decode ms/token against the mean KV length during decode
+ * (depth + n_gen / 2): overhead_ms_per_1k is the attention cost each 1k tokens
+ * of context add to every generated token, half_speed_depth where that doubles
+ * the depth-0 time.
+ * Returns: JSON {"status","n_gen","repetitions","n_ctx","depths":[{"depth",
+ * "status","decode":{stats},"ms_per_token","relative"}..],"fit":{"base_ms_per_token",
+ * "overhead_ms_per_1k","r2","half_speed_depth"}}; a depth that doesn't fit the
+ * model's training context is "skipped", one that failed is "error" with its
+ * "error", and one a stop landed in or before is "cancelled". The fit covers the
+ * "ok" depths. Valid until the next call.
+ */
+const char* run_kv_depth_sweep(const char* model_path, int32_t n_gen, int32_t max_depth, int32_t n_reps) {
+    static std::string report;
+    CommandScope command;
+    auto error_report = [](const char* status, const char* error) {
+        report = std::string("{\"status\":\"") + status + "\",\"error\":\"" + error + "\"}";
+        return report.c_str();
+    };
+    if (!model_path || n_gen <= 0 || max_depth < 0 || n_reps <= 0) return error_report("error", "invalid arguments");
+
+    EngineConfig cfg;
+    {
+        std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+        cfg = g_requested_config;
+    }
+    cfg.n_ctx = std::max(cfg.n_ctx, max_depth + n_gen);
+    cfg.n_batch = std::max(cfg.n_batch, 512);
+    cfg.n_ubatch = std::max(cfg.n_ubatch, 512);
+
+    dispose_model();
+    if (load_model_internal(model_path, cfg) != 0) return error_report("error", "model load failed");
+
+    std::vector<int> depths = {0};
+    for (int depth = 512; depth < max_depth; depth *= 2) depths.push_back(depth);
+    if (max_depth > 0) depths.push_back(max_depth);
+
+    {
+        std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+        CancelLatencyRecorder cancel_latency;
+        ThreadpoolRun threadpool_run;
+
+        std::vector<llama_token> filler;
+        if (g_shutdown_requested) {
+            error_report("cancelled", "engine shutting down");
+        } else if (!tokenize_filler(llama_model_get_vocab(g_model), filler)) {
+            error_report("error", "failed to tokenize filler");
+        } else {
+            const int n_ctx = (int) llama_n_ctx(g_ctx);
+            std::vector<double> fit_x, fit_y;
+            double base_tps = 0.0;
+            bool cancelled = false;
+            bool failed = false;
+            std::string entries;
+            char buf[160];
+
+            for (const int depth : depths) {
+                std::string entry = "{\"depth\":" + std::to_string(depth);
+                // n_ctx was grown to max_depth + n_gen, so only the model's training context caps it
+                if (depth + n_gen > n_ctx) {
+                    entries += (entries.empty() ? "" : ",") + entry + ",\"status\":\"skipped\"}";
+                    continue;
+                }
+                if (cancelled || stop_requested()) {
+                    cancelled = true;
+                    entries += (entries.empty() ? "" : ",") + entry + ",\"status\":\"cancelled\"}";
+                    continue;
+                }
+                std::vector<double> samples;
+                std::string error;
+                for (int rep = 0; rep < n_reps && error.empty(); rep++) {
+                    double prefill_tps = 0.0, decode_tps = 0.0;
+                    if (measure_at_depth(filler, depth, n_gen, prefill_tps, decode_tps, error)) {
+                        samples.push_back(decode_tps);
+                    }
+                }
+                if (!error.empty()) {
+                    if (stop_requested()) {
+                        cancelled = true;
+                        entries += (entries.empty() ? "" : ",") + entry + ",\"status\":\"cancelled\"}";
+                    } else {
+                        // Later depths still run: a larger one failing doesn't say a smaller one would
+                        LOGE("FFI: KV depth %d: %s", depth, error.c_str());
+                        failed = true;
+                        entries += (entries.empty() ? "" : ",") + entry + ",\"status\":\"error\",\"error\":\"" +
+                                   json_escape(error) + "\"}";
+                    }
+                    continue;
+                }
+
+                const SampleStats stats = compute_sample_stats(samples);
+                if (base_tps <= 0.0) base_tps = stats.mean;
+                const double ms_per_token = stats.mean > 0 ? 1000.0 / stats.mean : 0.0;
+                fit_x.push_back(depth + n_gen / 2.0);
+                fit_y.push_back(ms_per_token);
+                LOGI("FFI: KV depth %d: decode %.2f t/s (%.2f ms/token)", depth, stats.mean, ms_per_token);
+
+                snprintf(buf, sizeof(buf), ",\"ms_per_token\":%.4f,\"relative\":%.4f}",
+                         ms_per_token, base_tps > 0 ? stats.mean / base_tps : 0.0);
+                entries += (entries.empty() ? "" : ",") + entry + ",\"status\":\"ok\",\"decode\":" +
+                           sample_stats_json(stats) + buf;
+            }
+            llama_memory_clear(llama_get_memory(g_ctx), true);
+
+            const LinearFit fit = fit_line(fit_x, fit_y);
+            const double base_ms = fit_y.empty() ? 0.0 : fit_y.front();
+            snprintf(buf, sizeof(buf),
+                     "{\"base_ms_per_token\":%.4f,\"overhead_ms_per_1k\":%.4f,\"r2\":%.4f,"
+                     "\"half_speed_depth\":%.0f}",
+                     fit.intercept, fit.slope * 1000.0, fit.r2, fit.slope > 0 ? base_ms / fit.slope : 0.0);
+            const char* status = cancelled ? "cancelled" : failed ? "error" : "ok";
+            report = "{\"status\":\"" + std::string(status) + "\",\"n_gen\":" + std::to_string(n_gen) +
+                     ",\"repetitions\":" + std::to_string(n_reps) + ",\"n_ctx\":" + std::to_string(n_ctx) +
+                     ",\"depths\":[" + entries + "],\"fit\":" + buf + "}";
+        }
+    }
+
+    dispose_model();
+    return report.c_str();
+}
+
+/**
+ * One session of the contention benchmark: a context on the shared model, its CPUs and result
+ */
+struct ContentionSession {
+    llama_context* ctx = nullptr;
+    std::vector<int> cpus;
+    double decode_tps = 0.0;
+    bool ok = false;
+};
+
+/**
+ * Pin the calling thread to cpus; threads it creates afterwards (ggml's compute
+ * threads) inherit the mask
+ */
+static void pin_current_thread(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : cpus) CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        LOGE("FFI: sched_setaffinity failed: %s", strerror(errno));
+    }
+}
+
+/**
+ * Prefill the prompt and greedy-decode n_tokens on one session, timing the decode.
+ * Sessions wait for each other after prefill so their decodes overlap.
+ */
+static void run_contention_session(ContentionSession& session, const std::vector<llama_token>& prompt,
+                                   int n_tokens, std::atomic<int>& prefilled, int n_sessions) {
+    pin_current_thread(session.cpus);
+    std::vector<llama_token> tokens(prompt);
+    const bool prefill_ok =
+        llama_decode(session.ctx, llama_batch_get_one(tokens.data(), (int32_t) tokens.size())) == 0;
+    prefilled++;
+    while (prefilled.load() < n_sessions && !stop_requested()) std::this_thread::yield();
+    if (!prefill_ok) return;
+
+    const int n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(g_model));
+    const int64_t t_decode = now_us();
+    for (int i = 0; i < n_tokens; i++) {
+        if (stop_requested()) return;
+        const float* logits = llama_get_logits_ith(session.ctx, -1);
+        llama_token new_token = (llama_token) (std::max_element(logits, logits + n_vocab) - logits);
+        if (llama_decode(session.ctx, llama_batch_get_one(&new_token, 1)) != 0) return;
+    }
+    const int64_t decode_us = now_us() - t_decode;
+    session.decode_tps = decode_us > 0 ? n_tokens * 1e6 / decode_us : 0.0;
+    session.ok = true;
+}
+
+/**
+ * CPUs this thread may run on (sched_getaffinity), in id order; online ids can
+ * have gaps, and the app may be confined to some of them
+ */
+static std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    } else {
+        LOGE("FFI: sched_getaffinity failed: %s", strerror(errno));
+    }
+    return cpus;
+}
+
+static std::string cpu_list(const std::vector<int>& cpus) {
+    std::string list;
+    for (const int cpu : cpus) list += (list.empty() ? "" : ",") + std::to_string(cpu);
+    return list;
+}
+
+/**
+ * Run 1, 2, ... max_contexts sessions at once on the loaded model, each with its
+ * own context (engine config of the last load) on its own thread, and compare
+ * against one session. With overlap == 0 the CPUs this thread may run on are
+ * split into disjoint sets, one per session; otherwise every session may use all
+ * of them. Each
+ * session prefills the same prompt and greedy-decodes n_tokens - FFI version for Dart.
+ * Memory per extra context is the VmRSS growth beyond K = 1 divided by K - 1,
+ * next to the compute and KV buffers llama.cpp reserved per context.
+ * Returns: JSON {"status","n_tokens","mode","levels":[{"contexts","sessions":
+ * [{"cpus","decode_tps","ok"}..],"aggregate_tps","mean_tps","relative_speed","scaling",
+ * "rss_mib","rss_mib_per_extra","compute_buffer_mib","kv_buffer_mib"}..]},
+ * relative_speed the mean session speed over the single-session speed (below 1
+ * under contention). Valid until the next call.
+ */
+const char* run_context_contention(int32_t max_contexts, int32_t n_tokens, int32_t overlap) {
+    static std::string report;
+    std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+    CommandScope command;
+    CancelLatencyRecorder cancel_latency;
+
+    auto error_report = [](const char* status, const char* error) {
+        report = std::string("{\"status\":\"") + status + "\",\"error\":\"" + error + "\"}";
+        return report.c_str();
+    };
+    if (g_shutdown_requested) return error_report("cancelled", "engine shutting down");
+    if (!g_is_loaded || !g_model) return error_report("error", "model not loaded");
+    if (max_contexts <= 0 || n_tokens <= 0) return error_report("error", "invalid arguments");
+
+    std::vector<llama_token> prompt;
+    if (!tokenize_filler(llama_model_get_vocab(g_model), prompt)) {
+        return error_report("error", "failed to tokenize prompt");
+    }
+    const std::vector<int> cpus = allowed_cpus();
+    if (cpus.empty()) return error_report("error", "no CPUs in the affinity mask");
+    const int n_cpus = (int) cpus.size();
+    const bool disjoint = overlap == 0;
+    if (disjoint) max_contexts = std::min(max_contexts, n_cpus);
+
+    double single_tps = 0.0, single_rss = 0.0;
+    bool cancelled = false;
+    std::string levels;
+    for (int k = 1; k <= max_contexts && !cancelled; k++) {
+        EngineConfig cfg = g_requested_config;
+        cfg.n_ctx = std::max<int32_t>(cfg.n_ctx, (int32_t) prompt.size() + n_tokens + 1);
+        const int per_session = disjoint ? std::max(1, n_cpus / k) : n_cpus;
+        cfg.n_threads = std::min(cfg.n_threads > 0 ? cfg.n_threads : per_session, per_session);
+        cfg.n_threads_batch = cfg.n_threads;
+
+        const double rss_before = read_proc_status_mb("VmRSS");
+        std::vector<ContentionSession> sessions(k);
+        EngineContextReport buffers;
+        bool created = true;
+        for (int i = 0; i < k; i++) {
+            for (int c = 0; c < per_session; c++) {
+                sessions[i].cpus.push_back(cpus[disjoint ? (i * per_session + c) % n_cpus : c]);
+            }
+            EngineConfig session_cfg = cfg;
+            engine_context_report_begin();
+            sessions[i].ctx = llama_init_from_model(g_model, engine_config_context_params(session_cfg, g_model));
+            const EngineContextReport r = engine_context_report_end();
+            buffers.compute_buffer_mib = r.compute_buffer_mib;
+            buffers.kv_buffer_mib = r.kv_buffer_mib;
+            if (!sessions[i].ctx) {
+                created = false;
+                break;
+            }
+            llama_set_abort_callback(sessions[i].ctx, engine_abort_callback, nullptr);
+        }
+
+        std::string entry = "{\"contexts\":" + std::to_string(k);
+        if (created) {
+            std::atomic<int> prefilled{0};
+            std::vector<std::thread> threads;
+            for (int i = 0; i < k; i++) {
+                threads.emplace_back(run_contention_session, std::ref(sessions[i]), std::cref(prompt), n_tokens,
+                                     std::ref(prefilled), k);
+            }
+            for (std::thread& t : threads) t.join();
+        }
+        const double rss_mib = read_proc_status_mb("VmRSS") - rss_before;
+
+        double aggregate = 0.0;
+        bool all_ok = created;
+        std::string session_entries;
+        for (ContentionSession& s : sessions) {
+            all_ok = all_ok && s.ok;
+            aggregate += s.decode_tps;
+            session_entries += (session_entries.empty() ? "" : ",") + std::string("{\"cpus\":\"") +
+                               cpu_list(s.cpus) + "\",\"decode_tps\":" + std::to_string(s.decode_tps) +
+                               ",\"ok\":" + (s.ok ? "true" : "false") + "}";
+            if (s.ctx) llama_free(s.ctx);
+        }
+        if (!all_ok) {
+            cancelled = stop_requested();
+            levels += (levels.empty() ? "" : ",") + entry + ",\"status\":\"" +
+                      (cancelled ? "cancelled" : created ? "error" : "context_failed") + "\"}";
+            break;
+        }
+
+        const double mean = aggregate / k;
+        if (k == 1) {
+            single_tps = mean;
+            single_rss = rss_mib;
+        }
+        char buf[320];
+        snprintf(buf, sizeof(buf),
+                 ",\"status\":\"ok\",\"aggregate_tps\":%.4f,\"mean_tps\":%.4f,\"relative_speed\":%.4f,"
+                 "\"scaling\":%.4f,\"rss_mib\":%.2f,\"rss_mib_per_extra\":%.2f,"
+                 "\"compute_buffer_mib\":%.2f,\"kv_buffer_mib\":%.2f",
+                 aggregate, mean, single_tps > 0 ? mean / single_tps : 0.0,
+                 single_tps > 0 ? aggregate / single_tps : 0.0, rss_mib,
+                 k > 1 ? (rss_mib - single_rss) / (k - 1) : 0.0,
+                 buffers.compute_buffer_mib, buffers.kv_buffer_mib);
+        LOGI("FFI: %d contexts (%s): aggregate %.2f t/s, %.2f t/s each (%.0f%% of one)", k,
+             disjoint ? "disjoint" : "overlapping", aggregate, mean, single_tps > 0 ? 100.0 * mean / single_tps : 0.0);
+        levels += (levels.empty() ? "" : ",") + entry + buf + ",\"sessions\":[" + session_entries + "]}";
+    }
+
+    report = "{\"status\":\"" + std::string(cancelled ? "cancelled" : "ok") + "\",\"n_tokens\":" +
+             std::to_string(n_tokens) + ",\"mode\":\"" + (disjoint ? "disjoint" : "overlapping") +
+             "\",\"levels\":[" + levels + "]}";
+    return report.c_str();
+}
+
+// Embeddings context shape: up to kEmbeddingMaxSeq texts and kEmbeddingBatchTokens
+// tokens per batch. Every text must fit one ubatch to be pooled, so n_ubatch = n_batch.
+static constexpr int kEmbeddingMaxSeq = 64;
+static constexpr int kEmbeddingBatchTokens = 2048;
+
+static const char* pooling_name(int32_t pooling) {
+    switch (pooling) {
+        case LLAMA_POOLING_TYPE_MEAN: return "mean";
+        case LLAMA_POOLING_TYPE_CLS:  return "cls";
+        case LLAMA_POOLING_TYPE_LAST: return "last";
+        default:                      return "none";
+    }
+}
+
+/**
+ * Embeddings context with the given pooling (-1 = the model's own, mean if it
+ * has none, as generation models don't), reused while the pooling stays the same.
+ * Caller holds the engine lock.
+ */
+static llama_context* embedding_context(int32_t pooling, std::string& error) {
+    if (g_embd_ctx && g_embd_pooling == pooling) return g_embd_ctx;
+    free_embedding_context();
+
+    EngineConfig cfg = g_requested_config;
+    cfg.n_ctx = kEmbeddingBatchTokens;
+    cfg.n_batch = kEmbeddingBatchTokens;
+    cfg.n_ubatch = kEmbeddingBatchTokens;
+    llama_context_params params = engine_config_context_params(cfg, g_model);
+    params.n_ubatch = params.n_batch = params.n_ctx;
+    params.n_seq_max = kEmbeddingMaxSeq;
+    params.kv_unified = true; // Texts of a batch share the cells instead of n_ctx / n_seq each
+    params.embeddings = true;
+    params.pooling_type = (enum llama_pooling_type) pooling;
+
+    llama_context* ctx = llama_init_from_model(g_model, params);
+    if (ctx && llama_pooling_type(ctx) == LLAMA_POOLING_TYPE_NONE && pooling == LLAMA_POOLING_TYPE_UNSPECIFIED) {
+        llama_free(ctx);
+        params.pooling_type = LLAMA_POOLING_TYPE_MEAN;
+        ctx = llama_init_from_model(g_model, params);
+    }
+    if (!ctx) {
+        error = "failed to create embeddings context";
+        return nullptr;
+    }
+    if (llama_pooling_type(ctx) == LLAMA_POOLING_TYPE_NONE || llama_pooling_type(ctx) == LLAMA_POOLING_TYPE_RANK) {
+        llama_free(ctx);
+        error = "pooling must produce one vector per text";
+        return nullptr;
+    }
+    llama_set_abort_callback(ctx, engine_abort_callback, nullptr);
+    g_embd_ctx = ctx;
+    g_embd_pooling = pooling;
+    LOGI("FFI: Embeddings context: %s pooling, %u tokens x %u sequences",
+         pooling_name(llama_pooling_type(ctx)), llama_n_batch(ctx), llama_n_seq_max(ctx));
+    return ctx;
+}
+
+struct EmbeddingRun {
+    int64_t n_tokens = 0;
+    int n_batches = 0;
+    int64_t elapsed_us = 0;
+};
+
+/**
+ * Tokenize texts for embedding, truncated to one batch each
+ * Returns: number of truncated texts, or -1 if one fails to tokenize
+ */
+static int tokenize_for_embedding(const char* const* texts, int n_texts, int max_tokens,
+                                  std::vector<std::vector<llama_token>>& out) {
+    const llama_vocab* vocab = llama_model_get_vocab(g_model);
+    int n_truncated = 0;
+    out.assign(n_texts, {});
+    for (int i = 0; i < n_texts; i++) {
+        const char* text = texts[i] ? texts[i] : "";
+        const int n = -llama_tokenize(vocab, text, strlen(text), nullptr, 0, true, true);
+        out[i].resize(std::max(n, 0));
+        if (n > 0 && llama_tokenize(vocab, text, strlen(text), out[i].data(), n, true, true) < 0) return -1;
+        if (out[i].empty()) out[i].push_back(llama_vocab_bos(vocab));
+        if ((int) out[i].size() > max_tokens) {
+            out[i].resize(max_tokens);
+            n_truncated++;
+        }
+    }
+    return n_truncated;
+}
+
+/**
+ * Embed every text, packing up to batch_size of them per batch as separate
+ * sequences, and write the L2-normalized vectors to out (n_texts x n_embd,
+ * row-major) straight from llama's pooled output. Caller holds the engine lock.
+ * Returns: false on decode failure or abort
+ */
+static bool embed_tokenized(llama_context* ctx, const std::vector<std::vector<llama_token>>& texts,
+                            int batch_size, float* out, EmbeddingRun& run) {
+    const int n_embd = llama_model_n_embd(g_model);
+    const int n_batch_tokens = (int) llama_n_batch(ctx);
+    batch_size = std::min(std::max(batch_size, 1), (int) llama_n_seq_max(ctx));
+    const bool encoder_only = llama_model_has_encoder(g_model) && !llama_model_has_decoder(g_model);
+    llama_batch batch = llama_batch_init(n_batch_tokens, 0, 1);
+    run = EmbeddingRun();
+    bool ok = true;
+    const int64_t t_start = now_us();
+
+    for (size_t next = 0; next < texts.size() && ok;) {
+        const size_t first = next;
+        batch.n_tokens = 0;
+        while (next < texts.size() && (int) (next - first) < batch_size &&
+               batch.n_tokens + (int) texts[next].size() <= n_batch_tokens) {
+            const int seq = (int) (next - first);
+            for (size_t p = 0; p < texts[next].size(); p++) {
+                const int i = batch.n_tokens++;
+                batch.token[i] = texts[next][p];
+                batch.pos[i] = (llama_pos) p;
+                batch.n_seq_id[i] = 1;
+                batch.seq_id[i][0] = seq;
+                batch.logits[i] = true;
+            }
+            next++;
+        }
+
+        llama_memory_clear(llama_get_memory(ctx), true);
+        if ((encoder_only ? llama_encode(ctx, batch) : llama_decode(ctx, batch)) != 0) {
+            ok = false;
+            break;
+        }
+        for (size_t t = first; t < next; t++) {
+            const float* embd = llama_get_embeddings_seq(ctx, (llama_seq_id) (t - first));
+            if (!embd) {
+                ok = false;
+                break;
+            }
+            double norm = 0.0;
+            for (int j = 0; j < n_embd; j++) norm += (double) embd[j] * embd[j];
+            const float scale = norm > 0.0 ? (float) (1.0 / std::sqrt(norm)) : 0.0f;
+            float* row = out + t * n_embd;
+            for (int j = 0; j < n_embd; j++) row[j] = embd[j] * scale;
+        }
+        run.n_tokens += batch.n_tokens;
+        run.n_batches++;
+    }
+    run.elapsed_us = now_us() - t_start;
+    llama_batch_free(batch);
+    return ok;
+}
+
+/**
+ * JSON fields of an embedding run: "batch_size","batches","texts_per_s","tokens_per_s","elapsed_ms"
+ */
+static std::string embedding_run_json(int batch_size, size_t n_texts, const EmbeddingRun& run) {
+    const double seconds = run.elapsed_us / 1e6;
+    char buf[192];
+    snprintf(buf, sizeof(buf),
+             "\"batch_size\":%d,\"batches\":%d,\"texts_per_s\":%.2f,\"tokens_per_s\":%.2f,\"elapsed_ms\":%.3f",
+             batch_size, run.n_batches, seconds > 0 ? n_texts / seconds : 0.0,
+             seconds > 0 ? run.n_tokens / seconds : 0.0, run.elapsed_us / 1000.0);
+    return buf;
+}
+
+/**
+ * Dimension of the vectors run_embeddings writes (0 if no model is loaded) - FFI version for Dart
+ */
+int32_t get_embedding_dim() {
+    return g_embedding_dim.load();
+}
+
+/**
+ * Embed n_texts texts with the loaded model - FFI version for Dart.
+ * pooling: -1 = the model's own (mean for models without one), 1 = mean, 2 = cls, 3 = last.
+ * Up to batch_size texts (at most 64) share a batch as separate sequences; a text
+ * longer than one batch (2048 tokens, or the training context) is truncated.
+ * out: out_capacity floats, filled with n_texts x n_embd L2-normalized vectors
+ * in input order; the caller owns it and keeps it alive until this returns. The
+ * run fails without writing if the loaded model's vectors don't fit, as when a
+ * load queued ahead changed the model after the caller sized out.
+ * Returns: JSON {"status","n_embd","pooling","texts","tokens","truncated","batch_size",
+ * "batches","texts_per_s","tokens_per_s","elapsed_ms"}; out is only complete
+ * when status is "ok". Valid until the next call.
+ */
+const char* run_embeddings(const char* const* texts, int32_t n_texts, int32_t pooling, int32_t batch_size,
+                           float* out, int64_t out_capacity) {
+    static std::string report;
+    std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+    CommandScope command;
+    CancelLatencyRecorder cancel_latency;
+
+    auto error_report = [](const char* status, const std::string& error) {
+        report = std::string("{\"status\":\"") + status + "\",\"error\":\"" + json_escape(error) + "\"}";
+        return report.c_str();
+    };
+    if (g_shutdown_requested) return error_report("cancelled", "engine shutting down");
+    if (!g_is_loaded || !g_model) return error_report("error", "model not loaded");
+    if (!texts || n_texts <= 0 || !out) return error_report("error", "invalid arguments");
+    if ((int64_t) n_texts * llama_model_n_embd(g_model) > out_capacity) {
+        return error_report("error", "output buffer too small for the loaded model's n_embd");
+    }
+
+    std::string error;
+    llama_context* ctx = embedding_context(pooling, error);
+    if (!ctx) return error_report("error", error);
+    std::vector<std::vector<llama_token>> tokenized;
+    const int n_truncated = tokenize_for_embedding(texts, n_texts, (int) llama_n_batch(ctx), tokenized);
+    if (n_truncated < 0) return error_report("error", "failed to tokenize text");
+
+    EmbeddingRun run;
+    if (!embed_tokenized(ctx, tokenized, batch_size, out, run)) {
+        return stop_requested() ? error_report("cancelled", "stopped") : error_report("error", "embedding failed");
+    }
+    char buf[160];
+    snprintf(buf, sizeof(buf),
+             "{\"status\":\"ok\",\"n_embd\":%d,\"pooling\":\"%s\",\"texts\":%d,\"tokens\":%lld,\"truncated\":%d,",
+             llama_model_n_embd(g_model), pooling_name(llama_pooling_type(ctx)), n_texts,
+             (long long) run.n_tokens, n_truncated);
+    report = buf + embedding_run_json(std::min<int>(std::max(batch_size, 1), kEmbeddingMaxSeq), tokenized.size(), run) + "}";
+    return report.c_str();
+}
+
+/**
+ * Embedding throughput of the loaded model on texts at batch sizes 1, 2, 4, …
+ * up to max_batch (at most 64) - FFI version for Dart. One untimed pass at the
+ * largest batch size warms the weights first; vectors go to a scratch buffer
+ * and are normalized as in run_embeddings.
+ * Returns: JSON {"status","n_embd","pooling","texts","tokens","levels":[{"batch_size",
+ * "batches","texts_per_s","tokens_per_s","elapsed_ms"}]}. Valid until the next call.
+ */
+const char* run_embedding_benchmark(const char* const* texts, int32_t n_texts, int32_t pooling, int32_t max_batch) {
+    static std::string report;
+    std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+    CommandScope command;
+    CancelLatencyRecorder cancel_latency;
+
+    auto error_report = [](const char* status, const std::string& error) {
+        report = std::string("{\"status\":\"") + status + "\",\"error\":\"" + json_escape(error) + "\"}";
+        return report.c_str();
+    };
+    if (g_shutdown_requested) return error_report("cancelled", "engine shutting down");
+    if (!g_is_loaded || !g_model) return error_report("error", "model not loaded");
+    if (!texts || n_texts <= 0 || max_batch <= 0) return error_report("error", "invalid arguments");
+    max_batch = std::min<int32_t>(max_batch, kEmbeddingMaxSeq);
+
+    std::string error;
+    llama_context* ctx = embedding_context(pooling, error);
+    if (!ctx) return error_report("error", error);
+    std::vector<std::vector<llama_token>> tokenized;
+    if (tokenize_for_embedding(texts, n_texts, (int) llama_n_batch(ctx), tokenized) < 0) {
+        return error_report("error", "failed to tokenize text");
+    }
+    std::vector<float> scratch((size_t) n_texts * llama_model_n_embd(g_model));
+
+    std::vector<int> batch_sizes;
+    for (int size = 1; size < max_batch; size *= 2) batch_sizes.push_back(size);
+    batch_sizes.push_back(max_batch);
+
+    EmbeddingRun run;
+    if (!embed_tokenized(ctx, tokenized, max_batch, scratch.data(), run)) {
+        return stop_requested() ? error_report("cancelled", "stopped") : error_report("error", "embedding failed");
+    }
+    const int64_t n_tokens = run.n_tokens;
+    std::string levels;
+    for (const int size : batch_sizes) {
+        if (!embed_tokenized(ctx, tokenized, size, scratch.data(), run)) {
+            return stop_requested() ? error_report("cancelled", "stopped") : error_report("error", "embedding failed");
+        }
+        levels += (levels.empty() ? "{" : ",{") + embedding_run_json(size, tokenized.size(), run) + "}";
+        LOGI("FFI: Embeddings at batch %d: %.1f texts/s", size, tokenized.size() * 1e6 / std::max<int64_t>(run.elapsed_us, 1));
+    }
+
+    char buf[160];
+    snprintf(buf, sizeof(buf),
+             "{\"status\":\"ok\",\"n_embd\":%d,\"pooling\":\"%s\",\"texts\":%d,\"tokens\":%lld,",
+             llama_model_n_embd(g_model), pooling_name(llama_pooling_type(ctx)), n_texts, (long long) n_tokens);
+    report = std::string(buf) + "\"levels\":[" + levels + "]}";
+    return report.c_str();
+}
+
+// Cap on the logits buffer of a perplexity batch (n_outputs x n_vocab floats)
+static constexpr size_t kPerplexityLogitsBudget = 128u << 20;
+
+/**
+ * Add -log p(next) of one scored position to the running sums (log-softmax in double)
+ */
+static void accumulate_nll(const float* logits, int n_vocab, llama_token next, double& nll, double& nll2) {
+    const float max_logit = *std::max_element(logits, logits + n_vocab);
+    double sum_exp = 0.0;
+    for (int i = 0; i < n_vocab; i++) sum_exp += std::exp((double) logits[i] - max_logit);
+    const double token_nll = std::log(sum_exp) - ((double) logits[next] - max_logit);
+    nll += token_nll;
+    nll2 += token_nll * token_nll;
+}
+
+/**
+ * Perplexity of the loaded model on text, with its current engine config - FFI
+ * version for Dart. The text is split into chunks of n_ctx tokens (<= 0: 512);
+ * each chunk starts with BOS if the model uses one, and only its second half is
+ * scored, so every prediction has at least n_ctx/2 tokens of context (as in
+ * llama.cpp's perplexity tool). n_seq chunks are evaluated together as parallel
+ * sequences of one context, interleaved in batches that request logits for every
+ * scored position. At most max_chunks chunks are used (<= 0: all).
+ * Returns: JSON {"status","n_ctx","n_seq","n_batch","chunks","tokens_scored",
+ * "perplexity","ppl_stderr","nll","eval_tps","elapsed_s","chunk_ppl":[..],"config":{..}};
+ * eval_tps counts every token decoded over the time spent in llama_decode.
+ * Valid until the next call.
+ */
+const char* run_perplexity(const char* text, int32_t n_ctx, int32_t n_seq, int32_t max_chunks) {
+    static std::string report;
+    std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+    CommandScope command;
+    CancelLatencyRecorder cancel_latency;
+
+    auto error_report = [](const char* status, const char* error) {
+        report = std::string("{\"status\":\"") + status + "\",\"error\":\"" + error + "\"}";
+        return report.c_str();
+    };
+    if (g_shutdown_requested) return error_report("cancelled", "engine shutting down");
+    if (!g_is_loaded || !g_model || !g_ctx) return error_report("error", "model not loaded");
+    if (!text) return error_report("error", "invalid arguments");
+
+    const llama_vocab* vocab = llama_model_get_vocab(g_model);
+    const int n_text = -llama_tokenize(vocab, text, strlen(text), nullptr, 0, false, false);
+    std::vector<llama_token> tokens(std::max(n_text, 0));
+    if (n_text <= 0 || llama_tokenize(vocab, text, strlen(text), tokens.data(), tokens.size(), false, false) < 0) {
+        return error_report("error", "failed to tokenize text");
+    }
+
+    // Same KV types, flash attention and threads as the speed runs; only the shape differs
+    EngineConfig cfg = g_requested_config;
+    cfg.n_ctx = n_ctx > 0 ? n_ctx : 512;
+    llama_context_params params = engine_config_context_params(cfg, g_model);
+    n_ctx = cfg.n_ctx;
+    int n_chunks = (int) tokens.size() / n_ctx;
+    if (max_chunks > 0) n_chunks = std::min(n_chunks, (int) max_chunks);
+    if (n_chunks < 1) return error_report("error", "text is shorter than one chunk");
+    n_seq = std::min(std::max(n_seq, 1), n_chunks);
+
+    // Interleave `step` positions of every sequence per batch, bounded by the logits budget
+    const int n_vocab = llama_vocab_n_tokens(vocab);
+    const int max_outputs = (int) std::max<size_t>(n_seq, kPerplexityLogitsBudget / ((size_t) n_vocab * sizeof(float)));
+    const int step = std::max(1, std::min(n_ctx, max_outputs / n_seq));
+    const int n_batch = step * n_seq;
+    params.n_ctx = (uint32_t) (n_ctx * n_seq);
+    params.n_batch = (uint32_t) n_batch;
+    params.n_ubatch = (uint32_t) std::min(n_batch, std::max(cfg.n_ubatch, 512));
+    params.n_seq_max = (uint32_t) n_seq;
+
+    llama_context* ctx = llama_init_from_model(g_model, params);
+    if (!ctx) return error_report("error", "failed to create perplexity context");
+    llama_set_abort_callback(ctx, engine_abort_callback, nullptr);
+    engine_config_read_back(cfg, ctx);
+    cfg.n_ctx = n_ctx; // Per sequence
+    llama_batch batch = llama_batch_init(n_batch, 0, 1);
+
+    const bool add_bos = llama_vocab_get_add_bos(vocab);
+    const int first = n_ctx / 2;
+    double nll = 0.0, nll2 = 0.0, decode_us = 0.0;
+    int64_t n_scored = 0, n_decoded = 0;
+    std::vector<double> chunk_ppl;
+    const char* failure = nullptr;
+    const int64_t t_start = now_us();
+
+    for (int chunk0 = 0; chunk0 < n_chunks && !failure; chunk0 += n_seq) {
+        const int n_group = std::min(n_seq, n_chunks - chunk0);
+        std::vector<double> group_nll(n_group, 0.0);
+        llama_memory_clear(llama_get_memory(ctx), true);
+
+        for (int pos0 = 0; pos0 < n_ctx && !failure; pos0 += step) {
+            const int n_pos = std::min(step, n_ctx - pos0);
+            batch.n_tokens = 0;
+            for (int s = 0; s < n_group; s++) {
+                const llama_token* chunk = tokens.data() + (size_t) (chunk0 + s) * n_ctx;
+                for (int p = pos0; p < pos0 + n_pos; p++) {
+                    const int i = batch.n_tokens++;
+                    batch.token[i] = (p == 0 && add_bos) ? llama_vocab_bos(vocab) : chunk[p];
+                    batch.pos[i] = p;
+                    batch.n_seq_id[i] = 1;
+                    batch.seq_id[i][0] = s;
+                    batch.logits[i] = p >= first && p < n_ctx - 1;
+                }
+            }
+
+            const int64_t t_decode = now_us();
+            const int32_t rc = llama_decode(ctx, batch);
+            decode_us += now_us() - t_decode;
+            if (rc != 0) {
+                failure = stop_requested() ? "cancelled" : "decode failed";
+                break;
+            }
+            n_decoded += batch.n_tokens;
+
+            for (int i = 0; i < batch.n_tokens; i++) {
+                if (!batch.logits[i]) continue;
+                const int s = batch.seq_id[i][0];
+                const llama_token next = tokens[(size_t) (chunk0 + s) * n_ctx + batch.pos[i] + 1];
+                double seq_nll2 = 0.0;
+                accumulate_nll(llama_get_logits_ith(ctx, i), n_vocab, next, group_nll[s], seq_nll2);
+                nll2 += seq_nll2;
+                n_scored++;
+            }
+        }
+        if (failure) break;
+        for (int s = 0; s < n_group; s++) {
+            nll += group_nll[s];
+            chunk_ppl.push_back(std::exp(group_nll[s] / (n_ctx - 1 - first)));
+        }
+        LOGI("FFI: Perplexity chunks %d-%d/%d: running ppl %.4f", chunk0 + 1, chunk0 + n_group, n_chunks,
+             std::exp(nll / (double) n_scored));
+    }
+    const double elapsed_s = (now_us() - t_start) / 1e6;
+
+    llama_batch_free(batch);
+    llama_free(ctx);
+    if (failure) return error_report(strcmp(failure, "cancelled") == 0 ? "cancelled" : "error", failure);
+
+    const double mean_nll = nll / (double) n_scored;
+    const double var_nll = std::max(0.0, nll2 / (double) n_scored - mean_nll * mean_nll);
+    const double ppl = std::exp(mean_nll);
+    // Delta method: stderr of exp(mean) is exp(mean) * stderr of the mean
+    const double ppl_stderr = n_scored > 1 ? ppl * std::sqrt(var_nll / (double) (n_scored - 1)) : 0.0;
+    const double eval_tps = decode_us > 0 ? n_decoded * 1e6 / decode_us : 0.0;
+
+    std::string chunks_json = "[";
+    char buf[320];
+    for (size_t i = 0; i < chunk_ppl.size(); i++) {
+        snprintf(buf, sizeof(buf), "%s%.4f", i > 0 ? "," : "", chunk_ppl[i]);
+        chunks_json += buf;
+    }
+    chunks_json += "]";
+    snprintf(buf, sizeof(buf),
+             "{\"status\":\"ok\",\"n_ctx\":%d,\"n_seq\":%d,\"n_batch\":%d,\"chunks\":%d,"
+             "\"tokens_scored\":%lld,\"perplexity\":%.4f,\"ppl_stderr\":%.4f,\"nll\":%.6f,"
+             "\"eval_tps\":%.2f,\"elapsed_s\":%.3f,",
+             n_ctx, n_seq, n_batch, n_chunks, (long long) n_scored, ppl, ppl_stderr, mean_nll,
+             eval_tps, elapsed_s);
+    report = std::string(buf) + "\"chunk_ppl\":" + chunks_json + ",\"config\":" + engine_config_json(cfg) + "}";
+    LOGI("FFI: Perplexity %.4f +/- %.4f over %lld tokens (%d x %d, %d parallel), eval %.1f t/s",
+         ppl, ppl_stderr, (long long) n_scored, n_chunks, n_ctx, n_seq, eval_tps);
+    return report.c_str();
+}
+
+/**
+ * Dispose model - FFI version for Dart
+ */
+void dispose_model() {
+    LOGI("FFI: Disposing model");
+    // Blocks until any in-flight run has returned, so nothing is freed while in use
+    std::lock_guard<std::timed_mutex> lock(g_engine_mutex);
+    
+    free_embedding_context();
+    if (g_ctx) {
+        llama_free(g_ctx);
+        g_ctx = nullptr;
+    }
+    g_threadpool.release();
+    
+    if (g_model) {
+        llama_model_free(g_model);
+        g_model = nullptr;
+    }
+    
+    llama_backend_free();
+    release_model_fd();
+    g_is_loaded = false;
+    g_session_key_valid = false;
+    g_session_pending = PendingSessionSave();
+    g_loaded_buffer_bytes = 0;
+    g_token_callback = nullptr;
+    {
+        std::lock_guard<std::mutex> huge_lock(g_huge_page_mutex);
+        g_huge_page_advice = HugePageAdvice();
+    }
+    g_decode_weight_bytes = 0;
+    g_kv_bytes_per_position = 0;
+    g_embedding_dim = 0;
+    std::lock_guard<std::mutex> config_lock(g_config_json_mutex);
+    g_engine_config_json.clear();
+}
+
+/**
+ * Set token callback - FFI version for Dart
+ */
+void set_token_callback(TokenCallback callback) {
+    LOGI("FFI: Setting token callback");
+    g_token_callback = callback;
+}
+
+/**
+ * Get generated text - FFI version for Dart
+ * Returns: pointer to generated text string
+ */
+const char* get_generated_text() {
+    return g_generated_text.c_str();
+}
+
+/**
+ * Stop the running command - FFI version for Dart
+ */
+void stop_inference() {
+    g_stop_requested_us = now_us();
+    g_last_cancel_latency_us = -1; // Set again only if this stop cancels a command
+    g_stop_generation++;
+    std::lock_guard<std::mutex> lock(g_pause_mutex);
+    g_paused = false;
+    g_pause_cv.notify_all();
+}
+
+/**
+ * Returns: the stop generation, which every stop_inference() advances
+ */
+uint64_t engine_stop_generation() {
+    return g_stop_generation.load();
+}
+
+/**
+ * Make the commands this thread calls until engine_end_queued_command() stop
+ * relative to generation, the stop generation when they were queued
+ */
+void engine_begin_queued_command(uint64_t generation) {
+    t_queued_command = true;
+    t_queued_generation = generation;
+}
+
+void engine_end_queued_command() {
+    t_queued_command = false;
+}
+
+/**
+ * Hold the engine mutex for native work outside the engine worker, so it never
+ * overlaps a load, run or dispose (e.g. the quant comparison). Blocks until the
+ * engine is idle; release with engine_unlock()
+ */
+void engine_lock() {
+    g_engine_mutex.lock();
+}
+
+void engine_unlock() {
+    g_engine_mutex.unlock();
+}
+
+/**
+ * Pause generation before the next token - FFI version for Dart
+ */
+void pause_inference() {
+    std::lock_guard<std::mutex> lock(g_pause_mutex);
+    g_paused = true;
+}
+
+/**
+ * Resume a paused generation - FFI version for Dart
+ */
+void resume_inference() {
+    std::lock_guard<std::mutex> lock(g_pause_mutex);
+    g_paused = false;
+    g_pause_cv.notify_all();
+}
+
+/**
+ * Stop any in-flight work, refuse new runs until the next load, and wait for the
+ * engine to go idle. After a successful return dispose_model() won't block.
+ * Returns: cancel-to-idle latency in microseconds, or -1 if the engine was still
+ * busy after timeout_ms
+ */
+int64_t request_engine_shutdown(int32_t timeout_ms) {
+    g_shutdown_requested = true;
+    stop_inference();
+    const int64_t t_stop = g_stop_requested_us;
+
+    if (!g_engine_mutex.try_lock_for(std::chrono::milliseconds(timeout_ms))) {
+        LOGE("FFI: Engine still busy %d ms after shutdown request", timeout_ms);
+        return -1;
+    }
+    const int64_t latency_us = now_us() - t_stop;
+    g_engine_mutex.unlock();
+
+    LOGI("FFI: Engine idle %lld us after shutdown request", (long long) latency_us);
+    return latency_us;
+}
+
+/**
+ * Enable/disable hardware counters for the following run_inference calls - FFI version for Dart
+ */
+void set_perf_counters_enabled(int32_t enabled) {
+    g_perf_enabled = enabled != 0;
+}
+
+/**
+ * Enable/disable measuring the battery energy of run_benchmark_repetitions'
+ * measured passes, reading the power-supply tree under sysfs_root (nullptr or
+ * "" = /sys/class/power_supply; another root allows a fake tree for testing)
+ * Returns: 0, or -1 if enabling found no battery with a usable attribute there
+ */
+int32_t set_power_telemetry(int32_t enabled, const char* sysfs_root) {
+    std::lock_guard<std::mutex> lock(g_power_mutex);
+    g_power_enabled = enabled != 0;
+    g_power_root = sysfs_root ? sysfs_root : "";
+    if (!g_power_enabled) return 0;
+    PowerSampler probe;
+    std::string error;
+    if (!probe.open(g_power_root, error)) {
+        LOGE("FFI: Power telemetry: %s", error.c_str());
+        return -1;
+    }
+    LOGI("FFI: Power telemetry from %s", probe.supply().c_str());
+    return 0;
+}
+
+/**
+ * Returns: JSON counter report of the last run with counters enabled (see
+ * perf_counters.h), or "" if there is none. Valid until the next call.
+ */
+const char* get_perf_counter_report() {
+    static std::string report;
+    std::lock_guard<std::mutex> lock(g_perf_report_mutex);
+    report = g_perf_report;
+    return report.c_str();
+}
+
+/**
+ * Measure STREAM copy/scale/triad bandwidth single-threaded and on n_threads
+ * threads (<= 0: all online CPUs) - FFI version for Dart. Takes a few seconds
+ * and allocates 3 arrays past the last-level cache; run it while the engine is idle.
+ * Returns: JSON as in bandwidth_probe.h, or "" if the arrays could not be
+ * allocated. Valid until the next call.
+ */
+const char* run_bandwidth_probe(int32_t n_threads) {
+    static std::string report;
+    BandwidthReport result;
+    report = measure_memory_bandwidth(n_threads, 5, result) ? bandwidth_report_json(result) : "";
+    return report.c_str();
+}
+
+/**
+ * Bytes one batch-1 decode step of the loaded model reads with n_past positions
+ * in the KV cache: all weights plus the K/V rows of every layer. The weight
+ * figure includes the token embedding table, of which a step only reads one
+ * row, so this slightly overstates the traffic of models with an untied output.
+ * Returns: bytes, or 0 if no model is loaded
+ */
+int64_t get_decode_bytes_per_token(int32_t n_past) {
+    const int64_t weights = g_decode_weight_bytes;
+    if (weights <= 0) return 0;
+    return weights + g_kv_bytes_per_position * std::max<int32_t>(n_past, 0);
+}
+
+/**
+ * Returns: stop-to-idle latency in microseconds of the command the last stop
+ * cancelled, -1 if it found nothing running
+ */
+int64_t get_last_cancel_latency_us() {
+    return g_last_cancel_latency_us;
 }
 
 } // extern "C"
@@ -0,0 +1,184 @@
+#include "perf_counters.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "native_common.h"
+
+namespace {
+
+struct PerfEventSpec {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr uint64_t kLlcReadMiss = PERF_COUNT_HW_CACHE_LL |
+                                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+const PerfEventSpec kPerfEvents[kNumPerfCounters] = {
+    {"cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"llc_misses",    PERF_TYPE_HW_CACHE, kLlcReadMiss},
+    {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"task_clock",    PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+};
+
+int open_event(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1; // Required from perf_event_paranoid 2 on
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+#ifdef SYS_perf_event_open
+    return (int) syscall(SYS_perf_event_open, &attr, 0 /* this process */, -1 /* any cpu */, -1, PERF_FLAG_FD_CLOEXEC);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+int read_paranoid_level() {
+    FILE* f = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+    if (!f) return -100;
+    int level = -100;
+    if (fscanf(f, "%d", &level) != 1) level = -100;
+    fclose(f);
+    return level;
+}
+
+} // namespace
+
+PerfCounters::~PerfCounters() {
+    close();
+}
+
+bool PerfCounters::open() {
+    close();
+    int first_errno = 0;
+    for (int i = 0; i < kNumPerfCounters; i++) {
+        fds_[i] = open_event(kPerfEvents[i].type, kPerfEvents[i].config);
+        if (fds_[i] < 0 && i == kPerfLlcMisses) {
+            // Many ARM PMUs don't expose a generic LLC event; use the generic cache-miss count
+            fds_[i] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        }
+        if (fds_[i] < 0) {
+            if (!first_errno) first_errno = errno;
+            continue;
+        }
+        ioctl(fds_[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds_[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    if (first_errno) {
+        char buf[160];
+        const int paranoid = read_paranoid_level();
+        if (paranoid > -100) {
+            snprintf(buf, sizeof(buf), "%s (perf_event_paranoid=%d)", strerror(first_errno), paranoid);
+        } else {
+            snprintf(buf, sizeof(buf), "%s (perf_event_paranoid unreadable)", strerror(first_errno));
+        }
+        reason_ = buf;
+        LOGI("PERF: Some counters unavailable: %s", reason_.c_str());
+    }
+    return any_available();
+}
+
+void PerfCounters::close() {
+    for (int& fd : fds_) {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+    reason_.clear();
+}
+
+bool PerfCounters::any_available() const {
+    for (const int fd : fds_) {
+        if (fd >= 0) return true;
+    }
+    return false;
+}
+
+bool PerfCounters::read(PerfSample& out) const {
+    bool any = false;
+    for (int i = 0; i < kNumPerfCounters; i++) {
+        out.values[i] = 0;
+        if (fds_[i] < 0) continue;
+
+        uint64_t data[3]; // value, time_enabled, time_running
+        if (::read(fds_[i], data, sizeof(data)) != (ssize_t) sizeof(data)) continue;
+        if (data[2] > 0 && data[2] < data[1]) {
+            out.values[i] = (uint64_t) ((double) data[0] * data[1] / data[2]);
+        } else {
+            out.values[i] = data[0];
+        }
+        any = true;
+    }
+    return any;
+}
+
+PerfSample perf_delta(const PerfSample& a, const PerfSample& b) {
+    PerfSample d;
+    for (int i = 0; i < kNumPerfCounters; i++) {
+        d.values[i] = b.values[i] >= a.values[i] ? b.values[i] - a.values[i] : 0;
+    }
+    return d;
+}
+
+std::string perf_report_json(const PerfCounters& counters, const PerfRunStats& run) {
+    std::string json = "{\"available\":";
+    json += counters.any_available() ? "true" : "false";
+    json += ",\"reason\":\"" + json_escape(counters.unavailable_reason()) + "\",\"counters\":{";
+    for (int i = 0; i < kNumPerfCounters; i++) {
+        json += std::string(i > 0 ? "," : "") + "\"" + kPerfEvents[i].name + "\":" +
+                (counters.available((PerfCounterId) i) ? "true" : "false");
+    }
+    json += "}";
+
+    PerfSample total;
+    for (const PerfSample& s : run.steps) {
+        for (int i = 0; i < kNumPerfCounters; i++) total.values[i] += s.values[i];
+    }
+    const double n = run.steps.empty() ? 1.0 : (double) run.steps.size();
+    auto ipc = [](const PerfSample& s) {
+        return s.values[kPerfCycles] > 0 ? (double) s.values[kPerfInstructions] / s.values[kPerfCycles] : 0.0;
+    };
+
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             ",\"tokens\":%zu,\"ipc\":%.3f,\"instructions_per_token\":%.0f,\"cycles_per_token\":%.0f,"
+             "\"llc_misses_per_token\":%.1f,\"branch_misses_per_token\":%.1f,\"task_clock_ms_per_token\":%.3f,"
+             "\"prefill\":{\"ipc\":%.3f,\"llc_misses\":%llu,\"branch_misses\":%llu,\"task_clock_ms\":%.3f}",
+             run.steps.size(), ipc(total),
+             total.values[kPerfInstructions] / n, total.values[kPerfCycles] / n,
+             total.values[kPerfLlcMisses] / n, total.values[kPerfBranchMisses] / n,
+             total.values[kPerfTaskClockNs] / n / 1e6,
+             ipc(run.prefill),
+             (unsigned long long) run.prefill.values[kPerfLlcMisses],
+             (unsigned long long) run.prefill.values[kPerfBranchMisses],
+             run.prefill.values[kPerfTaskClockNs] / 1e6);
+    json += buf;
+
+    json += ",\"step_ipc\":[";
+    for (size_t i = 0; i < run.steps.size(); i++) {
+        snprintf(buf, sizeof(buf), "%s%.3f", i > 0 ? "," : "", ipc(run.steps[i]));
+        json += buf;
+    }
+    json += "],\"step_llc_misses\":[";
+    for (size_t i = 0; i < run.steps.size(); i++) {
+        json += (i > 0 ? "," : "") + std::to_string(run.steps[i].values[kPerfLlcMisses]);
+    }
+    json += "]}";
+    return json;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+// Optional hardware performance counters (perf_event_open) around llama_decode.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum PerfCounterId {
+    kPerfCycles = 0,
+    kPerfInstructions,
+    kPerfLlcMisses,
+    kPerfBranchMisses,
+    kPerfTaskClockNs,
+    kNumPerfCounters,
+};
+
+struct PerfSample {
+    uint64_t values[kNumPerfCounters] = {};
+};
+
+/**
+ * Counters for the calling thread and every thread it creates afterwards
+ * (inherit), which covers ggml's compute threads.
+ *
+ * Inherited counts are folded into the parent's counter when a child thread
+ * exits; ggml's per-graph workers exit after every llama_decode, so a read right
+ * after decode includes them. Threads that outlive the decode are never folded
+ * in, so the counts cover only the calling thread when ggml runs graphs on
+ * OpenMP's pooled threads (hence GGML_OPENMP OFF in CMakeLists.txt) or on a
+ * persistent threadpool (counted runs detach it).
+ *
+ * Each counter is opened on its own and is optional: PMUs without an LLC event,
+ * perf_event_paranoid restrictions and seccomp'd containers just leave the
+ * affected counters unavailable. Multiplexed counters are scaled by
+ * time_enabled / time_running.
+ */
+class PerfCounters {
+public:
+    PerfCounters() = default;
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * Open and enable the counters. Call before the inference threads are created.
+     * Returns: false if none could be opened (see unavailable_reason())
+     */
+    bool open();
+    void close();
+
+    /**
+     * Read all counters; unavailable ones read as 0
+     */
+    bool read(PerfSample& out) const;
+
+    bool available(PerfCounterId id) const { return fds_[id] >= 0; }
+    bool any_available() const;
+    const std::string& unavailable_reason() const { return reason_; }
+
+private:
+    int fds_[kNumPerfCounters] = {-1, -1, -1, -1, -1};
+    std::string reason_;
+};
+
+/**
+ * Per-step deltas of one inference run: prefill plus one sample per decoded token
+ */
+struct PerfRunStats {
+    PerfSample prefill;
+    std::vector<PerfSample> steps;
+};
+
+/**
+ * JSON report: availability, per-token averages (IPC, LLC/branch misses per
+ * token, task-clock ms per token) and per-step IPC/LLC-miss series
+ */
+std::string perf_report_json(const PerfCounters& counters, const PerfRunStats& run);
+
+/**
+ * b - a, counter by counter
+ */
+PerfSample perf_delta(const PerfSample& a, const PerfSample& b);
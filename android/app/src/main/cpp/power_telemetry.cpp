@@ -0,0 +1,226 @@
+#include "power_telemetry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <dirent.h>
+
+#include "native_common.h"
+
+namespace {
+
+constexpr double kJoulesPerMicrowattHour = 3.6e-3;
+
+bool read_text(const std::string& path, std::string& out) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return false;
+    char buf[64];
+    const bool ok = fgets(buf, sizeof(buf), f) != nullptr;
+    fclose(f);
+    if (!ok) return false;
+    out = buf;
+    while (!out.empty() && (out.back() == '\n' || out.back() == ' ')) out.pop_back();
+    return true;
+}
+
+/**
+ * Returns: the attribute's value, or NaN if it's missing or not a number
+ */
+double read_attr(const std::string& dir, const char* name) {
+    std::string text;
+    if (!read_text(dir + "/" + name, text)) return NAN;
+    char* end = nullptr;
+    const double value = strtod(text.c_str(), &end);
+    return end != text.c_str() ? value : NAN;
+}
+
+bool has(double value) {
+    return !std::isnan(value);
+}
+
+/**
+ * Trapezoidal integral of the power watts_of(sample) returns (NaN = no reading)
+ * Returns: joules, or NaN if fewer than two samples had a reading
+ */
+template <typename Sample, typename PowerFn>
+double integrate(const std::vector<Sample>& samples, PowerFn watts_of) {
+    double joules = 0.0;
+    int readings = 0;
+    int64_t prev_us = 0;
+    double prev_watts = 0.0;
+    for (const Sample& s : samples) {
+        const double watts = watts_of(s);
+        if (!has(watts)) continue;
+        if (readings++ > 0) joules += (prev_watts + watts) / 2.0 * (s.t_us - prev_us) / 1e6;
+        prev_us = s.t_us;
+        prev_watts = watts;
+    }
+    return readings >= 2 ? joules : NAN;
+}
+
+/**
+ * Returns: how often value_of changed between consecutive readings
+ */
+template <typename Sample, typename ValueFn>
+int counter_updates(const std::vector<Sample>& samples, ValueFn value_of) {
+    int updates = 0;
+    double prev = NAN;
+    for (const Sample& s : samples) {
+        const double value = value_of(s);
+        if (!has(value)) continue;
+        if (has(prev) && value != prev) updates++;
+        prev = value;
+    }
+    return updates;
+}
+
+} // namespace
+
+PowerSampler::~PowerSampler() {
+    if (thread_.joinable()) stop();
+}
+
+bool PowerSampler::open(const std::string& root, std::string& error) {
+    const std::string base = root.empty() ? kPowerSupplyRoot : root;
+    DIR* d = opendir(base.c_str());
+    if (!d) {
+        error = "cannot open " + base;
+        return false;
+    }
+    std::vector<std::string> names;
+    while (dirent* entry = readdir(d)) {
+        if (entry->d_name[0] != '.') names.push_back(entry->d_name);
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+
+    for (const std::string& name : names) {
+        const std::string dir = base + "/" + name;
+        std::string type;
+        if (!read_text(dir + "/type", type) || type != "Battery") continue;
+        dir_ = dir;
+        const Sample s = read_sample();
+        // Instantaneous power first: it gives a reading in any window, counters only in long ones
+        source_ = has(s.power_uw) ? "power_now"
+                  : has(s.voltage_uv) && has(s.current_ua) ? "voltage_current"
+                  : has(s.energy_uwh) ? "energy_now"
+                  : has(s.charge_uah) && has(s.voltage_uv) ? "charge_counter" : "";
+        if (!source_.empty()) return true;
+    }
+    dir_.clear();
+    error = "no battery with energy, power or voltage and current under " + base;
+    return false;
+}
+
+PowerSampler::Sample PowerSampler::read_sample() const {
+    Sample s;
+    s.t_us = now_us();
+    s.energy_uwh = read_attr(dir_, "energy_now");
+    s.charge_uah = read_attr(dir_, "charge_counter");
+    s.power_uw = read_attr(dir_, "power_now");
+    s.voltage_uv = read_attr(dir_, "voltage_now");
+    // Discharge is negative on some gauges and positive on others
+    s.current_ua = std::fabs(read_attr(dir_, "current_now"));
+    s.power_uw = std::fabs(s.power_uw);
+    return s;
+}
+
+bool PowerSampler::read_charging() const {
+    std::string status;
+    return read_text(dir_ + "/status", status) && (status == "Charging" || status == "Full");
+}
+
+void PowerSampler::start(int interval_ms) {
+    if (thread_.joinable()) stop();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        samples_.clear();
+        samples_.push_back(read_sample());
+    }
+    charging_at_start_ = read_charging();
+    stop_ = false;
+    thread_ = std::thread(&PowerSampler::run, this, std::max(1, interval_ms));
+}
+
+void PowerSampler::run(int interval_ms) {
+    while (!stop_) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        if (stop_) break;
+        const Sample s = read_sample();
+        std::lock_guard<std::mutex> lock(mutex_);
+        samples_.push_back(s);
+    }
+}
+
+PowerWindow PowerSampler::stop() {
+    stop_ = true;
+    if (thread_.joinable()) thread_.join();
+    std::vector<Sample> samples;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        samples_.push_back(read_sample());
+        samples.swap(samples_);
+    }
+
+    PowerWindow w;
+    w.samples = (int) samples.size();
+    w.seconds = (samples.back().t_us - samples.front().t_us) / 1e6;
+    w.charging = charging_at_start_ || read_charging();
+
+    const Sample& first = samples.front();
+    const Sample& last = samples.back();
+    double voltage_sum = 0.0;
+    int n_voltage = 0;
+    for (const Sample& s : samples) {
+        if (has(s.voltage_uv)) {
+            voltage_sum += s.voltage_uv;
+            n_voltage++;
+        }
+    }
+
+    double joules = NAN;
+    if (source_ == "power_now") {
+        joules = integrate(samples, [](const Sample& s) { return s.power_uw / 1e6; });
+    } else if (source_ == "voltage_current") {
+        joules = integrate(samples, [](const Sample& s) { return s.voltage_uv * s.current_ua / 1e12; });
+    } else if (source_ == "energy_now") {
+        if (first.energy_uwh > last.energy_uwh &&
+            counter_updates(samples, [](const Sample& s) { return s.energy_uwh; }) >= kMinCounterUpdates) {
+            joules = (first.energy_uwh - last.energy_uwh) * kJoulesPerMicrowattHour;
+        }
+    } else if (source_ == "charge_counter") {
+        if (first.charge_uah > last.charge_uah && n_voltage > 0 &&
+            counter_updates(samples, [](const Sample& s) { return s.charge_uah; }) >= kMinCounterUpdates) {
+            // uAh x V = uWh
+            joules = (first.charge_uah - last.charge_uah) * (voltage_sum / n_voltage / 1e6) *
+                     kJoulesPerMicrowattHour;
+        }
+    }
+    if (has(joules)) {
+        w.source = source_;
+        w.joules = joules;
+        w.avg_watts = w.seconds > 0.0 ? joules / w.seconds : 0.0;
+    }
+    return w;
+}
+
+std::string energy_report_json(const std::string& supply, const PowerWindow& baseline, const PowerWindow& run,
+                               int64_t tokens) {
+    // A net value needs an idle draw read the same way as the run
+    const bool has_baseline = !baseline.source.empty() && baseline.source == run.source;
+    const double net_joules = has_baseline ? std::max(0.0, run.joules - baseline.avg_watts * run.seconds) : 0.0;
+    const double net_watts = run.seconds > 0.0 ? net_joules / run.seconds : 0.0;
+    char buf[704];
+    snprintf(buf, sizeof(buf),
+             "{\"supply\":\"%s\",\"source\":\"%s\",\"baseline_source\":\"%s\",\"charging\":%s,"
+             "\"baseline_watts\":%.4f,\"baseline_seconds\":%.3f,\"seconds\":%.3f,\"joules\":%.4f,"
+             "\"avg_watts\":%.4f,\"net_joules\":%.4f,\"net_avg_watts\":%.4f,\"tokens\":%lld,"
+             "\"joules_per_token\":%.6f,\"tokens_per_joule\":%.4f,\"samples\":%d}",
+             json_escape(supply).c_str(), run.source.c_str(), baseline.source.c_str(),
+             run.charging || baseline.charging ? "true" : "false",
+             baseline.avg_watts, baseline.seconds, run.seconds, run.joules, run.avg_watts, net_joules, net_watts,
+             (long long) tokens, tokens > 0 ? net_joules / tokens : 0.0, net_joules > 0.0 ? tokens / net_joules : 0.0,
+             run.samples);
+    return buf;
+}
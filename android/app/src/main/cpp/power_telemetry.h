@@ -0,0 +1,113 @@
+#pragma once
+
+// Battery power from the kernel's power-supply class, for energy per token.
+//
+// Every supply under the root (/sys/class/power_supply by default) is a
+// directory of attribute files; the one with type "Battery" is sampled on a
+// background thread during a measured window. Energy comes from the first of
+// these the battery has, chosen once so that every window of a sampler (the
+// idle baseline and the run) uses the same one:
+//   power_now       instantaneous power (uW), integrated over time
+//   voltage_now x current_now   (uV, uA) integrated likewise; current signs
+//                   differ between vendors, so magnitudes are used
+//   energy_now      remaining energy (uWh), a counter: its drop is the energy used
+//   charge_counter  remaining charge (uAh) times the mean voltage_now (uV)
+// Fuel gauges update every few hundred ms to a few seconds, some counters only
+// per percent, so a counter window only counts if the counter stepped at least
+// kMinCounterUpdates times; one step over a short window would be mostly
+// quantization. While charging the battery current doesn't show the device's
+// draw, and such windows are flagged.
+//
+// The root is configurable so the reader can run against a fake tree on a
+// desktop (a directory per supply holding the attribute files above).
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr const char* kPowerSupplyRoot = "/sys/class/power_supply";
+constexpr int kMinCounterUpdates = 4;
+
+struct PowerWindow {
+    std::string source;    // Attribute the energy came from, "" if it gave no reading
+    double seconds = 0.0;
+    double joules = 0.0;
+    double avg_watts = 0.0;
+    int samples = 0;
+    bool charging = false; // At the start or end of the window
+};
+
+/**
+ * Samples the battery of a power-supply tree
+ */
+class PowerSampler {
+public:
+    PowerSampler() = default;
+    ~PowerSampler();
+
+    PowerSampler(const PowerSampler&) = delete;
+    PowerSampler& operator=(const PowerSampler&) = delete;
+
+    /**
+     * Find the battery under root ("" = kPowerSupplyRoot) and the source its
+     * windows read
+     * Returns: false with error set if there is none with a usable attribute
+     */
+    bool open(const std::string& root, std::string& error);
+
+    /**
+     * Start sampling every interval_ms on a background thread
+     */
+    void start(int interval_ms);
+
+    /**
+     * Stop sampling and integrate the window since start()
+     */
+    PowerWindow stop();
+
+    /**
+     * Battery directory, e.g. "/sys/class/power_supply/battery"
+     */
+    const std::string& supply() const { return dir_; }
+
+    /**
+     * Source every window uses: "power_now", "voltage_current", "energy_now" or "charge_counter"
+     */
+    const std::string& source() const { return source_; }
+
+private:
+    struct Sample {
+        int64_t t_us = 0;
+        double energy_uwh = NAN; // NaN: attribute missing or unreadable
+        double charge_uah = NAN;
+        double power_uw = NAN;
+        double voltage_uv = NAN;
+        double current_ua = NAN;
+    };
+
+    Sample read_sample() const;
+    bool read_charging() const;
+    void run(int interval_ms);
+
+    std::string dir_;
+    std::string source_;
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+    std::mutex mutex_; // Guards samples_
+    std::vector<Sample> samples_;
+    bool charging_at_start_ = false;
+};
+
+/**
+ * JSON of a measured window against an idle baseline: {"supply","source","baseline_source",
+ * "charging","baseline_watts","baseline_seconds","seconds","joules","avg_watts","net_joules",
+ * "net_avg_watts","tokens","joules_per_token","tokens_per_joule","samples"};
+ * net values subtract baseline_watts over the window, per-token values use them.
+ * Without a baseline reading from the run's source the net and per-token values are 0.
+ */
+std::string energy_report_json(const std::string& supply, const PowerWindow& baseline, const PowerWindow& run,
+                               int64_t tokens);
@@ -0,0 +1,372 @@
+// On-device requantization and quant-type comparison.
+//
+// Takes a local higher-precision GGUF (F16/BF16/Q8_0), produces the quant
+// variants we care about with llama_model_quantize and runs the same greedy
+// workload on each one, so the quant picked per device tier is based on data.
+// Everything runs on a background native thread; Dart polls progress and
+// fetches a JSON report when done. Each variant holds the engine mutex while it
+// is quantized and run, so it never overlaps a load or pass of the engine.
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+#include "llama.h"
+#include "cpu_variants.h"
+#include "engine_config.h"
+#include "native_common.h"
+#include "native_engine.h"
+
+namespace {
+
+struct QuantVariant {
+    const char* name;
+    llama_ftype ftype;
+};
+
+const QuantVariant kQuantVariants[] = {
+    {"Q8_0",   LLAMA_FTYPE_MOSTLY_Q8_0},
+    {"Q5_K_M", LLAMA_FTYPE_MOSTLY_Q5_K_M},
+    {"Q4_K_M", LLAMA_FTYPE_MOSTLY_Q4_K_M},
+    {"Q4_0",   LLAMA_FTYPE_MOSTLY_Q4_0},
+    {"Q2_K",   LLAMA_FTYPE_MOSTLY_Q2_K},
+};
+constexpr int kNumQuantVariants = sizeof(kQuantVariants) / sizeof(kQuantVariants[0]);
+
+struct VariantResult {
+    std::string name;
+    std::string path;
+    std::string error;
+    double file_size_mb = 0.0;
+    double quantize_ms = 0.0;
+    double load_ms = 0.0;
+    double peak_ram_mb = 0.0;
+    double prefill_tps = 0.0;
+    double decode_tps = 0.0;
+    int n_generated = 0;
+};
+
+struct ComparisonJob {
+    std::string source_path;
+    std::string output_dir;
+    std::string prompt;
+    int n_tokens = 128;
+    int n_threads = 0;
+    EngineConfig config = engine_config_defaults(); // Every variant is loaded with it
+};
+
+std::mutex g_qc_mutex;                 // Guards g_qc_results and g_qc_report
+std::atomic<bool> g_qc_running{false};
+std::atomic<bool> g_qc_cancel{false};
+std::atomic<int> g_qc_steps_done{0};   // Two steps per variant: quantize + run
+std::vector<VariantResult> g_qc_results;
+std::string g_qc_report;
+
+// Cancels and joins a comparison still running at exit, before the state it writes goes away
+struct ComparisonThread {
+    std::thread thread;
+    ~ComparisonThread() {
+        g_qc_cancel = true;
+        if (thread.joinable()) thread.join();
+    }
+};
+ComparisonThread g_qc_thread; // Last, so it is destroyed before the state the worker writes
+
+// Holds the engine mutex for one variant
+struct EngineLockScope {
+    EngineLockScope() { engine_lock(); }
+    ~EngineLockScope() { engine_unlock(); }
+    EngineLockScope(const EngineLockScope&) = delete;
+    EngineLockScope& operator=(const EngineLockScope&) = delete;
+};
+
+double file_size_mb(const std::string& path) {
+    struct stat st {};
+    if (stat(path.c_str(), &st) != 0) return 0.0;
+    return st.st_size / (1024.0 * 1024.0);
+}
+
+/**
+ * Identity of a source file: path, size and mtime, "" if it can't be stat'ed
+ */
+std::string source_stamp(const std::string& path) {
+    struct stat st {};
+    if (stat(path.c_str(), &st) != 0) return "";
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%lld %lld.%09ld ", (long long) st.st_size,
+             (long long) st.st_mtim.tv_sec, (long) st.st_mtim.tv_nsec);
+    return buf + path;
+}
+
+std::string read_stamp(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return "";
+    char buf[4096];
+    const size_t n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    return std::string(buf, n);
+}
+
+bool write_stamp(const std::string& path, const std::string& stamp) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) return false;
+    const bool ok = fwrite(stamp.data(), 1, stamp.size(), f) == stamp.size();
+    return fclose(f) == 0 && ok;
+}
+
+/**
+ * Quantize source -> variant, reusing a previous output only if the stamp written
+ * next to it (<variant>.source) matches the source's path, size and mtime.
+ * Writes to a temporary file first so an interrupted run never leaves a
+ * truncated variant that looks valid on the next attempt; the stamp is written
+ * last, so a variant without one is always quantized again.
+ */
+bool quantize_variant(const ComparisonJob& job, const QuantVariant& variant, VariantResult& out) {
+    const std::string stamp = source_stamp(job.source_path);
+    const std::string stamp_path = out.path + ".source";
+    if (stamp.empty()) {
+        out.error = "source not readable";
+        return false;
+    }
+    if (file_size_mb(out.path) > 0.0 && read_stamp(stamp_path) == stamp) {
+        LOGI("QC: Reusing existing %s", out.path.c_str());
+        return true;
+    }
+    remove(stamp_path.c_str());
+
+    const std::string tmp_path = out.path + ".tmp";
+    llama_model_quantize_params qparams = llama_model_quantize_default_params();
+    qparams.ftype = variant.ftype;
+    qparams.nthread = job.n_threads > 0 ? job.n_threads : (int) std::thread::hardware_concurrency();
+    qparams.allow_requantize = true; // Source may itself be a quantized type (e.g. Q8_0)
+
+    const int64_t t_start = now_us();
+    const uint32_t rc = llama_model_quantize(job.source_path.c_str(), tmp_path.c_str(), &qparams);
+    out.quantize_ms = (now_us() - t_start) / 1000.0;
+
+    if (rc != 0 || rename(tmp_path.c_str(), out.path.c_str()) != 0) {
+        remove(tmp_path.c_str());
+        out.error = "quantize failed (code " + std::to_string(rc) + ")";
+        return false;
+    }
+    if (!write_stamp(stamp_path, stamp)) {
+        LOGE("QC: Could not write %s, %s will be quantized again", stamp_path.c_str(), out.path.c_str());
+    }
+    return true;
+}
+
+/**
+ * Load a variant and run the shared workload: prompt prefill + greedy decode
+ */
+bool run_variant(const ComparisonJob& job, VariantResult& out) {
+    out.file_size_mb = file_size_mb(out.path);
+
+    // Peak RAM is per variant; if the kernel refuses the reset we fall back to VmHWM
+    const bool peak_reset = reset_peak_rss();
+
+    EngineConfig cfg = job.config; // Clamped per variant
+
+    const int64_t t_load = now_us();
+    llama_model* model = llama_model_load_from_file(out.path.c_str(), engine_config_model_params(cfg));
+    if (!model) {
+        out.error = "load failed";
+        return false;
+    }
+
+    llama_context* ctx = llama_init_from_model(model, engine_config_context_params(cfg, model));
+    out.load_ms = (now_us() - t_load) / 1000.0;
+    if (!ctx) {
+        llama_model_free(model);
+        out.error = "context creation failed";
+        return false;
+    }
+    llama_set_abort_callback(ctx, [](void*) { return g_qc_cancel.load(); }, nullptr);
+
+    const llama_vocab* vocab = llama_model_get_vocab(model);
+    const char* prompt = job.prompt.c_str();
+    const int n_prompt = -llama_tokenize(vocab, prompt, strlen(prompt), nullptr, 0, true, true);
+    std::vector<llama_token> tokens(n_prompt);
+    llama_tokenize(vocab, prompt, strlen(prompt), tokens.data(), tokens.size(), true, true);
+
+    auto sparams = llama_sampler_chain_default_params();
+    llama_sampler* smpl = llama_sampler_chain_init(sparams);
+    llama_sampler_chain_add(smpl, llama_sampler_init_greedy());
+
+    bool ok = true;
+    const int64_t t_prefill = now_us();
+    if (llama_decode(ctx, llama_batch_get_one(tokens.data(), n_prompt)) != 0) {
+        out.error = "prompt decode failed";
+        ok = false;
+    }
+    const int64_t prefill_us = now_us() - t_prefill;
+    if (ok && prefill_us > 0) {
+        out.prefill_tps = n_prompt * 1e6 / prefill_us;
+    }
+
+    // Fixed token count: EOG is ignored so every variant does the same amount of work
+    const int n_budget = std::min(job.n_tokens, (int) llama_n_ctx(ctx) - n_prompt - 1);
+    const int64_t t_decode = now_us();
+    for (int i = 0; ok && i < n_budget && !g_qc_cancel; i++) {
+        llama_token new_token = llama_sampler_sample(smpl, ctx, -1);
+        if (llama_decode(ctx, llama_batch_get_one(&new_token, 1)) != 0) {
+            out.error = "token decode failed";
+            ok = false;
+            break;
+        }
+        out.n_generated++;
+    }
+    const int64_t decode_us = now_us() - t_decode;
+    if (out.n_generated > 0 && decode_us > 0) {
+        out.decode_tps = out.n_generated * 1e6 / decode_us;
+    }
+
+    out.peak_ram_mb = read_proc_status_mb("VmHWM");
+    if (!peak_reset) {
+        LOGI("QC: clear_refs unavailable, peak RAM for %s includes earlier phases", out.name.c_str());
+    }
+
+    llama_sampler_free(smpl);
+    llama_free(ctx);
+    llama_model_free(model);
+    return ok;
+}
+
+std::string build_report(const ComparisonJob& job, const std::vector<VariantResult>& results,
+                         bool cancelled) {
+    std::string json = "{\"source\":\"" + json_escape(job.source_path) + "\"";
+    json += ",\"source_size_mb\":" + std::to_string(file_size_mb(job.source_path));
+    json += ",\"cancelled\":" + std::string(cancelled ? "true" : "false");
+    json += ",\"variants\":[";
+    for (size_t i = 0; i < results.size(); i++) {
+        const VariantResult& r = results[i];
+        char buf[512];
+        snprintf(buf, sizeof(buf),
+                 "{\"name\":\"%s\",\"file_size_mb\":%.2f,\"quantize_ms\":%.1f,\"load_ms\":%.1f,"
+                 "\"peak_ram_mb\":%.1f,\"prefill_tps\":%.2f,\"decode_tps\":%.2f,\"n_generated\":%d,",
+                 r.name.c_str(), r.file_size_mb, r.quantize_ms, r.load_ms,
+                 r.peak_ram_mb, r.prefill_tps, r.decode_tps, r.n_generated);
+        json += (i > 0 ? "," : "") + std::string(buf);
+        json += "\"path\":\"" + json_escape(r.path) + "\",\"error\":\"" + json_escape(r.error) + "\"}";
+    }
+    json += "]}";
+    return json;
+}
+
+void comparison_worker(ComparisonJob job) {
+    llama_backend_init();
+    cpu_backend_ensure_loaded();
+    LOGI("QC: Starting quant comparison for %s", job.source_path.c_str());
+
+    std::string base = job.source_path.substr(job.source_path.find_last_of('/') + 1);
+    if (base.size() > 5 && base.compare(base.size() - 5, 5, ".gguf") == 0) {
+        base.resize(base.size() - 5);
+    }
+
+    for (const QuantVariant& variant : kQuantVariants) {
+        if (g_qc_cancel) break;
+
+        VariantResult result;
+        result.name = variant.name;
+        result.path = job.output_dir + "/" + base + "." + variant.name + ".gguf";
+
+        {
+            // Quantizing and running load every core: neither may overlap an engine pass,
+            // and the peak RSS reset must not land inside one
+            EngineLockScope engine;
+            const bool quantized = !g_qc_cancel && quantize_variant(job, variant, result);
+            g_qc_steps_done++;
+            if (quantized && !g_qc_cancel) run_variant(job, result);
+            g_qc_steps_done++;
+        }
+
+        LOGI("QC: %s size=%.1fMB load=%.0fms peak=%.0fMB decode=%.2f t/s %s",
+             result.name.c_str(), result.file_size_mb, result.load_ms,
+             result.peak_ram_mb, result.decode_tps, result.error.c_str());
+
+        std::lock_guard<std::mutex> lock(g_qc_mutex);
+        g_qc_results.push_back(result);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(g_qc_mutex);
+        g_qc_report = build_report(job, g_qc_results, g_qc_cancel);
+    }
+    g_qc_running = false;
+    LOGI("QC: Quant comparison finished");
+}
+
+} // namespace
+
+extern "C" {
+
+/**
+ * Start a background requantization + comparison run
+ * source_path: higher-precision GGUF; output_dir: where the variants are written
+ * n_threads: quantization threads, 0 = all cores
+ * config: engine config every variant is loaded with (nullptr = defaults), copied now;
+ * pass the benchmark's so the variants compare with its runs
+ * Returns: 0 if started, -1 if a comparison is already running or args are invalid
+ */
+int32_t start_quant_comparison(const char* source_path, const char* output_dir,
+                               const char* prompt, int32_t n_tokens, int32_t n_threads,
+                               const EngineConfig* config) {
+    if (!source_path || !output_dir || !prompt || n_tokens <= 0) return -1;
+    ComparisonJob job;
+    std::string error;
+    if (!engine_config_import(config, job.config, error)) {
+        LOGE("QC: %s", error.c_str());
+        return -1;
+    }
+    if (g_qc_running.exchange(true)) {
+        LOGE("QC: Comparison already running");
+        return -1;
+    }
+    if (g_qc_thread.thread.joinable()) g_qc_thread.thread.join();
+
+    {
+        std::lock_guard<std::mutex> lock(g_qc_mutex);
+        g_qc_results.clear();
+        g_qc_report.clear();
+    }
+    g_qc_cancel = false;
+    g_qc_steps_done = 0;
+
+    job.source_path = source_path;
+    job.output_dir = output_dir;
+    job.prompt = prompt;
+    job.n_tokens = n_tokens;
+    job.n_threads = n_threads;
+    g_qc_thread.thread = std::thread(comparison_worker, std::move(job));
+    return 0;
+}
+
+/**
+ * Progress of the running comparison, 0.0 to 1.0
+ */
+double get_quant_comparison_progress() {
+    return g_qc_steps_done.load() / (2.0 * kNumQuantVariants);
+}
+
+/**
+ * Returns: JSON report of the last finished comparison, or "" while running.
+ * The pointer stays valid until the next call.
+ */
+const char* get_quant_comparison_report() {
+    static std::string report;
+    std::lock_guard<std::mutex> lock(g_qc_mutex);
+    report = g_qc_running ? std::string() : g_qc_report;
+    return report.c_str();
+}
+
+/**
+ * Cancel the running comparison; takes effect after the current quantize step
+ */
+void cancel_quant_comparison() {
+    g_qc_cancel = true;
+}
+
+} // extern "C"
@@ -0,0 +1,232 @@
+#include "session_cache.h"
+
+#include <cerrno>
+#include <cinttypes>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "native_common.h"
+
+namespace {
+
+constexpr char kMagic[4] = {'N', 'G', 'K', 'V'};
+constexpr uint32_t kFormatVersion = 1;
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    SessionKey key;
+    uint32_t n_tokens;
+    uint32_t reserved;
+    uint64_t state_bytes;
+    // Followed by n_tokens llama_tokens, then state_bytes of llama_state_get_data
+};
+
+constexpr uint64_t kFnvOffset = 0xcbf29ce484222325ull;
+constexpr uint64_t kFnvPrime = 0x100000001b3ull;
+
+uint64_t fnv1a(const void* data, size_t len, uint64_t h = kFnvOffset) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ p[i]) * kFnvPrime;
+    }
+    return h;
+}
+
+/**
+ * First key component that differs, or nullptr if the keys match
+ */
+const char* key_mismatch(const SessionKey& a, const SessionKey& b) {
+    if (a.model_dev != b.model_dev || a.model_ino != b.model_ino || a.model_size != b.model_size ||
+        a.model_mtime_ns != b.model_mtime_ns) {
+        return "model";
+    }
+    if (a.prompt_hash != b.prompt_hash) return "prompt";
+    if (a.n_ctx != b.n_ctx || a.type_k != b.type_k || a.type_v != b.type_v || a.flash_attn != b.flash_attn) {
+        return "config";
+    }
+    return nullptr;
+}
+
+bool write_all(int fd, const void* data, size_t len) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    while (len > 0) {
+        const ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+    return true;
+}
+
+} // namespace
+
+bool session_key_init(const char* model_path, const EngineConfig& cfg, SessionKey& key) {
+    key = SessionKey();
+    struct stat st;
+    if (!model_path || stat(model_path, &st) != 0) return false;
+    key.model_dev = (uint64_t) st.st_dev;
+    key.model_ino = (uint64_t) st.st_ino;
+    key.model_size = (uint64_t) st.st_size;
+    key.model_mtime_ns = (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    key.n_ctx = cfg.n_ctx;
+    key.type_k = cfg.type_k;
+    key.type_v = cfg.type_v;
+    key.flash_attn = cfg.flash_attn;
+    return true;
+}
+
+uint64_t session_prompt_hash(const std::vector<llama_token>& tokens) {
+    return fnv1a(tokens.data(), tokens.size() * sizeof(llama_token));
+}
+
+std::string session_snapshot_path(const std::string& dir, const SessionKey& key) {
+    uint64_t h = fnv1a(&key.model_dev, sizeof(key.model_dev));
+    h = fnv1a(&key.model_ino, sizeof(key.model_ino), h);
+    h = fnv1a(&key.prompt_hash, sizeof(key.prompt_hash), h);
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 ".ngkv", h);
+    return dir + "/" + name;
+}
+
+SessionSnapshotResult session_snapshot_save(const std::string& path, const SessionKey& key,
+                                            const std::vector<llama_token>& tokens, llama_context* ctx) {
+    SessionSnapshotResult result;
+    const int64_t t_start = now_us();
+
+    std::vector<uint8_t> state(llama_state_get_size(ctx));
+    const size_t state_bytes = llama_state_get_data(ctx, state.data(), state.size());
+    if (state_bytes == 0) {
+        result.status = "error";
+        result.reason = "llama_state_get_data failed";
+        return result;
+    }
+
+    SnapshotHeader header = {};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kFormatVersion;
+    header.key = key;
+    header.n_tokens = (uint32_t) tokens.size();
+    header.state_bytes = state_bytes;
+
+    const std::string tmp_path = path + ".tmp";
+    const int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        result.status = "error";
+        result.reason = std::string("open: ") + strerror(errno);
+        return result;
+    }
+    bool ok = write_all(fd, &header, sizeof(header)) &&
+              write_all(fd, tokens.data(), tokens.size() * sizeof(llama_token)) &&
+              write_all(fd, state.data(), state_bytes);
+    if (!ok) result.reason = std::string("write: ") + strerror(errno);
+    ok = close(fd) == 0 && ok;
+    if (ok && rename(tmp_path.c_str(), path.c_str()) != 0) {
+        result.reason = std::string("rename: ") + strerror(errno);
+        ok = false;
+    }
+    if (!ok) {
+        unlink(tmp_path.c_str());
+        result.status = "error";
+        return result;
+    }
+
+    result.status = "saved";
+    result.bytes = sizeof(header) + tokens.size() * sizeof(llama_token) + state_bytes;
+    result.elapsed_ms = (now_us() - t_start) / 1000.0;
+    LOGI("SESSION: Saved %u tokens to %s (%" PRIu64 " bytes, %.1f ms)",
+         header.n_tokens, path.c_str(), result.bytes, result.elapsed_ms);
+    return result;
+}
+
+SessionSnapshotResult session_snapshot_restore(const std::string& path, const SessionKey& key,
+                                               const std::vector<llama_token>& tokens, llama_context* ctx) {
+    SessionSnapshotResult result;
+    const int64_t t_start = now_us();
+
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        result.status = errno == ENOENT ? "missing" : "error";
+        if (errno != ENOENT) result.reason = std::string("open: ") + strerror(errno);
+        return result;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        unlink(path.c_str());
+        result.status = "stale";
+        result.reason = "format";
+        return result;
+    }
+    result.bytes = (uint64_t) st.st_size;
+
+    void* map = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        result.status = "error";
+        result.reason = std::string("mmap: ") + strerror(errno);
+        return result;
+    }
+    // One front-to-back pass: let readahead fetch the whole file
+    madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+    madvise(map, (size_t) st.st_size, MADV_WILLNEED);
+
+    const uint8_t* base = static_cast<const uint8_t*>(map);
+    SnapshotHeader header;
+    memcpy(&header, base, sizeof(header));
+    const uint64_t tokens_bytes = (uint64_t) header.n_tokens * sizeof(llama_token);
+    const char* stale = nullptr;
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kFormatVersion ||
+        sizeof(header) + tokens_bytes + header.state_bytes != (uint64_t) st.st_size) {
+        stale = "format";
+    } else if ((stale = key_mismatch(header.key, key)) == nullptr) {
+        // Guards against a prompt hash collision
+        if (header.n_tokens != tokens.size() || memcmp(base + sizeof(header), tokens.data(), tokens_bytes) != 0) {
+            stale = "prompt";
+        }
+    }
+
+    if (!stale) {
+        const uint8_t* state = base + sizeof(header) + tokens_bytes;
+        llama_memory_clear(llama_get_memory(ctx), true);
+        // The state of another llama.cpp build may not parse; treat it like a format change
+        if (llama_state_set_data(ctx, state, header.state_bytes) != header.state_bytes ||
+            llama_memory_seq_pos_max(llama_get_memory(ctx), 0) != (llama_pos) header.n_tokens - 1) {
+            llama_memory_clear(llama_get_memory(ctx), true);
+            stale = "format";
+        }
+    }
+    munmap(map, (size_t) st.st_size);
+
+    if (stale) {
+        LOGI("SESSION: Discarding stale snapshot %s (%s changed)", path.c_str(), stale);
+        unlink(path.c_str());
+        result.status = "stale";
+        result.reason = stale;
+        return result;
+    }
+    result.status = "restored";
+    result.elapsed_ms = (now_us() - t_start) / 1000.0;
+    LOGI("SESSION: Restored %u tokens from %s (%" PRIu64 " bytes, %.1f ms)",
+         header.n_tokens, path.c_str(), result.bytes, result.elapsed_ms);
+    return result;
+}
+
+bool session_snapshot_evict(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    const bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return ok;
+}
+
+std::string session_snapshot_json(const SessionSnapshotResult& result) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), ",\"bytes\":%" PRIu64 ",\"elapsed_ms\":%.3f}", result.bytes, result.elapsed_ms);
+    return "{\"status\":\"" + result.status + "\",\"reason\":\"" + json_escape(result.reason) + "\"" + buf;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+// Persisted KV session snapshots.
+//
+// After a prompt is prefilled, the full context state (KV cells, output logits)
+// is written next to the tokens it was computed from. On the next launch the
+// same prompt is restored from that file through a read-only mapping instead
+// of being prefilled again, so the first token only waits for the model load
+// and the restore.
+//
+// A snapshot is only valid for the exact model file, prompt and context layout
+// it was taken with; the key records all three and any difference discards it.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "engine_config.h"
+#include "llama.h"
+
+struct SessionKey {
+    // Identity of the model file (a rewritten or replaced file changes one of these)
+    uint64_t model_dev = 0;
+    uint64_t model_ino = 0;
+    uint64_t model_size = 0;
+    int64_t model_mtime_ns = 0;
+    // FNV-1a of the prompt tokens
+    uint64_t prompt_hash = 0;
+    // Context parameters that change the layout of the serialized state
+    int32_t n_ctx = 0;
+    int32_t type_k = 0;
+    int32_t type_v = 0;
+    int32_t flash_attn = 0;
+};
+
+struct SessionSnapshotResult {
+    std::string status; // "restored" | "saved" | "missing" | "stale" | "error"
+    std::string reason; // stale: "model", "prompt", "config" or "format"; error: what failed
+    uint64_t bytes = 0; // Snapshot file size
+    double elapsed_ms = 0.0;
+};
+
+/**
+ * Fill the model and context parts of key from the file at model_path and the
+ * effective config of its context.
+ * Returns: false if the model file can't be stat'ed (snapshots are then disabled)
+ */
+bool session_key_init(const char* model_path, const EngineConfig& cfg, SessionKey& key);
+
+uint64_t session_prompt_hash(const std::vector<llama_token>& tokens);
+
+/**
+ * Snapshot file for key under dir. The name depends only on the model file and
+ * the prompt, so a snapshot taken with another config or an older copy of the
+ * model is found, reported as stale and replaced.
+ */
+std::string session_snapshot_path(const std::string& dir, const SessionKey& key);
+
+/**
+ * Write the state of ctx, which must hold exactly the prefilled tokens, to path
+ * (through a temporary file and rename, so readers never see a partial snapshot)
+ */
+SessionSnapshotResult session_snapshot_save(const std::string& path, const SessionKey& key,
+                                            const std::vector<llama_token>& tokens, llama_context* ctx);
+
+/**
+ * Map the snapshot at path and load it into ctx if it matches key and tokens.
+ * A stale or unreadable snapshot is deleted and ctx is left cleared.
+ */
+SessionSnapshotResult session_snapshot_restore(const std::string& path, const SessionKey& key,
+                                               const std::vector<llama_token>& tokens, llama_context* ctx);
+
+/**
+ * Drop the snapshot's pages from the page cache, so the next restore reads from storage
+ * Returns: false if the kernel didn't accept the advice
+ */
+bool session_snapshot_evict(const std::string& path);
+
+/**
+ * JSON: {"status","reason","bytes","elapsed_ms"}
+ */
+std::string session_snapshot_json(const SessionSnapshotResult& result);
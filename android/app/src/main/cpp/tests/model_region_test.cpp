@@ -0,0 +1,268 @@
+// Model regions inside a plain archive, on a Linux host.
+//
+// Writes an uncompressed tar holding a padding member and a GGUF whose data
+// starts at a page-aligned, non-zero offset (as APK assets do), then resolves
+// the GGUF member through resolve_model_region, the step load_model_region
+// takes before llama.cpp opens the result:
+//   - the member region is copied once to the cache path, byte for byte, and
+//     the copy is reused by the next call;
+//   - a region covering a whole file opens in place through /proc/self/fd;
+//   - truncated and out-of-range regions are rejected.
+// A generated GGUF has no weights llama.cpp could run, so with NG_TEST_MODEL
+// set to a real model the test also archives that model and loads the resolved
+// path with llama.cpp.
+//
+// Build with -DNEURAL_GAUGE_BUILD_TESTS=ON (host build) and run ctest.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../gguf_reader.h"
+#include "../model_region.h"
+#include "../native_common.h"
+#include "test_support.h"
+#include "ggml-backend.h"
+#include "llama.h"
+
+namespace {
+
+constexpr uint64_t kPage = 4096;
+constexpr uint64_t kTarBlock = 512;
+
+void put_u32(std::vector<uint8_t>& out, uint32_t v) {
+    out.insert(out.end(), reinterpret_cast<uint8_t*>(&v), reinterpret_cast<uint8_t*>(&v) + 4);
+}
+
+void put_u64(std::vector<uint8_t>& out, uint64_t v) {
+    out.insert(out.end(), reinterpret_cast<uint8_t*>(&v), reinterpret_cast<uint8_t*>(&v) + 8);
+}
+
+void put_str(std::vector<uint8_t>& out, const std::string& s) {
+    put_u64(out, s.size());
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+/**
+ * GGUF v3 with two f32 tensors and 32-byte alignment
+ */
+std::vector<uint8_t> make_gguf() {
+    std::vector<uint8_t> out;
+    put_u32(out, 0x46554747); // "GGUF"
+    put_u32(out, 3);
+    put_u64(out, 2); // Tensors
+    put_u64(out, 2); // KV pairs
+    put_str(out, "general.architecture");
+    put_u32(out, 8); // String
+    put_str(out, "llama");
+    put_str(out, "general.alignment");
+    put_u32(out, 4); // uint32
+    put_u32(out, 32);
+
+    put_str(out, "a");
+    put_u32(out, 1);
+    put_u64(out, 64);
+    put_u32(out, 0); // f32
+    put_u64(out, 0);
+    put_str(out, "b");
+    put_u32(out, 2);
+    put_u64(out, 32);
+    put_u64(out, 4);
+    put_u32(out, 0);
+    put_u64(out, 256);
+
+    out.resize((out.size() + 31) / 32 * 32, 0);
+    for (int i = 0; i < 64 + 128; i++) {
+        const float v = i * 0.5f;
+        out.insert(out.end(), reinterpret_cast<const uint8_t*>(&v), reinterpret_cast<const uint8_t*>(&v) + 4);
+    }
+    return out;
+}
+
+/**
+ * ustar header block for a regular file
+ */
+std::vector<uint8_t> tar_header(const std::string& name, uint64_t size) {
+    std::vector<uint8_t> h(kTarBlock, 0);
+    memcpy(h.data(), name.c_str(), std::min<size_t>(name.size(), 99));
+    snprintf(reinterpret_cast<char*>(&h[100]), 8, "%07o", 0644);
+    snprintf(reinterpret_cast<char*>(&h[108]), 8, "%07o", 0);
+    snprintf(reinterpret_cast<char*>(&h[116]), 8, "%07o", 0);
+    snprintf(reinterpret_cast<char*>(&h[124]), 12, "%011llo", (unsigned long long) size);
+    snprintf(reinterpret_cast<char*>(&h[136]), 12, "%011o", 0);
+    h[156] = '0';
+    memcpy(&h[257], "ustar", 6);
+    memcpy(&h[263], "00", 2);
+    memset(&h[148], ' ', 8);
+    unsigned sum = 0;
+    for (const uint8_t b : h) sum += b;
+    snprintf(reinterpret_cast<char*>(&h[148]), 8, "%06o", sum);
+    return h;
+}
+
+void pad_to(std::vector<uint8_t>& out, uint64_t multiple) {
+    out.resize((out.size() + multiple - 1) / multiple * multiple, 0);
+}
+
+/**
+ * Tar of a padding member and model_name holding model, with the model's data
+ * starting at page_offset (page aligned, past the padding member)
+ */
+std::vector<uint8_t> make_archive(const std::string& model_name, const std::vector<uint8_t>& model,
+                                  uint64_t page_offset) {
+    std::vector<uint8_t> out = tar_header("README", page_offset - 2 * kTarBlock);
+    out.resize(page_offset - kTarBlock, 'x');
+    const std::vector<uint8_t> header = tar_header(model_name, model.size());
+    out.insert(out.end(), header.begin(), header.end());
+    out.insert(out.end(), model.begin(), model.end());
+    pad_to(out, kTarBlock);
+    out.resize(out.size() + 2 * kTarBlock, 0); // End of archive
+    return out;
+}
+
+/**
+ * Offset and size of a member's data, found by walking the tar headers
+ */
+bool find_member(int fd, const std::string& name, uint64_t& offset, uint64_t& size) {
+    uint64_t pos = 0;
+    char h[kTarBlock];
+    while (pread(fd, h, kTarBlock, (off_t) pos) == (ssize_t) kTarBlock && h[0] != '\0') {
+        size = strtoull(std::string(h + 124, 12).c_str(), nullptr, 8);
+        if (strncmp(h, name.c_str(), 100) == 0) {
+            offset = pos + kTarBlock;
+            return true;
+        }
+        pos += kTarBlock + (size + kTarBlock - 1) / kTarBlock * kTarBlock;
+    }
+    return false;
+}
+
+bool write_file(const std::string& path, const std::vector<uint8_t>& data) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+    const bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    return fclose(f) == 0 && ok;
+}
+
+std::vector<uint8_t> read_file(const std::string& path) {
+    std::vector<uint8_t> data;
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return data;
+    uint8_t buf[1 << 16];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+    fclose(f);
+    return data;
+}
+
+std::vector<uint8_t> read_region(int fd, uint64_t offset, uint64_t size) {
+    std::vector<uint8_t> data(size);
+    if (pread(fd, data.data(), size, (off_t) offset) != (ssize_t) size) data.clear();
+    return data;
+}
+
+void test_generated_gguf(const std::string& dir) {
+    const std::vector<uint8_t> gguf = make_gguf();
+    const std::string archive = dir + "/models.tar";
+    const std::string cache = dir + "/model.gguf";
+    CHECK(write_file(archive, make_archive("model.gguf", gguf, 2 * kPage)));
+
+    const int fd = open(archive.c_str(), O_RDONLY | O_CLOEXEC);
+    CHECK(fd >= 0);
+    uint64_t offset = 0, size = 0;
+    CHECK(find_member(fd, "model.gguf", offset, size));
+    CHECK(offset == 2 * kPage);
+    CHECK(size == gguf.size());
+
+    // Member at a non-zero offset: copied once, then reused
+    ModelRegionResult region;
+    CHECK(resolve_model_region(fd, offset, size, cache.c_str(), region));
+    CHECK(region.mode == "materialized");
+    CHECK(region.path == cache);
+    CHECK(region.bytes_copied == size);
+    CHECK(read_file(cache) == gguf);
+
+    GgufInfo info;
+    std::string error;
+    CHECK(gguf_read_info(region.path.c_str(), info, error) == GgufStatus::kComplete);
+    CHECK(info.tensors.size() == 2);
+    CHECK(info.architecture() == "llama");
+
+    CHECK(resolve_model_region(fd, offset, size, cache.c_str(), region));
+    CHECK(region.mode == "materialized");
+    CHECK(region.bytes_copied == 0);
+
+    // A region cut short, past the container, or at an offset without a cache path
+    CHECK(!resolve_model_region(fd, offset, size - 64, cache.c_str(), region));
+    CHECK(!resolve_model_region(fd, offset, size + 1024 * kPage, cache.c_str(), region));
+    CHECK(!resolve_model_region(fd, offset, size, "", region));
+    close(fd);
+
+    // A whole file opens in place
+    const int cache_fd = open(cache.c_str(), O_RDONLY | O_CLOEXEC);
+    CHECK(cache_fd >= 0);
+    CHECK(resolve_model_region(cache_fd, 0, gguf.size(), nullptr, region));
+    CHECK(region.mode == "direct");
+    CHECK(region.path == "/proc/self/fd/" + std::to_string(cache_fd));
+    CHECK(region.bytes_copied == 0);
+    CHECK(read_file(region.path) == gguf);
+    close(cache_fd);
+}
+
+/**
+ * Archive a real model and load it from the resolved path, as load_model_region does
+ */
+void test_real_model(const std::string& dir, const char* model_path) {
+    const std::vector<uint8_t> model = read_file(model_path);
+    CHECK(!model.empty());
+    const std::string archive = dir + "/real.tar";
+    const std::string cache = dir + "/real.gguf";
+    CHECK(write_file(archive, make_archive("real.gguf", model, 4 * kPage)));
+
+    const int fd = open(archive.c_str(), O_RDONLY | O_CLOEXEC);
+    uint64_t offset = 0, size = 0;
+    CHECK(find_member(fd, "real.gguf", offset, size));
+    CHECK(read_region(fd, offset, 4) == std::vector<uint8_t>(model.begin(), model.begin() + 4));
+
+    ModelRegionResult region;
+    CHECK(resolve_model_region(fd, offset, size, cache.c_str(), region));
+    close(fd);
+    if (region.path.empty()) return;
+
+    llama_backend_init();
+    ggml_backend_load_all();
+    llama_model_params params = llama_model_default_params();
+    llama_model* loaded = llama_model_load_from_file(region.path.c_str(), params);
+    CHECK(loaded != nullptr);
+    if (loaded) {
+        CHECK(llama_model_n_params(loaded) > 0);
+        llama_model_free(loaded);
+    }
+    llama_backend_free();
+}
+
+} // namespace
+
+int main() {
+    {
+        TestTempDir dir("/tmp/ng_region_test");
+        if (dir.path().empty()) return 1;
+
+        test_generated_gguf(dir.path());
+
+        const char* model_path = getenv("NG_TEST_MODEL");
+        if (model_path && *model_path) {
+            test_real_model(dir.path(), model_path);
+        } else {
+            printf("NG_TEST_MODEL not set, skipping the llama.cpp load\n");
+        }
+    }
+    return test_summary();
+}
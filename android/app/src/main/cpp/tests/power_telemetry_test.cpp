@@ -0,0 +1,229 @@
+// Power telemetry against a fake power-supply tree, on a Linux host.
+//
+// Builds a directory per supply holding the sysfs attribute files, changes them
+// while PowerSampler samples, and checks what the idle baseline and run windows
+// and energy_report_json make of it:
+//   - power_now, or voltage_now x current_now, is integrated and preferred over
+//     the counters, so both windows read the same source;
+//   - a counter window only counts when the counter stepped often enough, and a
+//     baseline without a reading leaves the net values at 0;
+//   - charging is flagged, and a tree without a battery is rejected.
+//
+// Build with -DNEURAL_GAUGE_BUILD_TESTS=ON (host build) and run ctest.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+
+#include "../power_telemetry.h"
+#include "test_support.h"
+
+namespace {
+
+constexpr int kIntervalMs = 5;
+
+bool near(double value, double expected, double tolerance) {
+    return std::fabs(value - expected) <= tolerance;
+}
+
+/**
+ * Write one attribute through a rename, so the sampler never reads a partial value
+ */
+void write_attr(const std::string& dir, const char* name, const std::string& value) {
+    const std::string path = dir + "/" + name;
+    const std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (!f) {
+        perror(tmp.c_str());
+        g_failures++;
+        return;
+    }
+    fprintf(f, "%s\n", value.c_str());
+    fclose(f);
+    rename(tmp.c_str(), path.c_str());
+}
+
+std::string make_supply(const std::string& root, const std::string& name, const char* type) {
+    mkdir(root.c_str(), 0700);
+    const std::string dir = root + "/" + name;
+    mkdir(dir.c_str(), 0700);
+    write_attr(dir, "type", type);
+    write_attr(dir, "status", "Discharging");
+    return dir;
+}
+
+PowerWindow sample_for(PowerSampler& sampler, int ms) {
+    sampler.start(kIntervalMs);
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    return sampler.stop();
+}
+
+/**
+ * Value of a number or string field of a flat JSON object, as text ("" if missing)
+ */
+std::string json_field(const std::string& json, const char* key) {
+    const std::string needle = std::string("\"") + key + "\":";
+    const size_t pos = json.find(needle);
+    if (pos == std::string::npos) return "";
+    size_t start = pos + needle.size();
+    if (json[start] == '"') {
+        const size_t end = json.find('"', start + 1);
+        return json.substr(start + 1, end - start - 1);
+    }
+    const size_t end = json.find_first_of(",}", start);
+    return json.substr(start, end - start);
+}
+
+double json_number(const std::string& json, const char* key) {
+    const std::string text = json_field(json, key);
+    return text.empty() ? NAN : strtod(text.c_str(), nullptr);
+}
+
+void test_voltage_current(const std::string& root) {
+    make_supply(root, "usb", "USB");
+    const std::string battery = make_supply(root, "battery", "Battery");
+    write_attr(battery, "voltage_now", "4000000");  // 4 V
+    write_attr(battery, "current_now", "-250000");  // 0.25 A discharging: 1 W
+    write_attr(battery, "charge_counter", "3000000");
+
+    PowerSampler sampler;
+    std::string error;
+    CHECK(sampler.open(root, error));
+    CHECK(sampler.supply() == battery);
+    CHECK(sampler.source() == "voltage_current");
+
+    const PowerWindow baseline = sample_for(sampler, 150);
+    CHECK(baseline.source == "voltage_current");
+    CHECK(near(baseline.avg_watts, 1.0, 1e-6));
+    CHECK(baseline.samples >= 3);
+    CHECK(!baseline.charging);
+
+    // 3 W, while the counter drops once: the run still reads voltage and current
+    write_attr(battery, "current_now", "750000");
+    sampler.start(kIntervalMs);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    write_attr(battery, "charge_counter", "2999000");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const PowerWindow run = sampler.stop();
+    CHECK(run.source == "voltage_current");
+    CHECK(near(run.avg_watts, 3.0, 1e-6));
+    CHECK(near(run.joules, 3.0 * run.seconds, 1e-6));
+
+    const std::string json = energy_report_json(sampler.supply(), baseline, run, 100);
+    CHECK(json_field(json, "source") == "voltage_current");
+    CHECK(json_field(json, "baseline_source") == "voltage_current");
+    CHECK(json_field(json, "charging") == "false");
+    CHECK(near(json_number(json, "net_avg_watts"), 2.0, 1e-3));
+    CHECK(near(json_number(json, "joules_per_token"), 2.0 * run.seconds / 100, 1e-4));
+}
+
+void test_prefers_power_now(const std::string& root) {
+    const std::string battery = make_supply(root, "battery", "Battery");
+    write_attr(battery, "power_now", "2000000"); // 2 W
+    write_attr(battery, "energy_now", "10000000");
+    write_attr(battery, "voltage_now", "4000000");
+
+    PowerSampler sampler;
+    std::string error;
+    CHECK(sampler.open(root, error));
+    CHECK(sampler.source() == "power_now");
+
+    // The energy counter moves, but the window keeps integrating power_now
+    sampler.start(kIntervalMs);
+    for (int i = 1; i <= 6; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(25));
+        write_attr(battery, "energy_now", std::to_string(10000000 - i * 1000));
+    }
+    const PowerWindow w = sampler.stop();
+    CHECK(w.source == "power_now");
+    CHECK(near(w.avg_watts, 2.0, 1e-6));
+}
+
+void test_counter_only(const std::string& root) {
+    const std::string battery = make_supply(root, "battery", "Battery");
+    write_attr(battery, "voltage_now", "4000000");
+    write_attr(battery, "charge_counter", "3000000");
+
+    PowerSampler sampler;
+    std::string error;
+    CHECK(sampler.open(root, error));
+    CHECK(sampler.source() == "charge_counter");
+
+    // The counter doesn't step during the baseline: no reading
+    const PowerWindow baseline = sample_for(sampler, 100);
+    CHECK(baseline.source.empty());
+    CHECK(baseline.joules == 0.0);
+
+    // A single step is quantization, not a reading
+    sampler.start(kIntervalMs);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    write_attr(battery, "charge_counter", "2999000");
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(sampler.stop().source.empty());
+
+    // Six steps of 100 uAh at 4 V: 600 uAh x 4 V = 2400 uWh = 8.64 J
+    sampler.start(kIntervalMs);
+    for (int i = 1; i <= 6; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(25));
+        write_attr(battery, "charge_counter", std::to_string(2999000 - i * 100));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(25));
+    const PowerWindow run = sampler.stop();
+    CHECK(run.source == "charge_counter");
+    CHECK(near(run.joules, 8.64, 1e-6));
+
+    // Without a baseline from the same source there is no net value
+    const std::string json = energy_report_json(sampler.supply(), baseline, run, 10);
+    CHECK(json_field(json, "source") == "charge_counter");
+    CHECK(json_field(json, "baseline_source").empty());
+    CHECK(json_number(json, "net_joules") == 0.0);
+    CHECK(json_number(json, "joules_per_token") == 0.0);
+    CHECK(near(json_number(json, "joules"), 8.64, 1e-3));
+}
+
+void test_charging(const std::string& root) {
+    const std::string battery = make_supply(root, "battery", "Battery");
+    write_attr(battery, "power_now", "1000000");
+    write_attr(battery, "status", "Charging");
+
+    PowerSampler sampler;
+    std::string error;
+    CHECK(sampler.open(root, error));
+    const PowerWindow w = sample_for(sampler, 30);
+    CHECK(w.charging);
+    const std::string json = energy_report_json(sampler.supply(), w, w, 1);
+    CHECK(json_field(json, "charging") == "true");
+}
+
+void test_no_battery(const std::string& root) {
+    make_supply(root, "usb", "USB");
+    make_supply(root, "battery", "Battery"); // No readable attribute
+
+    PowerSampler sampler;
+    std::string error;
+    CHECK(!sampler.open(root, error));
+    CHECK(!error.empty());
+    CHECK(sampler.supply().empty());
+    CHECK(!sampler.open(root + "/missing", error));
+}
+
+} // namespace
+
+int main() {
+    {
+        TestTempDir dir("/tmp/ng_power_test");
+        if (dir.path().empty()) return 1;
+        const std::string& root = dir.path();
+
+        test_voltage_current(root + "/voltage_current");
+        test_prefers_power_now(root + "/power_now");
+        test_counter_only(root + "/counter");
+        test_charging(root + "/charging");
+        test_no_battery(root + "/none");
+    }
+    return test_summary();
+}
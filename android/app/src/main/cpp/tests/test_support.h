@@ -0,0 +1,61 @@
+#pragma once
+
+// Shared pieces of the native host tests: a CHECK that counts failures instead
+// of stopping, a temporary directory removed with its contents, and the
+// PASS/FAIL line ctest reads together with the exit status.
+
+#include <cstdio>
+#include <ftw.h>
+#include <stdlib.h>
+#include <string>
+
+inline int g_failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_failures++;                                                    \
+        }                                                                    \
+    } while (0)
+
+/**
+ * Directory from mkdtemp(prefix + ".XXXXXX"), removed with everything in it
+ * when this goes out of scope. path() is "" if it couldn't be created.
+ */
+class TestTempDir {
+public:
+    explicit TestTempDir(const char* prefix) {
+        std::string name = std::string(prefix) + ".XXXXXX";
+        if (mkdtemp(name.data())) {
+            path_ = name;
+        } else {
+            perror("mkdtemp");
+        }
+    }
+
+    ~TestTempDir() {
+        if (path_.empty()) return;
+        // Depth first, so every directory is empty by the time it is removed
+        auto remove_entry = [](const char* path, const struct stat*, int, struct FTW*) { return remove(path); };
+        if (nftw(path_.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS) != 0) {
+            fprintf(stderr, "could not remove %s\n", path_.c_str());
+        }
+    }
+
+    TestTempDir(const TestTempDir&) = delete;
+    TestTempDir& operator=(const TestTempDir&) = delete;
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+/**
+ * Print the result line; returns the process exit status
+ */
+inline int test_summary() {
+    printf("%s (%d failed checks)\n", g_failures == 0 ? "PASS" : "FAIL", g_failures);
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,599 @@
+// Continuous-batching inference server over a Unix-domain socket.
+//
+// Loads one model and serves any number of concurrent generation requests from
+// it, the way a backend would, so the engine can be load-tested (ng_loadgen).
+// Every step builds one llama_batch from all active sequences: one token for
+// each sequence that is decoding, then prompt chunks of sequences still in
+// prefill, then newly admitted requests, up to --batch tokens. A request joins
+// the running batch at the next step instead of waiting for the others to
+// finish (continuous batching). All sequences share one KV pool of --ctx cells;
+// when a decoding sequence needs a cell and none is free, the most recently
+// admitted sequence is preempted: its cells are dropped and it goes back to the
+// front of the queue with its prompt and the tokens generated so far, which are
+// prefilled again when space frees up (recompute preemption).
+//
+// Protocol: newline-delimited JSON in both directions. Requests
+//   {"id":1,"prompt":"Once upon a time","n_predict":64}
+//   {"cmd":"stats"}
+// Replies, streamed per request as tokens are sampled (greedy):
+//   {"id":1,"text":" there"}
+//   {"id":1,"done":true,"prompt_tokens":5,"generated":64,"preemptions":0,
+//    "queue_ms":1.2,"ttft_ms":35.0,"total_ms":910.4}
+//   {"id":1,"error":"prompt does not fit the context"}
+//   {"stats":{"steps":..,"batch_tokens":..,"decode_tokens":..,...}}
+//
+// Build with -DNEURAL_GAUGE_BUILD_TOOLS=ON, push to a device and run:
+//   adb shell /data/local/tmp/ng_server --model /data/local/tmp/model.gguf
+// Options:
+//   --model PATH      GGUF model (required)
+//   --socket PATH     socket path (default /data/local/tmp/ng_server.sock)
+//   --ctx 4096        KV cells shared by all sequences
+//   --parallel 8      max sequences in the batch at once
+//   --batch 512       max tokens per step
+//   --threads N       decode threads (default: all cores)
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <map>
+#include <memory>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "ggml-backend.h"
+#include "llama.h"
+
+#include "../native_common.h"
+#include "mini_json.h"
+
+namespace {
+
+#ifdef __ANDROID__
+const char* kDefaultSocket = "/data/local/tmp/ng_server.sock";
+#else
+const char* kDefaultSocket = "/tmp/ng_server.sock";
+#endif
+
+volatile sig_atomic_t g_stop = 0;
+
+struct Options {
+    std::string model;
+    std::string socket = kDefaultSocket;
+    int n_ctx = 4096;
+    int n_parallel = 8;
+    int n_batch = 512;
+    int n_threads = 0;
+};
+
+struct Connection {
+    int fd = -1;
+    std::string in;  // Received bytes up to the next newline
+    std::string out; // Replies not yet sent
+};
+
+struct Request {
+    int64_t id = 0;        // Client id, echoed in every reply
+    uint64_t conn = 0;     // Connection the replies go to
+    int n_prompt = 0;
+    int n_predict = 0;
+    int n_generated = 0;
+    int preemptions = 0;
+
+    // Prompt followed by every sampled token. tokens[0, n_past) are in the KV
+    // cache, the rest is fed at the next steps; during decode that is just the
+    // last sampled token.
+    std::vector<llama_token> tokens;
+    int n_past = 0;
+    int seq = -1;           // Sequence id while admitted
+    uint64_t admitted = 0;  // Admission order, the youngest is preempted first
+
+    int64_t t_arrival = 0;
+    int64_t t_admitted = 0; // First admission
+    int64_t t_first_token = 0;
+};
+
+struct Stats {
+    int64_t steps = 0;
+    int64_t batch_tokens = 0;
+    int64_t decode_tokens = 0;  // Tokens of sequences past their prefill
+    int64_t prefill_tokens = 0; // Prompt tokens, including recomputed ones
+    int64_t preemptions = 0;
+    int64_t completed = 0;
+    int64_t rejected = 0;
+    int64_t decode_us = 0;
+};
+
+class Server {
+public:
+    Server(const llama_model* model, llama_context* ctx, const Options& opts)
+        : ctx_(ctx), vocab_(llama_model_get_vocab(model)), opts_(opts),
+          batch_(llama_batch_init(opts.n_batch, 0, 1)) {
+        for (int s = opts.n_parallel - 1; s >= 0; s--) free_seqs_.push_back(s);
+    }
+
+    ~Server() {
+        llama_batch_free(batch_);
+        for (auto& kv : conns_) close(kv.second.fd);
+    }
+
+    bool busy() const { return !running_.empty() || !waiting_.empty(); }
+
+    void add_connection(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        conns_[next_conn_++].fd = fd;
+    }
+
+    void fill_pollfds(std::vector<pollfd>& fds, std::vector<uint64_t>& ids) const {
+        for (const auto& kv : conns_) {
+            fds.push_back({kv.second.fd, (short) (POLLIN | (kv.second.out.empty() ? 0 : POLLOUT)), 0});
+            ids.push_back(kv.first);
+        }
+    }
+
+    /**
+     * Read what the connection sent and queue the complete requests.
+     * Returns: false if the peer closed the connection
+     */
+    bool on_readable(uint64_t conn_id) {
+        auto it = conns_.find(conn_id);
+        if (it == conns_.end()) return false;
+        Connection& conn = it->second;
+        char buf[16384];
+        while (true) {
+            const ssize_t n = recv(conn.fd, buf, sizeof(buf), 0);
+            if (n == 0) return false;
+            if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            conn.in.append(buf, (size_t) n);
+            size_t nl;
+            while ((nl = conn.in.find('\n')) != std::string::npos) {
+                const std::string line = conn.in.substr(0, nl);
+                conn.in.erase(0, nl + 1);
+                if (line.find_first_not_of(" \t\r") != std::string::npos) on_line(conn_id, line);
+            }
+        }
+    }
+
+    /**
+     * Send as much of the queued replies as the socket takes.
+     * Returns: false if the connection is broken
+     */
+    bool flush(uint64_t conn_id) {
+        auto it = conns_.find(conn_id);
+        if (it == conns_.end()) return false;
+        Connection& conn = it->second;
+        while (!conn.out.empty()) {
+            const ssize_t n = send(conn.fd, conn.out.data(), conn.out.size(), MSG_NOSIGNAL);
+            if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            conn.out.erase(0, (size_t) n);
+        }
+        return true;
+    }
+
+    void flush_all() {
+        std::vector<uint64_t> broken;
+        for (auto& kv : conns_) {
+            if (!kv.second.out.empty() && !flush(kv.first)) broken.push_back(kv.first);
+        }
+        for (uint64_t id : broken) drop_connection(id);
+    }
+
+    /**
+     * Close the connection and cancel its requests, freeing their KV cells
+     */
+    void drop_connection(uint64_t conn_id) {
+        auto it = conns_.find(conn_id);
+        if (it == conns_.end()) return;
+        close(it->second.fd);
+        conns_.erase(it);
+        for (size_t i = 0; i < running_.size();) {
+            if (running_[i]->conn == conn_id) {
+                release(running_[i].get());
+                running_.erase(running_.begin() + i);
+            } else {
+                i++;
+            }
+        }
+        waiting_.erase(std::remove_if(waiting_.begin(), waiting_.end(),
+                                      [&](const std::unique_ptr<Request>& r) { return r->conn == conn_id; }),
+                       waiting_.end());
+    }
+
+    /**
+     * One scheduler step: build the batch, decode it, sample and stream
+     */
+    void step() {
+        llama_memory_t mem = llama_get_memory(ctx_);
+        struct Entry { Request* req; int n; bool decode; };
+        std::vector<Entry> entries;
+        batch_.n_tokens = 0;
+
+        // Cells in use; the batch adds its tokens on top
+        int kv_used = 0;
+        for (const auto& r : running_) kv_used += r->n_past;
+        auto room = [&] { return opts_.n_ctx - kv_used - batch_.n_tokens; };
+
+        // 1. One token for every decoding sequence, oldest first, so that a
+        // shortage preempts the sequences that have not been added yet
+        std::sort(running_.begin(), running_.end(),
+                  [](const std::unique_ptr<Request>& a, const std::unique_ptr<Request>& b) {
+                      return a->admitted < b->admitted;
+                  });
+        for (size_t i = 0; i < running_.size(); i++) {
+            Request* r = running_[i].get();
+            if (!decoding(r) || batch_.n_tokens >= opts_.n_batch) continue;
+            while (room() < 1) {
+                Request* victim = running_.back().get();
+                kv_used -= victim->n_past;
+                preempt_youngest();
+                if (victim == r) break;
+            }
+            if (i >= running_.size() || running_[i].get() != r) break; // r itself was preempted
+            add_tokens(r, 1);
+            entries.push_back({r, 1, true});
+        }
+
+        // 2. Prompt chunks of admitted sequences still in prefill (or in the
+        // recompute after a preemption)
+        for (const auto& rp : running_) {
+            Request* r = rp.get();
+            if (decoding(r)) continue;
+            const int n = std::min({(int) r->tokens.size() - r->n_past, opts_.n_batch - batch_.n_tokens, room()});
+            if (n <= 0) continue;
+            add_tokens(r, n);
+            entries.push_back({r, n, false});
+        }
+
+        // 3. Admit queued requests whose prompt fits the free cells
+        while (!waiting_.empty() && !free_seqs_.empty() && batch_.n_tokens < opts_.n_batch &&
+               (int) waiting_.front()->tokens.size() <= room()) {
+            std::unique_ptr<Request> req = std::move(waiting_.front());
+            waiting_.pop_front();
+            Request* r = req.get();
+            r->seq = free_seqs_.back();
+            free_seqs_.pop_back();
+            r->admitted = next_admission_++;
+            if (r->t_admitted == 0) r->t_admitted = now_us();
+            running_.push_back(std::move(req));
+            const int n = std::min((int) r->tokens.size(), opts_.n_batch - batch_.n_tokens);
+            add_tokens(r, n);
+            entries.push_back({r, n, false});
+        }
+        if (batch_.n_tokens == 0) {
+            // Partial prefills hold every cell: let the oldest ones finish
+            if (running_.size() > 1) preempt_youngest();
+            return;
+        }
+
+        const int64_t t0 = now_us();
+        const int32_t rc = llama_decode(ctx_, batch_);
+        stats_.decode_us += now_us() - t0;
+        if (rc == 1) {
+            // No contiguous slot despite free cells (fragmentation): undo and make room
+            for (const Entry& e : entries) llama_memory_seq_rm(mem, e.req->seq, e.req->n_past, -1);
+            LOGE("server: no KV slot for %d tokens, preempting", batch_.n_tokens);
+            if (running_.size() > 1) {
+                preempt_youngest();
+            } else {
+                fail(running_.front().get(), "no KV slot");
+            }
+            return;
+        }
+        if (rc != 0) {
+            LOGE("server: llama_decode failed (%d), failing the batch", rc);
+            for (const Entry& e : entries) fail(e.req, "decode failed");
+            return;
+        }
+
+        stats_.steps++;
+        stats_.batch_tokens += batch_.n_tokens;
+        int out = 0;
+        std::vector<Request*> finished;
+        for (const Entry& e : entries) {
+            Request* r = e.req;
+            (e.decode ? stats_.decode_tokens : stats_.prefill_tokens) += e.n;
+            r->n_past += e.n;
+            out += e.n;
+            if (r->n_past < (int) r->tokens.size()) continue; // Prefill continues next step
+            if (sample(r, out - 1)) finished.push_back(r);
+        }
+        for (Request* r : finished) finish(r);
+    }
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    llama_context* ctx_;
+    const llama_vocab* vocab_;
+    const Options& opts_;
+    llama_batch batch_;
+
+    std::map<uint64_t, Connection> conns_;
+    uint64_t next_conn_ = 1;
+    std::deque<std::unique_ptr<Request>> waiting_;
+    std::vector<std::unique_ptr<Request>> running_;
+    std::vector<int> free_seqs_;
+    uint64_t next_admission_ = 0;
+    Stats stats_;
+
+    void reply(uint64_t conn_id, const std::string& line) {
+        auto it = conns_.find(conn_id);
+        if (it != conns_.end()) it->second.out += line + "\n";
+    }
+
+    void on_line(uint64_t conn_id, const std::string& line) {
+        JsonValue msg;
+        if (!JsonParser(line).parse(msg) || msg.type != JsonValue::kObject) {
+            reply(conn_id, "{\"error\":\"not a JSON object\"}");
+            return;
+        }
+        if (json_string(msg, "cmd") == "stats") {
+            reply(conn_id, stats_json());
+            return;
+        }
+
+        auto req = std::make_unique<Request>();
+        req->id = (int64_t) json_number(msg, "id");
+        req->conn = conn_id;
+        req->t_arrival = now_us();
+        const std::string prompt = json_string(msg, "prompt");
+        const int n = -llama_tokenize(vocab_, prompt.c_str(), (int32_t) prompt.size(), nullptr, 0, true, true);
+        req->tokens.resize(std::max(n, 0));
+        if (n > 0) llama_tokenize(vocab_, prompt.c_str(), (int32_t) prompt.size(), req->tokens.data(), n, true, true);
+        if (req->tokens.empty()) req->tokens.push_back(llama_vocab_bos(vocab_));
+        req->n_prompt = (int) req->tokens.size();
+        if (req->n_prompt >= opts_.n_ctx) {
+            stats_.rejected++;
+            reply(conn_id, "{\"id\":" + std::to_string(req->id) + ",\"error\":\"prompt does not fit the context\"}");
+            return;
+        }
+        // A sequence never holds more than the whole pool
+        req->n_predict = std::min(std::max(1, (int) json_number(msg, "n_predict", 64)), opts_.n_ctx - req->n_prompt);
+        waiting_.push_back(std::move(req));
+    }
+
+    /**
+     * Past its prefill, with just the last sampled token to feed
+     */
+    static bool decoding(const Request* r) {
+        return r->n_generated > 0 && r->n_past == (int) r->tokens.size() - 1;
+    }
+
+    void add_tokens(Request* r, int n) {
+        for (int k = 0; k < n; k++) {
+            const int i = batch_.n_tokens++;
+            const int p = r->n_past + k;
+            batch_.token[i] = r->tokens[p];
+            batch_.pos[i] = p;
+            batch_.n_seq_id[i] = 1;
+            batch_.seq_id[i][0] = r->seq;
+            batch_.logits[i] = p == (int) r->tokens.size() - 1;
+        }
+    }
+
+    /**
+     * Sample the next token of r from batch output i and stream it.
+     * Returns: true when the request is complete
+     */
+    bool sample(Request* r, int i) {
+        const float* logits = llama_get_logits_ith(ctx_, i);
+        const int n_vocab = llama_vocab_n_tokens(vocab_);
+        const llama_token token = (llama_token) (std::max_element(logits, logits + n_vocab) - logits);
+        if (llama_vocab_is_eog(vocab_, token)) return true;
+
+        if (r->t_first_token == 0) r->t_first_token = now_us();
+        r->n_generated++;
+        r->tokens.push_back(token);
+        char piece[256];
+        const int len = llama_token_to_piece(vocab_, token, piece, sizeof(piece), 0, false);
+        reply(r->conn, "{\"id\":" + std::to_string(r->id) + ",\"text\":\"" +
+                           json_escape(std::string(piece, std::max(len, 0))) + "\"}");
+        return r->n_generated >= r->n_predict;
+    }
+
+    void release(Request* r) {
+        llama_memory_seq_rm(llama_get_memory(ctx_), r->seq, -1, -1);
+        free_seqs_.push_back(r->seq);
+        r->seq = -1;
+        r->n_past = 0;
+    }
+
+    void remove_running(Request* r) {
+        for (size_t i = 0; i < running_.size(); i++) {
+            if (running_[i].get() == r) {
+                release(r);
+                running_.erase(running_.begin() + i);
+                return;
+            }
+        }
+    }
+
+    /**
+     * Move the most recently admitted sequence back to the front of the queue
+     * (running_ is sorted by admission during a step)
+     */
+    void preempt_youngest() {
+        std::unique_ptr<Request> r = std::move(running_.back());
+        running_.pop_back();
+        release(r.get());
+        r->preemptions++;
+        stats_.preemptions++;
+        waiting_.push_front(std::move(r));
+    }
+
+    void finish(Request* r) {
+        const int64_t now = now_us();
+        char buf[256];
+        snprintf(buf, sizeof(buf),
+                 "{\"id\":%lld,\"done\":true,\"prompt_tokens\":%d,\"generated\":%d,\"preemptions\":%d,"
+                 "\"queue_ms\":%.3f,\"ttft_ms\":%.3f,\"total_ms\":%.3f}",
+                 (long long) r->id, r->n_prompt, r->n_generated, r->preemptions,
+                 (r->t_admitted - r->t_arrival) / 1000.0,
+                 r->t_first_token > 0 ? (r->t_first_token - r->t_arrival) / 1000.0 : 0.0,
+                 (now - r->t_arrival) / 1000.0);
+        reply(r->conn, buf);
+        stats_.completed++;
+        remove_running(r);
+    }
+
+    void fail(Request* r, const char* error) {
+        reply(r->conn, "{\"id\":" + std::to_string(r->id) + ",\"error\":\"" + error + "\"}");
+        remove_running(r);
+    }
+
+    std::string stats_json() const {
+        char buf[512];
+        snprintf(buf, sizeof(buf),
+                 "{\"stats\":{\"steps\":%lld,\"batch_tokens\":%lld,\"decode_tokens\":%lld,\"prefill_tokens\":%lld,"
+                 "\"preemptions\":%lld,\"completed\":%lld,\"rejected\":%lld,\"decode_ms\":%.3f,"
+                 "\"running\":%zu,\"waiting\":%zu}}",
+                 (long long) stats_.steps, (long long) stats_.batch_tokens, (long long) stats_.decode_tokens,
+                 (long long) stats_.prefill_tokens, (long long) stats_.preemptions, (long long) stats_.completed,
+                 (long long) stats_.rejected, stats_.decode_us / 1000.0, running_.size(), waiting_.size());
+        return buf;
+    }
+};
+
+bool parse_options(int argc, char** argv, Options& opts) {
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--model") && has_value) {
+            opts.model = argv[++i];
+        } else if (!strcmp(argv[i], "--socket") && has_value) {
+            opts.socket = argv[++i];
+        } else if (!strcmp(argv[i], "--ctx") && has_value) {
+            opts.n_ctx = std::max(64, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--parallel") && has_value) {
+            opts.n_parallel = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--batch") && has_value) {
+            opts.n_batch = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--threads") && has_value) {
+            opts.n_threads = std::max(1, atoi(argv[++i]));
+        } else {
+            opts.model.clear();
+            break;
+        }
+    }
+    if (opts.model.empty()) {
+        fprintf(stderr, "usage: %s --model PATH [--socket PATH] [--ctx 4096] [--parallel 8] "
+                        "[--batch 512] [--threads N]\n", argv[0]);
+        return false;
+    }
+    if (opts.n_threads == 0) opts.n_threads = (int) std::max(1u, std::thread::hardware_concurrency());
+    return true;
+}
+
+int listen_unix(const std::string& path) {
+    sockaddr_un addr = {};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", path.c_str());
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(path.c_str()); // Left over from a previous run
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (sockaddr*) &addr, sizeof(addr)) != 0 || listen(fd, 128) != 0) {
+        fprintf(stderr, "cannot listen on %s: %s\n", path.c_str(), strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parse_options(argc, argv, opts)) return 2;
+
+    signal(SIGINT, [](int) { g_stop = 1; });
+    signal(SIGTERM, [](int) { g_stop = 1; });
+    signal(SIGPIPE, SIG_IGN);
+
+    llama_backend_init();
+    // Registers the best CPU variant when backends are built as loadable modules
+    ggml_backend_load_all();
+    llama_model* model = llama_model_load_from_file(opts.model.c_str(), llama_model_default_params());
+    if (!model) {
+        fprintf(stderr, "failed to load %s\n", opts.model.c_str());
+        return 1;
+    }
+    llama_context_params params = llama_context_default_params();
+    params.n_ctx = (uint32_t) opts.n_ctx;
+    params.n_batch = (uint32_t) opts.n_batch;
+    params.n_ubatch = (uint32_t) std::min(opts.n_batch, 512);
+    params.n_seq_max = (uint32_t) opts.n_parallel;
+    params.n_threads = opts.n_threads;
+    params.n_threads_batch = opts.n_threads;
+    params.kv_unified = true; // One pool of --ctx cells for all sequences, not --ctx / --parallel each
+    params.no_perf = true;
+    llama_context* ctx = llama_init_from_model(model, params);
+    if (!ctx) {
+        fprintf(stderr, "failed to create the context\n");
+        llama_model_free(model);
+        return 1;
+    }
+
+    const int listen_fd = listen_unix(opts.socket);
+    if (listen_fd < 0) {
+        llama_free(ctx);
+        llama_model_free(model);
+        return 1;
+    }
+    LOGI("server: %s on %s, ctx %d, parallel %d, batch %d, %d threads", opts.model.c_str(), opts.socket.c_str(),
+         opts.n_ctx, opts.n_parallel, opts.n_batch, opts.n_threads);
+
+    {
+        Server server(model, ctx, opts);
+        std::vector<pollfd> fds;
+        std::vector<uint64_t> ids;
+        int64_t t_report = now_us();
+        while (!g_stop) {
+            fds.assign(1, {listen_fd, POLLIN, 0});
+            ids.assign(1, 0);
+            server.fill_pollfds(fds, ids);
+            // Between steps only look at the sockets; block when there is no work
+            if (poll(fds.data(), fds.size(), server.busy() ? 0 : 1000) < 0 && errno != EINTR) break;
+
+            if (fds[0].revents & POLLIN) {
+                int fd;
+                while ((fd = accept(listen_fd, nullptr, nullptr)) >= 0) server.add_connection(fd);
+            }
+            for (size_t i = 1; i < fds.size(); i++) {
+                bool ok = true;
+                if (fds[i].revents & POLLIN) ok = server.on_readable(ids[i]);
+                if (ok && (fds[i].revents & POLLOUT)) ok = server.flush(ids[i]);
+                if (!ok || (fds[i].revents & (POLLERR | POLLNVAL))) server.drop_connection(ids[i]);
+            }
+
+            if (server.busy()) {
+                server.step();
+                server.flush_all(); // Stream the new tokens right away
+            }
+            if (now_us() - t_report > 10 * 1000000LL) {
+                const Stats& s = server.stats();
+                LOGI("server: %lld steps, %.1f tokens/step, %lld done, %lld preemptions", (long long) s.steps,
+                     s.steps > 0 ? (double) s.batch_tokens / s.steps : 0.0, (long long) s.completed,
+                     (long long) s.preemptions);
+                t_report = now_us();
+            }
+        }
+    }
+
+    close(listen_fd);
+    unlink(opts.socket.c_str());
+    llama_free(ctx);
+    llama_model_free(model);
+    llama_backend_free();
+    return 0;
+}
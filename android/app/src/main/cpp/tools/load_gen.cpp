@@ -0,0 +1,354 @@
+// Load generator for ng_server.
+//
+// Offers requests at fixed rates with Poisson (exponential) inter-arrival
+// times, open loop: a request is sent at its arrival time whether or not the
+// earlier ones have finished, as independent clients would. Each request gets
+// its own connection and its tokens are read as they stream. For every rate it
+// reports request latency and time-to-first-token percentiles, the aggregate
+// generated tok/s and, from the server's counters, the mean tokens per batch
+// step and the preemptions. Past the knee the latencies climb while tok/s
+// flattens: that is the capacity of the device for the model.
+//
+// Run next to a running server:
+//   adb shell /data/local/tmp/ng_loadgen --rates 0.5,1,2,4 --duration 30
+// Options:
+//   --socket PATH     server socket (default /data/local/tmp/ng_server.sock)
+//   --rates 1,2,4     offered loads in requests per second
+//   --duration 20     seconds of arrivals per rate
+//   --n-predict 64    tokens to generate per request
+//   --prompt TEXT     prompt of every request
+//   --seed 1          arrival process seed
+//   --json            one JSON object per rate instead of a table
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <poll.h>
+#include <random>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../native_common.h"
+#include "mini_json.h"
+
+namespace {
+
+#ifdef __ANDROID__
+const char* kDefaultSocket = "/data/local/tmp/ng_server.sock";
+#else
+const char* kDefaultSocket = "/tmp/ng_server.sock";
+#endif
+
+// Requests still streaming this long after the last arrival count as errors
+const int64_t kDrainTimeoutUs = 120 * 1000000LL;
+
+struct Options {
+    std::string socket = kDefaultSocket;
+    std::vector<double> rates = {1.0, 2.0, 4.0};
+    double duration_s = 20.0;
+    int n_predict = 64;
+    std::string prompt = "Once upon a time, in a small village by the sea, there lived";
+    unsigned seed = 1;
+    bool json = false;
+};
+
+struct Pending {
+    int fd = -1;
+    int64_t t_send = 0;
+    int64_t t_first = 0;
+    int64_t t_done = 0;
+    int tokens = 0;
+    int preemptions = 0;
+    double queue_ms = 0.0;
+    bool error = false;
+    std::string in;
+};
+
+struct LevelReport {
+    double rate = 0.0;
+    int sent = 0;
+    int completed = 0;
+    int errors = 0;
+    double elapsed_s = 0.0;
+    double achieved_rps = 0.0;
+    double tokens_per_s = 0.0;
+    double latency_ms[3] = {};  // p50, p90, p99
+    double ttft_ms[3] = {};
+    double queue_p50_ms = 0.0;
+    double tokens_per_step = 0.0;
+    int64_t preemptions = 0;
+};
+
+int connect_unix(const std::string& path) {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (sockaddr*) &addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool send_line(int fd, const std::string& line) {
+    const std::string data = line + "\n";
+    size_t off = 0;
+    while (off < data.size()) {
+        const ssize_t n = send(fd, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        off += (size_t) n;
+    }
+    return true;
+}
+
+/**
+ * Server counters ({"stats":{...}}), or an empty object if the server is not there
+ */
+JsonValue query_stats(const std::string& path) {
+    JsonValue stats;
+    const int fd = connect_unix(path);
+    if (fd < 0 || !send_line(fd, "{\"cmd\":\"stats\"}")) {
+        if (fd >= 0) close(fd);
+        return stats;
+    }
+    std::string line;
+    char c;
+    while (recv(fd, &c, 1, 0) == 1 && c != '\n') line += c;
+    close(fd);
+    JsonValue reply;
+    if (JsonParser(line).parse(reply) && reply.get("stats")) stats = *reply.get("stats");
+    return stats;
+}
+
+/**
+ * Percentile with linear interpolation between the closest ranks
+ */
+double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    const double rank = p / 100.0 * (v.size() - 1);
+    const size_t lo = (size_t) rank;
+    const size_t hi = std::min(lo + 1, v.size() - 1);
+    return v[lo] + (v[hi] - v[lo]) * (rank - lo);
+}
+
+/**
+ * Handle one reply line of a request
+ */
+void on_reply(Pending& req, const std::string& line) {
+    JsonValue msg;
+    if (!JsonParser(line).parse(msg) || msg.get("error")) {
+        req.error = true;
+        req.t_done = now_us();
+        return;
+    }
+    if (msg.get("text")) {
+        if (req.t_first == 0) req.t_first = now_us();
+        req.tokens++;
+    } else if (msg.get("done")) {
+        req.t_done = now_us();
+        req.tokens = (int) json_number(msg, "generated", req.tokens);
+        req.preemptions = (int) json_number(msg, "preemptions");
+        req.queue_ms = json_number(msg, "queue_ms");
+    }
+}
+
+LevelReport run_level(const Options& opts, double rate, std::mt19937& rng) {
+    LevelReport report;
+    report.rate = rate;
+    const JsonValue stats_before = query_stats(opts.socket);
+
+    std::exponential_distribution<double> gap(rate);
+    std::vector<int64_t> arrivals;
+    for (double t = gap(rng); t < opts.duration_s; t += gap(rng)) arrivals.push_back((int64_t) (t * 1e6));
+
+    std::string request_prefix = "{\"prompt\":\"" + json_escape(opts.prompt) +
+                                 "\",\"n_predict\":" + std::to_string(opts.n_predict) + ",\"id\":";
+    std::vector<Pending> reqs(arrivals.size());
+    size_t next = 0;
+    int open = 0;
+    const int64_t t_start = now_us();
+    std::vector<pollfd> fds;
+    std::vector<size_t> owners;
+
+    while (next < arrivals.size() || open > 0) {
+        const int64_t now = now_us() - t_start;
+        if (next == arrivals.size() && now > arrivals.back() + kDrainTimeoutUs) break;
+
+        // Send everything that has arrived
+        while (next < arrivals.size() && arrivals[next] <= now) {
+            Pending& req = reqs[next];
+            req.t_send = now_us();
+            req.fd = connect_unix(opts.socket);
+            if (req.fd < 0 || !send_line(req.fd, request_prefix + std::to_string(next) + "}")) {
+                req.error = true;
+                if (req.fd >= 0) close(req.fd);
+                req.fd = -1;
+            } else {
+                open++;
+            }
+            next++;
+        }
+
+        fds.clear();
+        owners.clear();
+        for (size_t i = 0; i < next; i++) {
+            if (reqs[i].fd < 0) continue;
+            fds.push_back({reqs[i].fd, POLLIN, 0});
+            owners.push_back(i);
+        }
+        const int64_t wait_us = next < arrivals.size() ? arrivals[next] - (now_us() - t_start) : 100000;
+        if (fds.empty() && next < arrivals.size()) {
+            usleep((useconds_t) std::max<int64_t>(0, wait_us));
+            continue;
+        }
+        poll(fds.data(), fds.size(), (int) std::max<int64_t>(0, std::min<int64_t>(wait_us, 100000) / 1000));
+
+        for (size_t k = 0; k < fds.size(); k++) {
+            if (!(fds[k].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            Pending& req = reqs[owners[k]];
+            char buf[8192];
+            const ssize_t n = recv(req.fd, buf, sizeof(buf), 0);
+            if (n <= 0) {
+                if (req.t_done == 0) req.error = true; // Server went away mid-request
+            } else {
+                req.in.append(buf, (size_t) n);
+                size_t nl;
+                while (req.t_done == 0 && (nl = req.in.find('\n')) != std::string::npos) {
+                    on_reply(req, req.in.substr(0, nl));
+                    req.in.erase(0, nl + 1);
+                }
+            }
+            if (n <= 0 || req.t_done != 0) {
+                close(req.fd);
+                req.fd = -1;
+                open--;
+            }
+        }
+    }
+
+    std::vector<double> latency, ttft, queue;
+    int64_t t_last = t_start;
+    int64_t tokens = 0;
+    for (Pending& req : reqs) {
+        if (req.fd >= 0) {
+            close(req.fd); // Timed out
+            req.error = true;
+        }
+        report.sent++;
+        if (req.error || req.t_done == 0) {
+            report.errors++;
+            continue;
+        }
+        report.completed++;
+        tokens += req.tokens;
+        latency.push_back((req.t_done - req.t_send) / 1000.0);
+        if (req.t_first > 0) ttft.push_back((req.t_first - req.t_send) / 1000.0);
+        queue.push_back(req.queue_ms);
+        t_last = std::max(t_last, req.t_done);
+    }
+    report.elapsed_s = (t_last - t_start) / 1e6;
+    if (report.elapsed_s > 0) {
+        report.achieved_rps = report.completed / report.elapsed_s;
+        report.tokens_per_s = tokens / report.elapsed_s;
+    }
+    const double ps[3] = {50.0, 90.0, 99.0};
+    for (int i = 0; i < 3; i++) {
+        report.latency_ms[i] = percentile(latency, ps[i]);
+        report.ttft_ms[i] = percentile(ttft, ps[i]);
+    }
+    report.queue_p50_ms = percentile(queue, 50.0);
+
+    const JsonValue stats_after = query_stats(opts.socket);
+    const double steps = json_number(stats_after, "steps") - json_number(stats_before, "steps");
+    const double batch_tokens = json_number(stats_after, "batch_tokens") - json_number(stats_before, "batch_tokens");
+    report.tokens_per_step = steps > 0 ? batch_tokens / steps : 0.0;
+    report.preemptions = (int64_t) (json_number(stats_after, "preemptions") - json_number(stats_before, "preemptions"));
+    return report;
+}
+
+void print_report(const Options& opts, const LevelReport& r) {
+    if (opts.json) {
+        printf("{\"rate\":%.3f,\"sent\":%d,\"completed\":%d,\"errors\":%d,\"elapsed_s\":%.3f,"
+               "\"achieved_rps\":%.3f,\"tokens_per_s\":%.2f,\"latency_ms\":{\"p50\":%.2f,\"p90\":%.2f,\"p99\":%.2f},"
+               "\"ttft_ms\":{\"p50\":%.2f,\"p90\":%.2f,\"p99\":%.2f},\"queue_p50_ms\":%.2f,"
+               "\"tokens_per_step\":%.2f,\"preemptions\":%lld}\n",
+               r.rate, r.sent, r.completed, r.errors, r.elapsed_s, r.achieved_rps, r.tokens_per_s,
+               r.latency_ms[0], r.latency_ms[1], r.latency_ms[2], r.ttft_ms[0], r.ttft_ms[1], r.ttft_ms[2],
+               r.queue_p50_ms, r.tokens_per_step, (long long) r.preemptions);
+    } else {
+        printf("%7.2f %6d %6d %5d %8.2f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %8.1f %6.1f %7lld\n", r.rate, r.sent,
+               r.completed, r.errors, r.achieved_rps, r.tokens_per_s, r.latency_ms[0], r.latency_ms[1],
+               r.latency_ms[2], r.ttft_ms[0], r.ttft_ms[2], r.queue_p50_ms, r.tokens_per_step,
+               (long long) r.preemptions);
+    }
+    fflush(stdout);
+}
+
+bool parse_options(int argc, char** argv, Options& opts) {
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--socket") && has_value) {
+            opts.socket = argv[++i];
+        } else if (!strcmp(argv[i], "--rates") && has_value) {
+            opts.rates.clear();
+            std::stringstream ss(argv[++i]);
+            std::string item;
+            while (std::getline(ss, item, ',')) {
+                const double rate = atof(item.c_str());
+                if (rate > 0) opts.rates.push_back(rate);
+            }
+        } else if (!strcmp(argv[i], "--duration") && has_value) {
+            opts.duration_s = std::max(0.1, atof(argv[++i]));
+        } else if (!strcmp(argv[i], "--n-predict") && has_value) {
+            opts.n_predict = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--prompt") && has_value) {
+            opts.prompt = argv[++i];
+        } else if (!strcmp(argv[i], "--seed") && has_value) {
+            opts.seed = (unsigned) atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--json")) {
+            opts.json = true;
+        } else {
+            opts.rates.clear();
+            break;
+        }
+    }
+    if (opts.rates.empty()) {
+        fprintf(stderr, "usage: %s [--socket PATH] [--rates 1,2,4] [--duration 20] [--n-predict 64] "
+                        "[--prompt TEXT] [--seed 1] [--json]\n", argv[0]);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parse_options(argc, argv, opts)) return 2;
+
+    const int probe = connect_unix(opts.socket);
+    if (probe < 0) {
+        fprintf(stderr, "no server on %s: %s\n", opts.socket.c_str(), strerror(errno));
+        return 1;
+    }
+    close(probe);
+
+    if (!opts.json) {
+        printf("%7s %6s %6s %5s %8s %9s %9s %9s %9s %9s %9s %8s %6s %7s\n", "req/s", "sent", "done", "err",
+               "done/s", "tok/s", "lat p50", "lat p90", "lat p99", "ttft p50", "ttft p99", "queue", "tok/st",
+               "preempt");
+    }
+    std::mt19937 rng(opts.seed);
+    for (const double rate : opts.rates) print_report(opts, run_level(opts, rate, rng));
+    return 0;
+}
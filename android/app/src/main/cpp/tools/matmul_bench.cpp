@@ -0,0 +1,277 @@
+// Quantized matmul microbenchmark.
+//
+// Times ggml mat-vec (decode) and mat-mat (prefill) products with weights in
+// Q2_K, Q4_0, Q4_K, Q8_0 and F16, on the per-layer shapes of the models the app
+// ships, for several thread counts. Isolates the quantized dot-product kernels
+// from the rest of llama.cpp, so a kernel regression shows up without a model.
+//
+// Build with -DNEURAL_GAUGE_BUILD_TOOLS=ON, push to a device and run:
+//   adb push ng_matmul_bench /data/local/tmp && adb shell /data/local/tmp/ng_matmul_bench
+// Options:
+//   --threads 1,2,4,8   thread counts (default 1,2,4 and all cores)
+//   --types q4_0,f16    weight types (default q2_k,q4_0,q4_k,q8_0,f16)
+//   --models tinyllama  shape sets (tinystories, tinyllama, gemma2)
+//   --batch 64          columns of the mat-mat product
+//   --reps 10           measured repetitions per case (after one warm-up)
+//   --json              one JSON object per case instead of a table
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ggml.h"
+#include "ggml-alloc.h"
+#include "ggml-backend.h"
+
+#include "../bench_stats.h"
+#include "../native_common.h"
+
+namespace {
+
+struct LayerShape {
+    const char* model;
+    const char* name;
+    int64_t k; // Input features (row length of the weight)
+    int64_t m; // Output features
+};
+
+// Per-layer weight shapes (attention K/V use the GQA width)
+const LayerShape kShapes[] = {
+    {"tinystories", "attn_qkvo", 128, 128},
+    {"tinystories", "ffn_up",    128, 512},
+    {"tinystories", "ffn_down",  512, 128},
+    {"tinyllama",   "attn_q",    2048, 2048},
+    {"tinyllama",   "attn_kv",   2048, 256},
+    {"tinyllama",   "ffn_up",    2048, 5632},
+    {"tinyllama",   "ffn_down",  5632, 2048},
+    {"gemma2",      "attn_q",    2304, 2048},
+    {"gemma2",      "attn_kv",   2304, 1024},
+    {"gemma2",      "attn_out",  2048, 2304},
+    {"gemma2",      "ffn_up",    2304, 9216},
+    {"gemma2",      "ffn_down",  9216, 2304},
+};
+
+struct Options {
+    std::vector<int> threads;
+    std::vector<ggml_type> types = {GGML_TYPE_Q2_K, GGML_TYPE_Q4_0, GGML_TYPE_Q4_K, GGML_TYPE_Q8_0, GGML_TYPE_F16};
+    std::vector<std::string> models = {"tinystories", "tinyllama", "gemma2"};
+    int batch = 64;
+    int reps = 10;
+    bool json = false;
+};
+
+std::vector<std::string> split(const char* arg) {
+    std::vector<std::string> out;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) out.push_back(item);
+    }
+    return out;
+}
+
+bool parse_type(const std::string& name, ggml_type& out) {
+    static const struct { const char* name; ggml_type type; } kTypes[] = {
+        {"q2_k", GGML_TYPE_Q2_K}, {"q4_0", GGML_TYPE_Q4_0}, {"q4_k", GGML_TYPE_Q4_K},
+        {"q8_0", GGML_TYPE_Q8_0}, {"f16", GGML_TYPE_F16}, {"q5_k", GGML_TYPE_Q5_K},
+        {"q6_k", GGML_TYPE_Q6_K}, {"f32", GGML_TYPE_F32},
+    };
+    for (const auto& t : kTypes) {
+        if (name == t.name) {
+            out = t.type;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_options(int argc, char** argv, Options& opts) {
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--threads") && has_value) {
+            opts.threads.clear();
+            for (const std::string& t : split(argv[++i])) opts.threads.push_back(std::max(1, atoi(t.c_str())));
+        } else if (!strcmp(argv[i], "--types") && has_value) {
+            opts.types.clear();
+            for (const std::string& t : split(argv[++i])) {
+                ggml_type type;
+                if (!parse_type(t, type)) {
+                    fprintf(stderr, "unknown type: %s\n", t.c_str());
+                    return false;
+                }
+                opts.types.push_back(type);
+            }
+        } else if (!strcmp(argv[i], "--models") && has_value) {
+            opts.models = split(argv[++i]);
+        } else if (!strcmp(argv[i], "--batch") && has_value) {
+            opts.batch = std::max(2, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--reps") && has_value) {
+            opts.reps = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--json")) {
+            opts.json = true;
+        } else {
+            fprintf(stderr, "usage: %s [--threads 1,4] [--types q4_0,f16] [--models tinyllama] "
+                            "[--batch 64] [--reps 10] [--json]\n", argv[0]);
+            return false;
+        }
+    }
+    if (opts.threads.empty()) {
+        const int cores = (int) std::max(1u, std::thread::hardware_concurrency());
+        for (int t : {1, 2, 4}) {
+            if (t < cores) opts.threads.push_back(t);
+        }
+        opts.threads.push_back(cores);
+    }
+    return true;
+}
+
+struct CaseResult {
+    SampleStats time_us;
+    double gflops = 0.0;
+    double gbps = 0.0;
+};
+
+/**
+ * Time one graph: one warm-up compute, then reps measured ones.
+ * GFLOPS and GB/s are from the median time; bytes are weights + activations in/out.
+ */
+CaseResult time_graph(ggml_backend_t backend, ggml_cgraph* graph, int reps,
+                      double flops, double bytes) {
+    ggml_backend_graph_compute(backend, graph);
+    std::vector<double> samples;
+    for (int r = 0; r < reps; r++) {
+        const int64_t t0 = now_us();
+        ggml_backend_graph_compute(backend, graph);
+        samples.push_back((double) (now_us() - t0));
+    }
+    CaseResult result;
+    result.time_us = compute_sample_stats(samples);
+    if (result.time_us.median > 0) {
+        result.gflops = flops / (result.time_us.median * 1e3);
+        result.gbps = bytes / (result.time_us.median * 1e3);
+    }
+    return result;
+}
+
+void print_case(const Options& opts, const LayerShape& shape, ggml_type type, int threads,
+                const char* product, int n, const CaseResult& r) {
+    if (opts.json) {
+        printf("{\"model\":\"%s\",\"layer\":\"%s\",\"k\":%lld,\"m\":%lld,\"n\":%d,\"type\":\"%s\","
+               "\"product\":\"%s\",\"threads\":%d,\"median_us\":%.1f,\"ci95_low_us\":%.1f,"
+               "\"ci95_high_us\":%.1f,\"outliers\":%d,\"gflops\":%.2f,\"gbps\":%.2f}\n",
+               shape.model, shape.name, (long long) shape.k, (long long) shape.m, n, ggml_type_name(type),
+               product, threads, r.time_us.median, r.time_us.ci95_low, r.time_us.ci95_high,
+               r.time_us.n_outliers, r.gflops, r.gbps);
+    } else {
+        printf("%-12s %-10s %5lldx%-5lld %-5s %-7s %3d %10.1f %9.2f %8.2f\n",
+               shape.model, shape.name, (long long) shape.k, (long long) shape.m, ggml_type_name(type),
+               product, threads, r.time_us.median, r.gflops, r.gbps);
+    }
+    fflush(stdout);
+}
+
+/**
+ * Quantize random weights for one shape/type and time mat-vec and mat-mat products
+ */
+bool run_shape(ggml_backend_t backend, ggml_backend_set_n_threads_t set_threads, const Options& opts,
+               const LayerShape& shape, ggml_type type) {
+    if (shape.k % ggml_blck_size(type) != 0) {
+        // llama.cpp falls back to another type for such tensors too
+        if (!opts.json) {
+            printf("%-12s %-10s %5lldx%-5lld %-5s skipped: row length not a multiple of %lld\n",
+                   shape.model, shape.name, (long long) shape.k, (long long) shape.m,
+                   ggml_type_name(type), (long long) ggml_blck_size(type));
+        }
+        return true;
+    }
+
+    ggml_init_params params = {
+        /*.mem_size   =*/ ggml_tensor_overhead() * 8 + ggml_graph_overhead() * 2,
+        /*.mem_buffer =*/ nullptr,
+        /*.no_alloc   =*/ true,
+    };
+    ggml_context* ctx = ggml_init(params);
+    ggml_tensor* weight = ggml_new_tensor_2d(ctx, type, shape.k, shape.m);
+    ggml_tensor* vec = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, shape.k, 1);
+    ggml_tensor* mat = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, shape.k, opts.batch);
+    ggml_cgraph* gf_vec = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf_vec, ggml_mul_mat(ctx, weight, vec));
+    ggml_cgraph* gf_mat = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf_mat, ggml_mul_mat(ctx, weight, mat));
+
+    ggml_backend_buffer_t buffer = ggml_backend_alloc_ctx_tensors(ctx, backend);
+    if (!buffer) {
+        fprintf(stderr, "out of memory for %s %s %s\n", shape.model, shape.name, ggml_type_name(type));
+        ggml_free(ctx);
+        return false;
+    }
+
+    std::mt19937 rng(42);
+    std::normal_distribution<float> dist(0.0f, 0.02f);
+    std::vector<float> f32((size_t) (shape.k * std::max<int64_t>(shape.m, opts.batch)));
+    for (float& v : f32) v = dist(rng);
+
+    ggml_quantize_init(type);
+    std::vector<uint8_t> quantized(ggml_nbytes(weight));
+    ggml_quantize_chunk(type, f32.data(), quantized.data(), 0, shape.m, shape.k, nullptr);
+    ggml_backend_tensor_set(weight, quantized.data(), 0, quantized.size());
+    ggml_backend_tensor_set(vec, f32.data(), 0, ggml_nbytes(vec));
+    ggml_backend_tensor_set(mat, f32.data(), 0, ggml_nbytes(mat));
+
+    const double weight_bytes = (double) ggml_nbytes(weight);
+    for (const int threads : opts.threads) {
+        if (set_threads) set_threads(backend, threads);
+        for (const int n : {1, opts.batch}) {
+            const double flops = 2.0 * shape.k * shape.m * n;
+            const double bytes = weight_bytes + 4.0 * (shape.k + shape.m) * n;
+            const CaseResult r = time_graph(backend, n == 1 ? gf_vec : gf_mat, opts.reps, flops, bytes);
+            print_case(opts, shape, type, threads, n == 1 ? "mat-vec" : "mat-mat", n, r);
+        }
+    }
+
+    ggml_backend_buffer_free(buffer);
+    ggml_free(ctx);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parse_options(argc, argv, opts)) return 2;
+
+    // Registers the best CPU variant when backends are built as loadable modules
+    ggml_backend_load_all();
+    ggml_backend_t backend = ggml_backend_init_by_type(GGML_BACKEND_DEVICE_TYPE_CPU, nullptr);
+    if (!backend) {
+        fprintf(stderr, "no CPU backend available\n");
+        return 1;
+    }
+    ggml_backend_dev_t dev = ggml_backend_get_device(backend);
+    ggml_backend_reg_t reg = ggml_backend_dev_backend_reg(dev);
+    auto set_threads = (ggml_backend_set_n_threads_t) ggml_backend_reg_get_proc_address(
+        reg, "ggml_backend_set_n_threads");
+
+    if (!opts.json) {
+        printf("backend: %s (%s), batch %d, %d reps\n", ggml_backend_name(backend),
+               ggml_backend_dev_description(dev), opts.batch, opts.reps);
+        printf("%-12s %-10s %-11s %-5s %-7s %3s %10s %9s %8s\n",
+               "model", "layer", "KxM", "type", "product", "thr", "median_us", "GFLOPS", "GB/s");
+    }
+
+    bool ok = true;
+    for (const LayerShape& shape : kShapes) {
+        if (std::find(opts.models.begin(), opts.models.end(), shape.model) == opts.models.end()) continue;
+        for (const ggml_type type : opts.types) {
+            ok = run_shape(backend, set_threads, opts, shape, type) && ok;
+        }
+    }
+
+    ggml_backend_free(backend);
+    return ok ? 0 : 1;
+}
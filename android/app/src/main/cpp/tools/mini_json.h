@@ -0,0 +1,148 @@
+#pragma once
+
+// Minimal JSON reader for the host tools: the result exports of ng_regress and
+// the line protocol of ng_server / ng_loadgen. Not a general parser: \u escapes
+// outside ASCII become '?', and numbers are doubles.
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+// Objects, arrays, strings, numbers and literals
+struct JsonValue {
+    enum Type { kNull, kBool, kNumber, kString, kArray, kObject } type = kNull;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::map<std::string, JsonValue> object; // Sorted keys give a canonical form for free
+
+    const JsonValue* get(const char* key) const {
+        auto it = object.find(key);
+        return it != object.end() ? &it->second : nullptr;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text) : s_(text) {}
+
+    bool parse(JsonValue& out) {
+        if (!value(out)) return false;
+        skip_ws();
+        return pos_ == s_.size();
+    }
+
+private:
+    const std::string& s_;
+    size_t pos_ = 0;
+
+    void skip_ws() {
+        while (pos_ < s_.size() && isspace((unsigned char) s_[pos_])) pos_++;
+    }
+
+    bool literal(const char* word) {
+        const size_t len = strlen(word);
+        if (s_.compare(pos_, len, word) != 0) return false;
+        pos_ += len;
+        return true;
+    }
+
+    bool string(std::string& out) {
+        if (s_[pos_] != '"') return false;
+        pos_++;
+        while (pos_ < s_.size() && s_[pos_] != '"') {
+            char c = s_[pos_++];
+            if (c == '\\' && pos_ < s_.size()) {
+                c = s_[pos_++];
+                switch (c) {
+                    case 'n': c = '\n'; break;
+                    case 't': c = '\t'; break;
+                    case 'r': c = '\r'; break;
+                    case 'b': c = '\b'; break;
+                    case 'f': c = '\f'; break;
+                    case 'u': {
+                        // Device and model names are ASCII; keep anything else as '?'
+                        if (pos_ + 4 > s_.size()) return false;
+                        const long code = strtol(s_.substr(pos_, 4).c_str(), nullptr, 16);
+                        pos_ += 4;
+                        c = code < 0x80 ? (char) code : '?';
+                        break;
+                    }
+                    default: break; // '"', '\\' and '/' stand for themselves
+                }
+            }
+            out += c;
+        }
+        if (pos_ >= s_.size()) return false;
+        pos_++;
+        return true;
+    }
+
+    bool value(JsonValue& out) {
+        skip_ws();
+        if (pos_ >= s_.size()) return false;
+        const char c = s_[pos_];
+        if (c == '{') {
+            out.type = JsonValue::kObject;
+            pos_++;
+            skip_ws();
+            if (pos_ < s_.size() && s_[pos_] == '}') return ++pos_, true;
+            while (true) {
+                skip_ws();
+                std::string key;
+                if (pos_ >= s_.size() || !string(key)) return false;
+                skip_ws();
+                if (pos_ >= s_.size() || s_[pos_++] != ':') return false;
+                if (!value(out.object[key])) return false;
+                skip_ws();
+                if (pos_ >= s_.size()) return false;
+                if (s_[pos_] == ',') { pos_++; continue; }
+                return s_[pos_++] == '}';
+            }
+        }
+        if (c == '[') {
+            out.type = JsonValue::kArray;
+            pos_++;
+            skip_ws();
+            if (pos_ < s_.size() && s_[pos_] == ']') return ++pos_, true;
+            while (true) {
+                out.array.emplace_back();
+                if (!value(out.array.back())) return false;
+                skip_ws();
+                if (pos_ >= s_.size()) return false;
+                if (s_[pos_] == ',') { pos_++; continue; }
+                return s_[pos_++] == ']';
+            }
+        }
+        if (c == '"') {
+            out.type = JsonValue::kString;
+            return string(out.string);
+        }
+        if (literal("true") || literal("false")) {
+            out.type = JsonValue::kBool;
+            out.boolean = c == 't';
+            return true;
+        }
+        if (literal("null")) return true;
+        char* end = nullptr;
+        out.type = JsonValue::kNumber;
+        out.number = strtod(s_.c_str() + pos_, &end);
+        if (end == s_.c_str() + pos_) return false;
+        pos_ = end - s_.c_str();
+        return true;
+    }
+};
+
+inline std::string json_string(const JsonValue& v, const char* key, const std::string& fallback = "") {
+    const JsonValue* f = v.get(key);
+    return f && f->type == JsonValue::kString ? f->string : fallback;
+}
+
+inline double json_number(const JsonValue& v, const char* key, double fallback = 0.0) {
+    const JsonValue* f = v.get(key);
+    return f && f->type == JsonValue::kNumber ? f->number : fallback;
+}
@@ -0,0 +1,49 @@
+// Content manifest generator for model downloads.
+//
+// Hashes a GGUF into the chunked Merkle manifest of model_hash.cpp, the same
+// one the app builds. Run it on the file that gets published and publish the
+// manifest next to it (ModelType.manifestUrl): the app fetches it before the
+// download and checks every chunk it receives against it, which a manifest the
+// app records from its own copy can't do.
+//
+// Build with -DNEURAL_GAUGE_BUILD_TOOLS=ON (host build) and run:
+//   ng_manifest MODEL.gguf [MODEL.gguf.manifest] [--chunk-mb 4]
+// Prints the JSON hash report. Exit status: 0 ok, 1 hashing failed, 2 bad arguments.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+extern "C" const char* hash_model_create_manifest(const char* model_path, const char* manifest_path,
+                                                  int32_t chunk_size_mb);
+
+int main(int argc, char** argv) {
+    std::string model, manifest;
+    int chunk_mb = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--chunk-mb") == 0 && i + 1 < argc) {
+            chunk_mb = atoi(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        } else if (model.empty()) {
+            model = argv[i];
+        } else if (manifest.empty()) {
+            manifest = argv[i];
+        } else {
+            fprintf(stderr, "too many arguments\n");
+            return 2;
+        }
+    }
+    if (model.empty() || chunk_mb < 0) {
+        fprintf(stderr, "usage: ng_manifest MODEL.gguf [MANIFEST] [--chunk-mb N]\n");
+        return 2;
+    }
+    if (manifest.empty()) manifest = model + ".manifest";
+
+    const char* report = hash_model_create_manifest(model.c_str(), manifest.c_str(), chunk_mb);
+    printf("%s\n", report);
+    return strstr(report, "\"status\":\"ok\"") != nullptr ? 0 : 1;
+}
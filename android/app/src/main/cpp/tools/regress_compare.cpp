@@ -0,0 +1,259 @@
+// Benchmark regression comparator.
+//
+// Reads two sets of result files (the JSONL export of the benchmark history,
+// one run per line), groups the runs of each set by device, model, CPU variant
+// and engine config, and compares matching groups with a Mann-Whitney U test:
+// decode throughput over the repetition samples (tokens_per_second for runs
+// saved without them) and decode step latency over the pooled per-step times.
+// A metric regresses when its median moved the wrong way by more than the
+// threshold and the difference is significant, so noisy devices need a real
+// shift before they fail. Meant to gate engine upgrades on a desktop or CI box:
+// thousands of runs take well under a second.
+//
+// Build with -DNEURAL_GAUGE_BUILD_TOOLS=ON (host build) and run:
+//   ng_regress [options] BASELINE.jsonl[,more.jsonl] CANDIDATE.jsonl[,more.jsonl]
+// Options:
+//   --threshold 5   regression threshold, percent change of the median (default 5)
+//   --alpha 0.01    significance level of the two-sided test (default 0.01)
+//   --json          one JSON object per comparison instead of a table
+// Exit status: 0 no regression, 1 regression found, 2 bad arguments or input.
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../bench_stats.h"
+#include "../native_common.h"
+#include "mini_json.h"
+
+namespace {
+
+/**
+ * Compact JSON with sorted keys, so equal configs give equal strings
+ */
+std::string canonical(const JsonValue& v) {
+    char buf[32];
+    switch (v.type) {
+        case JsonValue::kNull: return "null";
+        case JsonValue::kBool: return v.boolean ? "true" : "false";
+        case JsonValue::kNumber: snprintf(buf, sizeof(buf), "%.10g", v.number); return buf;
+        case JsonValue::kString: return "\"" + json_escape(v.string) + "\"";
+        case JsonValue::kArray: {
+            std::string out = "[";
+            for (size_t i = 0; i < v.array.size(); i++) out += (i > 0 ? "," : "") + canonical(v.array[i]);
+            return out + "]";
+        }
+        case JsonValue::kObject: {
+            std::string out = "{";
+            for (const auto& kv : v.object) {
+                if (out.size() > 1) out += ",";
+                out += "\"" + json_escape(kv.first) + "\":" + canonical(kv.second);
+            }
+            return out + "}";
+        }
+    }
+    return "null";
+}
+
+struct Group {
+    std::string device;
+    std::string model;
+    std::string variant;
+    std::string config;
+    int runs = 0;
+    std::vector<double> throughput; // t/s, higher is better
+    std::vector<double> step_ms;    // ms, lower is better
+};
+
+using GroupMap = std::map<std::string, Group>;
+
+void append_numbers(const JsonValue* array, std::vector<double>& out) {
+    if (!array || array->type != JsonValue::kArray) return;
+    for (const JsonValue& v : array->array) {
+        if (v.type == JsonValue::kNumber) out.push_back(v.number);
+    }
+}
+
+bool load_file(const std::string& path, GroupMap& groups) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) {
+        fprintf(stderr, "cannot open %s: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    std::string line;
+    char buf[65536];
+    int line_no = 0;
+    bool ok = true;
+    while (ok && fgets(buf, sizeof(buf), f)) {
+        line += buf;
+        if (line.back() != '\n' && !feof(f)) continue; // Line longer than the buffer
+        line_no++;
+        JsonValue run;
+        if (line.find_first_not_of(" \t\r\n") == std::string::npos) {
+            // Blank line
+        } else if (!JsonParser(line).parse(run) || run.type != JsonValue::kObject) {
+            fprintf(stderr, "%s:%d: not a JSON object\n", path.c_str(), line_no);
+            ok = false;
+        } else {
+            Group g;
+            g.device = json_string(run, "device");
+            g.model = json_string(run, "model");
+            g.variant = json_string(run, "cpu_variant");
+            const JsonValue* config = run.get("engine_config");
+            g.config = config ? canonical(*config) : "null";
+            const std::string key = g.device + "\n" + g.model + "\n" + g.variant + "\n" + g.config;
+
+            Group& group = groups.emplace(key, g).first->second;
+            group.runs++;
+            const size_t before = group.throughput.size();
+            append_numbers(run.get("decode_samples"), group.throughput);
+            const JsonValue* tps = run.get("tokens_per_second");
+            if (group.throughput.size() == before && tps && tps->type == JsonValue::kNumber) {
+                group.throughput.push_back(tps->number);
+            }
+            append_numbers(run.get("decode_step_ms"), group.step_ms);
+        }
+        line.clear();
+    }
+    fclose(f);
+    return ok;
+}
+
+double median(std::vector<double> v) {
+    if (v.empty()) return 0.0;
+    const size_t mid = v.size() / 2;
+    std::nth_element(v.begin(), v.begin() + mid, v.end());
+    if (v.size() % 2 == 1) return v[mid];
+    return (v[mid] + *std::max_element(v.begin(), v.begin() + mid)) / 2.0;
+}
+
+struct Options {
+    double threshold = 5.0;
+    double alpha = 0.01;
+    bool json = false;
+    std::vector<std::string> baseline;
+    std::vector<std::string> candidate;
+};
+
+std::vector<std::string> split(const char* arg) {
+    std::vector<std::string> out;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) out.push_back(item);
+    }
+    return out;
+}
+
+bool parse_options(int argc, char** argv, Options& opts) {
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = i + 1 < argc;
+        if (!strcmp(argv[i], "--threshold") && has_value) {
+            opts.threshold = std::max(0.0, atof(argv[++i]));
+        } else if (!strcmp(argv[i], "--alpha") && has_value) {
+            opts.alpha = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--json")) {
+            opts.json = true;
+        } else if (argv[i][0] != '-') {
+            files.push_back(argv[i]);
+        } else {
+            files.clear();
+            break;
+        }
+    }
+    if (files.size() != 2 || opts.alpha <= 0.0 || opts.alpha >= 1.0) {
+        fprintf(stderr, "usage: %s [--threshold 5] [--alpha 0.01] [--json] "
+                        "BASELINE.jsonl[,..] CANDIDATE.jsonl[,..]\n", argv[0]);
+        return false;
+    }
+    opts.baseline = split(files[0]);
+    opts.candidate = split(files[1]);
+    return true;
+}
+
+/**
+ * Compare one metric of a matched group and print it.
+ * Returns: true if the candidate regressed
+ */
+bool compare_metric(const Options& opts, const Group& base, const Group& cand, const char* metric,
+                    const std::vector<double>& a, const std::vector<double>& b, bool higher_is_better) {
+    if (a.empty() || b.empty()) return false;
+    const double median_a = median(a);
+    const double median_b = median(b);
+    const double change = median_a != 0.0 ? (median_b - median_a) / std::fabs(median_a) * 100.0 : 0.0;
+    const MannWhitneyResult mw = mann_whitney_u(a, b);
+    const double worse = higher_is_better ? -change : change;
+    const bool significant = mw.p_value < opts.alpha;
+    const char* verdict = !significant ? "same" : worse > opts.threshold ? "REGRESSION"
+                        : worse < -opts.threshold ? "improved" : "within";
+
+    if (opts.json) {
+        printf("{\"device\":\"%s\",\"model\":\"%s\",\"cpu_variant\":\"%s\",\"engine_config\":%s,"
+               "\"metric\":\"%s\",\"runs_a\":%d,\"runs_b\":%d,\"n_a\":%d,\"n_b\":%d,"
+               "\"median_a\":%.4f,\"median_b\":%.4f,\"change_pct\":%.3f,\"u\":%.1f,"
+               "\"prob_a_greater\":%.4f,\"p_value\":%.3g,\"exact\":%s,\"verdict\":\"%s\"}\n",
+               json_escape(base.device).c_str(), json_escape(base.model).c_str(),
+               json_escape(base.variant).c_str(), base.config.c_str(), metric, base.runs, cand.runs,
+               mw.n_a, mw.n_b, median_a, median_b, change, mw.u, mw.prob_a_greater, mw.p_value,
+               mw.exact ? "true" : "false", verdict);
+    } else {
+        printf("  %-10s %6d %6d %12.3f %12.3f %+8.2f%% %10.3g  %s\n", metric, mw.n_a, mw.n_b,
+               median_a, median_b, change, mw.p_value, verdict);
+    }
+    return significant && worse > opts.threshold;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parse_options(argc, argv, opts)) return 2;
+
+    const int64_t t_start = now_us();
+    GroupMap baseline, candidate;
+    for (const std::string& path : opts.baseline) {
+        if (!load_file(path, baseline)) return 2;
+    }
+    for (const std::string& path : opts.candidate) {
+        if (!load_file(path, candidate)) return 2;
+    }
+
+    int matched = 0, regressions = 0, runs = 0;
+    for (const auto& kv : baseline) runs += kv.second.runs;
+    for (const auto& kv : candidate) {
+        runs += kv.second.runs;
+        auto it = baseline.find(kv.first);
+        if (it == baseline.end()) {
+            fprintf(stderr, "no baseline for %s / %s (%d runs)\n", kv.second.device.c_str(),
+                    kv.second.model.c_str(), kv.second.runs);
+            continue;
+        }
+        const Group& base = it->second;
+        const Group& cand = kv.second;
+        matched++;
+        if (!opts.json) {
+            printf("%s / %s / %s, %d vs %d runs\n  config %s\n", base.device.c_str(), base.model.c_str(),
+                   base.variant.empty() ? "-" : base.variant.c_str(), base.runs, cand.runs, base.config.c_str());
+            printf("  %-10s %6s %6s %12s %12s %9s %10s  %s\n", "metric", "n_a", "n_b", "median_a",
+                   "median_b", "change", "p", "verdict");
+        }
+        regressions += compare_metric(opts, base, cand, "decode_tps", base.throughput, cand.throughput, true);
+        regressions += compare_metric(opts, base, cand, "step_ms", base.step_ms, cand.step_ms, false);
+    }
+    for (const auto& kv : baseline) {
+        if (!candidate.count(kv.first)) {
+            fprintf(stderr, "no candidate for %s / %s (%d runs)\n", kv.second.device.c_str(),
+                    kv.second.model.c_str(), kv.second.runs);
+        }
+    }
+
+    fprintf(stderr, "%d runs, %d matched groups, %d regressions (threshold %.1f%%, alpha %g) in %.1f ms\n",
+            runs, matched, regressions, opts.threshold, opts.alpha, (now_us() - t_start) / 1000.0);
+    return regressions > 0 ? 1 : 0;
+}
@@ -1,5 +1,43 @@
 package com.npucheck.app
 
+import io.flutter.FlutterInjector
 import io.flutter.embedding.android.FlutterActivity
+import io.flutter.embedding.engine.FlutterEngine
+import io.flutter.plugin.common.MethodChannel
+import java.io.IOException
 
-class MainActivity: FlutterActivity()
+class MainActivity: FlutterActivity() {
+    override fun configureFlutterEngine(flutterEngine: FlutterEngine) {
+        super.configureFlutterEngine(flutterEngine)
+
+        // Exposes bundled models as (fd, offset, length) regions of the APK so the
+        // native loader can read them in place instead of copying them out first
+        MethodChannel(flutterEngine.dartExecutor.binaryMessenger, "npu_check/model_assets")
+            .setMethodCallHandler { call, result ->
+                when (call.method) {
+                    "openAssetRegion" -> {
+                        val asset = call.argument<String>("asset")
+                        if (asset == null) {
+                            result.error("BAD_ARGS", "Missing asset", null)
+                            return@setMethodCallHandler
+                        }
+                        try {
+                            val key = FlutterInjector.instance().flutterLoader().getLookupKeyForAsset(asset)
+                            val afd = assets.openFd(key)
+                            // Ownership of the fd moves to the native loader
+                            val fd = afd.parcelFileDescriptor.detachFd()
+                            result.success(mapOf(
+                                "fd" to fd,
+                                "offset" to afd.startOffset,
+                                "length" to afd.length,
+                            ))
+                        } catch (e: IOException) {
+                            // Compressed assets can't be opened as a file region
+                            result.error("UNAVAILABLE", e.message, null)
+                        }
+                    }
+                    else -> result.notImplemented()
+                }
+            }
+    }
+}
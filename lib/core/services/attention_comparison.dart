@@ -0,0 +1,121 @@
+import 'benchmark_stats.dart';
+
+/// Prefill and decode speed at one context depth
+class DepthResult {
+  /// Tokens in the KV cache before decoding starts (and the prefill length)
+  final int depth;
+  final SampleStats prefill;
+  final SampleStats decode;
+
+  const DepthResult({required this.depth, required this.prefill, required this.decode});
+
+  factory DepthResult.fromJson(Map<String, dynamic> json) {
+    return DepthResult(
+      depth: json['depth'] as int,
+      prefill: SampleStats.fromJson(json['prefill'] as Map<String, dynamic>),
+      decode: SampleStats.fromJson(json['decode'] as Map<String, dynamic>),
+    );
+  }
+}
+
+/// One flash attention setting of the comparison (native run_flash_attention_comparison)
+class FlashAttentionSetting {
+  final bool flashAttention;
+
+  /// "ok" | "load_failed" | "cancelled" | "error"
+  final String status;
+  final int nCtx;
+
+  /// KV cache types the setting ran with (ggml type names)
+  final String typeK;
+  final String typeV;
+
+  /// Graph scratch memory the context reserved, as reported by llama.cpp
+  final double computeBufferMiB;
+  final double kvBufferMiB;
+  final List<DepthResult> depths;
+
+  /// Depths that didn't fit the context the model was loaded with
+  final List<int> skippedDepths;
+
+  const FlashAttentionSetting({
+    required this.flashAttention,
+    required this.status,
+    required this.nCtx,
+    required this.typeK,
+    required this.typeV,
+    required this.computeBufferMiB,
+    required this.kvBufferMiB,
+    required this.depths,
+    this.skippedDepths = const [],
+  });
+
+  factory FlashAttentionSetting.fromJson(Map<String, dynamic> json) {
+    final depths = ((json['depths'] as List?) ?? const []).cast<Map<String, dynamic>>();
+    return FlashAttentionSetting(
+      flashAttention: json['flash_attn'] == 1,
+      status: json['status'] as String,
+      nCtx: json['n_ctx'] as int? ?? 0,
+      typeK: json['type_k'] as String? ?? '',
+      typeV: json['type_v'] as String? ?? '',
+      computeBufferMiB: (json['compute_buffer_mib'] as num?)?.toDouble() ?? 0.0,
+      kvBufferMiB: (json['kv_buffer_mib'] as num?)?.toDouble() ?? 0.0,
+      depths: depths.where((d) => d['status'] == 'ok').map(DepthResult.fromJson).toList(),
+      skippedDepths: depths.where((d) => d['status'] == 'skipped').map((d) => d['depth'] as int).toList(),
+    );
+  }
+
+  @override
+  String toString() {
+    final rates = depths
+        .map((d) => '${d.depth}: ${d.prefill.mean.toStringAsFixed(1)}/${d.decode.mean.toStringAsFixed(1)}')
+        .join(', ');
+    final skipped = skippedDepths.isEmpty ? '' : ', skipped depths $skippedDepths';
+    return 'FA ${flashAttention ? 'on' : 'off'} [$status] compute ${computeBufferMiB.toStringAsFixed(1)} MiB, '
+        'KV $typeK/$typeV ${kvBufferMiB.toStringAsFixed(1)} MiB, prefill/decode t/s by depth {$rates}$skipped';
+  }
+}
+
+/// Flash attention off vs on at increasing context depths
+class FlashAttentionComparison {
+  /// "ok" | "cancelled"
+  final String status;
+  final int tokensPerDepth;
+  final int repetitions;
+
+  /// The two settings ran with different KV cache types, so their buffer sizes
+  /// and speeds aren't from the flash attention switch alone
+  final bool kvTypesDiffer;
+  final List<FlashAttentionSetting> settings;
+
+  const FlashAttentionComparison({
+    required this.status,
+    required this.tokensPerDepth,
+    required this.repetitions,
+    required this.kvTypesDiffer,
+    required this.settings,
+  });
+
+  FlashAttentionSetting? setting(bool flashAttention) =>
+      settings.where((s) => s.flashAttention == flashAttention && s.status == 'ok').firstOrNull;
+
+  /// Decode speedup of flash attention at [depth] (on / off), or null if either wasn't measured
+  double? decodeSpeedup(int depth) {
+    final off = setting(false)?.depths.where((d) => d.depth == depth).firstOrNull;
+    final on = setting(true)?.depths.where((d) => d.depth == depth).firstOrNull;
+    if (off == null || on == null || off.decode.mean <= 0) return null;
+    return on.decode.mean / off.decode.mean;
+  }
+
+  factory FlashAttentionComparison.fromJson(Map<String, dynamic> json) {
+    return FlashAttentionComparison(
+      status: json['status'] as String,
+      tokensPerDepth: json['n_gen'] as int,
+      repetitions: json['repetitions'] as int,
+      kvTypesDiffer: json['kv_types_differ'] as bool? ?? false,
+      settings: (json['settings'] as List)
+          .map((s) => FlashAttentionSetting.fromJson(s as Map<String, dynamic>))
+          .toList(),
+    );
+  }
+}
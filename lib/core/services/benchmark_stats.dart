@@ -0,0 +1,100 @@
+import 'energy_report.dart';
+
+/// Summary of repeated measurements after outlier rejection.
+/// Outliers are samples outside the Tukey fences [Q1 - 1.5 IQR, Q3 + 1.5 IQR]
+/// (applied from 4 samples on); every other figure is over the kept samples.
+class SampleStats {
+  final int n;
+  final double mean;
+  final double median;
+  final double stddev;
+  final double ci95Low;
+  final double ci95High;
+  final double min;
+  final double max;
+
+  /// Indices of the rejected repetitions
+  final List<int> outliers;
+
+  const SampleStats({
+    required this.n,
+    required this.mean,
+    required this.median,
+    required this.stddev,
+    required this.ci95Low,
+    required this.ci95High,
+    required this.min,
+    required this.max,
+    required this.outliers,
+  });
+
+  /// Half-width of the 95% confidence interval relative to the mean
+  double get relativeCi95 => mean > 0 ? (ci95High - mean) / mean : 0.0;
+
+  factory SampleStats.fromJson(Map<String, dynamic> json) {
+    return SampleStats(
+      n: json['n'] as int,
+      mean: (json['mean'] as num).toDouble(),
+      median: (json['median'] as num).toDouble(),
+      stddev: (json['stddev'] as num).toDouble(),
+      ci95Low: (json['ci95_low'] as num).toDouble(),
+      ci95High: (json['ci95_high'] as num).toDouble(),
+      min: (json['min'] as num).toDouble(),
+      max: (json['max'] as num).toDouble(),
+      outliers: (json['outliers'] as List).cast<int>(),
+    );
+  }
+
+  @override
+  String toString() => '${mean.toStringAsFixed(2)} ± '
+      '${(ci95High - mean).toStringAsFixed(2)} t/s '
+      '(median ${median.toStringAsFixed(2)}, sd ${stddev.toStringAsFixed(2)}, '
+      'n $n, ${outliers.length} outliers)';
+}
+
+/// Result of the native warm-up + repetition harness
+class RepetitionReport {
+  final int warmup;
+  final int repetitions;
+  final int promptTokens;
+  final int tokensPerRepetition;
+  final SampleStats prefill;
+  final SampleStats decode;
+  final List<double> prefillSamples;
+  final List<double> decodeSamples;
+
+  /// Latency of every decode step of the measured repetitions, in ms
+  final List<double> decodeStepMs;
+
+  /// Battery energy of the measured repetitions; null without power telemetry
+  /// ([LlamaService.setPowerTelemetry])
+  final EnergyReport? energy;
+
+  const RepetitionReport({
+    required this.warmup,
+    required this.repetitions,
+    required this.promptTokens,
+    required this.tokensPerRepetition,
+    required this.prefill,
+    required this.decode,
+    required this.prefillSamples,
+    required this.decodeSamples,
+    this.decodeStepMs = const [],
+    this.energy,
+  });
+
+  factory RepetitionReport.fromJson(Map<String, dynamic> json) {
+    return RepetitionReport(
+      warmup: json['warmup'] as int,
+      repetitions: json['repetitions'] as int,
+      promptTokens: json['prompt_tokens'] as int,
+      tokensPerRepetition: json['n_tokens'] as int,
+      prefill: SampleStats.fromJson(json['prefill'] as Map<String, dynamic>),
+      decode: SampleStats.fromJson(json['decode'] as Map<String, dynamic>),
+      prefillSamples: (json['prefill_samples'] as List).map((v) => (v as num).toDouble()).toList(),
+      decodeSamples: (json['decode_samples'] as List).map((v) => (v as num).toDouble()).toList(),
+      decodeStepMs: (json['decode_step_ms'] as List? ?? []).map((v) => (v as num).toDouble()).toList(),
+      energy: json['energy'] != null ? EnergyReport.fromJson(json['energy'] as Map<String, dynamic>) : null,
+    );
+  }
+}
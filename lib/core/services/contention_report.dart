@@ -0,0 +1,115 @@
+/// One session of a contention level
+class ContentionSession {
+  /// CPUs the session's threads were pinned to, e.g. "0,1,2,3"
+  final String cpus;
+  final double decodeTps;
+  final bool ok;
+
+  const ContentionSession({required this.cpus, required this.decodeTps, required this.ok});
+
+  factory ContentionSession.fromJson(Map<String, dynamic> json) {
+    return ContentionSession(
+      cpus: json['cpus'] as String,
+      decodeTps: (json['decode_tps'] as num).toDouble(),
+      ok: json['ok'] as bool,
+    );
+  }
+}
+
+/// K sessions decoding at the same time on one shared model
+class ContentionLevel {
+  final int contexts;
+
+  /// "ok" | "cancelled" | "error" | "context_failed"
+  final String status;
+  final double aggregateTps;
+  final double meanTps;
+
+  /// Per-session speed relative to a single session (1.0 = no contention, below 1 under contention)
+  final double relativeSpeed;
+
+  /// Aggregate speed relative to a single session (K = ideal scaling)
+  final double scaling;
+
+  /// Resident memory growth for this level, and per context beyond the first
+  final double rssMiB;
+  final double rssMiBPerExtra;
+
+  /// Buffers llama.cpp reserved for each context
+  final double computeBufferMiB;
+  final double kvBufferMiB;
+  final List<ContentionSession> sessions;
+
+  const ContentionLevel({
+    required this.contexts,
+    required this.status,
+    this.aggregateTps = 0.0,
+    this.meanTps = 0.0,
+    this.relativeSpeed = 0.0,
+    this.scaling = 0.0,
+    this.rssMiB = 0.0,
+    this.rssMiBPerExtra = 0.0,
+    this.computeBufferMiB = 0.0,
+    this.kvBufferMiB = 0.0,
+    this.sessions = const [],
+  });
+
+  factory ContentionLevel.fromJson(Map<String, dynamic> json) {
+    double number(String key) => (json[key] as num?)?.toDouble() ?? 0.0;
+    return ContentionLevel(
+      contexts: json['contexts'] as int,
+      status: json['status'] as String,
+      aggregateTps: number('aggregate_tps'),
+      meanTps: number('mean_tps'),
+      relativeSpeed: number('relative_speed'),
+      scaling: number('scaling'),
+      rssMiB: number('rss_mib'),
+      rssMiBPerExtra: number('rss_mib_per_extra'),
+      computeBufferMiB: number('compute_buffer_mib'),
+      kvBufferMiB: number('kv_buffer_mib'),
+      sessions: ((json['sessions'] as List?) ?? const [])
+          .map((s) => ContentionSession.fromJson(s as Map<String, dynamic>))
+          .toList(),
+    );
+  }
+
+  @override
+  String toString() => 'K=$contexts: ${aggregateTps.toStringAsFixed(1)} t/s total, '
+      '${meanTps.toStringAsFixed(1)} each (${(relativeSpeed * 100).toStringAsFixed(0)}% of one), '
+      '+${rssMiBPerExtra.toStringAsFixed(0)} MiB per extra context';
+}
+
+/// Multi-context contention benchmark (native run_context_contention)
+class ContentionReport {
+  /// "ok" | "cancelled"
+  final String status;
+
+  /// "disjoint" (each session on its own CPUs) or "overlapping" (all share all CPUs)
+  final String mode;
+  final int tokens;
+  final List<ContentionLevel> levels;
+
+  const ContentionReport({
+    required this.status,
+    required this.mode,
+    required this.tokens,
+    required this.levels,
+  });
+
+  /// Whether running [contexts] sessions in one process beats serializing them
+  bool scalesTo(int contexts) {
+    final level = levels.where((l) => l.contexts == contexts && l.status == 'ok').firstOrNull;
+    return level != null && level.scaling > 1.0;
+  }
+
+  factory ContentionReport.fromJson(Map<String, dynamic> json) {
+    return ContentionReport(
+      status: json['status'] as String,
+      mode: json['mode'] as String,
+      tokens: json['n_tokens'] as int,
+      levels: (json['levels'] as List)
+          .map((l) => ContentionLevel.fromJson(l as Map<String, dynamic>))
+          .toList(),
+    );
+  }
+}
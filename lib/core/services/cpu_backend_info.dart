@@ -0,0 +1,70 @@
+import 'benchmark_stats.dart';
+
+/// ggml CPU backend variant built into the app and its score on this CPU
+/// (0 = the CPU lacks a feature the variant needs)
+class CpuVariant {
+  final String name;
+  final int score;
+
+  const CpuVariant(this.name, this.score);
+
+  bool get isSupported => score > 0;
+}
+
+/// Which CPU backend variant the engine is running and why (native cpu_variants.cpp)
+class CpuBackendInfo {
+  /// False when the CPU backend is linked statically (a single variant)
+  final bool dynamic;
+  final String active;
+  final bool forced;
+  final List<String> detectedFeatures;
+  final Map<String, String> backendFeatures;
+  final List<CpuVariant> variants;
+
+  const CpuBackendInfo({
+    required this.dynamic,
+    required this.active,
+    required this.forced,
+    required this.detectedFeatures,
+    required this.backendFeatures,
+    required this.variants,
+  });
+
+  factory CpuBackendInfo.fromJson(Map<String, dynamic> json) {
+    return CpuBackendInfo(
+      dynamic: json['dynamic'] as bool,
+      active: json['active'] as String,
+      forced: json['forced'] as bool,
+      detectedFeatures: (json['detected_features'] as List).cast<String>(),
+      backendFeatures: (json['backend_features'] as Map<String, dynamic>).cast<String, String>(),
+      variants: (json['variants'] as List)
+          .map((v) => CpuVariant(v['name'] as String, v['score'] as int))
+          .toList(),
+    );
+  }
+
+  @override
+  String toString() => 'CpuBackendInfo(active: $active${forced ? ' (forced)' : ''}, '
+      'features: ${detectedFeatures.join(' ')}, '
+      'variants: ${variants.where((v) => v.isSupported).map((v) => v.name).join(', ')})';
+}
+
+/// One variant's result in a forced-variant comparison
+class CpuVariantResult {
+  final CpuVariant variant;
+
+  /// "ok" | "unsupported" | "load_failed" | "cancelled"
+  final String status;
+  final RepetitionReport? report;
+
+  const CpuVariantResult({required this.variant, required this.status, this.report});
+
+  factory CpuVariantResult.fromJson(Map<String, dynamic> json) {
+    final report = json['report'] as Map<String, dynamic>?;
+    return CpuVariantResult(
+      variant: CpuVariant(json['name'] as String, json['score'] as int),
+      status: json['status'] as String,
+      report: report != null && report['status'] == 'ok' ? RepetitionReport.fromJson(report) : null,
+    );
+  }
+}
@@ -0,0 +1,119 @@
+import 'dart:typed_data';
+
+/// How token vectors are pooled into one vector per text
+enum EmbeddingPooling {
+  /// The model's own pooling; mean for generation models, which have none
+  model(-1),
+  mean(1),
+  cls(2),
+  last(3);
+
+  final int value;
+
+  const EmbeddingPooling(this.value);
+}
+
+/// Speed of one embedding run at one batch size
+class EmbeddingRunStats {
+  /// Texts packed per batch as separate sequences
+  final int batchSize;
+  final int batches;
+  final double textsPerSecond;
+  final double tokensPerSecond;
+  final double elapsedMs;
+
+  const EmbeddingRunStats({
+    required this.batchSize,
+    required this.batches,
+    required this.textsPerSecond,
+    required this.tokensPerSecond,
+    required this.elapsedMs,
+  });
+
+  factory EmbeddingRunStats.fromJson(Map<String, dynamic> json) {
+    return EmbeddingRunStats(
+      batchSize: json['batch_size'] as int,
+      batches: json['batches'] as int,
+      textsPerSecond: (json['texts_per_s'] as num).toDouble(),
+      tokensPerSecond: (json['tokens_per_s'] as num).toDouble(),
+      elapsedMs: (json['elapsed_ms'] as num).toDouble(),
+    );
+  }
+
+  @override
+  String toString() => 'batch $batchSize: ${textsPerSecond.toStringAsFixed(1)} texts/s, '
+      '${tokensPerSecond.toStringAsFixed(1)} tokens/s';
+}
+
+/// L2-normalized vectors of a list of texts (native run_embeddings).
+/// [data] is the native buffer the engine wrote, freed when it is garbage
+/// collected; [vector] returns views into it, so nothing is copied per text.
+class Embeddings {
+  final int dimension;
+  final Float32List data;
+
+  /// Resolved pooling: "mean" | "cls" | "last"
+  final String pooling;
+  final int tokens;
+
+  /// Texts cut to the batch limit before embedding
+  final int truncated;
+  final EmbeddingRunStats stats;
+
+  const Embeddings({
+    required this.dimension,
+    required this.data,
+    required this.pooling,
+    required this.tokens,
+    required this.truncated,
+    required this.stats,
+  });
+
+  int get length => dimension > 0 ? data.length ~/ dimension : 0;
+
+  Float32List vector(int index) => Float32List.sublistView(data, index * dimension, (index + 1) * dimension);
+
+  /// Cosine similarity of two texts (vectors are normalized, so a dot product)
+  double similarity(int a, int b) {
+    var dot = 0.0;
+    for (var i = 0; i < dimension; i++) {
+      dot += data[a * dimension + i] * data[b * dimension + i];
+    }
+    return dot;
+  }
+}
+
+/// Embedding throughput by batch size (native run_embedding_benchmark)
+class EmbeddingThroughput {
+  final int dimension;
+  final String pooling;
+  final int texts;
+  final int tokens;
+  final List<EmbeddingRunStats> levels;
+
+  const EmbeddingThroughput({
+    required this.dimension,
+    required this.pooling,
+    required this.texts,
+    required this.tokens,
+    required this.levels,
+  });
+
+  EmbeddingRunStats? get best =>
+      levels.isEmpty ? null : levels.reduce((a, b) => b.textsPerSecond > a.textsPerSecond ? b : a);
+
+  factory EmbeddingThroughput.fromJson(Map<String, dynamic> json) {
+    return EmbeddingThroughput(
+      dimension: json['n_embd'] as int,
+      pooling: json['pooling'] as String,
+      texts: json['texts'] as int,
+      tokens: json['tokens'] as int,
+      levels: (json['levels'] as List)
+          .map((l) => EmbeddingRunStats.fromJson(l as Map<String, dynamic>))
+          .toList(),
+    );
+  }
+
+  @override
+  String toString() => 'Embeddings ($pooling, dim $dimension, $texts texts): ${levels.join('; ')}';
+}
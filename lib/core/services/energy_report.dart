@@ -0,0 +1,79 @@
+/// Battery energy of the measured repetitions (native power_telemetry.cpp),
+/// against the idle draw measured just before them
+class EnergyReport {
+  /// Power-supply directory read, e.g. /sys/class/power_supply/battery
+  final String supply;
+
+  /// Attribute the energy came from: "power_now", "voltage_current",
+  /// "energy_now", "charge_counter", or "" if it gave no reading in the window
+  final String source;
+
+  /// Same for the idle baseline; the net values need it to match [source]
+  final String baselineSource;
+
+  /// Plugged in during the window; the battery current then doesn't show the draw
+  final bool charging;
+  final double baselineWatts;
+  final double seconds;
+  final double joules;
+  final double averageWatts;
+
+  /// Energy and power above the idle baseline
+  final double netJoules;
+  final double netAverageWatts;
+
+  /// Generated tokens of the window; prefill energy is included in theirs
+  final int tokens;
+  final double joulesPerToken;
+  final double tokensPerJoule;
+  final int samples;
+
+  const EnergyReport({
+    required this.supply,
+    required this.source,
+    required this.baselineSource,
+    required this.charging,
+    required this.baselineWatts,
+    required this.seconds,
+    required this.joules,
+    required this.averageWatts,
+    required this.netJoules,
+    required this.netAverageWatts,
+    required this.tokens,
+    required this.joulesPerToken,
+    required this.tokensPerJoule,
+    required this.samples,
+  });
+
+  /// Whether the numbers describe the device's draw
+  bool get valid => source.isNotEmpty && baselineSource == source && !charging && netJoules > 0;
+
+  factory EnergyReport.fromJson(Map<String, dynamic> json) {
+    double value(String key) => (json[key] as num).toDouble();
+    return EnergyReport(
+      supply: json['supply'] as String,
+      source: json['source'] as String,
+      baselineSource: json['baseline_source'] as String? ?? '',
+      charging: json['charging'] as bool,
+      baselineWatts: value('baseline_watts'),
+      seconds: value('seconds'),
+      joules: value('joules'),
+      averageWatts: value('avg_watts'),
+      netJoules: value('net_joules'),
+      netAverageWatts: value('net_avg_watts'),
+      tokens: json['tokens'] as int,
+      joulesPerToken: value('joules_per_token'),
+      tokensPerJoule: value('tokens_per_joule'),
+      samples: json['samples'] as int,
+    );
+  }
+
+  @override
+  String toString() {
+    if (source.isEmpty) return 'EnergyReport(no reading in ${seconds.toStringAsFixed(1)} s)';
+    if (baselineSource != source) return 'EnergyReport(no idle baseline from $source)';
+    return 'EnergyReport(${(joulesPerToken * 1000).toStringAsFixed(1)} mJ/token, '
+        '${tokensPerJoule.toStringAsFixed(2)} tokens/J, ${netAverageWatts.toStringAsFixed(2)} W '
+        'above ${baselineWatts.toStringAsFixed(2)} W idle, from $source${charging ? ', charging' : ''})';
+  }
+}
@@ -0,0 +1,283 @@
+import 'dart:ffi';
+
+/// C layout of the native EngineConfig (engine_config.h), passed by pointer
+final class EngineConfigStruct extends Struct {
+  @Uint32()
+  external int version;
+
+  @Uint32()
+  external int size;
+
+  @Int32()
+  external int nCtx;
+
+  @Int32()
+  external int nBatch;
+
+  @Int32()
+  external int nUbatch;
+
+  @Int32()
+  external int nThreads;
+
+  @Int32()
+  external int nThreadsBatch;
+
+  @Int32()
+  external int typeK;
+
+  @Int32()
+  external int typeV;
+
+  @Int32()
+  external int flashAttn;
+
+  @Int32()
+  external int useMmap;
+
+  @Int32()
+  external int useMlock;
+
+  @Uint32()
+  external int seed;
+
+  @Int32()
+  external int hugePages;
+
+  @Int32()
+  external int poll;
+
+  @Int32()
+  external int priority;
+
+  @Uint32()
+  external int cpuMask;
+
+  @Int32()
+  external int strictCpu;
+}
+
+/// Flash attention setting of llama.cpp
+enum FlashAttention {
+  auto(-1),
+  off(0),
+  on(1);
+
+  final int value;
+
+  const FlashAttention(this.value);
+
+  static FlashAttention fromValue(int value) =>
+      FlashAttention.values.firstWhere((f) => f.value == value, orElse: () => FlashAttention.auto);
+}
+
+/// Engine parameters of a model load. The same fields describe the request
+/// and, after [LlamaService.loadModel], the effective values the native side
+/// clamped them to; storing the effective config with a result is enough to
+/// rerun it the same way.
+class EngineConfig {
+  /// Version of the native struct layout this class writes
+  static const version = 3;
+
+  /// ggml KV cache types by name, as reported by the native side
+  static const kvCacheTypes = {
+    'f32': 0,
+    'f16': 1,
+    'q4_0': 2,
+    'q4_1': 3,
+    'q5_0': 6,
+    'q5_1': 7,
+    'q8_0': 8,
+    'bf16': 30,
+  };
+
+  /// 0 = the model's training context
+  final int nCtx;
+  final int nBatch;
+  final int nUbatch;
+
+  /// Decode threads; 0 = native default
+  final int nThreads;
+
+  /// Prompt processing threads; 0 = same as [nThreads]
+  final int nThreadsBatch;
+
+  /// KV cache types, keys of [kvCacheTypes]. A quantized V cache needs flash attention.
+  final String typeK;
+  final String typeV;
+  final FlashAttention flashAttention;
+  final bool useMmap;
+  final bool useMlock;
+
+  /// Seed for sampled decoding; benchmark passes decode greedily
+  final int seed;
+
+  /// Advise transparent huge pages for the weights, KV cache and compute buffers
+  final bool hugePages;
+
+  /// How long idle compute threads spin for the next token before sleeping,
+  /// 0 (sleep at once) to 100; spinning trades CPU time for latency
+  final int poll;
+
+  /// Compute thread priority: -1 low, 0 normal, 1 medium, 2 high, 3 realtime
+  final int priority;
+
+  /// Bit i set: compute threads may run on CPU i; 0 = any CPU
+  final int cpuMask;
+
+  /// Pin each compute thread to its own CPU of [cpuMask]
+  final bool strictCpu;
+
+  const EngineConfig({
+    this.nCtx = 512,
+    this.nBatch = 128,
+    this.nUbatch = 128,
+    this.nThreads = 4,
+    this.nThreadsBatch = 4,
+    this.typeK = 'f16',
+    this.typeV = 'f16',
+    this.flashAttention = FlashAttention.auto,
+    this.useMmap = true,
+    this.useMlock = false,
+    this.seed = 42,
+    this.hugePages = false,
+    this.poll = 50,
+    this.priority = 0,
+    this.cpuMask = 0,
+    this.strictCpu = false,
+  });
+
+  EngineConfig copyWith({
+    int? nCtx,
+    int? nBatch,
+    int? nUbatch,
+    int? nThreads,
+    int? nThreadsBatch,
+    String? typeK,
+    String? typeV,
+    FlashAttention? flashAttention,
+    bool? useMmap,
+    bool? useMlock,
+    int? seed,
+    bool? hugePages,
+    int? poll,
+    int? priority,
+    int? cpuMask,
+    bool? strictCpu,
+  }) {
+    return EngineConfig(
+      nCtx: nCtx ?? this.nCtx,
+      nBatch: nBatch ?? this.nBatch,
+      nUbatch: nUbatch ?? this.nUbatch,
+      nThreads: nThreads ?? this.nThreads,
+      nThreadsBatch: nThreadsBatch ?? this.nThreadsBatch,
+      typeK: typeK ?? this.typeK,
+      typeV: typeV ?? this.typeV,
+      flashAttention: flashAttention ?? this.flashAttention,
+      useMmap: useMmap ?? this.useMmap,
+      useMlock: useMlock ?? this.useMlock,
+      seed: seed ?? this.seed,
+      hugePages: hugePages ?? this.hugePages,
+      poll: poll ?? this.poll,
+      priority: priority ?? this.priority,
+      cpuMask: cpuMask ?? this.cpuMask,
+      strictCpu: strictCpu ?? this.strictCpu,
+    );
+  }
+
+  /// Fill a native struct for load_model_with_config / engine_submit_load
+  void writeTo(Pointer<EngineConfigStruct> ptr) {
+    ptr.ref
+      ..version = version
+      ..size = sizeOf<EngineConfigStruct>()
+      ..nCtx = nCtx
+      ..nBatch = nBatch
+      ..nUbatch = nUbatch
+      ..nThreads = nThreads
+      ..nThreadsBatch = nThreadsBatch
+      ..typeK = kvCacheTypes[typeK] ?? kvCacheTypes['f16']!
+      ..typeV = kvCacheTypes[typeV] ?? kvCacheTypes['f16']!
+      ..flashAttn = flashAttention.value
+      ..useMmap = useMmap ? 1 : 0
+      ..useMlock = useMlock ? 1 : 0
+      ..seed = seed
+      ..hugePages = hugePages ? 1 : 0
+      ..poll = poll
+      ..priority = priority
+      ..cpuMask = cpuMask
+      ..strictCpu = strictCpu ? 1 : 0;
+  }
+
+  factory EngineConfig.fromJson(Map<String, dynamic> json) {
+    return EngineConfig(
+      nCtx: json['n_ctx'] as int,
+      nBatch: json['n_batch'] as int,
+      nUbatch: json['n_ubatch'] as int,
+      nThreads: json['n_threads'] as int,
+      nThreadsBatch: json['n_threads_batch'] as int,
+      typeK: json['type_k'] as String,
+      typeV: json['type_v'] as String,
+      flashAttention: FlashAttention.fromValue(json['flash_attn'] as int),
+      useMmap: json['use_mmap'] as bool,
+      useMlock: json['use_mlock'] as bool,
+      seed: json['seed'] as int,
+      // Absent from configs stored before version 2
+      hugePages: json['huge_pages'] as bool? ?? false,
+      // Version 3
+      poll: json['poll'] as int? ?? 50,
+      priority: json['priority'] as int? ?? 0,
+      cpuMask: json['cpu_mask'] as int? ?? 0,
+      strictCpu: json['strict_cpu'] as bool? ?? false,
+    );
+  }
+
+  Map<String, dynamic> toJson() => {
+        'version': version,
+        'n_ctx': nCtx,
+        'n_batch': nBatch,
+        'n_ubatch': nUbatch,
+        'n_threads': nThreads,
+        'n_threads_batch': nThreadsBatch,
+        'type_k': typeK,
+        'type_v': typeV,
+        'flash_attn': flashAttention.value,
+        'use_mmap': useMmap,
+        'use_mlock': useMlock,
+        'seed': seed,
+        'huge_pages': hugePages,
+        'poll': poll,
+        'priority': priority,
+        'cpu_mask': cpuMask,
+        'strict_cpu': strictCpu,
+      };
+
+  @override
+  bool operator ==(Object other) =>
+      other is EngineConfig &&
+      other.nCtx == nCtx &&
+      other.nBatch == nBatch &&
+      other.nUbatch == nUbatch &&
+      other.nThreads == nThreads &&
+      other.nThreadsBatch == nThreadsBatch &&
+      other.typeK == typeK &&
+      other.typeV == typeV &&
+      other.flashAttention == flashAttention &&
+      other.useMmap == useMmap &&
+      other.useMlock == useMlock &&
+      other.seed == seed &&
+      other.hugePages == hugePages &&
+      other.poll == poll &&
+      other.priority == priority &&
+      other.cpuMask == cpuMask &&
+      other.strictCpu == strictCpu;
+
+  @override
+  int get hashCode => Object.hash(nCtx, nBatch, nUbatch, nThreads, nThreadsBatch, typeK, typeV,
+      flashAttention, useMmap, useMlock, seed, hugePages, poll, priority, cpuMask, strictCpu);
+
+  @override
+  String toString() => 'EngineConfig(ctx $nCtx, batch $nBatch/$nUbatch, '
+      'threads $nThreads/$nThreadsBatch, kv $typeK/$typeV, fa ${flashAttention.name}, '
+      'mmap $useMmap, mlock $useMlock, seed $seed, huge pages $hugePages, '
+      'poll $poll, priority $priority, cpus 0x${cpuMask.toRadixString(16)}${strictCpu ? ' strict' : ''})';
+}
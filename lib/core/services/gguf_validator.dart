@@ -0,0 +1,67 @@
+import 'dart:convert';
+import 'dart:isolate';
+import 'package:ffi/ffi.dart';
+import 'llama_bindings.dart';
+
+/// Result of a native GGUF header check
+enum GgufStatus {
+  complete,  // Every tensor lies inside the file
+  truncated, // Valid header but data is missing (e.g. partial download)
+  corrupt,   // Not a GGUF file or inconsistent header
+}
+
+/// Parsed report from the native `validate_gguf` call
+class GgufReport {
+  final GgufStatus status;
+  final String error;
+  final String architecture;
+  final int parameterCount;
+  final int fileBytes;
+  final int expectedBytes;
+  final Map<String, int> tensorTypes;
+  final double elapsedMs;
+
+  const GgufReport({
+    required this.status,
+    required this.error,
+    required this.architecture,
+    required this.parameterCount,
+    required this.fileBytes,
+    required this.expectedBytes,
+    required this.tensorTypes,
+    required this.elapsedMs,
+  });
+
+  bool get isComplete => status == GgufStatus.complete;
+
+  factory GgufReport.fromJson(Map<String, dynamic> json) {
+    return GgufReport(
+      status: GgufStatus.values.byName(json['status'] as String),
+      error: json['error'] as String,
+      architecture: json['architecture'] as String,
+      parameterCount: json['n_params'] as int,
+      fileBytes: json['file_bytes'] as int,
+      expectedBytes: json['expected_bytes'] as int,
+      tensorTypes: (json['tensor_types'] as Map<String, dynamic>).cast<String, int>(),
+      elapsedMs: (json['elapsed_ms'] as num).toDouble(),
+    );
+  }
+
+  @override
+  String toString() => 'GgufReport(${status.name}, $architecture, '
+      '$fileBytes/$expectedBytes bytes${error.isEmpty ? '' : ', $error'})';
+}
+
+/// Validates GGUF files natively by parsing only the header and tensor table
+class GgufValidator {
+  /// Validate [path] off the calling isolate
+  static Future<GgufReport> validate(String path) {
+    return Isolate.run(() {
+      final bindings = LlamaBindings();
+      final pathPtr = path.toNativeUtf8();
+      final json = bindings.validateGguf(pathPtr.cast()).cast<Utf8>().toDartString();
+      malloc.free(pathPtr);
+      return GgufReport.fromJson(jsonDecode(json) as Map<String, dynamic>);
+    });
+  }
+}
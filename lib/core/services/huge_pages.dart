@@ -0,0 +1,133 @@
+import 'benchmark_stats.dart';
+
+/// Transparent huge page advice for the loaded model and how much of its memory
+/// is on huge pages (native get_huge_page_report)
+class HugePageReport {
+  /// Kernel THP mode: "always" | "madvise" | "never" | "unsupported"
+  final String thpMode;
+
+  /// Mappings advised at load; 0 unless loaded with [EngineConfig.hugePages]
+  final int ranges;
+  final double advisedMiB;
+
+  /// Collapsed right away (MADV_COLLAPSE); the rest is left to khugepaged
+  final double collapsedMiB;
+  final int failures;
+
+  /// Resident mmapped weights and the part of them mapped by huge pages
+  final double weightsMiB;
+  final double weightsHugeMiB;
+
+  /// Resident KV cache, compute buffers (and weights loaded without mmap)
+  /// and the part of them on huge pages
+  final double anonMiB;
+  final double anonHugeMiB;
+
+  /// Huge pages of the whole process, advised or not
+  final double processHugeMiB;
+
+  const HugePageReport({
+    required this.thpMode,
+    required this.ranges,
+    required this.advisedMiB,
+    required this.collapsedMiB,
+    required this.failures,
+    required this.weightsMiB,
+    required this.weightsHugeMiB,
+    required this.anonMiB,
+    required this.anonHugeMiB,
+    required this.processHugeMiB,
+  });
+
+  /// Fraction of the advised resident memory on huge pages
+  double get hugeFraction {
+    final resident = weightsMiB + anonMiB;
+    return resident > 0 ? (weightsHugeMiB + anonHugeMiB) / resident : 0.0;
+  }
+
+  factory HugePageReport.fromJson(Map<String, dynamic> json) {
+    double mib(String key) => (json[key] as num?)?.toDouble() ?? 0.0;
+    return HugePageReport(
+      thpMode: json['thp'] as String,
+      ranges: json['ranges'] as int,
+      advisedMiB: mib('advised_mib'),
+      collapsedMiB: mib('collapsed_mib'),
+      failures: json['failures'] as int? ?? 0,
+      weightsMiB: mib('weights_mib'),
+      weightsHugeMiB: mib('weights_huge_mib'),
+      anonMiB: mib('anon_mib'),
+      anonHugeMiB: mib('anon_huge_mib'),
+      processHugeMiB: mib('process_huge_mib'),
+    );
+  }
+
+  @override
+  String toString() => 'HugePageReport(thp $thpMode, $ranges ranges, '
+      'weights ${weightsHugeMiB.toStringAsFixed(1)}/${weightsMiB.toStringAsFixed(1)} MiB, '
+      'buffers ${anonHugeMiB.toStringAsFixed(1)}/${anonMiB.toStringAsFixed(1)} MiB on huge pages, '
+      'process ${processHugeMiB.toStringAsFixed(1)} MiB)';
+}
+
+/// One setting of the huge page comparison (native run_huge_page_comparison)
+class HugePageSetting {
+  final bool hugePages;
+
+  /// "ok" | "load_failed" | "cancelled"
+  final String status;
+  final HugePageReport? memory;
+  final RepetitionReport? report;
+
+  const HugePageSetting({required this.hugePages, required this.status, this.memory, this.report});
+
+  factory HugePageSetting.fromJson(Map<String, dynamic> json) {
+    final memory = json['memory'] as Map<String, dynamic>?;
+    final report = json['report'] as Map<String, dynamic>?;
+    return HugePageSetting(
+      hugePages: json['huge_pages'] as bool,
+      status: json['status'] as String,
+      memory: memory != null ? HugePageReport.fromJson(memory) : null,
+      report: report != null && report['status'] == 'ok' ? RepetitionReport.fromJson(report) : null,
+    );
+  }
+
+  @override
+  String toString() => 'Huge pages ${hugePages ? 'on' : 'off'} [$status] '
+      'decode ${report?.decode.median.toStringAsFixed(2) ?? '-'} t/s, $memory';
+}
+
+/// Decode speed with huge pages off vs on
+class HugePageComparison {
+  /// "ok" | "cancelled"
+  final String status;
+  final List<HugePageSetting> settings;
+
+  const HugePageComparison({required this.status, required this.settings});
+
+  HugePageSetting? _setting(bool hugePages) {
+    for (final s in settings) {
+      if (s.hugePages == hugePages && s.report != null) return s;
+    }
+    return null;
+  }
+
+  /// Median decode speed with huge pages over without, or null if a side is missing
+  double? get decodeSpeedup {
+    final off = _setting(false)?.report?.decode.median;
+    final on = _setting(true)?.report?.decode.median;
+    if (off == null || on == null || off <= 0) return null;
+    return on / off;
+  }
+
+  factory HugePageComparison.fromJson(Map<String, dynamic> json) {
+    return HugePageComparison(
+      status: json['status'] as String,
+      settings: (json['settings'] as List)
+          .map((s) => HugePageSetting.fromJson(s as Map<String, dynamic>))
+          .toList(),
+    );
+  }
+
+  @override
+  String toString() => 'HugePageComparison($status, speedup '
+      '${decodeSpeedup?.toStringAsFixed(3) ?? '-'}x: ${settings.join('; ')})';
+}
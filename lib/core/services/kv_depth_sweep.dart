@@ -0,0 +1,99 @@
+import 'benchmark_stats.dart';
+
+/// Decode speed from one KV-cache depth
+class KvDepthPoint {
+  final int depth;
+
+  /// "ok" | "skipped" (doesn't fit the model's training context) | "error" | "cancelled"
+  final String status;
+
+  /// Why the depth failed, when [status] is "error"
+  final String error;
+  final SampleStats? decode;
+  final double msPerToken;
+
+  /// Decode speed relative to depth 0
+  final double relative;
+
+  const KvDepthPoint({
+    required this.depth,
+    required this.status,
+    this.error = '',
+    this.decode,
+    this.msPerToken = 0.0,
+    this.relative = 0.0,
+  });
+
+  factory KvDepthPoint.fromJson(Map<String, dynamic> json) {
+    final decode = json['decode'] as Map<String, dynamic>?;
+    return KvDepthPoint(
+      depth: json['depth'] as int,
+      status: json['status'] as String,
+      error: json['error'] as String? ?? '',
+      decode: decode != null ? SampleStats.fromJson(decode) : null,
+      msPerToken: (json['ms_per_token'] as num?)?.toDouble() ?? 0.0,
+      relative: (json['relative'] as num?)?.toDouble() ?? 0.0,
+    );
+  }
+}
+
+/// Decode speed against KV-cache depth (native run_kv_depth_sweep).
+/// Per-token decode time is fitted as a line over the mean KV length while
+/// decoding; the slope is the attention cost of the context.
+class KvDepthSweep {
+  /// "ok" | "cancelled" | "error"
+  final String status;
+  final int tokensPerDepth;
+  final int nCtx;
+  final List<KvDepthPoint> points;
+
+  /// Fitted decode time per token with an empty cache
+  final double baseMsPerToken;
+
+  /// Extra decode time per token for every 1k tokens of context
+  final double overheadMsPer1k;
+
+  /// Goodness of the linear fit (0..1)
+  final double r2;
+
+  /// Context depth at which decode runs at about half its depth-0 speed
+  final double halfSpeedDepth;
+
+  const KvDepthSweep({
+    required this.status,
+    required this.tokensPerDepth,
+    required this.nCtx,
+    required this.points,
+    required this.baseMsPerToken,
+    required this.overheadMsPer1k,
+    required this.r2,
+    required this.halfSpeedDepth,
+  });
+
+  factory KvDepthSweep.fromJson(Map<String, dynamic> json) {
+    final fit = json['fit'] as Map<String, dynamic>;
+    return KvDepthSweep(
+      status: json['status'] as String,
+      tokensPerDepth: json['n_gen'] as int,
+      nCtx: json['n_ctx'] as int,
+      points: (json['depths'] as List)
+          .map((p) => KvDepthPoint.fromJson(p as Map<String, dynamic>))
+          .toList(),
+      baseMsPerToken: (fit['base_ms_per_token'] as num).toDouble(),
+      overheadMsPer1k: (fit['overhead_ms_per_1k'] as num).toDouble(),
+      r2: (fit['r2'] as num).toDouble(),
+      halfSpeedDepth: (fit['half_speed_depth'] as num).toDouble(),
+    );
+  }
+
+  @override
+  String toString() {
+    final curve = points
+        .where((p) => p.status == 'ok')
+        .map((p) => '${p.depth}: ${p.decode!.mean.toStringAsFixed(1)} t/s (${(p.relative * 100).toStringAsFixed(0)}%)')
+        .join(', ');
+    final errors = points.where((p) => p.status == 'error').map((p) => '${p.depth}: ${p.error}').join(', ');
+    return 'KvDepthSweep[$status](tg$tokensPerDepth {$curve}, +${overheadMsPer1k.toStringAsFixed(2)} ms/token per 1k ctx, '
+        'r² ${r2.toStringAsFixed(2)}${errors.isEmpty ? '' : ', errors {$errors}'})';
+  }
+}
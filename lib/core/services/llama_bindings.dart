@@ -2,6 +2,8 @@
 import 'dart:ffi';
 import 'dart:io';
 
+import 'engine_config.dart';
+
 // Native callback function signature
 typedef TokenCallbackNative = Void Function(Pointer<Char> token, Int64 timeMs);
 typedef TokenCallbackDart = void Function(Pointer<Char> token, int timeMs);
@@ -10,6 +12,20 @@ typedef TokenCallbackDart = void Function(Pointer<Char> token, int timeMs);
 typedef LoadModelNative = Int32 Function(Pointer<Char> modelPath);
 typedef LoadModelDart = int Function(Pointer<Char> modelPath);
 
+typedef LoadModelWithConfigNative = Int32 Function(Pointer<Char> modelPath, Pointer<EngineConfigStruct> config);
+typedef LoadModelWithConfigDart = int Function(Pointer<Char> modelPath, Pointer<EngineConfigStruct> config);
+
+typedef LoadModelRegionNative = Int32 Function(
+    Int32 fd, Int64 offset, Int64 length, Pointer<Char> cachePath, Pointer<EngineConfigStruct> config);
+typedef LoadModelRegionDart = int Function(
+    int fd, int offset, int length, Pointer<Char> cachePath, Pointer<EngineConfigStruct> config);
+
+typedef GetEngineConfigNative = Pointer<Char> Function();
+typedef GetEngineConfigDart = Pointer<Char> Function();
+
+typedef ReleaseModelRegionFdNative = Void Function(Int32 fd);
+typedef ReleaseModelRegionFdDart = void Function(int fd);
+
 typedef RunInferenceNative = Int32 Function(Pointer<Char> prompt, Int32 maxTokens);
 typedef RunInferenceDart = int Function(Pointer<Char> prompt, int maxTokens);
 
@@ -25,13 +41,237 @@ typedef GetGeneratedTextDart = Pointer<Char> Function();
 typedef StopInferenceNative = Void Function();
 typedef StopInferenceDart = void Function();
 
+typedef RequestEngineShutdownNative = Int64 Function(Int32 timeoutMs);
+typedef RequestEngineShutdownDart = int Function(int timeoutMs);
+
+typedef GetLastCancelLatencyNative = Int64 Function();
+typedef GetLastCancelLatencyDart = int Function();
+
+typedef RunBenchmarkRepetitionsNative = Pointer<Char> Function(
+    Pointer<Char> prompt, Int32 nTokens, Int32 nWarmup, Int32 nReps);
+typedef RunBenchmarkRepetitionsDart = Pointer<Char> Function(
+    Pointer<Char> prompt, int nTokens, int nWarmup, int nReps);
+
+// Engine worker listeners; text/token are malloc'd and freed by the receiver
+typedef EngineEventCallbackNative = Void Function(Int64 id, Int32 type, Int64 result, Pointer<Char> text);
+typedef EngineTokenCallbackNative = Void Function(Pointer<Char> token, Int64 timeMs);
+
+typedef EngineWorkerAttachNative = Void Function(
+    Pointer<NativeFunction<EngineEventCallbackNative>> onEvent,
+    Pointer<NativeFunction<EngineTokenCallbackNative>> onToken);
+typedef EngineWorkerAttachDart = void Function(
+    Pointer<NativeFunction<EngineEventCallbackNative>> onEvent,
+    Pointer<NativeFunction<EngineTokenCallbackNative>> onToken);
+
+typedef EngineVoidNative = Void Function();
+typedef EngineVoidDart = void Function();
+
+typedef EngineSubmitLoadNative = Int64 Function(Pointer<Char> modelPath, Pointer<EngineConfigStruct> config);
+typedef EngineSubmitLoadDart = int Function(Pointer<Char> modelPath, Pointer<EngineConfigStruct> config);
+
+typedef EngineSubmitLoadRegionNative = Int64 Function(
+    Int32 fd, Int64 offset, Int64 length, Pointer<Char> cachePath, Pointer<EngineConfigStruct> config);
+typedef EngineSubmitLoadRegionDart = int Function(
+    int fd, int offset, int length, Pointer<Char> cachePath, Pointer<EngineConfigStruct> config);
+
+typedef EngineSubmitRunNative = Int64 Function(Pointer<Char> prompt, Int32 maxTokens);
+typedef EngineSubmitRunDart = int Function(Pointer<Char> prompt, int maxTokens);
+
+typedef EngineSubmitRepetitionsNative = Int64 Function(
+    Pointer<Char> prompt, Int32 nTokens, Int32 nWarmup, Int32 nReps);
+typedef EngineSubmitRepetitionsDart = int Function(
+    Pointer<Char> prompt, int nTokens, int nWarmup, int nReps);
+
+typedef EngineSubmitCpuVariantComparisonNative = Int64 Function(
+    Pointer<Char> modelPath, Pointer<Char> prompt, Int32 nTokens, Int32 nWarmup, Int32 nReps);
+typedef EngineSubmitCpuVariantComparisonDart = int Function(
+    Pointer<Char> modelPath, Pointer<Char> prompt, int nTokens, int nWarmup, int nReps);
+
+typedef EngineSubmitHugePageComparisonNative = Int64 Function(
+    Pointer<Char> modelPath, Pointer<Char> prompt, Int32 nTokens, Int32 nWarmup, Int32 nReps);
+typedef EngineSubmitHugePageComparisonDart = int Function(
+    Pointer<Char> modelPath, Pointer<Char> prompt, int nTokens, int nWarmup, int nReps);
+
+typedef GetHugePageReportNative = Pointer<Char> Function();
+typedef GetHugePageReportDart = Pointer<Char> Function();
+
+typedef EngineSubmitFlashAttentionComparisonNative = Int64 Function(
+    Pointer<Char> modelPath, Int32 nGen, Int32 maxDepth, Int32 nReps);
+typedef EngineSubmitFlashAttentionComparisonDart = int Function(
+    Pointer<Char> modelPath, int nGen, int maxDepth, int nReps);
+
+typedef EngineSubmitKvDepthSweepNative = Int64 Function(
+    Pointer<Char> modelPath, Int32 nGen, Int32 maxDepth, Int32 nReps);
+typedef EngineSubmitKvDepthSweepDart = int Function(
+    Pointer<Char> modelPath, int nGen, int maxDepth, int nReps);
+
+typedef EngineSubmitContextContentionNative = Int64 Function(Int32 maxContexts, Int32 nTokens, Int32 overlap);
+typedef EngineSubmitContextContentionDart = int Function(int maxContexts, int nTokens, int overlap);
+
+typedef EngineSubmitSessionRestoreBenchmarkNative = Int64 Function(Pointer<Char> prompt, Int32 nReps);
+typedef EngineSubmitSessionRestoreBenchmarkDart = int Function(Pointer<Char> prompt, int nReps);
+
+typedef EngineSubmitThreadpoolPollSweepNative = Int64 Function(Pointer<Char> prompt, Int32 nTokens, Int32 nReps);
+typedef EngineSubmitThreadpoolPollSweepDart = int Function(Pointer<Char> prompt, int nTokens, int nReps);
+
+typedef EngineSubmitPerplexityNative = Int64 Function(
+    Pointer<Char> text, Int32 nCtx, Int32 nSeq, Int32 maxChunks);
+typedef EngineSubmitPerplexityDart = int Function(Pointer<Char> text, int nCtx, int nSeq, int maxChunks);
+
+typedef EngineSubmitEmbeddingsNative = Int64 Function(Pointer<Pointer<Char>> texts, Int32 nTexts, Int32 pooling,
+    Int32 batchSize, Pointer<Float> out, Int64 outCapacity);
+typedef EngineSubmitEmbeddingsDart = int Function(
+    Pointer<Pointer<Char>> texts, int nTexts, int pooling, int batchSize, Pointer<Float> out, int outCapacity);
+
+typedef EngineSubmitEmbeddingBenchmarkNative = Int64 Function(
+    Pointer<Pointer<Char>> texts, Int32 nTexts, Int32 pooling, Int32 maxBatch);
+typedef EngineSubmitEmbeddingBenchmarkDart = int Function(
+    Pointer<Pointer<Char>> texts, int nTexts, int pooling, int maxBatch);
+
+typedef GetEmbeddingDimNative = Int32 Function();
+typedef GetEmbeddingDimDart = int Function();
+
+typedef SetSessionCacheDirNative = Int32 Function(Pointer<Char> dir);
+typedef SetSessionCacheDirDart = int Function(Pointer<Char> dir);
+
+typedef GetSessionReportNative = Pointer<Char> Function();
+typedef GetSessionReportDart = Pointer<Char> Function();
+
+typedef EngineSubmitBandwidthProbeNative = Int64 Function(Int32 nThreads);
+typedef EngineSubmitBandwidthProbeDart = int Function(int nThreads);
+
+typedef GetDecodeBytesPerTokenNative = Int64 Function(Int32 nPast);
+typedef GetDecodeBytesPerTokenDart = int Function(int nPast);
+
+typedef EngineSubmitDisposeNative = Int64 Function();
+typedef EngineSubmitDisposeDart = int Function();
+
+typedef SetPerfCountersEnabledNative = Void Function(Int32 enabled);
+typedef SetPerfCountersEnabledDart = void Function(int enabled);
+
+typedef GetPerfCounterReportNative = Pointer<Char> Function();
+typedef GetPerfCounterReportDart = Pointer<Char> Function();
+
+typedef SetPowerTelemetryNative = Int32 Function(Int32 enabled, Pointer<Char> sysfsRoot);
+typedef SetPowerTelemetryDart = int Function(int enabled, Pointer<Char> sysfsRoot);
+
+typedef SelectCpuVariantNative = Int32 Function(Pointer<Char> variant);
+typedef SelectCpuVariantDart = int Function(Pointer<Char> variant);
+
+typedef GetCpuBackendInfoNative = Pointer<Char> Function();
+typedef GetCpuBackendInfoDart = Pointer<Char> Function();
+
+typedef StartQuantComparisonNative = Int32 Function(Pointer<Char> sourcePath, Pointer<Char> outputDir,
+    Pointer<Char> prompt, Int32 nTokens, Int32 nThreads, Pointer<EngineConfigStruct> config);
+typedef StartQuantComparisonDart = int Function(Pointer<Char> sourcePath, Pointer<Char> outputDir,
+    Pointer<Char> prompt, int nTokens, int nThreads, Pointer<EngineConfigStruct> config);
+
+typedef GetQuantComparisonProgressNative = Double Function();
+typedef GetQuantComparisonProgressDart = double Function();
+
+typedef GetQuantComparisonReportNative = Pointer<Char> Function();
+typedef GetQuantComparisonReportDart = Pointer<Char> Function();
+
+typedef CancelQuantComparisonNative = Void Function();
+typedef CancelQuantComparisonDart = void Function();
+
+typedef StartModelPrefetchNative = Int32 Function(Pointer<Char> modelPath);
+typedef StartModelPrefetchDart = int Function(Pointer<Char> modelPath);
+
+typedef GetModelPrefetchStatusNative = Pointer<Char> Function();
+typedef GetModelPrefetchStatusDart = Pointer<Char> Function();
+
+typedef CancelModelPrefetchNative = Void Function();
+typedef CancelModelPrefetchDart = void Function();
+
+typedef PlanModelMemoryNative = Pointer<Char> Function(Pointer<Char> modelPath, Pointer<EngineConfigStruct> config);
+typedef PlanModelMemoryDart = Pointer<Char> Function(Pointer<Char> modelPath, Pointer<EngineConfigStruct> config);
+
+typedef PlanModelRegionMemoryNative = Pointer<Char> Function(
+    Int32 fd, Int64 offset, Int64 length, Pointer<EngineConfigStruct> config);
+typedef PlanModelRegionMemoryDart = Pointer<Char> Function(
+    int fd, int offset, int length, Pointer<EngineConfigStruct> config);
+
+typedef GetMemoryCalibrationNative = Pointer<Char> Function();
+typedef GetMemoryCalibrationDart = Pointer<Char> Function();
+
+typedef ValidateGgufNative = Pointer<Char> Function(Pointer<Char> path);
+typedef ValidateGgufDart = Pointer<Char> Function(Pointer<Char> path);
+
+typedef HashModelCreateManifestNative = Pointer<Char> Function(
+    Pointer<Char> modelPath, Pointer<Char> manifestPath, Int32 chunkSizeMB);
+typedef HashModelCreateManifestDart = Pointer<Char> Function(
+    Pointer<Char> modelPath, Pointer<Char> manifestPath, int chunkSizeMB);
+
+typedef HashModelVerifyNative = Pointer<Char> Function(
+    Pointer<Char> modelPath, Pointer<Char> manifestPath, Int64 fromOffset);
+typedef HashModelVerifyDart = Pointer<Char> Function(
+    Pointer<Char> modelPath, Pointer<Char> manifestPath, int fromOffset);
+
+typedef HashModelVerifyPrefixNative = Pointer<Char> Function(
+    Pointer<Char> modelPath, Pointer<Char> manifestPath);
+typedef HashModelVerifyPrefixDart = Pointer<Char> Function(
+    Pointer<Char> modelPath, Pointer<Char> manifestPath);
+
 class LlamaBindings {
   late final DynamicLibrary _dylib;
   late final LoadModelDart loadModel;
+  late final LoadModelWithConfigDart loadModelWithConfig;
+  late final LoadModelRegionDart loadModelRegion;
+  late final GetEngineConfigDart getEngineConfig;
+  late final ReleaseModelRegionFdDart releaseModelRegionFd;
   late final RunInferenceDart runInference;
   late final DisposeModelDart disposeModel;
   late final GetGeneratedTextDart getGeneratedText;
   late final StopInferenceDart stopInference;
+  late final RequestEngineShutdownDart requestEngineShutdown;
+  late final GetLastCancelLatencyDart getLastCancelLatencyUs;
+  late final RunBenchmarkRepetitionsDart runBenchmarkRepetitions;
+  late final EngineWorkerAttachDart engineWorkerAttach;
+  late final EngineVoidDart engineWorkerDetach;
+  late final EngineSubmitLoadDart engineSubmitLoad;
+  late final EngineSubmitLoadRegionDart engineSubmitLoadRegion;
+  late final EngineSubmitRunDart engineSubmitRun;
+  late final EngineSubmitRepetitionsDart engineSubmitRepetitions;
+  late final EngineSubmitCpuVariantComparisonDart engineSubmitCpuVariantComparison;
+  late final EngineSubmitHugePageComparisonDart engineSubmitHugePageComparison;
+  late final GetHugePageReportDart getHugePageReport;
+  late final EngineSubmitFlashAttentionComparisonDart engineSubmitFlashAttentionComparison;
+  late final EngineSubmitKvDepthSweepDart engineSubmitKvDepthSweep;
+  late final EngineSubmitContextContentionDart engineSubmitContextContention;
+  late final EngineSubmitSessionRestoreBenchmarkDart engineSubmitSessionRestoreBenchmark;
+  late final EngineSubmitThreadpoolPollSweepDart engineSubmitThreadpoolPollSweep;
+  late final SetSessionCacheDirDart setSessionCacheDir;
+  late final EngineSubmitPerplexityDart engineSubmitPerplexity;
+  late final EngineSubmitEmbeddingsDart engineSubmitEmbeddings;
+  late final EngineSubmitEmbeddingBenchmarkDart engineSubmitEmbeddingBenchmark;
+  late final GetEmbeddingDimDart getEmbeddingDim;
+  late final GetSessionReportDart getSessionReport;
+  late final EngineSubmitBandwidthProbeDart engineSubmitBandwidthProbe;
+  late final GetDecodeBytesPerTokenDart getDecodeBytesPerToken;
+  late final EngineSubmitDisposeDart engineSubmitDispose;
+  late final EngineVoidDart enginePause;
+  late final EngineVoidDart engineResume;
+  late final EngineVoidDart engineCancel;
+  late final SetPerfCountersEnabledDart setPerfCountersEnabled;
+  late final GetPerfCounterReportDart getPerfCounterReport;
+  late final SetPowerTelemetryDart setPowerTelemetry;
+  late final SelectCpuVariantDart selectCpuVariant;
+  late final GetCpuBackendInfoDart getCpuBackendInfo;
+  late final StartQuantComparisonDart startQuantComparison;
+  late final GetQuantComparisonProgressDart getQuantComparisonProgress;
+  late final GetQuantComparisonReportDart getQuantComparisonReport;
+  late final CancelQuantComparisonDart cancelQuantComparison;
+  late final StartModelPrefetchDart startModelPrefetch;
+  late final GetModelPrefetchStatusDart getModelPrefetchStatus;
+  late final CancelModelPrefetchDart cancelModelPrefetch;
+  late final PlanModelMemoryDart planModelMemory;
+  late final PlanModelRegionMemoryDart planModelRegionMemory;
+  late final GetMemoryCalibrationDart getMemoryCalibration;
+  late final ValidateGgufDart validateGguf;
+  late final HashModelCreateManifestDart hashModelCreateManifest;
+  late final HashModelVerifyDart hashModelVerify;
+  late final HashModelVerifyPrefixDart hashModelVerifyPrefix;
   SetTokenCallbackDart? setTokenCallback;
 
   LlamaBindings() {
@@ -48,6 +288,22 @@ class LlamaBindings {
     loadModel = _dylib
         .lookup<NativeFunction<LoadModelNative>>('load_model')
         .asFunction();
+
+    loadModelWithConfig = _dylib
+        .lookup<NativeFunction<LoadModelWithConfigNative>>('load_model_with_config')
+        .asFunction();
+
+    loadModelRegion = _dylib
+        .lookup<NativeFunction<LoadModelRegionNative>>('load_model_region')
+        .asFunction();
+
+    getEngineConfig = _dylib
+        .lookup<NativeFunction<GetEngineConfigNative>>('get_engine_config')
+        .asFunction();
+
+    releaseModelRegionFd = _dylib
+        .lookup<NativeFunction<ReleaseModelRegionFdNative>>('release_model_region_fd')
+        .asFunction();
     
     runInference = _dylib
         .lookup<NativeFunction<RunInferenceNative>>('run_inference')
@@ -64,6 +320,200 @@ class LlamaBindings {
     stopInference = _dylib
         .lookup<NativeFunction<StopInferenceNative>>('stop_inference')
         .asFunction();
+
+    requestEngineShutdown = _dylib
+        .lookup<NativeFunction<RequestEngineShutdownNative>>('request_engine_shutdown')
+        .asFunction();
+
+    getLastCancelLatencyUs = _dylib
+        .lookup<NativeFunction<GetLastCancelLatencyNative>>('get_last_cancel_latency_us')
+        .asFunction();
+
+    runBenchmarkRepetitions = _dylib
+        .lookup<NativeFunction<RunBenchmarkRepetitionsNative>>('run_benchmark_repetitions')
+        .asFunction();
+
+    engineWorkerAttach = _dylib
+        .lookup<NativeFunction<EngineWorkerAttachNative>>('engine_worker_attach')
+        .asFunction();
+
+    engineWorkerDetach = _dylib
+        .lookup<NativeFunction<EngineVoidNative>>('engine_worker_detach')
+        .asFunction();
+
+    engineSubmitLoad = _dylib
+        .lookup<NativeFunction<EngineSubmitLoadNative>>('engine_submit_load')
+        .asFunction();
+
+    engineSubmitLoadRegion = _dylib
+        .lookup<NativeFunction<EngineSubmitLoadRegionNative>>('engine_submit_load_region')
+        .asFunction();
+
+    engineSubmitRun = _dylib
+        .lookup<NativeFunction<EngineSubmitRunNative>>('engine_submit_run')
+        .asFunction();
+
+    engineSubmitRepetitions = _dylib
+        .lookup<NativeFunction<EngineSubmitRepetitionsNative>>('engine_submit_repetitions')
+        .asFunction();
+
+    engineSubmitCpuVariantComparison = _dylib
+        .lookup<NativeFunction<EngineSubmitCpuVariantComparisonNative>>('engine_submit_cpu_variant_comparison')
+        .asFunction();
+
+    engineSubmitHugePageComparison = _dylib
+        .lookup<NativeFunction<EngineSubmitHugePageComparisonNative>>('engine_submit_huge_page_comparison')
+        .asFunction();
+
+    getHugePageReport = _dylib
+        .lookup<NativeFunction<GetHugePageReportNative>>('get_huge_page_report')
+        .asFunction();
+
+    engineSubmitFlashAttentionComparison = _dylib
+        .lookup<NativeFunction<EngineSubmitFlashAttentionComparisonNative>>(
+            'engine_submit_flash_attention_comparison')
+        .asFunction();
+
+    engineSubmitKvDepthSweep = _dylib
+        .lookup<NativeFunction<EngineSubmitKvDepthSweepNative>>('engine_submit_kv_depth_sweep')
+        .asFunction();
+
+    engineSubmitContextContention = _dylib
+        .lookup<NativeFunction<EngineSubmitContextContentionNative>>('engine_submit_context_contention')
+        .asFunction();
+
+    engineSubmitSessionRestoreBenchmark = _dylib
+        .lookup<NativeFunction<EngineSubmitSessionRestoreBenchmarkNative>>(
+            'engine_submit_session_restore_benchmark')
+        .asFunction();
+
+    engineSubmitThreadpoolPollSweep = _dylib
+        .lookup<NativeFunction<EngineSubmitThreadpoolPollSweepNative>>('engine_submit_threadpool_poll_sweep')
+        .asFunction();
+
+    engineSubmitPerplexity = _dylib
+        .lookup<NativeFunction<EngineSubmitPerplexityNative>>('engine_submit_perplexity')
+        .asFunction();
+
+    engineSubmitEmbeddings = _dylib
+        .lookup<NativeFunction<EngineSubmitEmbeddingsNative>>('engine_submit_embeddings')
+        .asFunction();
+
+    engineSubmitEmbeddingBenchmark = _dylib
+        .lookup<NativeFunction<EngineSubmitEmbeddingBenchmarkNative>>('engine_submit_embedding_benchmark')
+        .asFunction();
+
+    getEmbeddingDim = _dylib
+        .lookup<NativeFunction<GetEmbeddingDimNative>>('get_embedding_dim')
+        .asFunction();
+
+    setSessionCacheDir = _dylib
+        .lookup<NativeFunction<SetSessionCacheDirNative>>('set_session_cache_dir')
+        .asFunction();
+
+    getSessionReport = _dylib
+        .lookup<NativeFunction<GetSessionReportNative>>('get_session_report')
+        .asFunction();
+
+    engineSubmitBandwidthProbe = _dylib
+        .lookup<NativeFunction<EngineSubmitBandwidthProbeNative>>('engine_submit_bandwidth_probe')
+        .asFunction();
+
+    getDecodeBytesPerToken = _dylib
+        .lookup<NativeFunction<GetDecodeBytesPerTokenNative>>('get_decode_bytes_per_token')
+        .asFunction();
+
+    engineSubmitDispose = _dylib
+        .lookup<NativeFunction<EngineSubmitDisposeNative>>('engine_submit_dispose')
+        .asFunction();
+
+    enginePause = _dylib
+        .lookup<NativeFunction<EngineVoidNative>>('engine_pause')
+        .asFunction();
+
+    engineResume = _dylib
+        .lookup<NativeFunction<EngineVoidNative>>('engine_resume')
+        .asFunction();
+
+    engineCancel = _dylib
+        .lookup<NativeFunction<EngineVoidNative>>('engine_cancel')
+        .asFunction();
+
+    setPerfCountersEnabled = _dylib
+        .lookup<NativeFunction<SetPerfCountersEnabledNative>>('set_perf_counters_enabled')
+        .asFunction();
+
+    getPerfCounterReport = _dylib
+        .lookup<NativeFunction<GetPerfCounterReportNative>>('get_perf_counter_report')
+        .asFunction();
+
+    setPowerTelemetry = _dylib
+        .lookup<NativeFunction<SetPowerTelemetryNative>>('set_power_telemetry')
+        .asFunction();
+
+    selectCpuVariant = _dylib
+        .lookup<NativeFunction<SelectCpuVariantNative>>('select_cpu_variant')
+        .asFunction();
+
+    getCpuBackendInfo = _dylib
+        .lookup<NativeFunction<GetCpuBackendInfoNative>>('get_cpu_backend_info')
+        .asFunction();
+
+    startQuantComparison = _dylib
+        .lookup<NativeFunction<StartQuantComparisonNative>>('start_quant_comparison')
+        .asFunction();
+
+    getQuantComparisonProgress = _dylib
+        .lookup<NativeFunction<GetQuantComparisonProgressNative>>('get_quant_comparison_progress')
+        .asFunction();
+
+    getQuantComparisonReport = _dylib
+        .lookup<NativeFunction<GetQuantComparisonReportNative>>('get_quant_comparison_report')
+        .asFunction();
+
+    cancelQuantComparison = _dylib
+        .lookup<NativeFunction<CancelQuantComparisonNative>>('cancel_quant_comparison')
+        .asFunction();
+
+    startModelPrefetch = _dylib
+        .lookup<NativeFunction<StartModelPrefetchNative>>('start_model_prefetch')
+        .asFunction();
+
+    getModelPrefetchStatus = _dylib
+        .lookup<NativeFunction<GetModelPrefetchStatusNative>>('get_model_prefetch_status')
+        .asFunction();
+
+    cancelModelPrefetch = _dylib
+        .lookup<NativeFunction<CancelModelPrefetchNative>>('cancel_model_prefetch')
+        .asFunction();
+
+    planModelMemory = _dylib
+        .lookup<NativeFunction<PlanModelMemoryNative>>('plan_model_memory')
+        .asFunction();
+
+    planModelRegionMemory = _dylib
+        .lookup<NativeFunction<PlanModelRegionMemoryNative>>('plan_model_region_memory')
+        .asFunction();
+
+    getMemoryCalibration = _dylib
+        .lookup<NativeFunction<GetMemoryCalibrationNative>>('get_memory_calibration')
+        .asFunction();
+
+    validateGguf = _dylib
+        .lookup<NativeFunction<ValidateGgufNative>>('validate_gguf')
+        .asFunction();
+
+    hashModelCreateManifest = _dylib
+        .lookup<NativeFunction<HashModelCreateManifestNative>>('hash_model_create_manifest')
+        .asFunction();
+
+    hashModelVerify = _dylib
+        .lookup<NativeFunction<HashModelVerifyNative>>('hash_model_verify')
+        .asFunction();
+
+    hashModelVerifyPrefix = _dylib
+        .lookup<NativeFunction<HashModelVerifyPrefixNative>>('hash_model_verify_prefix')
+        .asFunction();
     
     // setTokenCallback is optional for now
     try {
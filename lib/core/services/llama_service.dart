@@ -1,11 +1,29 @@
 import 'dart:async';
+import 'dart:convert';
 import 'dart:ffi' as ffi;
-import 'dart:isolate';
 import 'dart:io';
+import 'dart:isolate';
 import 'package:ffi/ffi.dart';
+import 'attention_comparison.dart';
+import 'benchmark_stats.dart';
+import 'contention_report.dart';
+import 'cpu_backend_info.dart';
+import 'embeddings.dart';
+import 'energy_report.dart';
+import 'engine_config.dart';
+import 'huge_pages.dart';
+import 'kv_depth_sweep.dart';
 import 'llama_bindings.dart';
+import 'memory_plan.dart';
+import 'model_prefetch.dart';
+import 'model_region.dart';
+import 'perf_report.dart';
+import 'perplexity_report.dart';
+import 'roofline.dart';
+import 'session_snapshot.dart';
+import 'threadpool_sweep.dart';
 
-/// Token event sent from Isolate to main thread
+/// Token event streamed from the native engine worker
 class TokenEvent {
   final String token;
   final int timeMs;
@@ -13,99 +31,643 @@ class TokenEvent {
   const TokenEvent(this.token, this.timeMs);
 }
 
-/// Message types for Isolate communication
-sealed class IsolateMessage {}
-
-class LoadModelMessage extends IsolateMessage {
-  final String modelPath;
-  LoadModelMessage(this.modelPath);
+/// Command types of the native engine worker (engine_worker.cpp)
+abstract final class EngineCommandType {
+  static const load = 0;
+  static const loadRegion = 1;
+  static const run = 2;
+  static const repetitions = 3;
+  static const dispose = 4;
+  static const cpuVariants = 5;
+  static const bandwidth = 6;
+  static const flashAttention = 7;
+  static const kvDepth = 8;
+  static const contention = 9;
+  static const sessionRestore = 10;
+  static const perplexity = 11;
+  static const embed = 12;
+  static const embedBenchmark = 13;
+  static const hugePages = 14;
+  static const pollSweep = 15;
 }
 
-class RunInferenceMessage extends IsolateMessage {
-  final String prompt;
-  final int maxTokens;
-  RunInferenceMessage(this.prompt, this.maxTokens);
-}
+/// Completion of a queued engine command
+class _EngineCompletion {
+  final int result;
+  final String? text;
+
+  /// Completed by [LlamaService.dispose] while the worker may still be running the command
+  final bool abandoned;
 
-class DisposeMessage extends IsolateMessage {}
+  const _EngineCompletion(this.result, this.text, {this.abandoned = false});
+}
 
-/// High-level service for llama.cpp inference
-/// Runs inference in a separate Isolate to prevent UI blocking
+/// High-level service for llama.cpp inference.
+/// Commands go to a long-lived native worker thread through a lock-free queue
+/// and return immediately; completions and tokens come back on this isolate's
+/// port through NativeCallable listeners, so nothing blocks the UI isolate.
 class LlamaService {
-  Isolate? _isolate;
-  SendPort? _sendPort;
-  final _receivePort = ReceivePort();
   final _tokenController = StreamController<List<TokenEvent>>.broadcast();
   final _statusController = StreamController<String>.broadcast();
 
   Stream<List<TokenEvent>> get tokenStream => _tokenController.stream;
   Stream<String> get statusStream => _statusController.stream;
 
+  /// Result of a run that was cancelled before it started
+  static const cancelledResult = -2;
+
   bool _isInitialized = false;
   final _bindingsForMain = LlamaBindings();
+  static const _shutdownTimeout = Duration(seconds: 2);
   String? _lastLoadedModelPath;
+  EngineConfig? _lastLoadedConfig;
+
+  ffi.NativeCallable<EngineEventCallbackNative>? _onEvent;
+  ffi.NativeCallable<EngineTokenCallbackNative>? _onToken;
+  final _pending = <int, Completer<_EngineCompletion>>{};
+  final List<TokenEvent> _tokenBatch = [];
+  int _lastBatchSendTime = 0;
 
-  /// Initialize the service and spawn the Isolate
+  /// Initialize the service and attach to the native engine worker
   Future<void> initialize() async {
     if (_isInitialized) return;
 
-    _receivePort.listen((message) {
-      if (message is SendPort) {
-        _sendPort = message;
-        _statusController.add('Isolate ready');
-      } else if (message is TokenEvent) {
-        _tokenController.add([message]);
-      } else if (message is List<TokenEvent>) {
-        _tokenController.add(message);
-      } else if (message is String) {
-        _statusController.add(message);
+    _onEvent = ffi.NativeCallable<EngineEventCallbackNative>.listener(_onEngineEvent);
+    _onToken = ffi.NativeCallable<EngineTokenCallbackNative>.listener(_onEngineToken);
+    _bindingsForMain.engineWorkerAttach(_onEvent!.nativeFunction, _onToken!.nativeFunction);
+    _isInitialized = true;
+    _statusController.add('Engine worker ready');
+  }
+
+  /// Queue a command and return the future of its completion
+  Future<_EngineCompletion> _submit(int id, String what) {
+    if (id < 0) {
+      return Future.error(Exception('Error: Engine queue rejected $what'));
+    }
+    final completer = Completer<_EngineCompletion>();
+    _pending[id] = completer;
+    return completer.future;
+  }
+
+  void _onEngineEvent(int id, int type, int result, ffi.Pointer<ffi.Char> textPtr) {
+    String? text;
+    if (textPtr != ffi.nullptr) {
+      text = textPtr.cast<Utf8>().toDartString();
+      malloc.free(textPtr);
+    }
+    if (type == EngineCommandType.run) {
+      _flushTokens();
+      if (!_statusController.isClosed) {
+        _statusController.add('Inference complete: $result tokens');
       }
-    });
+    }
+    _pending.remove(id)?.complete(_EngineCompletion(result, text));
+  }
 
-    _isolate = await Isolate.spawn(
-      _isolateEntry,
-      _receivePort.sendPort,
-      debugName: 'NPUCheckInferenceIsolate',
-    );
+  void _onEngineToken(ffi.Pointer<ffi.Char> tokenPtr, int timeMs) {
+    _tokenBatch.add(TokenEvent(tokenPtr.cast<Utf8>().toDartString(), timeMs));
+    malloc.free(tokenPtr);
 
-    // Wait for Isolate to be ready
-    await _statusController.stream.firstWhere((msg) => msg == 'Isolate ready');
-    _isInitialized = true;
+    final now = DateTime.now().millisecondsSinceEpoch;
+    // Emit a batch every ~33ms (30 FPS) to keep UI smooth but not saturated
+    if (now - _lastBatchSendTime >= 33) {
+      _flushTokens();
+      _lastBatchSendTime = now;
+    }
+  }
+
+  void _flushTokens() {
+    if (_tokenBatch.isEmpty || _tokenController.isClosed) return;
+    _tokenController.add(List<TokenEvent>.of(_tokenBatch));
+    _tokenBatch.clear();
   }
 
-  /// Load a model from GGUF file
-  Future<void> loadModel(String modelPath) async {
-    if (_lastLoadedModelPath == modelPath) {
+  /// Load a model from GGUF file, or from a [ModelRegion.uri], with [config].
+  /// The native side clamps the config to the model and device; read the
+  /// values actually used back with [engineConfig].
+  Future<void> loadModel(String modelPath, {EngineConfig config = const EngineConfig()}) async {
+    // Regions get a fresh fd each time; compare the model behind them instead
+    final region = ModelRegion.tryParse(modelPath);
+    final modelKey = region?.modelKey ?? modelPath;
+    if (_lastLoadedModelPath == modelKey && _lastLoadedConfig == config) {
+      // The native side only takes ownership of region fds it loads
+      if (region != null) _bindingsForMain.releaseModelRegionFd(region.fd);
       _statusController.add('Model already loaded: $modelPath');
       return;
     }
 
     if (!_isInitialized) await initialize();
-    _sendPort?.send(LoadModelMessage(modelPath));
-    _lastLoadedModelPath = modelPath;
-    
-    // Wait for the status controller to receive "Model loaded successfully" or Error
-    final result = await _statusController.stream.firstWhere(
-      (msg) => msg.startsWith('Model loaded successfully') || msg.startsWith('Error'),
-    );
+    _statusController.add('Loading model: $modelPath');
 
-    if (result.startsWith('Error')) {
+    // Copied by the native side at submit time
+    final configPtr = malloc<EngineConfigStruct>();
+    config.writeTo(configPtr);
+    final int id;
+    if (region != null) {
+      // Native side takes ownership of the fd
+      final cachePtr = region.cachePath.toNativeUtf8();
+      id = _bindingsForMain.engineSubmitLoadRegion(
+        region.fd,
+        region.offset,
+        region.length,
+        cachePtr.cast(),
+        configPtr,
+      );
+      malloc.free(cachePtr);
+    } else {
+      final pathPtr = modelPath.toNativeUtf8();
+      id = _bindingsForMain.engineSubmitLoad(pathPtr.cast(), configPtr);
+      malloc.free(pathPtr);
+    }
+    malloc.free(configPtr);
+    _lastLoadedModelPath = modelKey;
+    _lastLoadedConfig = config;
+
+    final completion = await _submit(id, 'model load');
+    if (completion.result != 0) {
       _lastLoadedModelPath = null;
-      throw Exception(result);
+      final error = 'Error: Failed to load model (code: ${completion.result})';
+      _statusController.add(error);
+      throw Exception(error);
+    }
+    _statusController.add('Model loaded successfully');
+  }
+
+  /// Check whether loading [modelPath] with [config] fits the available memory,
+  /// from the GGUF header alone, and which smaller n_ctx or KV type would if it
+  /// doesn't. A region ([ModelRegion.uri]) is read through its fd.
+  MemoryPlan planMemory(String modelPath, {EngineConfig config = const EngineConfig()}) {
+    final region = ModelRegion.tryParse(modelPath);
+    final configPtr = malloc<EngineConfigStruct>();
+    config.writeTo(configPtr);
+    final String json;
+    if (region != null) {
+      json = _bindingsForMain
+          .planModelRegionMemory(region.fd, region.offset, region.length, configPtr)
+          .cast<Utf8>()
+          .toDartString();
+    } else {
+      final pathPtr = modelPath.toNativeUtf8();
+      json = _bindingsForMain.planModelMemory(pathPtr.cast(), configPtr).cast<Utf8>().toDartString();
+      malloc.free(pathPtr);
+    }
+    malloc.free(configPtr);
+    return MemoryPlan.fromJson(jsonDecode(json) as Map<String, dynamic>);
+  }
+
+  /// Predicted vs measured footprint of the last load, or null before the first
+  MemoryCalibration? memoryCalibration() {
+    final json = _bindingsForMain.getMemoryCalibration().cast<Utf8>().toDartString();
+    if (json.isEmpty) return null;
+    return MemoryCalibration.fromJson(jsonDecode(json) as Map<String, dynamic>);
+  }
+
+  /// Effective engine config of the loaded model, or null if none is loaded
+  EngineConfig? engineConfig() {
+    final json = _bindingsForMain.getEngineConfig().cast<Utf8>().toDartString();
+    if (json.isEmpty) return null;
+    return EngineConfig.fromJson(jsonDecode(json) as Map<String, dynamic>);
+  }
+
+  /// Queue a generation pass with the loaded model.
+  /// The pass is queued right away, behind any pass still running, so callers
+  /// can pipeline the next one. Completes with the number of tokens generated,
+  /// or [cancelledResult] if it was cancelled before starting.
+  Future<int> runInference(String prompt, {int maxTokens = 100}) async {
+    if (!_isInitialized) {
+      throw StateError('Service not initialized. Call initialize() first.');
+    }
+    final promptPtr = prompt.toNativeUtf8();
+    final id = _bindingsForMain.engineSubmitRun(promptPtr.cast(), maxTokens);
+    malloc.free(promptPtr);
+
+    final completion = await _submit(id, 'inference');
+    if (completion.result == -1) throw Exception('Error: Inference failed');
+    return completion.result;
+  }
+
+  /// Run [warmup] discarded passes and [repetitions] measured passes of a
+  /// fixed [tokens]-token greedy workload on the loaded model.
+  /// Returns null if the run was stopped.
+  Future<RepetitionReport?> runRepetitions(
+    String prompt, {
+    required int tokens,
+    required int warmup,
+    required int repetitions,
+  }) async {
+    if (!_isInitialized) {
+      throw StateError('Service not initialized. Call initialize() first.');
+    }
+    _statusController.add('Starting $warmup warm-up + $repetitions measured runs...');
+    final promptPtr = prompt.toNativeUtf8();
+    final id = _bindingsForMain.engineSubmitRepetitions(promptPtr.cast(), tokens, warmup, repetitions);
+    malloc.free(promptPtr);
+
+    final completion = await _submit(id, 'repetitions');
+    if (completion.text == null) return null;
+    final json = jsonDecode(completion.text!) as Map<String, dynamic>;
+    switch (json['status']) {
+      case 'ok':
+        return RepetitionReport.fromJson(json);
+      case 'cancelled':
+        return null;
+      default:
+        throw Exception('Error: ${json['error']}');
+    }
+  }
+
+  /// Active CPU backend variant, detected CPU features and available variants
+  CpuBackendInfo cpuBackendInfo() {
+    final json = _bindingsForMain.getCpuBackendInfo().cast<Utf8>().toDartString();
+    return CpuBackendInfo.fromJson(jsonDecode(json) as Map<String, dynamic>);
+  }
+
+  /// Load [modelPath] (a plain file) under every CPU variant this device
+  /// supports and run the repetition workload on each. Leaves no model loaded
+  /// unless cancelled before starting; the best variant is active again afterwards.
+  Future<List<CpuVariantResult>> runCpuVariantComparison(
+    String modelPath, {
+    String prompt = 'Write a short story about artificial intelligence:',
+    int tokens = 64,
+    int warmup = 1,
+    int repetitions = 5,
+  }) async {
+    if (!_isInitialized) await initialize();
+    final pathPtr = modelPath.toNativeUtf8();
+    final promptPtr = prompt.toNativeUtf8();
+    final id = _bindingsForMain.engineSubmitCpuVariantComparison(
+      pathPtr.cast(),
+      promptPtr.cast(),
+      tokens,
+      warmup,
+      repetitions,
+    );
+    malloc.free(pathPtr);
+    malloc.free(promptPtr);
+
+    final completion = await _submit(id, 'CPU variant comparison');
+    // Cancelled before starting: the loaded model stays
+    if (completion.result != cancelledResult) _lastLoadedModelPath = null;
+    if (completion.text == null) return const [];
+    final json = jsonDecode(completion.text!) as Map<String, dynamic>;
+    return (json['variants'] as List)
+        .map((v) => CpuVariantResult.fromJson(v as Map<String, dynamic>))
+        .toList();
+  }
+
+  /// Huge page advice for the loaded model and how much of its memory is on
+  /// huge pages right now (see [EngineConfig.hugePages])
+  HugePageReport hugePageReport() {
+    final json = _bindingsForMain.getHugePageReport().cast<Utf8>().toDartString();
+    return HugePageReport.fromJson(jsonDecode(json) as Map<String, dynamic>);
+  }
+
+  /// Load [modelPath] (a plain file) with huge pages off and then on, using the
+  /// engine config of the last load otherwise, and run the repetition workload
+  /// on each. Leaves no model loaded unless cancelled before starting.
+  Future<HugePageComparison?> runHugePageComparison(
+    String modelPath, {
+    String prompt = 'Write a short story about artificial intelligence:',
+    int tokens = 64,
+    int warmup = 1,
+    int repetitions = 5,
+  }) async {
+    if (!_isInitialized) await initialize();
+    final pathPtr = modelPath.toNativeUtf8();
+    final promptPtr = prompt.toNativeUtf8();
+    final id = _bindingsForMain.engineSubmitHugePageComparison(
+      pathPtr.cast(),
+      promptPtr.cast(),
+      tokens,
+      warmup,
+      repetitions,
+    );
+    malloc.free(pathPtr);
+    malloc.free(promptPtr);
+
+    final completion = await _submit(id, 'huge page comparison');
+    // Cancelled before starting: the loaded model stays
+    if (completion.result != cancelledResult) _lastLoadedModelPath = null;
+    if (completion.text == null) return null;
+    return HugePageComparison.fromJson(jsonDecode(completion.text!) as Map<String, dynamic>);
+  }
+
+  /// Load [modelPath] (a plain file) with flash attention off and then on, and
+  /// measure prefill and decode of [tokens] tokens at context depths from 128
+  /// doubling up to [maxDepth]. Uses the engine config of the last load, with
+  /// the context grown to fit. Leaves no model loaded. Returns null if cancelled
+  /// before it started.
+  Future<FlashAttentionComparison?> runFlashAttentionComparison(
+    String modelPath, {
+    int tokens = 32,
+    int maxDepth = 2048,
+    int repetitions = 3,
+  }) async {
+    if (!_isInitialized) await initialize();
+    final pathPtr = modelPath.toNativeUtf8();
+    final id = _bindingsForMain.engineSubmitFlashAttentionComparison(
+      pathPtr.cast(),
+      tokens,
+      maxDepth,
+      repetitions,
+    );
+    malloc.free(pathPtr);
+    _lastLoadedModelPath = null;
+
+    final completion = await _submit(id, 'flash attention comparison');
+    if (completion.text == null) return null;
+    final json = jsonDecode(completion.text!) as Map<String, dynamic>;
+    if (json['status'] == 'error') throw Exception('Error: ${json['error']}');
+    return FlashAttentionComparison.fromJson(json);
+  }
+
+  /// Measure tg[tokens] decode speed from KV-cache depths 0, 512, 1024, …
+  /// up to [maxDepth], filled by a synthetic prefill, and fit the per-token
+  /// attention overhead. Uses the engine config of the last load with the
+  /// context grown to fit. Leaves no model loaded. Returns null if cancelled
+  /// before it started.
+  Future<KvDepthSweep?> runKvDepthSweep(
+    String modelPath, {
+    int tokens = 128,
+    int maxDepth = 4096,
+    int repetitions = 3,
+  }) async {
+    if (!_isInitialized) await initialize();
+    final pathPtr = modelPath.toNativeUtf8();
+    final id = _bindingsForMain.engineSubmitKvDepthSweep(pathPtr.cast(), tokens, maxDepth, repetitions);
+    malloc.free(pathPtr);
+    _lastLoadedModelPath = null;
+
+    final completion = await _submit(id, 'KV depth sweep');
+    if (completion.text == null) return null;
+    final json = jsonDecode(completion.text!) as Map<String, dynamic>;
+    if (json['fit'] == null) throw Exception('Error: ${json['error']}');
+    return KvDepthSweep.fromJson(json);
+  }
+
+  /// Run 1, 2, … [maxContexts] sessions on the loaded model at the same time,
+  /// each with its own context and thread, and compare them with a single
+  /// session. [overlapping] lets every session use all CPUs; otherwise the CPUs
+  /// are split into disjoint sets. Returns null if cancelled before it started.
+  Future<ContentionReport?> runContextContention({
+    int maxContexts = 4,
+    int tokens = 64,
+    bool overlapping = false,
+  }) async {
+    if (!_isInitialized) {
+      throw StateError('Service not initialized. Call initialize() first.');
+    }
+    final id = _bindingsForMain.engineSubmitContextContention(maxContexts, tokens, overlapping ? 1 : 0);
+    final completion = await _submit(id, 'context contention');
+    if (completion.text == null) return null;
+    final json = jsonDecode(completion.text!) as Map<String, dynamic>;
+    if (json['levels'] == null) throw Exception('Error: ${json['error']}');
+    return ContentionReport.fromJson(json);
+  }
+
+  /// Perplexity of the loaded model on [text] with its current engine config,
+  /// in chunks of [nCtx] tokens of which [parallel] are evaluated at once.
+  /// [maxChunks] bounds the run time (0 = the whole text). Returns null if cancelled.
+  Future<PerplexityReport?> runPerplexity(
+    String text, {
+    int nCtx = 256,
+    int parallel = 4,
+    int maxChunks = 8,
+  }) async {
+    if (!_isInitialized) {
+      throw StateError('Service not initialized. Call initialize() first.');
+    }
+    final textPtr = text.toNativeUtf8();
+    final id = _bindingsForMain.engineSubmitPerplexity(textPtr.cast(), nCtx, parallel, maxChunks);
+    malloc.free(textPtr);
+
+    final completion = await _submit(id, 'perplexity');
+    if (completion.text == null) return null;
+    final json = jsonDecode(completion.text!) as Map<String, dynamic>;
+    switch (json['status']) {
+      case 'ok':
+        return PerplexityReport.fromJson(json);
+      case 'cancelled':
+        return null;
+      default:
+        throw Exception('Error: ${json['error']}');
     }
   }
 
-  /// Run inference with the loaded model
-  Future<void> runInference(String prompt, {int maxTokens = 100}) async {
+  /// Copy [texts] into a native array of C strings; free it with [_freeTexts]
+  ffi.Pointer<ffi.Pointer<ffi.Char>> _allocTexts(List<String> texts) {
+    final array = malloc<ffi.Pointer<ffi.Char>>(texts.length);
+    for (var i = 0; i < texts.length; i++) {
+      array[i] = texts[i].toNativeUtf8().cast();
+    }
+    return array;
+  }
+
+  void _freeTexts(ffi.Pointer<ffi.Pointer<ffi.Char>> array, int count) {
+    for (var i = 0; i < count; i++) {
+      malloc.free(array[i]);
+    }
+    malloc.free(array);
+  }
+
+  /// Embed [texts] with the loaded model, packing up to [batchSize] of them
+  /// into each batch. The vectors are L2-normalized and land in one native
+  /// buffer, in input order. Returns null if cancelled.
+  Future<Embeddings?> embed(
+    List<String> texts, {
+    EmbeddingPooling pooling = EmbeddingPooling.model,
+    int batchSize = 16,
+  }) async {
+    if (!_isInitialized) {
+      throw StateError('Service not initialized. Call initialize() first.');
+    }
+    final dimension = _bindingsForMain.getEmbeddingDim();
+    if (dimension <= 0) throw StateError('No model loaded');
+    if (texts.isEmpty) throw ArgumentError('No texts to embed');
+
+    // Written by the worker; stays allocated until the command completes. Sized
+    // for the model loaded now: the worker refuses to run if a load queued ahead
+    // leaves a model whose vectors don't fit.
+    final capacity = texts.length * dimension;
+    final out = malloc<ffi.Float>(capacity);
+    final array = _allocTexts(texts);
+    final id = _bindingsForMain.engineSubmitEmbeddings(array, texts.length, pooling.value, batchSize, out, capacity);
+    _freeTexts(array, texts.length);
+
+    final _EngineCompletion completion;
+    try {
+      completion = await _submit(id, 'embeddings');
+    } catch (_) {
+      // Never queued
+      malloc.free(out);
+      rethrow;
+    }
+    // The worker may still be writing into out; leak it rather than free it under the worker
+    if (completion.abandoned) return null;
+    final json = completion.text != null ? jsonDecode(completion.text!) as Map<String, dynamic> : null;
+    if (json == null || json['status'] != 'ok') {
+      malloc.free(out);
+      if (json == null || json['status'] == 'cancelled') return null;
+      throw Exception('Error: ${json['error']}');
+    }
+    final nEmbd = json['n_embd'] as int;
+    return Embeddings(
+      dimension: nEmbd,
+      data: out.asTypedList(texts.length * nEmbd, finalizer: malloc.nativeFree),
+      pooling: json['pooling'] as String,
+      tokens: json['tokens'] as int,
+      truncated: json['truncated'] as int,
+      stats: EmbeddingRunStats.fromJson(json),
+    );
+  }
+
+  /// Embedding throughput of the loaded model on [texts] at batch sizes 1, 2,
+  /// 4, … up to [maxBatch] (at most 64). Returns null if cancelled.
+  Future<EmbeddingThroughput?> runEmbeddingBenchmark(
+    List<String> texts, {
+    EmbeddingPooling pooling = EmbeddingPooling.model,
+    int maxBatch = 64,
+  }) async {
+    if (!_isInitialized) {
+      throw StateError('Service not initialized. Call initialize() first.');
+    }
+    if (texts.isEmpty) throw ArgumentError('No texts to embed');
+    final array = _allocTexts(texts);
+    final id = _bindingsForMain.engineSubmitEmbeddingBenchmark(array, texts.length, pooling.value, maxBatch);
+    _freeTexts(array, texts.length);
+
+    final completion = await _submit(id, 'embedding benchmark');
+    if (completion.text == null) return null;
+    final json = jsonDecode(completion.text!) as Map<String, dynamic>;
+    switch (json['status']) {
+      case 'ok':
+        return EmbeddingThroughput.fromJson(json);
+      case 'cancelled':
+        return null;
+      default:
+        throw Exception('Error: ${json['error']}');
+    }
+  }
+
+  /// Keep KV snapshots of prefilled prompts under [dir] (null = off). Later
+  /// passes, also after a restart, restore a prompt they have seen with the
+  /// same model file and context layout instead of prefilling it again.
+  bool setSessionCacheDir(String? dir) {
+    final dirPtr = (dir ?? '').toNativeUtf8();
+    final result = _bindingsForMain.setSessionCacheDir(dirPtr.cast());
+    malloc.free(dirPtr);
+    return result == 0;
+  }
+
+  /// How the last pass got its prompt into the KV cache, or null before the first pass
+  SessionReport? sessionReport() {
+    final json = _bindingsForMain.getSessionReport().cast<Utf8>().toDartString();
+    if (json.isEmpty) return null;
+    return SessionReport.fromJson(jsonDecode(json) as Map<String, dynamic>);
+  }
+
+  /// Time re-prefilling [prompt] against restoring its snapshot from storage,
+  /// [repetitions] times each. Needs [setSessionCacheDir] and a loaded model.
+  /// Returns null if cancelled.
+  Future<SessionRestoreBenchmark?> runSessionRestoreBenchmark(String prompt, {int repetitions = 5}) async {
     if (!_isInitialized) {
       throw StateError('Service not initialized. Call initialize() first.');
     }
-    _sendPort?.send(RunInferenceMessage(prompt, maxTokens));
+    final promptPtr = prompt.toNativeUtf8();
+    final id = _bindingsForMain.engineSubmitSessionRestoreBenchmark(promptPtr.cast(), repetitions);
+    malloc.free(promptPtr);
+
+    final completion = await _submit(id, 'session restore benchmark');
+    if (completion.text == null) return null;
+    final json = jsonDecode(completion.text!) as Map<String, dynamic>;
+    switch (json['status']) {
+      case 'ok':
+        return SessionRestoreBenchmark.fromJson(json);
+      case 'cancelled':
+        return null;
+      default:
+        throw Exception('Error: ${json['error']}');
+    }
   }
 
-  /// Stop ongoing inference
+  /// Decode [nTokens] after [prompt] on the loaded model with its compute
+  /// threadpool at each poll level, [repetitions] times per level, measuring
+  /// step latency, CPU time per token and the idle pool's CPU usage (see
+  /// [EngineConfig.poll]). The pool is restored afterwards. Returns null if cancelled.
+  Future<ThreadpoolPollSweep?> runThreadpoolPollSweep(String prompt,
+      {int nTokens = 64, int repetitions = 3}) async {
+    if (!_isInitialized) {
+      throw StateError('Service not initialized. Call initialize() first.');
+    }
+    final promptPtr = prompt.toNativeUtf8();
+    final id = _bindingsForMain.engineSubmitThreadpoolPollSweep(promptPtr.cast(), nTokens, repetitions);
+    malloc.free(promptPtr);
+
+    final completion = await _submit(id, 'threadpool poll sweep');
+    if (completion.text == null) return null;
+    final json = jsonDecode(completion.text!) as Map<String, dynamic>;
+    switch (json['status']) {
+      case 'ok':
+        return ThreadpoolPollSweep.fromJson(json);
+      case 'cancelled':
+        return null;
+      default:
+        throw Exception('Error: ${json['error']}');
+    }
+  }
+
+  /// Measure the sustained memory bandwidth with a STREAM-style probe on
+  /// [threads] threads (0 = all CPUs). Queued like a pass, so it never runs
+  /// concurrently with inference. Returns null if the probe couldn't allocate.
+  Future<BandwidthReport?> measureMemoryBandwidth({int threads = 0}) async {
+    if (!_isInitialized) await initialize();
+    final id = _bindingsForMain.engineSubmitBandwidthProbe(threads);
+    final completion = await _submit(id, 'bandwidth probe');
+    if (completion.text == null || completion.text!.isEmpty) return null;
+    return BandwidthReport.fromJson(jsonDecode(completion.text!) as Map<String, dynamic>);
+  }
+
+  /// Bytes one decode step of the loaded model reads with [nPast] tokens in
+  /// the KV cache (0 if no model is loaded)
+  int decodeBytesPerToken(int nPast) => _bindingsForMain.getDecodeBytesPerToken(nPast);
+
+  /// Stop the running pass and drop any passes queued behind it
   void stopInference() {
-    _bindingsForMain.stopInference();
+    _bindingsForMain.engineCancel();
+  }
+
+  /// Pause the running pass before its next token
+  void pauseInference() {
+    _bindingsForMain.enginePause();
+  }
+
+  /// Resume a paused pass
+  void resumeInference() {
+    _bindingsForMain.engineResume();
+  }
+
+  /// Sample hardware counters (cycles, instructions, LLC/branch misses,
+  /// task-clock) around every decode of the following passes
+  void setPerfCountersEnabled(bool enabled) {
+    _bindingsForMain.setPerfCountersEnabled(enabled ? 1 : 0);
+  }
+
+  /// Counter report of the last pass run with counters enabled, or null
+  PerfReport? perfCounterReport() {
+    final json = _bindingsForMain.getPerfCounterReport().cast<Utf8>().toDartString();
+    if (json.isEmpty) return null;
+    return PerfReport.fromJson(jsonDecode(json) as Map<String, dynamic>);
+  }
+
+  /// Measure the battery energy of the measured repetitions of [runRepetitions]
+  /// against the idle draw just before them (see [EnergyReport]), reading the
+  /// power-supply tree under [sysfsRoot] (default /sys/class/power_supply).
+  /// Returns false if enabling found no battery to read there.
+  bool setPowerTelemetry(bool enabled, {String? sysfsRoot}) {
+    final rootPtr = sysfsRoot?.toNativeUtf8();
+    final rc = _bindingsForMain.setPowerTelemetry(enabled ? 1 : 0, rootPtr?.cast<ffi.Char>() ?? ffi.nullptr);
+    if (rootPtr != null) malloc.free(rootPtr);
+    return rc == 0;
   }
 
   /// Get current RAM usage in MB
@@ -119,117 +681,128 @@ class LlamaService {
     }
   }
 
-  /// Dispose the model and clean up resources
-  Future<void> dispose() async {
-    // 1. Tell native code to stop any ongoing inference
-    // This affects the global state in the C++ library shared by isolates
-    _bindingsForMain.stopInference();
+  /// Start reading [modelPath] into the page cache on a native background
+  /// thread, in the order the first pass touches it, so a later [loadModel]
+  /// finds it warm. Replaces a prefetch that is still running. Regions
+  /// ([ModelRegion.uri]) are not prefetched.
+  bool startPrefetch(String modelPath) {
+    if (ModelRegion.tryParse(modelPath) != null) return false;
+    final pathPtr = modelPath.toNativeUtf8();
+    final result = _bindingsForMain.startModelPrefetch(pathPtr.cast());
+    malloc.free(pathPtr);
+    return result == 0;
+  }
 
-    // 2. Try to signal the isolate to dispose gracefully
-    _sendPort?.send(DisposeMessage());
-    
-    // 3. Give it time to break the inference loop and process the message
-    await Future.delayed(const Duration(milliseconds: 300));
-    
-    // 4. Kill it if it's still alive
-    _isolate?.kill(priority: Isolate.immediate);
-    _isolate = null;
-    _sendPort = null;
-    _isInitialized = false;
-    _lastLoadedModelPath = null;
-    
-    await _tokenController.close();
-    await _statusController.close();
-    _receivePort.close();
+  /// Progress of the last prefetch and how much of the file is resident
+  ModelPrefetchStatus prefetchStatus() {
+    final json = _bindingsForMain.getModelPrefetchStatus().cast<Utf8>().toDartString();
+    return ModelPrefetchStatus.fromJson(jsonDecode(json) as Map<String, dynamic>);
   }
 
-  /// Isolate entry point - runs in separate thread
-  static void _isolateEntry(SendPort mainSendPort) {
-    final isolateReceivePort = ReceivePort();
-    final bindings = LlamaBindings();
+  /// Poll [prefetchStatus] every [interval] until the prefetch stops running
+  Stream<ModelPrefetchStatus> prefetchProgress({Duration interval = const Duration(milliseconds: 250)}) async* {
+    while (true) {
+      final status = prefetchStatus();
+      yield status;
+      if (!status.running) return;
+      await Future.delayed(interval);
+    }
+  }
 
-    // Send our SendPort back to main thread
-    mainSendPort.send(isolateReceivePort.sendPort);
+  /// Cancel the running prefetch after its current chunk
+  void cancelPrefetch() {
+    _bindingsForMain.cancelModelPrefetch();
+  }
 
-    // Set up the native callback
-    _isolateSendPort = mainSendPort;
-    final callbackPointer = ffi.Pointer.fromFunction<TokenCallbackNative>(
-      _nativeTokenCallback,
+  /// Start requantizing [sourcePath] into Q8_0/Q5_K_M/Q4_K_M/Q4_0/Q2_K variants
+  /// under [outputDir] and benchmarking each one, loaded with [config] (default:
+  /// the config of the last load, so the variants compare with its runs). Runs on
+  /// a native background thread; poll [quantComparisonProgress] and [quantComparisonReport].
+  bool startQuantComparison(
+    String sourcePath,
+    String outputDir, {
+    String prompt = 'Write a short story about artificial intelligence:',
+    int tokens = 128,
+    int threads = 0,
+    EngineConfig? config,
+  }) {
+    final sourcePtr = sourcePath.toNativeUtf8();
+    final outputPtr = outputDir.toNativeUtf8();
+    final promptPtr = prompt.toNativeUtf8();
+    // Copied by the native side before it returns
+    final configPtr = malloc<EngineConfigStruct>();
+    (config ?? _lastLoadedConfig ?? const EngineConfig()).writeTo(configPtr);
+    final result = _bindingsForMain.startQuantComparison(
+      sourcePtr.cast(),
+      outputPtr.cast(),
+      promptPtr.cast(),
+      tokens,
+      threads,
+      configPtr,
     );
-    bindings.setTokenCallback?.call(callbackPointer);
+    malloc.free(sourcePtr);
+    malloc.free(outputPtr);
+    malloc.free(promptPtr);
+    malloc.free(configPtr);
+    return result == 0;
+  }
 
-    // Listen for messages from main thread
-    isolateReceivePort.listen((message) {
-      try {
-        if (message is LoadModelMessage) {
-          mainSendPort.send('Loading model: ${message.modelPath}');
-          final pathPtr = message.modelPath.toNativeUtf8();
-          final result = bindings.loadModel(pathPtr.cast());
-          malloc.free(pathPtr);
-
-          if (result == 0) {
-            mainSendPort.send('Model loaded successfully');
-          } else {
-            mainSendPort.send('Error: Failed to load model (code: $result)');
-          }
-        } else if (message is RunInferenceMessage) {
-          mainSendPort.send('Starting inference...');
-          
-          // Reset batch timer for this run
-          _lastBatchSendTime = 0;
-          _tokenBatch.clear();
-
-          final promptPtr = message.prompt.toNativeUtf8();
-          final tokensGenerated = bindings.runInference(
-            promptPtr.cast(),
-            message.maxTokens,
-          );
-          malloc.free(promptPtr);
-
-          // Send any remaining tokens
-          if (_tokenBatch.isNotEmpty) {
-            mainSendPort.send(List<TokenEvent>.of(_tokenBatch));
-            _tokenBatch.clear();
-          }
-          
-          // Get the generated text
-          final textPtr = bindings.getGeneratedText();
-          final generatedText = textPtr.cast<Utf8>().toDartString();
-          
-          print('DEBUG: Generated text length: ${generatedText.length}');
-          print('DEBUG: Generated text: $generatedText');
-          
-          // Send both token count and generated text
-          mainSendPort.send('Inference complete: $tokensGenerated tokens');
-          mainSendPort.send(TokenEvent(generatedText, DateTime.now().millisecondsSinceEpoch));
-        } else if (message is DisposeMessage) {
-          bindings.disposeModel();
-          mainSendPort.send('Model disposed');
-          isolateReceivePort.close();
-        }
-      } catch (e) {
-        mainSendPort.send('Error: $e');
-      }
-    });
+  /// Progress of the running quant comparison (0.0 to 1.0)
+  double get quantComparisonProgress => _bindingsForMain.getQuantComparisonProgress();
+
+  /// Report of the last finished quant comparison, or null while it is running
+  Map<String, dynamic>? quantComparisonReport() {
+    final json = _bindingsForMain.getQuantComparisonReport().cast<Utf8>().toDartString();
+    if (json.isEmpty) return null;
+    return jsonDecode(json) as Map<String, dynamic>;
+  }
+
+  /// Cancel the running quant comparison after its current step
+  void cancelQuantComparison() {
+    _bindingsForMain.cancelQuantComparison();
   }
 
-  static SendPort? _isolateSendPort;
-  static final List<TokenEvent> _tokenBatch = [];
-  static int _lastBatchSendTime = 0;
+  /// Stop-to-idle latency in microseconds of the run the last stop cancelled
+  /// (-1 if that stop found nothing running)
+  int get lastCancelLatencyUs => _bindingsForMain.getLastCancelLatencyUs();
 
-  /// Native callback wrapper (must be top-level or static)
-  static void _nativeTokenCallback(ffi.Pointer<ffi.Char> token, int timeMs) {
-    if (_isolateSendPort != null) {
-      final tokenStr = token.cast<Utf8>().toDartString();
-      _tokenBatch.add(TokenEvent(tokenStr, timeMs));
+  /// Dispose the model and clean up resources
+  Future<void> dispose() async {
+    if (_isInitialized) {
+      // 1. Stop the running pass (aborts mid-graph), drop queued ones and refuse new
+      // runs, then wait until the engine confirms it is idle. Waiting happens on a
+      // helper isolate so the UI thread never blocks on native code.
+      final idleLatencyUs = await Isolate.run(
+        () => LlamaBindings().requestEngineShutdown(_shutdownTimeout.inMilliseconds),
+      );
 
-      final now = DateTime.now().millisecondsSinceEpoch;
-      // Send batch every ~33ms (30 FPS) to keep UI smooth but not saturated
-      if (now - _lastBatchSendTime >= 33) {
-        _isolateSendPort!.send(List<TokenEvent>.of(_tokenBatch));
-        _tokenBatch.clear();
-        _lastBatchSendTime = now;
+      // 2. Free the model on the worker
+      final disposeId = _bindingsForMain.engineSubmitDispose();
+      try {
+        await _submit(disposeId, 'dispose').timeout(_shutdownTimeout);
+        _statusController.add(idleLatencyUs >= 0
+            ? 'Model disposed (engine idle after ${idleLatencyUs}us)'
+            : 'Model disposed (engine was busy for more than ${_shutdownTimeout.inMilliseconds}ms)');
+      } catch (e) {
+        _statusController.add('Error: Engine still busy after ${_shutdownTimeout.inMilliseconds}ms');
       }
+
+      // 3. After detach the worker no longer calls back, so the listeners can be closed
+      _bindingsForMain.engineWorkerDetach();
+      _onEvent?.close();
+      _onToken?.close();
+      _onEvent = null;
+      _onToken = null;
+    }
+
+    for (final completer in _pending.values) {
+      completer.complete(const _EngineCompletion(cancelledResult, null, abandoned: true));
     }
+    _pending.clear();
+    _isInitialized = false;
+    _lastLoadedModelPath = null;
+    
+    await _tokenController.close();
+    await _statusController.close();
   }
 }
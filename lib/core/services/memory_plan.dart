@@ -0,0 +1,168 @@
+import 'engine_config.dart';
+
+/// Predicted footprint of loading a model with one config (native memory_planner)
+class MemoryEstimate {
+  final int nCtx;
+  final String typeK;
+  final String typeV;
+  final double weightsMiB;
+  final double kvMiB;
+  final double computeMiB;
+
+  /// Tokenizer, graph metadata, output buffer
+  final double overheadMiB;
+  final double totalMiB;
+
+  /// Weights are mmapped and not locked: page cache the kernel can reclaim
+  final bool weightsMapped;
+
+  /// [totalMiB] less mapped weights, what has to come out of MemAvailable
+  final double committedMiB;
+
+  const MemoryEstimate({
+    required this.nCtx,
+    required this.typeK,
+    required this.typeV,
+    required this.weightsMiB,
+    required this.kvMiB,
+    required this.computeMiB,
+    required this.overheadMiB,
+    required this.totalMiB,
+    required this.weightsMapped,
+    required this.committedMiB,
+  });
+
+  factory MemoryEstimate.fromJson(Map<String, dynamic> json) {
+    return MemoryEstimate(
+      nCtx: json['n_ctx'] as int,
+      typeK: json['type_k'] as String,
+      typeV: json['type_v'] as String,
+      weightsMiB: (json['weights_mib'] as num).toDouble(),
+      kvMiB: (json['kv_mib'] as num).toDouble(),
+      computeMiB: (json['compute_mib'] as num).toDouble(),
+      overheadMiB: (json['overhead_mib'] as num).toDouble(),
+      totalMiB: (json['total_mib'] as num).toDouble(),
+      weightsMapped: json['weights_mapped'] as bool? ?? false,
+      committedMiB: (json['committed_mib'] as num? ?? json['total_mib'] as num).toDouble(),
+    );
+  }
+
+  @override
+  String toString() => 'n_ctx $nCtx, KV $typeK/$typeV: ${totalMiB.toStringAsFixed(0)} MiB '
+      '(weights ${weightsMiB.toStringAsFixed(0)}${weightsMapped ? ' mapped' : ''}, KV ${kvMiB.toStringAsFixed(0)}, '
+      'compute ${computeMiB.toStringAsFixed(0)})';
+}
+
+enum MemoryVerdict {
+  fits,
+  adjusted, // A smaller n_ctx or KV type fits; see [MemoryPlan.config]
+  doesNotFit,
+  error, // File or config unreadable
+}
+
+/// Whether a model fits the device's available memory, checked before loading it
+/// (native plan_model_memory)
+class MemoryPlan {
+  final MemoryVerdict verdict;
+  final String reason;
+
+  /// MemAvailable plus the buffers of the loaded model, which the load frees
+  final double availableMiB;
+
+  /// The part of [availableMiB] a load may use for committed memory
+  final double budgetMiB;
+
+  /// MemTotal; the whole footprint, mapped weights included, must fit a part of it
+  final double memTotalMiB;
+  final MemoryEstimate? requested;
+  final MemoryEstimate? suggested;
+
+  /// Config to load with: the requested one, or with the suggested n_ctx and KV types
+  final EngineConfig? config;
+
+  const MemoryPlan({
+    required this.verdict,
+    required this.reason,
+    required this.availableMiB,
+    required this.budgetMiB,
+    required this.memTotalMiB,
+    this.requested,
+    this.suggested,
+    this.config,
+  });
+
+  bool get canLoad => verdict == MemoryVerdict.fits || verdict == MemoryVerdict.adjusted;
+
+  factory MemoryPlan.fromJson(Map<String, dynamic> json) {
+    final verdict = json['verdict'] as String;
+    final requested = json['requested'] as Map<String, dynamic>?;
+    final suggested = json['suggested'] as Map<String, dynamic>?;
+    final config = json['config'] as Map<String, dynamic>?;
+    return MemoryPlan(
+      verdict: verdict == 'does_not_fit' ? MemoryVerdict.doesNotFit : MemoryVerdict.values.byName(verdict),
+      reason: json['reason'] as String? ?? '',
+      availableMiB: (json['available_mib'] as num?)?.toDouble() ?? 0.0,
+      budgetMiB: (json['budget_mib'] as num?)?.toDouble() ?? 0.0,
+      memTotalMiB: (json['mem_total_mib'] as num?)?.toDouble() ?? 0.0,
+      requested: verdict != 'error' && requested != null ? MemoryEstimate.fromJson(requested) : null,
+      suggested: verdict != 'error' && suggested != null ? MemoryEstimate.fromJson(suggested) : null,
+      config: config != null ? EngineConfig.fromJson(config) : null,
+    );
+  }
+
+  @override
+  String toString() => 'MemoryPlan(${verdict.name}: $reason; '
+      'requested ${requested ?? '-'}${verdict == MemoryVerdict.adjusted ? ', suggested $suggested' : ''})';
+}
+
+/// Predicted vs measured footprint of the last load, to calibrate the planner
+/// (native get_memory_calibration)
+class MemoryCalibration {
+  final MemoryEstimate predicted;
+  final double weightsMiB;
+  final double kvMiB;
+  final double computeMiB;
+  final double totalMiB;
+
+  /// RSS growth over the load; mmapped weights only count once touched
+  final double rssDeltaMiB;
+  final double availableDropMiB;
+
+  /// (predicted - measured) / measured in percent, by component
+  final Map<String, double> errorPct;
+
+  const MemoryCalibration({
+    required this.predicted,
+    required this.weightsMiB,
+    required this.kvMiB,
+    required this.computeMiB,
+    required this.totalMiB,
+    required this.rssDeltaMiB,
+    required this.availableDropMiB,
+    required this.errorPct,
+  });
+
+  factory MemoryCalibration.fromJson(Map<String, dynamic> json) {
+    final measured = json['measured'] as Map<String, dynamic>;
+    double mib(String key) => (measured[key] as num).toDouble();
+    return MemoryCalibration(
+      predicted: MemoryEstimate.fromJson(json['predicted'] as Map<String, dynamic>),
+      weightsMiB: mib('weights_mib'),
+      kvMiB: mib('kv_mib'),
+      computeMiB: mib('compute_mib'),
+      totalMiB: mib('total_mib'),
+      rssDeltaMiB: mib('rss_delta_mib'),
+      availableDropMiB: mib('available_drop_mib'),
+      errorPct: (json['error_pct'] as Map<String, dynamic>)
+          .map((k, v) => MapEntry(k, (v as num).toDouble())),
+    );
+  }
+
+  @override
+  String toString() {
+    String pct(String key) => '${(errorPct[key] ?? 0).toStringAsFixed(1)}%';
+    return 'MemoryCalibration(predicted ${predicted.totalMiB.toStringAsFixed(0)} MiB, '
+        'measured ${totalMiB.toStringAsFixed(0)} MiB: total ${pct('total')}, KV ${pct('kv')}, '
+        'compute ${pct('compute')}; MemAvailable dropped ${availableDropMiB.toStringAsFixed(0)} MiB)';
+  }
+}
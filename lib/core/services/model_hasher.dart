@@ -0,0 +1,128 @@
+import 'dart:convert';
+import 'dart:isolate';
+import 'package:ffi/ffi.dart';
+import 'llama_bindings.dart';
+
+/// Parsed report from the native chunked Merkle hashing engine
+class HashReport {
+  final String status; // "ok" | "mismatch" | "error"
+  final String root;
+  final String error;
+  final int fileBytes;
+  final int bytesHashed;
+  final List<int> badChunks;
+  final int chunkBytes;
+  final double elapsedMs;
+  final double gbps;
+
+  const HashReport({
+    required this.status,
+    required this.root,
+    required this.error,
+    required this.fileBytes,
+    required this.bytesHashed,
+    required this.badChunks,
+    required this.chunkBytes,
+    required this.elapsedMs,
+    required this.gbps,
+  });
+
+  bool get isOk => status == 'ok';
+  bool get isMismatch => status == 'mismatch';
+
+  /// For [ModelHasher.verifyPrefix]: leading bytes that matched the manifest,
+  /// i.e. where a download can resume
+  int get intactPrefixBytes {
+    if (!isOk && !isMismatch) return 0;
+    if (badChunks.isNotEmpty) return badChunks.first * chunkBytes;
+    return fileBytes - fileBytes % chunkBytes;
+  }
+
+  factory HashReport.fromJson(Map<String, dynamic> json) {
+    return HashReport(
+      status: json['status'] as String,
+      root: json['root'] as String,
+      error: json['error'] as String,
+      fileBytes: json['file_bytes'] as int,
+      bytesHashed: json['bytes_hashed'] as int,
+      badChunks: (json['bad_chunks'] as List).cast<int>(),
+      chunkBytes: json['chunk_bytes'] as int,
+      elapsedMs: (json['elapsed_ms'] as num).toDouble(),
+      gbps: (json['gbps'] as num).toDouble(),
+    );
+  }
+
+  @override
+  String toString() => 'HashReport($status, root: $root, '
+      '${gbps.toStringAsFixed(2)} GB/s, bad chunks: $badChunks)';
+}
+
+/// Content hashing for downloaded models.
+/// Hashing runs natively on all cores; calls are made off the calling isolate.
+///
+/// A model has up to two manifests: the one published with its definition
+/// ([manifestPathFor], fetched before the download), which catches a corrupt or
+/// truncated download, and one recorded from the file itself when nothing was
+/// published ([localManifestPathFor]). The local one is unverified: it trusts
+/// whatever was downloaded and only catches later storage corruption.
+class ModelHasher {
+  /// Location of the published manifest of a model file
+  static String manifestPathFor(String modelPath) => '$modelPath.manifest';
+
+  /// Location of the manifest recorded from the model file itself
+  static String localManifestPathFor(String modelPath) => '$modelPath.local.manifest';
+
+  /// Hash the whole model and record its unverified local manifest
+  static Future<HashReport> createManifest(String modelPath) {
+    final manifestPath = localManifestPathFor(modelPath);
+    return Isolate.run(() {
+      final bindings = LlamaBindings();
+      final modelPtr = modelPath.toNativeUtf8();
+      final manifestPtr = manifestPath.toNativeUtf8();
+      final json = bindings
+          .hashModelCreateManifest(modelPtr.cast(), manifestPtr.cast(), 0)
+          .cast<Utf8>()
+          .toDartString();
+      malloc.free(modelPtr);
+      malloc.free(manifestPtr);
+      return HashReport.fromJson(jsonDecode(json) as Map<String, dynamic>);
+    });
+  }
+
+  /// Verify the model against a manifest, the published one unless [manifestPath]
+  /// is given. With [fromOffset] only the chunks from that byte on are re-hashed,
+  /// for a download that resumed there after [verifyPrefix] checked the rest.
+  static Future<HashReport> verify(String modelPath, {String? manifestPath, int fromOffset = 0}) {
+    final path = manifestPath ?? manifestPathFor(modelPath);
+    return Isolate.run(() {
+      final bindings = LlamaBindings();
+      final modelPtr = modelPath.toNativeUtf8();
+      final manifestPtr = path.toNativeUtf8();
+      final json = bindings
+          .hashModelVerify(modelPtr.cast(), manifestPtr.cast(), fromOffset)
+          .cast<Utf8>()
+          .toDartString();
+      malloc.free(modelPtr);
+      malloc.free(manifestPtr);
+      return HashReport.fromJson(jsonDecode(json) as Map<String, dynamic>);
+    });
+  }
+
+  /// Check the complete chunks of a partial download against the published
+  /// manifest; [HashReport.intactPrefixBytes] is where the download can resume
+  static Future<HashReport> verifyPrefix(String modelPath) {
+    final manifestPath = manifestPathFor(modelPath);
+    return Isolate.run(() {
+      final bindings = LlamaBindings();
+      final modelPtr = modelPath.toNativeUtf8();
+      final manifestPtr = manifestPath.toNativeUtf8();
+      final json = bindings
+          .hashModelVerifyPrefix(modelPtr.cast(), manifestPtr.cast())
+          .cast<Utf8>()
+          .toDartString();
+      malloc.free(modelPtr);
+      malloc.free(manifestPtr);
+      return HashReport.fromJson(jsonDecode(json) as Map<String, dynamic>);
+    });
+  }
+}
@@ -0,0 +1,61 @@
+/// State of the speculative model prefetch (native get_model_prefetch_status)
+class ModelPrefetchStatus {
+  /// "idle" | "running" | "done" | "cancelled" | "error"
+  final String state;
+  final String path;
+
+  /// "layers" (first-pass order from the GGUF tensor table) | "sequential"
+  final String order;
+  final int totalBytes;
+  final int readBytes;
+
+  /// Page-cache residency of the file when the prefetch started and now
+  final int residentBeforeBytes;
+  final int residentBytes;
+
+  /// [readBytes] / [totalBytes]
+  final double progress;
+  final double elapsedMs;
+  final String error;
+
+  const ModelPrefetchStatus({
+    required this.state,
+    required this.path,
+    required this.order,
+    required this.totalBytes,
+    required this.readBytes,
+    required this.residentBeforeBytes,
+    required this.residentBytes,
+    required this.progress,
+    required this.elapsedMs,
+    this.error = '',
+  });
+
+  bool get running => state == 'running';
+
+  /// Bytes the prefetch brought in from storage
+  int get warmedBytes => residentBytes > residentBeforeBytes ? residentBytes - residentBeforeBytes : 0;
+
+  factory ModelPrefetchStatus.fromJson(Map<String, dynamic> json) {
+    return ModelPrefetchStatus(
+      state: json['state'] as String,
+      path: json['path'] as String,
+      order: json['order'] as String,
+      totalBytes: json['total_bytes'] as int,
+      readBytes: json['read_bytes'] as int,
+      residentBeforeBytes: json['resident_before_bytes'] as int,
+      residentBytes: json['resident_bytes'] as int,
+      progress: (json['progress'] as num).toDouble(),
+      elapsedMs: (json['elapsed_ms'] as num).toDouble(),
+      error: json['error'] as String? ?? '',
+    );
+  }
+
+  @override
+  String toString() {
+    String mib(int bytes) => (bytes / (1024 * 1024)).toStringAsFixed(1);
+    return 'ModelPrefetchStatus($state, ${(progress * 100).toStringAsFixed(0)}% of ${mib(totalBytes)} MiB '
+        '($order), resident ${mib(residentBeforeBytes)} -> ${mib(residentBytes)} MiB in '
+        '${elapsedMs.toStringAsFixed(0)} ms${error.isEmpty ? '' : ', $error'})';
+  }
+}
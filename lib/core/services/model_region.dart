@@ -0,0 +1,70 @@
+import 'package:flutter/services.dart';
+
+/// A GGUF stored at [offset, offset + length) of an open file descriptor,
+/// e.g. an uncompressed asset inside the APK. Passed to [LlamaService.loadModel]
+/// through its [uri] so the existing path-based flow can carry it.
+class ModelRegion {
+  static const _channel = MethodChannel('npu_check/model_assets');
+  static const _scheme = 'region';
+
+  final int fd;
+  final int offset;
+  final int length;
+
+  /// Where the native loader materializes the region if it can't map it in place
+  final String cachePath;
+
+  const ModelRegion({
+    required this.fd,
+    required this.offset,
+    required this.length,
+    required this.cachePath,
+  });
+
+  String get uri => Uri(
+        scheme: _scheme,
+        host: '$fd',
+        queryParameters: {
+          'offset': '$offset',
+          'length': '$length',
+          'cache': cachePath,
+        },
+      ).toString();
+
+  /// Identity of the model behind the region, stable across fds
+  String get modelKey => '$cachePath@$offset+$length';
+
+  /// Parse a [uri] produced by this class; returns null for plain file paths
+  static ModelRegion? tryParse(String path) {
+    if (!path.startsWith('$_scheme://')) return null;
+    final uri = Uri.parse(path);
+    return ModelRegion(
+      fd: int.parse(uri.host),
+      offset: int.parse(uri.queryParameters['offset']!),
+      length: int.parse(uri.queryParameters['length']!),
+      cachePath: uri.queryParameters['cache']!,
+    );
+  }
+
+  /// Open a bundled asset as a region of the APK.
+  /// Returns null when the platform can't (iOS, compressed asset).
+  static Future<ModelRegion?> openAsset(String assetPath, String cachePath) async {
+    try {
+      final result = await _channel.invokeMapMethod<String, dynamic>(
+        'openAssetRegion',
+        {'asset': assetPath},
+      );
+      if (result == null) return null;
+      return ModelRegion(
+        fd: result['fd'] as int,
+        offset: result['offset'] as int,
+        length: result['length'] as int,
+        cachePath: cachePath,
+      );
+    } on MissingPluginException {
+      return null;
+    } on PlatformException {
+      return null;
+    }
+  }
+}
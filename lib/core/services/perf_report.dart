@@ -0,0 +1,55 @@
+/// Hardware counter report for one inference run (native perf_counters.cpp).
+/// Counters the kernel won't open (perf_event_paranoid, seccomp, missing PMU
+/// event) are reported as unavailable and read as zero.
+class PerfReport {
+  final bool available;
+  final String reason;
+  final Map<String, bool> counters;
+  final int tokens;
+  final double ipc;
+  final double llcMissesPerToken;
+  final double branchMissesPerToken;
+  final double taskClockMsPerToken;
+  final List<double> stepIpc;
+  final List<int> stepLlcMisses;
+
+  const PerfReport({
+    required this.available,
+    required this.reason,
+    required this.counters,
+    required this.tokens,
+    required this.ipc,
+    required this.llcMissesPerToken,
+    required this.branchMissesPerToken,
+    required this.taskClockMsPerToken,
+    required this.stepIpc,
+    required this.stepLlcMisses,
+  });
+
+  bool has(String counter) => counters[counter] ?? false;
+
+  factory PerfReport.fromJson(Map<String, dynamic> json) {
+    return PerfReport(
+      available: json['available'] as bool,
+      reason: json['reason'] as String,
+      counters: (json['counters'] as Map<String, dynamic>).cast<String, bool>(),
+      tokens: json['tokens'] as int,
+      ipc: (json['ipc'] as num).toDouble(),
+      llcMissesPerToken: (json['llc_misses_per_token'] as num).toDouble(),
+      branchMissesPerToken: (json['branch_misses_per_token'] as num).toDouble(),
+      taskClockMsPerToken: (json['task_clock_ms_per_token'] as num).toDouble(),
+      stepIpc: (json['step_ipc'] as List).map((v) => (v as num).toDouble()).toList(),
+      stepLlcMisses: (json['step_llc_misses'] as List).cast<int>(),
+    );
+  }
+
+  @override
+  String toString() {
+    if (!available) return 'PerfReport(unavailable: $reason)';
+    return 'PerfReport($tokens tokens, '
+        'IPC ${has('cycles') && has('instructions') ? ipc.toStringAsFixed(2) : 'n/a'}, '
+        'LLC misses/token ${has('llc_misses') ? llcMissesPerToken.toStringAsFixed(0) : 'n/a'}, '
+        'branch misses/token ${has('branch_misses') ? branchMissesPerToken.toStringAsFixed(0) : 'n/a'}, '
+        'task-clock ${taskClockMsPerToken.toStringAsFixed(2)} ms/token)';
+  }
+}
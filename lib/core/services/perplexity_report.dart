@@ -0,0 +1,56 @@
+import 'engine_config.dart';
+
+/// Perplexity of the loaded model on an evaluation text (native run_perplexity)
+class PerplexityReport {
+  /// Tokens per chunk; only the second half of each chunk is scored
+  final int nCtx;
+
+  /// Chunks evaluated together as parallel sequences
+  final int parallel;
+  final int chunks;
+  final int tokensScored;
+  final double perplexity;
+
+  /// Standard error of [perplexity] over the scored tokens
+  final double stderr;
+
+  /// Tokens decoded per second of llama_decode time
+  final double evalTokensPerSecond;
+  final double elapsedSeconds;
+  final List<double> chunkPerplexity;
+
+  /// KV types, flash attention and threads the evaluation ran with
+  final EngineConfig config;
+
+  const PerplexityReport({
+    required this.nCtx,
+    required this.parallel,
+    required this.chunks,
+    required this.tokensScored,
+    required this.perplexity,
+    required this.stderr,
+    required this.evalTokensPerSecond,
+    required this.elapsedSeconds,
+    required this.chunkPerplexity,
+    required this.config,
+  });
+
+  factory PerplexityReport.fromJson(Map<String, dynamic> json) {
+    return PerplexityReport(
+      nCtx: json['n_ctx'] as int,
+      parallel: json['n_seq'] as int,
+      chunks: json['chunks'] as int,
+      tokensScored: json['tokens_scored'] as int,
+      perplexity: (json['perplexity'] as num).toDouble(),
+      stderr: (json['ppl_stderr'] as num).toDouble(),
+      evalTokensPerSecond: (json['eval_tps'] as num).toDouble(),
+      elapsedSeconds: (json['elapsed_s'] as num).toDouble(),
+      chunkPerplexity: (json['chunk_ppl'] as List).map((p) => (p as num).toDouble()).toList(),
+      config: EngineConfig.fromJson(json['config'] as Map<String, dynamic>),
+    );
+  }
+
+  @override
+  String toString() => 'PPL ${perplexity.toStringAsFixed(3)} ± ${stderr.toStringAsFixed(3)} '
+      '($chunks × $nCtx tokens, $parallel parallel, ${evalTokensPerSecond.toStringAsFixed(1)} t/s)';
+}
@@ -0,0 +1,86 @@
+/// STREAM kernel rates in GB/s (native bandwidth_probe.cpp)
+class StreamRates {
+  final double copy;
+  final double scale;
+  final double triad;
+
+  const StreamRates({required this.copy, required this.scale, required this.triad});
+
+  double get best => [copy, scale, triad].reduce((a, b) => a > b ? a : b);
+
+  factory StreamRates.fromJson(Map<String, dynamic> json) {
+    return StreamRates(
+      copy: (json['copy'] as num).toDouble(),
+      scale: (json['scale'] as num).toDouble(),
+      triad: (json['triad'] as num).toDouble(),
+    );
+  }
+
+  @override
+  String toString() => 'copy ${copy.toStringAsFixed(1)} / scale ${scale.toStringAsFixed(1)} / '
+      'triad ${triad.toStringAsFixed(1)} GB/s';
+}
+
+/// Sustained memory bandwidth of the device, measured past the last-level cache
+class BandwidthReport {
+  final int llcBytes;
+  final int arrayBytes;
+  final int threads;
+  final StreamRates single;
+  final StreamRates multi;
+
+  /// Highest rate of any kernel; the ceiling used for the roofline bound
+  final double bestGBps;
+
+  const BandwidthReport({
+    required this.llcBytes,
+    required this.arrayBytes,
+    required this.threads,
+    required this.single,
+    required this.multi,
+    required this.bestGBps,
+  });
+
+  factory BandwidthReport.fromJson(Map<String, dynamic> json) {
+    return BandwidthReport(
+      llcBytes: json['llc_bytes'] as int,
+      arrayBytes: json['array_bytes'] as int,
+      threads: json['threads'] as int,
+      single: StreamRates.fromJson(json['single'] as Map<String, dynamic>),
+      multi: StreamRates.fromJson(json['multi'] as Map<String, dynamic>),
+      bestGBps: (json['best_gbps'] as num).toDouble(),
+    );
+  }
+
+  @override
+  String toString() => 'BandwidthReport(1 thread: $single; $threads threads: $multi)';
+}
+
+/// Decode speed measured against the bandwidth bound of the device.
+/// Batch-1 decoding reads every weight (and the KV cache) once per token, so
+/// it can't beat bandwidth / bytes per token; low efficiency on a fast device
+/// points at the engine rather than the hardware.
+class RooflineScore {
+  final double bandwidthGBps;
+  final int bytesPerToken;
+  final double measuredTokensPerSecond;
+
+  const RooflineScore({
+    required this.bandwidthGBps,
+    required this.bytesPerToken,
+    required this.measuredTokensPerSecond,
+  });
+
+  /// Theoretical maximum decode rate of this model on this device
+  double get ceilingTokensPerSecond => bytesPerToken > 0 ? bandwidthGBps * 1e9 / bytesPerToken : 0.0;
+
+  /// Fraction of the ceiling reached (0.0 to ~1.0)
+  double get efficiency =>
+      ceilingTokensPerSecond > 0 ? measuredTokensPerSecond / ceilingTokensPerSecond : 0.0;
+
+  @override
+  String toString() => 'RooflineScore(${measuredTokensPerSecond.toStringAsFixed(2)} of '
+      '${ceilingTokensPerSecond.toStringAsFixed(2)} t/s at ${bandwidthGBps.toStringAsFixed(1)} GB/s, '
+      '${(bytesPerToken / (1 << 20)).toStringAsFixed(0)} MiB/token, '
+      'efficiency ${(efficiency * 100).toStringAsFixed(0)}%)';
+}
@@ -0,0 +1,130 @@
+import 'benchmark_stats.dart';
+
+/// Outcome of saving or restoring a KV session snapshot
+class SessionSnapshotResult {
+  /// "restored" | "saved" | "missing" | "stale" | "error"
+  final String status;
+
+  /// stale: which key component changed ("model", "prompt", "config", "format");
+  /// error: what failed
+  final String reason;
+  final int bytes;
+  final double elapsedMs;
+
+  const SessionSnapshotResult({
+    required this.status,
+    this.reason = '',
+    this.bytes = 0,
+    this.elapsedMs = 0.0,
+  });
+
+  factory SessionSnapshotResult.fromJson(Map<String, dynamic> json) {
+    return SessionSnapshotResult(
+      status: json['status'] as String,
+      reason: json['reason'] as String? ?? '',
+      bytes: json['bytes'] as int? ?? 0,
+      elapsedMs: (json['elapsed_ms'] as num?)?.toDouble() ?? 0.0,
+    );
+  }
+}
+
+/// How the last pass got its prompt into the KV cache (native get_session_report)
+class SessionReport {
+  final bool enabled;
+
+  /// "restored" (from a snapshot) | "prefilled"
+  final String source;
+  final int promptTokens;
+
+  /// Prefill time; 0 when the prompt was restored
+  final double prefillMs;
+  final SessionSnapshotResult? restore;
+  final SessionSnapshotResult? save;
+
+  const SessionReport({
+    required this.enabled,
+    required this.source,
+    required this.promptTokens,
+    required this.prefillMs,
+    this.restore,
+    this.save,
+  });
+
+  bool get restored => source == 'restored';
+
+  /// Time until the prompt was in the KV cache, whichever way it got there
+  double get promptMs => restored ? restore!.elapsedMs : prefillMs;
+
+  factory SessionReport.fromJson(Map<String, dynamic> json) {
+    final restore = json['restore'] as Map<String, dynamic>?;
+    final save = json['save'] as Map<String, dynamic>?;
+    return SessionReport(
+      enabled: json['enabled'] as bool,
+      source: json['source'] as String,
+      promptTokens: json['prompt_tokens'] as int,
+      prefillMs: (json['prefill_ms'] as num).toDouble(),
+      restore: restore != null ? SessionSnapshotResult.fromJson(restore) : null,
+      save: save != null ? SessionSnapshotResult.fromJson(save) : null,
+    );
+  }
+
+  @override
+  String toString() {
+    if (restored) {
+      return '$promptTokens-token prompt restored in ${restore!.elapsedMs.toStringAsFixed(1)} ms '
+          '(${(restore!.bytes / 1024).toStringAsFixed(0)} KiB)';
+    }
+    final stale = restore?.status == 'stale' ? ', stale snapshot: ${restore!.reason} changed' : '';
+    return '$promptTokens-token prompt prefilled in ${prefillMs.toStringAsFixed(1)} ms$stale';
+  }
+}
+
+/// Re-prefill vs snapshot restore of one prompt (native run_session_restore_benchmark)
+class SessionRestoreBenchmark {
+  final int promptTokens;
+  final int repetitions;
+  final int snapshotBytes;
+  final double saveMs;
+
+  /// Whether the page cache was dropped before every restore, as after a cold start
+  final bool coldReads;
+
+  /// Whether the restored state predicts the same first token as a fresh prefill
+  final bool firstTokenMatch;
+  final SampleStats prefillMs;
+  final SampleStats restoreMs;
+
+  /// Median prefill time / median restore time
+  final double speedup;
+
+  const SessionRestoreBenchmark({
+    required this.promptTokens,
+    required this.repetitions,
+    required this.snapshotBytes,
+    required this.saveMs,
+    required this.coldReads,
+    required this.firstTokenMatch,
+    required this.prefillMs,
+    required this.restoreMs,
+    required this.speedup,
+  });
+
+  factory SessionRestoreBenchmark.fromJson(Map<String, dynamic> json) {
+    return SessionRestoreBenchmark(
+      promptTokens: json['prompt_tokens'] as int,
+      repetitions: json['repetitions'] as int,
+      snapshotBytes: json['snapshot_bytes'] as int,
+      saveMs: (json['save_ms'] as num).toDouble(),
+      coldReads: json['cold_reads'] as bool,
+      firstTokenMatch: json['first_token_match'] as bool,
+      prefillMs: SampleStats.fromJson(json['prefill_ms'] as Map<String, dynamic>),
+      restoreMs: SampleStats.fromJson(json['restore_ms'] as Map<String, dynamic>),
+      speedup: (json['speedup'] as num).toDouble(),
+    );
+  }
+
+  @override
+  String toString() => '$promptTokens tokens: prefill ${prefillMs.median.toStringAsFixed(1)} ms, '
+      'restore ${restoreMs.median.toStringAsFixed(1)} ms${coldReads ? ' (cold)' : ''} '
+      '= ${speedup.toStringAsFixed(1)}x, snapshot ${(snapshotBytes / 1024).toStringAsFixed(0)} KiB';
+}
@@ -0,0 +1,116 @@
+import 'benchmark_stats.dart';
+
+/// Decode step latency percentiles of one poll level, in ms
+class StepLatency {
+  final double mean;
+  final double p50;
+  final double p90;
+  final double p99;
+  final double max;
+
+  const StepLatency({
+    required this.mean,
+    required this.p50,
+    required this.p90,
+    required this.p99,
+    required this.max,
+  });
+
+  factory StepLatency.fromJson(Map<String, dynamic> json) {
+    double ms(String key) => (json[key] as num).toDouble();
+    return StepLatency(mean: ms('mean'), p50: ms('p50'), p90: ms('p90'), p99: ms('p99'), max: ms('max'));
+  }
+}
+
+/// Decode latency and CPU cost at one threadpool poll level
+class PollLevelResult {
+  /// [EngineConfig.poll] of the level
+  final int poll;
+
+  /// Decode throughput over the repetitions, t/s
+  final SampleStats decode;
+  final StepLatency stepMs;
+
+  /// Process CPU time per decoded token
+  final double cpuMsPerToken;
+
+  /// Mean number of busy cores while decoding
+  final double cpuCores;
+
+  /// Process CPU usage right after a run, with the pool left running and
+  /// paused, in percent of one core
+  final double idleCpuPct;
+  final double pausedIdleCpuPct;
+
+  const PollLevelResult({
+    required this.poll,
+    required this.decode,
+    required this.stepMs,
+    required this.cpuMsPerToken,
+    required this.cpuCores,
+    required this.idleCpuPct,
+    required this.pausedIdleCpuPct,
+  });
+
+  factory PollLevelResult.fromJson(Map<String, dynamic> json) {
+    return PollLevelResult(
+      poll: json['poll'] as int,
+      decode: SampleStats.fromJson(json['decode'] as Map<String, dynamic>),
+      stepMs: StepLatency.fromJson(json['step_ms'] as Map<String, dynamic>),
+      cpuMsPerToken: (json['cpu_ms_per_token'] as num).toDouble(),
+      cpuCores: (json['cpu_cores'] as num).toDouble(),
+      idleCpuPct: (json['idle_cpu_pct'] as num).toDouble(),
+      pausedIdleCpuPct: (json['paused_idle_cpu_pct'] as num).toDouble(),
+    );
+  }
+
+  @override
+  String toString() => 'poll $poll: step p50 ${stepMs.p50.toStringAsFixed(2)} ms, '
+      'p99 ${stepMs.p99.toStringAsFixed(2)} ms, ${cpuMsPerToken.toStringAsFixed(2)} CPU ms/token '
+      '(${cpuCores.toStringAsFixed(2)} cores), idle ${idleCpuPct.toStringAsFixed(1)}% '
+      '(paused ${pausedIdleCpuPct.toStringAsFixed(1)}%)';
+}
+
+/// Threadpool poll level sweep on the loaded model (native run_threadpool_poll_sweep)
+class ThreadpoolPollSweep {
+  final int promptTokens;
+  final int nTokens;
+  final int repetitions;
+
+  /// Window the idle CPU usage is measured over
+  final int idleWindowMs;
+  final int nThreads;
+
+  /// Whether the CPU backend can pause the pool between runs
+  final bool pausable;
+  final List<PollLevelResult> levels;
+
+  const ThreadpoolPollSweep({
+    required this.promptTokens,
+    required this.nTokens,
+    required this.repetitions,
+    required this.idleWindowMs,
+    required this.nThreads,
+    required this.pausable,
+    required this.levels,
+  });
+
+  factory ThreadpoolPollSweep.fromJson(Map<String, dynamic> json) {
+    final threadpool = json['threadpool'] as Map<String, dynamic>;
+    return ThreadpoolPollSweep(
+      promptTokens: json['prompt_tokens'] as int,
+      nTokens: json['n_tokens'] as int,
+      repetitions: json['repetitions'] as int,
+      idleWindowMs: json['idle_window_ms'] as int,
+      nThreads: threadpool['n_threads'] as int,
+      pausable: threadpool['pausable'] as bool,
+      levels: (json['levels'] as List)
+          .map((l) => PollLevelResult.fromJson(l as Map<String, dynamic>))
+          .toList(),
+    );
+  }
+
+  @override
+  String toString() => 'ThreadpoolPollSweep($nThreads threads, $nTokens tokens x $repetitions)\n'
+      '${levels.map((l) => '  $l').join('\n')}';
+}
@@ -1,9 +1,16 @@
 import 'dart:async';
+import 'dart:convert';
 import 'dart:io';
+import 'package:flutter/services.dart' show rootBundle;
 import 'package:riverpod_annotation/riverpod_annotation.dart';
 import 'package:device_info_plus/device_info_plus.dart';
 import 'package:connectivity_plus/connectivity_plus.dart';
+import '../../../core/services/benchmark_stats.dart';
+import '../../../core/services/engine_config.dart';
 import '../../../core/services/llama_service.dart';
+import '../../../core/services/memory_plan.dart';
+import '../../../core/services/perplexity_report.dart';
+import '../../../core/services/roofline.dart';
 import '../domain/model_manager.dart';
 import '../domain/model_strategy.dart';
 import '../domain/model_type.dart';
@@ -30,6 +37,11 @@ class BenchmarkController extends _$BenchmarkController {
   final StringBuffer _generatedBuffer = StringBuffer();
   final Map<ModelType, Future<String?>> _activeDownloads = {};
   Timer? _durationTimer;
+  BandwidthReport? _bandwidth; // Probed once per session; it doesn't depend on the model
+  EngineConfig _engineConfig = const EngineConfig();
+
+  static const _benchmarkPrompt = 'Write a short story about artificial intelligence:';
+  static const _perplexityCorpus = 'assets/corpus/perplexity.txt';
 
   @override
   BenchmarkState build() {
@@ -79,6 +91,8 @@ class BenchmarkController extends _$BenchmarkController {
     _statusSubscription = _llamaService!.statusStream.listen(_onStatusUpdate);
     
     await _llamaService!.initialize();
+    // The first pass after a launch restores the benchmark prompt instead of prefilling it
+    _llamaService!.setSessionCacheDir(await _modelManager.sessionCacheDir());
   }
 
   Future<void> _disposeService() async {
@@ -111,17 +125,38 @@ class BenchmarkController extends _$BenchmarkController {
       hasPartialDownload: hasPartial,
     );
     
+    // The previous selection's prefetch would only evict pages of this one
+    _llamaService?.cancelPrefetch();
+
     // Proactively refresh the downloaded models list to be absolutely sure
     await _refreshDownloadedModels();
     
     // Auto-trigger download if needed
     final strategy = await _modelManager.selectStrategy(modelType: modelType);
+    String? modelPath;
     if (strategy is OnlineModelStrategy) {
       if (_activeDownloads.containsKey(modelType)) {
         // Already downloading this model, just wait for the existing task
         return;
       }
-      await _ensureModelDownloaded(strategy);
+      modelPath = await _ensureModelDownloaded(strategy);
+    } else if (strategy is! EmbeddedModelStrategy) {
+      modelPath = await strategy.getModelPath();
+    }
+
+    if (modelPath != null && state.selectedModel == modelType && await File(modelPath).exists()) {
+      unawaited(_prefetchModel(modelPath));
+    }
+  }
+
+  /// Warm the page cache with the selected model while the user is still
+  /// choosing a workload, so the load in [startBenchmark] doesn't wait on storage
+  Future<void> _prefetchModel(String modelPath) async {
+    await _initService();
+    final service = _llamaService!;
+    if (!service.startPrefetch(modelPath)) return;
+    await for (final status in service.prefetchProgress()) {
+      if (!status.running) print('Model prefetch: $status');
     }
   }
 
@@ -160,6 +195,11 @@ class BenchmarkController extends _$BenchmarkController {
 
       // Initialize service
       await _initService();
+      // Counters only cost a few syscalls per token and the saved speed comes
+      // from the repetitions below, which run without them
+      _llamaService!.setPerfCountersEnabled(true);
+      // Energy per token of the repetitions; phones without a readable battery just skip it
+      _llamaService!.setPowerTelemetry(true);
 
       // Ensure model is ready (downloaded/extracted)
       final strategy = await _modelManager.selectStrategy(modelType: state.selectedModel);
@@ -172,9 +212,23 @@ class BenchmarkController extends _$BenchmarkController {
         modelName: strategy.modelName,
       );
 
+      // Normally finished while the workload was being chosen; a prefetch still
+      // running keeps reading ahead of the load
+      print('Model prefetch: ${_llamaService!.prefetchStatus()}');
+
+      // Fail before a load that would get the process killed halfway through;
+      // if a smaller context or KV cache type fits, load with that instead
+      var loadConfig = _engineConfig;
+      final memoryPlan = _llamaService!.planMemory(modelPath, config: _engineConfig);
+      print('Memory plan: $memoryPlan');
+      if (memoryPlan.verdict == MemoryVerdict.doesNotFit) {
+        throw Exception('Not enough memory for ${strategy.modelName}: ${memoryPlan.reason}');
+      }
+      if (memoryPlan.verdict == MemoryVerdict.adjusted) loadConfig = memoryPlan.config!;
+
       // Load model with corruption recovery
       try {
-        await _llamaService!.loadModel(modelPath);
+        await _llamaService!.loadModel(modelPath, config: loadConfig);
       } catch (e) {
         // If loading fails, it's likely a corrupt model file (code -1)
         // We should delete it so the user can download it cleanly again
@@ -195,6 +249,9 @@ class BenchmarkController extends _$BenchmarkController {
 
       // Update RAM usage after loading the model
       _updateRamUsage();
+      print('Benchmark CPU backend: ${_llamaService!.cpuBackendInfo()}');
+      print('Benchmark engine: ${_llamaService!.engineConfig()}');
+      print('Benchmark memory: ${_llamaService!.memoryCalibration()}');
 
       // Start inference
       state = state.copyWith(
@@ -210,26 +267,83 @@ class BenchmarkController extends _$BenchmarkController {
       if (workload.isTimeBased) {
         // We loop until the time is up, so if the model finishes one story, it starts another
         // away from the stuttering 16-token loop, but ensuring the test lasts the full duration.
+        // The next pass is always queued behind the running one, so the native worker
+        // moves straight on without a round trip; stopping drops the queued pass too.
+        var current = _startPass(maxTokens: 2048);
         while (state.status == BenchmarkStatus.running || state.status == BenchmarkStatus.preparing) {
-          await _runOnePass(maxTokens: 2048);
+          final next = _startPass(maxTokens: 2048);
+          await _awaitPass(current);
           
           // Check if the timer fired or if we reached the end naturally after the time
           if (_startTime != null && 
               DateTime.now().difference(_startTime!) >= workload.minDuration) {
+            _llamaService?.stopInference();
+            await _awaitPass(next);
             break;
           }
+          current = next;
         }
       } else {
         // Token-based (single pass)
-        await _runOnePass(maxTokens: workload.tokens);
+        await _awaitPass(_startPass(maxTokens: workload.tokens));
       }
 
       _durationTimer?.cancel();
 
+      final perf = _llamaService?.perfCounterReport();
+      if (perf != null) print('Benchmark counters: $perf');
+      final session = _llamaService?.sessionReport();
+      if (session != null) print('Benchmark prompt: $session');
+
+      // The live pass above is cold; the saved number comes from warm, repeated runs
+      RepetitionReport? report;
+      if (state.status == BenchmarkStatus.running || state.status == BenchmarkStatus.preparing) {
+        report = await _llamaService?.runRepetitions(
+          _benchmarkPrompt,
+          tokens: workload.repetitionTokens,
+          warmup: workload.warmupRuns,
+          repetitions: workload.measuredRuns,
+        );
+        if (report != null) {
+          print('Benchmark decode: ${report.decode}');
+          if (report.energy != null) print('Benchmark energy: ${report.energy}');
+          state = state.copyWith(averageSpeed: report.decode.mean, progress: 1.0);
+        }
+      }
+
+      // Score the decode rate against the bandwidth bound of the device
+      RooflineScore? roofline;
+      if (report != null &&
+          (state.status == BenchmarkStatus.running || state.status == BenchmarkStatus.preparing)) {
+        _bandwidth ??= await _llamaService?.measureMemoryBandwidth();
+        final bytesPerToken = _llamaService?.decodeBytesPerToken(
+              report.promptTokens + report.tokensPerRepetition ~/ 2,
+            ) ??
+            0;
+        if (_bandwidth != null && bytesPerToken > 0) {
+          roofline = RooflineScore(
+            bandwidthGBps: _bandwidth!.bestGBps,
+            bytesPerToken: bytesPerToken,
+            measuredTokensPerSecond: report.decode.mean,
+          );
+          print('Benchmark bandwidth: $_bandwidth');
+          print('Benchmark roofline: $roofline');
+        }
+      }
+
+      // What the engine config costs in quality, measured with the same config
+      PerplexityReport? perplexity;
+      if (report != null &&
+          (state.status == BenchmarkStatus.running || state.status == BenchmarkStatus.preparing)) {
+        final corpus = await rootBundle.loadString(_perplexityCorpus);
+        perplexity = await _llamaService?.runPerplexity(corpus);
+        if (perplexity != null) print('Benchmark perplexity: $perplexity');
+      }
+
       // Check if we were cancelled during the loop
       if (state.status == BenchmarkStatus.running || state.status == BenchmarkStatus.preparing) {
         // Save result
-        await _saveResult();
+        await _saveResult(report, roofline, perplexity);
         state = state.copyWith(status: BenchmarkStatus.completed);
       }
       
@@ -248,23 +362,20 @@ class BenchmarkController extends _$BenchmarkController {
     }
   }
 
-  Future<void> _runOnePass({required int maxTokens}) async {
-    if (_llamaService == null) return;
-
-    // Start inference
-    await _llamaService!.runInference(
-      'Write a short story about artificial intelligence:',
+  /// Queue a generation pass on the engine worker; completes when it has finished
+  Future<int> _startPass({required int maxTokens}) {
+    if (_llamaService == null) return Future.value(LlamaService.cancelledResult);
+    return _llamaService!.runInference(
+      _benchmarkPrompt,
       maxTokens: maxTokens,
     );
-    
+  }
+
+  Future<void> _awaitPass(Future<int> pass) async {
     try {
-      // Wait for completion
-      // We listen to the status stream for "Inference complete"
-      await _llamaService!.statusStream.firstWhere(
-        (msg) => msg.startsWith('Inference complete') || msg.startsWith('Error'),
-      );
+      await pass;
     } catch (_) {
-      // Stream swallowed/closed - likely due to manual stop
+      // Service torn down - likely due to manual stop
       if (state.status != BenchmarkStatus.running && state.status != BenchmarkStatus.preparing) {
         return;
       }
@@ -419,6 +530,7 @@ class BenchmarkController extends _$BenchmarkController {
 
         final strategyWithProgress = OnlineModelStrategy(
           downloadUrl: strategy.downloadUrl,
+          manifestUrl: strategy.manifestUrl,
           modelName: strategy.modelName,
           sizeMB: strategy.expectedSizeMB,
           onProgress: (progress) {
@@ -461,13 +573,22 @@ class BenchmarkController extends _$BenchmarkController {
     }
   }
 
+  /// Engine parameters for the next benchmark's model load, e.g. the
+  /// [BenchmarkResult.engineConfig] of a stored result to reproduce it
+  void setEngineConfig(EngineConfig config) {
+    _engineConfig = config;
+  }
+
   void _onStatusUpdate(String status) {
     // Log status updates (could be displayed in UI)
     print('Benchmark status: $status');
   }
 
-  /// Save benchmark result to Hive
-  Future<void> _saveResult() async {
+  /// Save benchmark result to Hive.
+  /// With a repetition [report] the speed is the outlier-filtered decode mean.
+  Future<void> _saveResult(RepetitionReport? report, RooflineScore? roofline, PerplexityReport? perplexity) async {
+    final engineConfig = _llamaService?.engineConfig();
+    final energy = report?.energy;
     final deviceInfo = DeviceInfoPlugin();
     String deviceModel = 'Unknown';
 
@@ -486,8 +607,23 @@ class BenchmarkController extends _$BenchmarkController {
       timestamp: DateTime.now(),
       deviceModel: deviceModel,
       aiModelName: state.modelName ?? 'Unknown',
-      tokensPerSecond: state.averageSpeed,
+      tokensPerSecond: report?.decode.mean ?? state.averageSpeed,
       ramUsageMB: state.ramPeakMB, // Save peak RAM
+      tokensPerSecondMedian: report?.decode.median,
+      tokensPerSecondStdDev: report?.decode.stddev,
+      tokensPerSecondCi95Low: report?.decode.ci95Low,
+      tokensPerSecondCi95High: report?.decode.ci95High,
+      repetitions: report?.decode.n,
+      cpuVariant: _llamaService?.cpuBackendInfo().active,
+      memoryBandwidthGBps: roofline?.bandwidthGBps,
+      rooflineEfficiency: roofline?.efficiency,
+      engineConfig: engineConfig != null ? jsonEncode(engineConfig.toJson()) : null,
+      perplexity: perplexity?.perplexity,
+      perplexityTokensPerSecond: perplexity?.evalTokensPerSecond,
+      decodeSamples: report?.decodeSamples,
+      decodeStepMs: report?.decodeStepMs,
+      joulesPerToken: energy != null && energy.valid ? energy.joulesPerToken : null,
+      averageWatts: energy != null && energy.valid ? energy.netAverageWatts : null,
     );
 
     await _repository.saveBenchmark(result);
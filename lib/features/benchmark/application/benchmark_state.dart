@@ -36,15 +36,25 @@ enum BenchmarkStatus {
 }
 
 enum BenchmarkWorkload {
-  quick(50, Duration.zero, 'Quick Scan'),
-  standard(256, Duration(seconds: 15), 'Standard'),
-  stress(1024, Duration(seconds: 60), 'Stress Test');
+  quick(50, Duration.zero, 'Quick Scan', 1, 3, 32),
+  standard(256, Duration(seconds: 15), 'Standard', 1, 5, 64),
+  stress(1024, Duration(seconds: 60), 'Stress Test', 2, 10, 128);
 
   final int tokens;
   final Duration minDuration;
   final String label;
+
+  /// Discarded passes after the live run (page faults, CPU ramp-up)
+  final int warmupRuns;
+
+  /// Measured passes the saved result is computed from
+  final int measuredRuns;
+
+  /// Tokens decoded per warm-up/measured pass
+  final int repetitionTokens;
   
-  const BenchmarkWorkload(this.tokens, this.minDuration, this.label);
+  const BenchmarkWorkload(this.tokens, this.minDuration, this.label,
+      this.warmupRuns, this.measuredRuns, this.repetitionTokens);
   
   bool get isTimeBased => minDuration > Duration.zero;
 }
@@ -1,5 +1,6 @@
 import 'dart:io';
 import 'package:path_provider/path_provider.dart';
+import '../../../core/services/gguf_validator.dart';
 import '../domain/model_type.dart';
 
 /// Helper to check if a model has a partial download
@@ -16,11 +17,11 @@ class PartialDownloadChecker {
       if (!await file.exists()) return false;
       
       final existingSize = await file.length();
-      final expectedSize = (modelType.sizeMB * 1024 * 1024).toInt();
-      final tolerance = (expectedSize * 0.05).toInt();
-      
-      // If file exists but is not complete, it's a partial download
-      return existingSize > 0 && existingSize < (expectedSize - tolerance);
+      if (existingSize == 0) return false;
+
+      // If the header is valid but tensor data is missing, it's a partial download
+      final report = await GgufValidator.validate(filePath);
+      return report.status == GgufStatus.truncated;
     } catch (e) {
       return false;
     }
@@ -1,3 +1,5 @@
+import 'dart:convert';
+
 import 'package:hive/hive.dart';
 
 part 'benchmark_result.g.dart';
@@ -19,14 +21,102 @@ class BenchmarkResult extends HiveObject {
   @HiveField(4)
   final double ramUsageMB;
 
+  // Repetition statistics; null for results saved before they were measured
+  @HiveField(5)
+  final double? tokensPerSecondMedian;
+
+  @HiveField(6)
+  final double? tokensPerSecondStdDev;
+
+  @HiveField(7)
+  final double? tokensPerSecondCi95Low;
+
+  @HiveField(8)
+  final double? tokensPerSecondCi95High;
+
+  @HiveField(9)
+  final int? repetitions;
+
+  /// ggml CPU backend variant the run used, e.g. "android_armv8.2_1"
+  @HiveField(10)
+  final String? cpuVariant;
+
+  /// Best STREAM rate of the device, the bound behind [rooflineEfficiency]
+  @HiveField(11)
+  final double? memoryBandwidthGBps;
+
+  /// Decode speed as a fraction of bandwidth / bytes read per token
+  @HiveField(12)
+  final double? rooflineEfficiency;
+
+  /// Effective engine config as JSON (EngineConfig.toJson), enough to rerun the benchmark
+  @HiveField(13)
+  final String? engineConfig;
+
+  /// Perplexity on the bundled evaluation text with the same engine config,
+  /// the quality side of [tokensPerSecond]
+  @HiveField(14)
+  final double? perplexity;
+
+  /// Batched evaluation speed of the perplexity run
+  @HiveField(15)
+  final double? perplexityTokensPerSecond;
+
+  /// Decode speed of each repetition, the raw samples behind [tokensPerSecondMedian]
+  @HiveField(16)
+  final List<double>? decodeSamples;
+
+  /// Latency of every decode step of the repetitions, in ms
+  @HiveField(17)
+  final List<double>? decodeStepMs;
+
+  /// Battery energy per generated token above the idle draw, in joules, and
+  /// the mean power above idle while decoding; null without a valid reading
+  @HiveField(18)
+  final double? joulesPerToken;
+
+  @HiveField(19)
+  final double? averageWatts;
+
   BenchmarkResult({
     required this.timestamp,
     required this.deviceModel,
     required this.aiModelName,
     required this.tokensPerSecond,
     required this.ramUsageMB,
+    this.tokensPerSecondMedian,
+    this.tokensPerSecondStdDev,
+    this.tokensPerSecondCi95Low,
+    this.tokensPerSecondCi95High,
+    this.repetitions,
+    this.cpuVariant,
+    this.memoryBandwidthGBps,
+    this.rooflineEfficiency,
+    this.engineConfig,
+    this.perplexity,
+    this.perplexityTokensPerSecond,
+    this.decodeSamples,
+    this.decodeStepMs,
+    this.joulesPerToken,
+    this.averageWatts,
   });
 
+  /// One line of the JSONL export read by tools/regress_compare (ng_regress)
+  Map<String, dynamic> toJson() => {
+        'timestamp': timestamp.toIso8601String(),
+        'device': deviceModel,
+        'model': aiModelName,
+        'cpu_variant': cpuVariant,
+        'engine_config': engineConfig != null ? jsonDecode(engineConfig!) : null,
+        'tokens_per_second': tokensPerSecond,
+        'repetitions': repetitions,
+        'perplexity': perplexity,
+        'decode_samples': decodeSamples ?? const <double>[],
+        'decode_step_ms': decodeStepMs ?? const <double>[],
+        'joules_per_token': joulesPerToken,
+        'avg_watts': averageWatts,
+      };
+
   @override
   String toString() {
     return 'BenchmarkResult('
@@ -34,6 +124,10 @@ class BenchmarkResult extends HiveObject {
         'device: $deviceModel, '
         'model: $aiModelName, '
         'speed: ${tokensPerSecond.toStringAsFixed(2)} t/s, '
+        '${tokensPerSecondCi95Low != null ? 'ci95: ${tokensPerSecondCi95Low!.toStringAsFixed(2)}-${tokensPerSecondCi95High!.toStringAsFixed(2)}, ' : ''}'
+        '${perplexity != null ? 'ppl: ${perplexity!.toStringAsFixed(3)}, ' : ''}'
+        '${rooflineEfficiency != null ? 'roofline: ${(rooflineEfficiency! * 100).toStringAsFixed(0)}%, ' : ''}'
+        '${joulesPerToken != null ? 'energy: ${(joulesPerToken! * 1000).toStringAsFixed(1)} mJ/token, ' : ''}'
         'ram: ${ramUsageMB.toStringAsFixed(1)} MB'
         ')';
   }
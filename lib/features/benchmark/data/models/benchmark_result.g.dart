@@ -22,13 +22,28 @@ class BenchmarkResultAdapter extends TypeAdapter<BenchmarkResult> {
       aiModelName: fields[2] as String,
       tokensPerSecond: fields[3] as double,
       ramUsageMB: fields[4] as double,
+      tokensPerSecondMedian: fields[5] as double?,
+      tokensPerSecondStdDev: fields[6] as double?,
+      tokensPerSecondCi95Low: fields[7] as double?,
+      tokensPerSecondCi95High: fields[8] as double?,
+      repetitions: fields[9] as int?,
+      cpuVariant: fields[10] as String?,
+      memoryBandwidthGBps: fields[11] as double?,
+      rooflineEfficiency: fields[12] as double?,
+      engineConfig: fields[13] as String?,
+      perplexity: fields[14] as double?,
+      perplexityTokensPerSecond: fields[15] as double?,
+      decodeSamples: (fields[16] as List?)?.cast<double>(),
+      decodeStepMs: (fields[17] as List?)?.cast<double>(),
+      joulesPerToken: fields[18] as double?,
+      averageWatts: fields[19] as double?,
     );
   }
 
   @override
   void write(BinaryWriter writer, BenchmarkResult obj) {
     writer
-      ..writeByte(5)
+      ..writeByte(20)
       ..writeByte(0)
       ..write(obj.timestamp)
       ..writeByte(1)
@@ -38,7 +53,37 @@ class BenchmarkResultAdapter extends TypeAdapter<BenchmarkResult> {
       ..writeByte(3)
       ..write(obj.tokensPerSecond)
       ..writeByte(4)
-      ..write(obj.ramUsageMB);
+      ..write(obj.ramUsageMB)
+      ..writeByte(5)
+      ..write(obj.tokensPerSecondMedian)
+      ..writeByte(6)
+      ..write(obj.tokensPerSecondStdDev)
+      ..writeByte(7)
+      ..write(obj.tokensPerSecondCi95Low)
+      ..writeByte(8)
+      ..write(obj.tokensPerSecondCi95High)
+      ..writeByte(9)
+      ..write(obj.repetitions)
+      ..writeByte(10)
+      ..write(obj.cpuVariant)
+      ..writeByte(11)
+      ..write(obj.memoryBandwidthGBps)
+      ..writeByte(12)
+      ..write(obj.rooflineEfficiency)
+      ..writeByte(13)
+      ..write(obj.engineConfig)
+      ..writeByte(14)
+      ..write(obj.perplexity)
+      ..writeByte(15)
+      ..write(obj.perplexityTokensPerSecond)
+      ..writeByte(16)
+      ..write(obj.decodeSamples)
+      ..writeByte(17)
+      ..write(obj.decodeStepMs)
+      ..writeByte(18)
+      ..write(obj.joulesPerToken)
+      ..writeByte(19)
+      ..write(obj.averageWatts);
   }
 
   @override
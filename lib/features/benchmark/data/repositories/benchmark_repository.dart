@@ -1,3 +1,6 @@
+import 'dart:convert';
+import 'dart:io';
+
 import 'package:hive_flutter/hive_flutter.dart';
 import '../models/benchmark_result.dart';
 
@@ -55,6 +58,19 @@ class BenchmarkRepository {
         a.tokensPerSecond > b.tokensPerSecond ? a : b);
   }
 
+  /// Write every result as one JSON object per line (oldest first), the input
+  /// format of the ng_regress comparison tool. Returns the number of results.
+  Future<int> exportJsonl(String path) async {
+    await _ensureInitialized();
+    final results = _box!.values.toList()..sort((a, b) => a.timestamp.compareTo(b.timestamp));
+    final sink = File(path).openWrite();
+    for (final result in results) {
+      sink.writeln(jsonEncode(result.toJson()));
+    }
+    await sink.close();
+    return results.length;
+  }
+
   /// Ensure box is initialized
   Future<void> _ensureInitialized() async {
     if (_box == null || !_box!.isOpen) {
@@ -3,6 +3,9 @@ import 'package:connectivity_plus/connectivity_plus.dart';
 import 'package:flutter/services.dart';
 import 'package:http/http.dart' as http;
 import 'package:path_provider/path_provider.dart';
+import '../../../core/services/gguf_validator.dart';
+import '../../../core/services/model_hasher.dart';
+import '../../../core/services/model_region.dart';
 import 'model_strategy.dart';
 import 'model_type.dart';
 
@@ -17,6 +20,9 @@ class ModelManager {
   http.Client? _activeClient;
   bool _isCancelled = false;
 
+  /// Models whose content was hashed and matched their manifest in this launch
+  static final Set<String> _verifiedThisLaunch = {};
+
   /// Check if device has internet connectivity
   Future<bool> hasConnectivity() async {
     final result = await _connectivity.checkConnectivity();
@@ -33,7 +39,7 @@ class ModelManager {
     }
 
     final cachedPath = await _getCachedModelPath(modelType.fileName);
-    if (cachedPath != null && await _isModelFullyDownloaded(cachedPath, modelType.sizeMB)) {
+    if (cachedPath != null && await _isModelFullyDownloaded(cachedPath)) {
       return _CachedModelStrategy(
         cachedPath,
         modelType.displayName,
@@ -43,21 +49,68 @@ class ModelManager {
 
     return OnlineModelStrategy(
       downloadUrl: modelType.downloadUrl,
+      manifestUrl: modelType.manifestUrl,
       modelName: modelType.displayName,
       sizeMB: modelType.sizeMB,
     );
   }
 
-  Future<bool> _isModelFullyDownloaded(String path, double expectedSizeMB) async {
+  Future<bool> _isModelFullyDownloaded(String path) async {
     final file = File(path);
     if (!await file.exists()) return false;
-    
-    final size = await file.length();
-    final expectedSize = (expectedSizeMB * 1024 * 1024).toInt();
-    final tolerance = (expectedSize * 0.05).toInt(); // 5% tolerance
-    
-    // Check if size is within 5% of expected size
-    return (size - expectedSize).abs() < tolerance;
+
+    // Native header check: every tensor must lie inside the file
+    final report = await GgufValidator.validate(path);
+    if (!report.isComplete) return false;
+
+    return _verifyContent(path);
+  }
+
+  /// Hash the model against its manifest, once per launch.
+  /// The published manifest is preferred; without one the model is checked
+  /// against its unverified local manifest, recorded on first use.
+  /// A mismatching model is deleted so it gets downloaded again.
+  Future<bool> _verifyContent(String path) async {
+    if (_verifiedThisLaunch.contains(path)) return true;
+
+    final published = File(ModelHasher.manifestPathFor(path));
+    final local = File(ModelHasher.localManifestPathFor(path));
+    final HashReport report;
+    if (await published.exists() || await local.exists()) {
+      final trusted = await published.exists();
+      report = await ModelHasher.verify(path, manifestPath: trusted ? published.path : local.path);
+      if (report.isMismatch) {
+        print('DEBUG: Model content mismatch, deleting: $report');
+        await File(path).delete();
+        // A published manifest stays: it describes the model, not this copy
+        if (!trusted) await local.delete();
+        return false;
+      }
+      if (!trusted) print('DEBUG: No published manifest, checked against the local one (unverified)');
+    } else {
+      // Nothing published: record what we have, unverified
+      report = await ModelHasher.createManifest(path);
+    }
+
+    print('DEBUG: Model content check: $report');
+    if (report.isOk) _verifiedThisLaunch.add(path);
+    // A hashing error (e.g. mmap failure) is not evidence of corruption
+    return true;
+  }
+
+  /// Fetch the published manifest of a model before downloading it.
+  /// Returns: whether the model has one to be checked against
+  Future<bool> _fetchManifest(OnlineModelStrategy strategy, File modelFile) async {
+    final manifest = File(ModelHasher.manifestPathFor(modelFile.path));
+    if (await manifest.exists()) return true;
+    if (strategy.manifestUrl == null) return false;
+
+    final response = await http.get(Uri.parse(strategy.manifestUrl!));
+    if (response.statusCode != 200) {
+      throw Exception('Failed to download model manifest: ${response.statusCode}');
+    }
+    await manifest.writeAsBytes(response.bodyBytes, flush: true);
+    return true;
   }
 
   /// Download and cache a model from OnlineModelStrategy
@@ -70,17 +123,38 @@ class ModelManager {
       // Create directory if it doesn't exist
       await modelFile.parent.create(recursive: true);
 
+      final hasManifest = await _fetchManifest(strategy, modelFile);
+
       int existingBytes = 0;
       if (await modelFile.exists()) {
         existingBytes = await modelFile.length();
       }
 
-      final expectedSize = (strategy.expectedSizeMB * 1024 * 1024).toInt();
-      final tolerance = (expectedSize * 0.05).toInt(); // 5% tolerance
-      
-      // If already fully downloaded
-      if (existingBytes >= expectedSize - tolerance && existingBytes <= expectedSize + tolerance) {
-        return modelFile.path;
+      if (existingBytes > 0) {
+        final report = await GgufValidator.validate(modelFile.path);
+        // If already fully downloaded
+        if (report.isComplete) {
+          return modelFile.path;
+        }
+        // A corrupt file can't be resumed, start over
+        if (report.status == GgufStatus.corrupt) {
+          await modelFile.delete();
+          existingBytes = 0;
+        }
+      }
+
+      if (existingBytes > 0 && hasManifest) {
+        // Resume after the chunks that match the manifest, so every chunk of the
+        // finished file has been checked once
+        final prefix = await ModelHasher.verifyPrefix(modelFile.path);
+        final intact = prefix.intactPrefixBytes;
+        if (intact < existingBytes) {
+          print('DEBUG: Resuming download at $intact of $existingBytes bytes: $prefix');
+          final file = await modelFile.open(mode: FileMode.append);
+          await file.truncate(intact);
+          await file.close();
+          existingBytes = intact;
+        }
       }
 
       _isCancelled = false;
@@ -97,15 +171,11 @@ class ModelManager {
       // Handle 416 Range Not Satisfiable - file is already complete
       if (response.statusCode == 416) {
         _cleanupClient();
-        // Verify the file is actually complete
-        if (existingBytes >= expectedSize - tolerance && existingBytes <= expectedSize + tolerance) {
-          return modelFile.path;
-        } else {
-          // File is corrupt or size mismatch, delete and restart download automatically
-          await modelFile.delete();
-          // Recursive call to start fresh
-          return downloadModel(strategy);
-        }
+        // The server has nothing more to send but the file did not validate above:
+        // it is corrupt, delete and restart download automatically
+        await modelFile.delete();
+        // Recursive call to start fresh
+        return downloadModel(strategy);
       }
 
       // Handle 206 Partial Content or 200 OK
@@ -145,6 +215,35 @@ class ModelManager {
         _cleanupClient();
       }
 
+      // Check the header and tensor extents now instead of finding out in load_model
+      final report = await GgufValidator.validate(modelFile.path);
+      if (!report.isComplete) {
+        if (report.status == GgufStatus.corrupt) {
+          await modelFile.delete();
+        }
+        throw Exception('Downloaded model failed validation: ${report.error}');
+      }
+
+      if (hasManifest) {
+        // verifyPrefix checked the bytes before the resume point; only the chunks
+        // written by this download need hashing
+        final hash = await ModelHasher.verify(
+          modelFile.path,
+          fromOffset: isResuming ? existingBytes : 0,
+        );
+        if (hash.isMismatch) {
+          await modelFile.delete();
+          throw Exception('Downloaded model failed content check: $hash');
+        }
+        if (hash.isOk) _verifiedThisLaunch.add(modelFile.path);
+      } else {
+        // Nothing to check the download against: record it, unverified, so later
+        // storage corruption is caught at least
+        final hash = await ModelHasher.createManifest(modelFile.path);
+        print('DEBUG: No published manifest, recorded an unverified one: $hash');
+        if (hash.isOk) _verifiedThisLaunch.add(modelFile.path);
+      }
+
       return modelFile.path;
       
     } catch (e) {
@@ -184,21 +283,27 @@ class ModelManager {
     return targetFile.path;
   }
 
-  /// Copy embedded model from assets to writable location
+  /// Resolve the embedded model for loading.
+  /// On Android the asset is handed to the native loader as an (fd, offset, length)
+  /// region of the APK, so it is never read through the Dart heap. Elsewhere it is
+  /// copied from assets to a writable location.
   Future<String> extractEmbeddedModel(EmbeddedModelStrategy strategy) async {
     final assetPath = await strategy.getModelPath();
     final cacheDir = await getApplicationDocumentsDirectory();
     final fileName = assetPath.split('/').last;
     final targetFile = File('${cacheDir.path}/models/$fileName');
 
+    await targetFile.parent.create(recursive: true);
+    final region = await ModelRegion.openAsset(assetPath, targetFile.path);
+    if (region != null) {
+      return region.uri;
+    }
+
     // Check if already extracted
     if (await targetFile.exists()) {
       return targetFile.path;
     }
 
-    // Create directory
-    await targetFile.parent.create(recursive: true);
-
     // Copy from assets
     final byteData = await rootBundle.load(assetPath);
     final buffer = byteData.buffer;
@@ -209,6 +314,14 @@ class ModelManager {
     return targetFile.path;
   }
 
+  /// Directory for KV session snapshots of prefilled prompts
+  Future<String> sessionCacheDir() async {
+    final cacheDir = await getApplicationDocumentsDirectory();
+    final dir = Directory('${cacheDir.path}/kv_sessions');
+    await dir.create(recursive: true);
+    return dir.path;
+  }
+
   /// Get cached model path if it exists
   Future<String?> _getCachedModelPath(String fileName) async {
     final cacheDir = await getApplicationDocumentsDirectory();
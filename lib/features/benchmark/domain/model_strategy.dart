@@ -44,6 +44,9 @@ class OfflineModelStrategy implements ModelStrategy {
 /// Strategy for downloading a model from a URL
 class OnlineModelStrategy implements ModelStrategy {
   final String downloadUrl;
+
+  /// Published content manifest of the model, null if there is none
+  final String? manifestUrl;
   final String _modelName;
   final double _sizeMB;
   
@@ -52,6 +55,7 @@ class OnlineModelStrategy implements ModelStrategy {
 
   OnlineModelStrategy({
     required this.downloadUrl,
+    this.manifestUrl,
     required String modelName,
     required double sizeMB,
     this.onProgress,
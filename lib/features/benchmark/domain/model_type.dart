@@ -53,6 +53,18 @@ extension ModelTypeExtension on ModelType {
     }
   }
   
+  /// Published content manifest of the download (model_hash.cpp format), fetched
+  /// before the model so the download can be checked against it. null while none
+  /// is published: the download then only records an unverified local manifest.
+  String? get manifestUrl {
+    switch (this) {
+      case ModelType.tinyStories:
+      case ModelType.tinyLlama:
+      case ModelType.phi2:
+        return null;
+    }
+  }
+
   String get fileName {
     switch (this) {
       case ModelType.tinyStories: